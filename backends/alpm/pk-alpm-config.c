@@ -31,16 +31,20 @@
 #include "pk-backend-alpm.h"
 #include "pk-alpm-config.h"
 #include "pk-alpm-databases.h"
+#include "pk-alpm-download.h"
 #include "pk-alpm-error.h"
 
 // bad API choice
 static gchar *xfercmd = NULL;
+static GRegex *xo = NULL, *xi = NULL;
+static PkAlpmDownload *prefetched = NULL;
 
 typedef struct
 {
 	 gboolean		 checkspace, color, ilovecandy, totaldl,
 				 usesyslog, verbosepkglists;
 	 gdouble		 deltaratio;
+	 guint			 paralleldownloads;
 
 	 gchar			*arch, *cleanmethod, *dbpath, *gpgdir, *logfile,
 				*root, *xfercmd;
@@ -66,6 +70,7 @@ pk_alpm_config_new (PkBackend *backend)
 	PkAlpmConfig *config = g_new0 (PkAlpmConfig, 1);
 	config->backend = backend;
 	config->deltaratio = 0.0;
+	config->paralleldownloads = 5;
 
 	config->xrepo = g_regex_new ("\\$repo", 0, 0, NULL);
 	config->xarch = g_regex_new ("\\$arch", 0, 0, NULL);
@@ -308,6 +313,22 @@ pk_alpm_config_set_deltaratio (PkAlpmConfig *config, const gchar *number)
 	}
 }
 
+static void
+pk_alpm_config_set_paralleldownloads (PkAlpmConfig *config, const gchar *number)
+{
+	guint64 value;
+	gchar *endptr;
+
+	g_return_if_fail (config != NULL);
+	g_return_if_fail (number != NULL);
+
+	value = g_ascii_strtoull (number, &endptr, 10);
+	/* this ignores invalid values whereas pacman reports an error */
+	if (*endptr == '\0' && 0 < value && value <= 100) {
+		config->paralleldownloads = value;
+	}
+}
+
 static void
 pk_alpm_config_set_xfercmd (PkAlpmConfig *config, const gchar *command)
 {
@@ -332,6 +353,7 @@ static const PkAlpmConfigString pk_alpm_config_string_options[] = {
 	{ "DBPath", pk_alpm_config_set_dbpath },
 	{ "GPGDir", pk_alpm_config_set_gpgdir },
 	{ "LogFile", pk_alpm_config_set_logfile },
+	{ "ParallelDownloads", pk_alpm_config_set_paralleldownloads },
 	{ "RootDir", pk_alpm_config_set_root },
 	{ "UseDelta", pk_alpm_config_set_deltaratio },
 	{ "XferCommand", pk_alpm_config_set_xfercmd },
@@ -865,9 +887,8 @@ pk_alpm_spawn (const gchar *command)
 }
 
 static gint
-pk_alpm_fetchcb (const gchar *url, const gchar *path, gint force)
+pk_alpm_fetch_xfercmd (const gchar *url, const gchar *path, gint force)
 {
-	GRegex *xo, *xi;
 	gint result = 0;
 	g_autofree gchar *basename = NULL;
 	g_autofree gchar *file = NULL;
@@ -876,20 +897,12 @@ pk_alpm_fetchcb (const gchar *url, const gchar *path, gint force)
 	g_autofree gchar *part = NULL;
 	g_autofree gchar *tempcmd = NULL;
 
-	g_return_val_if_fail (url != NULL, -1);
-	g_return_val_if_fail (path != NULL, -1);
-	g_return_val_if_fail (xfercmd != NULL, -1);
-
 	oldpwd = g_get_current_dir ();
 	if (g_chdir (path) < 0) {
 		syslog (LOG_DAEMON | LOG_WARNING, "could not find or read directory '%s'", path);
-		g_free (oldpwd);
 		return -1;
 	}
 
-	xo = g_regex_new ("%o", 0, 0, NULL);
-	xi = g_regex_new ("%u", 0, 0, NULL);
-
 	basename = g_path_get_basename (url);
 	file = g_strconcat (path, basename, NULL);
 	part = g_strconcat (file, ".part", NULL);
@@ -924,14 +937,106 @@ pk_alpm_fetchcb (const gchar *url, const gchar *path, gint force)
 		}
 	}
 out:
-	g_regex_unref (xi);
-	g_regex_unref (xo);
-
 	g_chdir (oldpwd);
 
 	return result;
 }
 
+static gint
+pk_alpm_fetch_curl (const gchar *url, const gchar *path, gint force)
+{
+	PkAlpmDownload *download;
+	PkAlpmDownloadState state = PK_ALPM_DOWNLOAD_STATE_FAILED;
+	const gchar *servers[2];
+	const gchar *slash;
+	g_autofree gchar *basename = NULL;
+	g_autofree gchar *server = NULL;
+	g_autoptr(GError) error = NULL;
+
+	slash = strrchr (url, '/');
+	if (slash == NULL)
+		return -1;
+	server = g_strndup (url, slash - url);
+	basename = g_strdup (slash + 1);
+	servers[0] = server;
+	servers[1] = NULL;
+
+	download = pk_alpm_download_new (1);
+	pk_alpm_download_add (download, basename, servers, path, force == 0);
+	if (pk_alpm_download_run (download, NULL, NULL, NULL, &error)) {
+		state = pk_alpm_download_get_state (download, basename);
+	} else {
+		syslog (LOG_DAEMON | LOG_WARNING, "could not download %s: %s", url, error->message);
+	}
+	pk_alpm_download_free (download);
+
+	switch (state) {
+	case PK_ALPM_DOWNLOAD_STATE_DONE:
+		return 0;
+	case PK_ALPM_DOWNLOAD_STATE_NOT_MODIFIED:
+		return 1;
+	default:
+		return -1;
+	}
+}
+
+static gint
+pk_alpm_fetchcb (const gchar *url, const gchar *path, gint force)
+{
+	g_autofree gchar *basename = NULL;
+	g_autofree gchar *file = NULL;
+
+	g_return_val_if_fail (url != NULL, -1);
+	g_return_val_if_fail (path != NULL, -1);
+
+	basename = g_path_get_basename (url);
+	file = g_build_filename (path, basename, NULL);
+
+	/* already fetched together with the other files */
+	if (prefetched != NULL) {
+		switch (pk_alpm_download_get_state (prefetched, basename)) {
+		case PK_ALPM_DOWNLOAD_STATE_DONE:
+			if (g_file_test (file, G_FILE_TEST_EXISTS))
+				return 0;
+			break;
+		case PK_ALPM_DOWNLOAD_STATE_NOT_MODIFIED:
+			if (force == 0)
+				return 1;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (xfercmd != NULL)
+		return pk_alpm_fetch_xfercmd (url, path, force);
+
+	/* the batch failed for this file, the databases are small enough
+	 * that alpm counts them as a whole rather than by bytes */
+	return pk_alpm_fetch_curl (url, path, force);
+}
+
+/**
+ * pk_alpm_config_set_prefetched:
+ *
+ * Makes alpm use the files of @download instead of fetching them again;
+ * pass %NULL once alpm is done with them. Without XferCommand the fetch
+ * callback is only installed while there is a batch, so that the other
+ * downloads keep the progress reported by alpm itself.
+ **/
+void
+pk_alpm_config_set_prefetched (alpm_handle_t *handle, PkAlpmDownload *download)
+{
+	g_return_if_fail (handle != NULL);
+
+	prefetched = download;
+	if (prefetched != NULL || xfercmd != NULL) {
+		alpm_option_set_fetchcb (handle, pk_alpm_fetchcb);
+	} else {
+		alpm_option_set_fetchcb (handle, NULL);
+	}
+}
+
 static alpm_handle_t *
 pk_alpm_config_configure_alpm (PkBackend *backend, PkAlpmConfig *config, GError **error)
 {
@@ -953,12 +1058,13 @@ pk_alpm_config_configure_alpm (PkBackend *backend, PkAlpmConfig *config, GError
 	g_free (xfercmd);
 	xfercmd = config->xfercmd;
 	config->xfercmd = NULL;
+	priv->parallel_downloads = config->paralleldownloads;
 
-	if (xfercmd != NULL) {
-		alpm_option_set_fetchcb (handle, pk_alpm_fetchcb);
-	} else {
-		alpm_option_set_fetchcb (handle, NULL);
+	if (xfercmd != NULL && xo == NULL) {
+		xo = g_regex_new ("%o", 0, 0, NULL);
+		xi = g_regex_new ("%u", 0, 0, NULL);
 	}
+	pk_alpm_config_set_prefetched (handle, NULL);
 
 	/* backend takes ownership */
 	FREELIST (priv->holdpkgs);
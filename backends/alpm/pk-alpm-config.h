@@ -24,4 +24,9 @@
 #include <alpm.h>
 #include <glib.h>
 
+#include "pk-alpm-download.h"
+
 alpm_handle_t	*pk_alpm_configure	(PkBackend *backend, const gchar *filename, GError **error);
+
+void		 pk_alpm_config_set_prefetched	(alpm_handle_t *handle,
+						 PkAlpmDownload *download);
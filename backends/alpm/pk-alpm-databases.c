@@ -39,6 +39,7 @@ pk_alpm_disabled_repos_configure (PkBackend *backend, gboolean only_trusted, GEr
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
 	const alpm_list_t *i;
 
+	pk_alpm_databases_invalidate (backend);
 	if (alpm_unregister_all_syncdbs (priv->alpm) < 0) {
 		alpm_errno_t errno = alpm_errno (priv->alpm);
 		g_set_error_literal (error, PK_ALPM_ERROR, errno,
@@ -114,6 +115,10 @@ pk_alpm_destroy_databases (PkBackend *backend)
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
 	alpm_list_t *i;
 
+	if (priv->replaces != NULL) {
+		g_hash_table_unref (priv->replaces);
+		priv->replaces = NULL;
+	}
 	for (i = priv->configured_repos; i != NULL; i = i->next) {
 		PkBackendRepo *repo = (PkBackendRepo *) i->data;
 		g_free (repo->name);
@@ -123,6 +128,56 @@ pk_alpm_destroy_databases (PkBackend *backend)
 	alpm_list_free (priv->configured_repos);
 }
 
+static GHashTable *
+pk_alpm_databases_build_replaces (alpm_db_t *db)
+{
+	GHashTable *replaces = g_hash_table_new (g_str_hash, g_str_equal);
+	const alpm_list_t *i, *j;
+
+	for (i = alpm_db_get_pkgcache (db); i != NULL; i = i->next) {
+		for (j = alpm_pkg_get_replaces (i->data); j != NULL; j = j->next) {
+			/* the first package in the cache wins, as before */
+			if (!g_hash_table_contains (replaces, j->data))
+				g_hash_table_insert (replaces, j->data, i->data);
+		}
+	}
+
+	return replaces;
+}
+
+alpm_pkg_t *
+pk_alpm_databases_find_replacer (PkBackend *backend, alpm_db_t *db, const gchar *name)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	GHashTable *replaces;
+
+	g_return_val_if_fail (db != NULL, NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	if (priv->replaces == NULL) {
+		priv->replaces = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+							NULL, (GDestroyNotify) g_hash_table_unref);
+	}
+
+	/* built on first use after each load of the sync db */
+	replaces = g_hash_table_lookup (priv->replaces, db);
+	if (replaces == NULL) {
+		replaces = pk_alpm_databases_build_replaces (db);
+		g_hash_table_insert (priv->replaces, db, replaces);
+	}
+
+	return g_hash_table_lookup (replaces, name);
+}
+
+void
+pk_alpm_databases_invalidate (PkBackend *backend)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	if (priv->replaces != NULL)
+		g_hash_table_remove_all (priv->replaces);
+}
+
 static gboolean
 pk_backend_repo_info (PkBackendJob *job, const gchar *repo, gboolean enabled)
 {
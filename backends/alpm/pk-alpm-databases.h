@@ -36,3 +36,9 @@ gboolean	 pk_alpm_enable_signatures		(PkBackend *backend, GError **error);
 gboolean	 pk_alpm_initialize_databases		(PkBackend *backend, GError **error);
 
 void		 pk_alpm_destroy_databases		(PkBackend *backend);
+
+alpm_pkg_t	*pk_alpm_databases_find_replacer	(PkBackend *backend,
+							 alpm_db_t *db,
+							 const gchar *name);
+
+void		 pk_alpm_databases_invalidate		(PkBackend *backend);
@@ -0,0 +1,349 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <curl/curl.h>
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <utime.h>
+
+#include "pk-alpm-download.h"
+
+typedef struct
+{
+	PkAlpmDownload		*download;
+	gchar			*basename;
+	gchar			**servers;
+	guint			 server;
+	gchar			*path;
+	gchar			*part;
+	gboolean		 conditional;
+	PkAlpmDownloadState	 state;
+	goffset			 received;
+	FILE			*file;
+	CURL			*curl;
+} PkAlpmDownloadItem;
+
+struct PkAlpmDownload
+{
+	GPtrArray		*items;
+	GHashTable		*by_basename;
+	guint			 max_per_host;
+	guint			 active;
+	PkAlpmDownloadFunc	 func;
+	gpointer		 user_data;
+};
+
+static void
+pk_alpm_download_item_free (PkAlpmDownloadItem *item)
+{
+	if (item->curl != NULL)
+		curl_easy_cleanup (item->curl);
+	if (item->file != NULL)
+		fclose (item->file);
+	g_free (item->basename);
+	g_strfreev (item->servers);
+	g_free (item->path);
+	g_free (item->part);
+	g_free (item);
+}
+
+PkAlpmDownload *
+pk_alpm_download_new (guint max_per_host)
+{
+	PkAlpmDownload *download = g_new0 (PkAlpmDownload, 1);
+
+	download->items = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_alpm_download_item_free);
+	download->by_basename = g_hash_table_new (g_str_hash, g_str_equal);
+	download->max_per_host = MAX (max_per_host, 1);
+	return download;
+}
+
+void
+pk_alpm_download_free (PkAlpmDownload *download)
+{
+	g_return_if_fail (download != NULL);
+
+	g_hash_table_unref (download->by_basename);
+	g_ptr_array_unref (download->items);
+	g_free (download);
+}
+
+void
+pk_alpm_download_add (PkAlpmDownload *download, const gchar *basename,
+		      const gchar *const *servers, const gchar *directory,
+		      gboolean conditional)
+{
+	PkAlpmDownloadItem *item;
+
+	g_return_if_fail (download != NULL);
+	g_return_if_fail (basename != NULL);
+	g_return_if_fail (servers != NULL);
+	g_return_if_fail (directory != NULL);
+
+	if (g_hash_table_contains (download->by_basename, basename))
+		return;
+
+	item = g_new0 (PkAlpmDownloadItem, 1);
+	item->download = download;
+	item->basename = g_strdup (basename);
+	item->servers = g_strdupv ((gchar **) servers);
+	item->path = g_build_filename (directory, basename, NULL);
+	item->part = g_strconcat (item->path, ".part", NULL);
+	item->conditional = conditional;
+	item->state = PK_ALPM_DOWNLOAD_STATE_PENDING;
+
+	g_ptr_array_add (download->items, item);
+	g_hash_table_insert (download->by_basename, item->basename, item);
+}
+
+static int
+pk_alpm_download_item_progress (void *data, curl_off_t dltotal, curl_off_t dlnow,
+				curl_off_t ultotal, curl_off_t ulnow)
+{
+	PkAlpmDownloadItem *item = (PkAlpmDownloadItem *) data;
+	PkAlpmDownload *download = item->download;
+
+	/* the complete file is reported once it has been renamed */
+	if (download->func == NULL || dltotal <= 0 || dlnow >= dltotal)
+		return 0;
+	if (dlnow == item->received)
+		return 0;
+
+	item->received = dlnow;
+	download->func (item->basename, dlnow, dltotal, download->user_data);
+	return 0;
+}
+
+static void
+pk_alpm_download_item_start (PkAlpmDownload *download, CURLM *multi,
+			     PkAlpmDownloadItem *item)
+{
+	const gchar *server = item->servers[item->server];
+	g_autofree gchar *url = NULL;
+	GStatBuf buf;
+
+	/* all mirrors tried */
+	if (server == NULL) {
+		item->state = PK_ALPM_DOWNLOAD_STATE_FAILED;
+		return;
+	}
+
+	if (g_str_has_suffix (server, "/")) {
+		url = g_strconcat (server, item->basename, NULL);
+	} else {
+		url = g_strconcat (server, "/", item->basename, NULL);
+	}
+	item->received = 0;
+
+	item->file = g_fopen (item->part, "wb");
+	if (item->file == NULL) {
+		g_debug ("could not open %s: %s", item->part, g_strerror (errno));
+		item->state = PK_ALPM_DOWNLOAD_STATE_FAILED;
+		return;
+	}
+
+	if (item->curl == NULL) {
+		item->curl = curl_easy_init ();
+	} else {
+		curl_easy_reset (item->curl);
+	}
+
+	curl_easy_setopt (item->curl, CURLOPT_URL, url);
+	curl_easy_setopt (item->curl, CURLOPT_WRITEDATA, item->file);
+	curl_easy_setopt (item->curl, CURLOPT_PRIVATE, item);
+	curl_easy_setopt (item->curl, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt (item->curl, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt (item->curl, CURLOPT_FILETIME, 1L);
+	curl_easy_setopt (item->curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt (item->curl, CURLOPT_CONNECTTIMEOUT, 10L);
+	curl_easy_setopt (item->curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+	curl_easy_setopt (item->curl, CURLOPT_LOW_SPEED_TIME, 10L);
+	curl_easy_setopt (item->curl, CURLOPT_NOPROGRESS, 0L);
+	curl_easy_setopt (item->curl, CURLOPT_XFERINFOFUNCTION, pk_alpm_download_item_progress);
+	curl_easy_setopt (item->curl, CURLOPT_XFERINFODATA, item);
+
+	/* only fetch the file if it is newer than ours */
+	if (item->conditional && g_stat (item->path, &buf) == 0) {
+		curl_easy_setopt (item->curl, CURLOPT_TIMECONDITION,
+				  (long) CURL_TIMECOND_IFMODSINCE);
+		curl_easy_setopt (item->curl, CURLOPT_TIMEVALUE,
+				  (long) buf.st_mtime);
+	}
+
+	curl_multi_add_handle (multi, item->curl);
+	download->active++;
+}
+
+static void
+pk_alpm_download_item_finish (PkAlpmDownload *download, CURLM *multi,
+			      PkAlpmDownloadItem *item, CURLcode result)
+{
+	long unmet = 0;
+	long filetime = -1;
+	GStatBuf buf;
+
+	curl_multi_remove_handle (multi, item->curl);
+	download->active--;
+	fclose (item->file);
+	item->file = NULL;
+
+	if (result != CURLE_OK) {
+		g_debug ("failed to download %s from %s: %s", item->basename,
+			 item->servers[item->server],
+			 curl_easy_strerror (result));
+		g_unlink (item->part);
+		item->server++;
+		pk_alpm_download_item_start (download, multi, item);
+		return;
+	}
+
+	curl_easy_getinfo (item->curl, CURLINFO_CONDITION_UNMET, &unmet);
+	if (unmet != 0) {
+		g_unlink (item->part);
+		item->state = PK_ALPM_DOWNLOAD_STATE_NOT_MODIFIED;
+		return;
+	}
+
+	if (g_rename (item->part, item->path) < 0) {
+		g_debug ("could not rename %s: %s", item->part, g_strerror (errno));
+		g_unlink (item->part);
+		item->state = PK_ALPM_DOWNLOAD_STATE_FAILED;
+		return;
+	}
+
+	/* keep the server time so the next request can be conditional */
+	curl_easy_getinfo (item->curl, CURLINFO_FILETIME, &filetime);
+	if (filetime >= 0) {
+		struct utimbuf times;
+		times.actime = filetime;
+		times.modtime = filetime;
+		g_utime (item->path, &times);
+	}
+	item->state = PK_ALPM_DOWNLOAD_STATE_DONE;
+
+	if (download->func != NULL && g_stat (item->path, &buf) == 0)
+		download->func (item->basename, buf.st_size, buf.st_size, download->user_data);
+}
+
+/**
+ * pk_alpm_download_run:
+ *
+ * Fetches every pending file at once, with at most max_per_host
+ * connections to each mirror. A file that fails on one mirror is tried on
+ * the next one; only setup errors and cancellation make this fail, the
+ * outcome for each file is given by pk_alpm_download_get_state().
+ **/
+gboolean
+pk_alpm_download_run (PkAlpmDownload *download, GCancellable *cancellable,
+		      PkAlpmDownloadFunc func, gpointer user_data,
+		      GError **error)
+{
+	CURLM *multi;
+	gboolean ret = TRUE;
+	gint running = 0;
+	guint i;
+
+	g_return_val_if_fail (download != NULL, FALSE);
+
+	multi = curl_multi_init ();
+	if (multi == NULL) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				     "failed to initialize curl");
+		return FALSE;
+	}
+	curl_multi_setopt (multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+			   (long) download->max_per_host);
+	download->func = func;
+	download->user_data = user_data;
+
+	for (i = 0; i < download->items->len; i++) {
+		PkAlpmDownloadItem *item = g_ptr_array_index (download->items, i);
+		if (item->state == PK_ALPM_DOWNLOAD_STATE_PENDING)
+			pk_alpm_download_item_start (download, multi, item);
+	}
+
+	while (download->active > 0) {
+		CURLMcode code;
+		CURLMsg *msg;
+		gint queued;
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+			ret = FALSE;
+			break;
+		}
+
+		code = curl_multi_perform (multi, &running);
+		if (code != CURLM_OK) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+					     curl_multi_strerror (code));
+			ret = FALSE;
+			break;
+		}
+
+		while ((msg = curl_multi_info_read (multi, &queued)) != NULL) {
+			gchar *data = NULL;
+
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+			curl_easy_getinfo (msg->easy_handle, CURLINFO_PRIVATE, &data);
+			pk_alpm_download_item_finish (download, multi,
+						      (PkAlpmDownloadItem *) data,
+						      msg->data.result);
+		}
+
+		if (download->active > 0)
+			curl_multi_wait (multi, NULL, 0, 500, NULL);
+	}
+
+	/* drop whatever was interrupted */
+	for (i = 0; i < download->items->len; i++) {
+		PkAlpmDownloadItem *item = g_ptr_array_index (download->items, i);
+		if (item->file == NULL)
+			continue;
+		curl_multi_remove_handle (multi, item->curl);
+		fclose (item->file);
+		item->file = NULL;
+		g_unlink (item->part);
+		item->state = PK_ALPM_DOWNLOAD_STATE_FAILED;
+	}
+	download->active = 0;
+	download->func = NULL;
+	download->user_data = NULL;
+
+	curl_multi_cleanup (multi);
+	return ret;
+}
+
+PkAlpmDownloadState
+pk_alpm_download_get_state (PkAlpmDownload *download, const gchar *basename)
+{
+	PkAlpmDownloadItem *item;
+
+	g_return_val_if_fail (download != NULL, PK_ALPM_DOWNLOAD_STATE_FAILED);
+	g_return_val_if_fail (basename != NULL, PK_ALPM_DOWNLOAD_STATE_FAILED);
+
+	item = g_hash_table_lookup (download->by_basename, basename);
+	if (item == NULL)
+		return PK_ALPM_DOWNLOAD_STATE_FAILED;
+	return item->state;
+}
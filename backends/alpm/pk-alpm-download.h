@@ -0,0 +1,58 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <gio/gio.h>
+
+typedef enum {
+	PK_ALPM_DOWNLOAD_STATE_PENDING,
+	PK_ALPM_DOWNLOAD_STATE_DONE,
+	PK_ALPM_DOWNLOAD_STATE_NOT_MODIFIED,
+	PK_ALPM_DOWNLOAD_STATE_FAILED
+} PkAlpmDownloadState;
+
+typedef struct PkAlpmDownload PkAlpmDownload;
+
+/* called with complete < total as data arrives for a file, and once with
+ * complete == total when it is complete; files are fetched concurrently,
+ * so calls for different files are interleaved */
+typedef void	(*PkAlpmDownloadFunc)			(const gchar *basename,
+							 goffset complete,
+							 goffset total,
+							 gpointer user_data);
+
+PkAlpmDownload	*pk_alpm_download_new			(guint max_per_host);
+
+void		 pk_alpm_download_free			(PkAlpmDownload *download);
+
+void		 pk_alpm_download_add			(PkAlpmDownload *download,
+							 const gchar *basename,
+							 const gchar *const *servers,
+							 const gchar *directory,
+							 gboolean conditional);
+
+gboolean	 pk_alpm_download_run			(PkAlpmDownload *download,
+							 GCancellable *cancellable,
+							 PkAlpmDownloadFunc func,
+							 gpointer user_data,
+							 GError **error);
+
+PkAlpmDownloadState pk_alpm_download_get_state		(PkAlpmDownload *download,
+							 const gchar *basename);
@@ -0,0 +1,182 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <curl/curl.h>
+#include <glib/gstdio.h>
+#include <utime.h>
+
+#include "pk-alpm-download.h"
+
+static void
+pk_test_download_write (const gchar *dir, const gchar *name,
+			const gchar *contents, time_t mtime)
+{
+	g_autofree gchar *path = g_build_filename (dir, name, NULL);
+	g_autoptr(GError) error = NULL;
+	struct utimbuf times;
+
+	g_file_set_contents (path, contents, -1, &error);
+	g_assert_no_error (error);
+	times.actime = mtime;
+	times.modtime = mtime;
+	g_assert_cmpint (g_utime (path, &times), ==, 0);
+}
+
+static void
+pk_test_download_check (const gchar *dir, const gchar *name,
+			const gchar *contents)
+{
+	g_autofree gchar *path = g_build_filename (dir, name, NULL);
+	g_autofree gchar *part = g_strconcat (path, ".part", NULL);
+	g_autofree gchar *data = NULL;
+	g_autoptr(GError) error = NULL;
+
+	g_file_get_contents (path, &data, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (data, ==, contents);
+	g_assert (!g_file_test (part, G_FILE_TEST_EXISTS));
+}
+
+static void
+pk_test_download_remove (const gchar *dir, const gchar *name)
+{
+	g_autofree gchar *path = g_build_filename (dir, name, NULL);
+	g_unlink (path);
+}
+
+static void
+pk_test_download_count_cb (const gchar *basename, goffset complete,
+			   goffset total, gpointer user_data)
+{
+	guint *finished = (guint *) user_data;
+	if (complete == total)
+		(*finished)++;
+}
+
+static void
+pk_test_download_func (void)
+{
+	PkAlpmDownload *download;
+	gboolean ret;
+	guint finished = 0;
+	g_autofree gchar *tmp = NULL;
+	g_autofree gchar *mirror1 = NULL;
+	g_autofree gchar *mirror2 = NULL;
+	g_autofree gchar *dest = NULL;
+	g_autofree gchar *url1 = NULL;
+	g_autofree gchar *url2 = NULL;
+	g_autofree gchar *missing = NULL;
+	g_autoptr(GError) error = NULL;
+	const gchar *servers[3];
+	const gchar *broken[2];
+
+	tmp = g_dir_make_tmp ("pk-alpm-XXXXXX", &error);
+	g_assert_no_error (error);
+	mirror1 = g_build_filename (tmp, "mirror1", NULL);
+	mirror2 = g_build_filename (tmp, "mirror2", NULL);
+	dest = g_build_filename (tmp, "sync", NULL);
+	g_assert_cmpint (g_mkdir (mirror1, 0755), ==, 0);
+	g_assert_cmpint (g_mkdir (mirror2, 0755), ==, 0);
+	g_assert_cmpint (g_mkdir (dest, 0755), ==, 0);
+
+	/* the first mirror does not have extra.db */
+	pk_test_download_write (mirror1, "core.db", "core", 1000000000);
+	pk_test_download_write (mirror1, "foo-1-1-x86_64.pkg.tar.xz", "foo", 1000000000);
+	pk_test_download_write (mirror2, "core.db", "stale", 1000000000);
+	pk_test_download_write (mirror2, "extra.db", "extra", 1000000000);
+
+	url1 = g_strconcat ("file://", mirror1, NULL);
+	url2 = g_strconcat ("file://", mirror2, "/", NULL);
+	missing = g_strconcat ("file://", tmp, "/missing", NULL);
+	servers[0] = url1;
+	servers[1] = url2;
+	servers[2] = NULL;
+	broken[0] = missing;
+	broken[1] = NULL;
+
+	/* fetch everything at once */
+	download = pk_alpm_download_new (2);
+	pk_alpm_download_add (download, "core.db", servers, dest, TRUE);
+	pk_alpm_download_add (download, "extra.db", servers, dest, TRUE);
+	pk_alpm_download_add (download, "foo-1-1-x86_64.pkg.tar.xz", servers, dest, FALSE);
+	pk_alpm_download_add (download, "bar-1-1-x86_64.pkg.tar.xz", broken, dest, FALSE);
+	ret = pk_alpm_download_run (download, NULL, pk_test_download_count_cb,
+				    &finished, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (pk_alpm_download_get_state (download, "core.db"), ==, PK_ALPM_DOWNLOAD_STATE_DONE);
+	g_assert_cmpint (pk_alpm_download_get_state (download, "extra.db"), ==, PK_ALPM_DOWNLOAD_STATE_DONE);
+	g_assert_cmpint (pk_alpm_download_get_state (download, "foo-1-1-x86_64.pkg.tar.xz"), ==, PK_ALPM_DOWNLOAD_STATE_DONE);
+	g_assert_cmpint (pk_alpm_download_get_state (download, "bar-1-1-x86_64.pkg.tar.xz"), ==, PK_ALPM_DOWNLOAD_STATE_FAILED);
+	g_assert_cmpint (finished, ==, 3);
+	pk_alpm_download_free (download);
+
+	pk_test_download_check (dest, "core.db", "core");
+	pk_test_download_check (dest, "extra.db", "extra");
+	pk_test_download_check (dest, "foo-1-1-x86_64.pkg.tar.xz", "foo");
+
+	/* unchanged databases are not fetched again */
+	finished = 0;
+	pk_test_download_write (mirror1, "extra.db", "newer", 1100000000);
+	download = pk_alpm_download_new (2);
+	pk_alpm_download_add (download, "core.db", servers, dest, TRUE);
+	pk_alpm_download_add (download, "extra.db", servers, dest, TRUE);
+	ret = pk_alpm_download_run (download, NULL, pk_test_download_count_cb,
+				    &finished, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (pk_alpm_download_get_state (download, "core.db"), ==, PK_ALPM_DOWNLOAD_STATE_NOT_MODIFIED);
+	g_assert_cmpint (pk_alpm_download_get_state (download, "extra.db"), ==, PK_ALPM_DOWNLOAD_STATE_DONE);
+	g_assert_cmpint (finished, ==, 1);
+	pk_alpm_download_free (download);
+
+	pk_test_download_check (dest, "core.db", "core");
+	pk_test_download_check (dest, "extra.db", "newer");
+
+	/* clean up */
+	pk_test_download_remove (dest, "core.db");
+	pk_test_download_remove (dest, "extra.db");
+	pk_test_download_remove (dest, "foo-1-1-x86_64.pkg.tar.xz");
+	pk_test_download_remove (mirror1, "core.db");
+	pk_test_download_remove (mirror1, "extra.db");
+	pk_test_download_remove (mirror1, "foo-1-1-x86_64.pkg.tar.xz");
+	pk_test_download_remove (mirror2, "core.db");
+	pk_test_download_remove (mirror2, "extra.db");
+	g_rmdir (dest);
+	g_rmdir (mirror1);
+	g_rmdir (mirror2);
+	g_rmdir (tmp);
+}
+
+int
+main (int argc, char **argv)
+{
+	gint ret;
+
+	g_test_init (&argc, &argv, NULL);
+	curl_global_init (CURL_GLOBAL_DEFAULT);
+
+	g_test_add_func ("/alpm/download", pk_test_download_func);
+
+	ret = g_test_run ();
+	curl_global_cleanup ();
+	return ret;
+}
@@ -22,6 +22,7 @@
  */
 
 #include "pk-backend-alpm.h"
+#include "pk-alpm-download.h"
 #include "pk-alpm-error.h"
 #include "pk-alpm-packages.h"
 #include "pk-alpm-transaction.h"
@@ -1044,6 +1045,123 @@ pk_alpm_string_build_list (const alpm_list_t *i)
 	return g_string_free (list, FALSE);
 }
 
+static gboolean
+pk_alpm_transaction_is_cached (PkBackend *backend, const gchar *filename)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	const alpm_list_t *i;
+
+	for (i = alpm_option_get_cachedirs (priv->alpm); i != NULL; i = i->next) {
+		g_autofree gchar *path = g_build_filename (i->data, filename, NULL);
+		if (g_file_test (path, G_FILE_TEST_EXISTS))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+typedef struct {
+	GHashTable	*received;
+	guint		 percentage;
+} PkAlpmPrefetch;
+
+static void
+pk_alpm_transaction_prefetch_cb (const gchar *basename, goffset complete,
+				 goffset total, gpointer user_data)
+{
+	PkAlpmPrefetch *prefetch = (PkAlpmPrefetch *) user_data;
+	PkBackendJob *job;
+	GHashTableIter iter;
+	gpointer value;
+	goffset *received;
+	goffset active = 0;
+	guint percentage;
+
+	g_assert (pkalpm_current_job);
+	job = pkalpm_current_job;
+
+	/* packages are reported one at a time as they complete, like alpm
+	 * does, but the bytes of the others count towards the percentage */
+	if (complete == total) {
+		g_hash_table_remove (prefetch->received, basename);
+		pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD);
+		pk_alpm_transaction_download_start (job, basename);
+		dcomplete += total;
+	} else {
+		received = g_hash_table_lookup (prefetch->received, basename);
+		if (received == NULL) {
+			received = g_new0 (goffset, 1);
+			g_hash_table_insert (prefetch->received, g_strdup (basename), received);
+		}
+		*received = complete;
+	}
+
+	g_hash_table_iter_init (&iter, prefetch->received);
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+		active += *((goffset *) value);
+
+	/* a file that is retried on another mirror starts again from zero */
+	percentage = MIN ((dcomplete + active) * 100 / dtotal, 100);
+	if (percentage > prefetch->percentage) {
+		prefetch->percentage = percentage;
+		pk_backend_job_set_percentage (job, percentage);
+	}
+}
+
+static void
+pk_alpm_transaction_prefetch (PkBackendJob *job)
+{
+	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	PkAlpmDownload *download;
+	PkAlpmPrefetch prefetch;
+	const alpm_list_t *i, *cachedirs;
+	off_t total = 0;
+
+	/* alpm would pick deltas over the packages we fetch */
+	if (alpm_option_get_deltaratio (priv->alpm) != 0.0)
+		return;
+
+	cachedirs = alpm_option_get_cachedirs (priv->alpm);
+	if (cachedirs == NULL)
+		return;
+
+	download = pk_alpm_download_new (priv->parallel_downloads);
+	for (i = alpm_trans_get_add (priv->alpm); i != NULL; i = i->next) {
+		alpm_pkg_t *pkg = (alpm_pkg_t *) i->data;
+		const gchar *filename = alpm_pkg_get_filename (pkg);
+		const alpm_list_t *j;
+		g_autoptr(GPtrArray) servers = NULL;
+
+		if (alpm_pkg_get_origin (pkg) != ALPM_PKG_FROM_SYNCDB)
+			continue;
+		if (pk_alpm_transaction_is_cached (backend, filename))
+			continue;
+
+		servers = g_ptr_array_new ();
+		for (j = alpm_db_get_servers (alpm_pkg_get_db (pkg)); j != NULL; j = j->next)
+			g_ptr_array_add (servers, j->data);
+		g_ptr_array_add (servers, NULL);
+
+		pk_alpm_download_add (download, filename,
+				      (const gchar *const *) servers->pdata,
+				      cachedirs->data, FALSE);
+		total += alpm_pkg_get_size (pkg);
+	}
+
+	/* alpm finds the files in the cache and fetches the rest itself */
+	if (total > 0) {
+		prefetch.received = g_hash_table_new_full (g_str_hash, g_str_equal,
+							   g_free, g_free);
+		prefetch.percentage = 0;
+		pk_alpm_transaction_totaldlcb (total);
+		pk_alpm_download_run (download, pk_backend_job_get_cancellable (job),
+				      pk_alpm_transaction_prefetch_cb, &prefetch, NULL);
+		pk_alpm_transaction_totaldlcb (0);
+		g_hash_table_unref (prefetch.received);
+	}
+	pk_alpm_download_free (download);
+}
+
 gboolean
 pk_alpm_transaction_commit (PkBackendJob *job, GError **error)
 {
@@ -1053,6 +1171,10 @@ pk_alpm_transaction_commit (PkBackendJob *job, GError **error)
 	g_autofree gchar *prefix = NULL;
 	gint commit_result;
 
+	if (pk_backend_job_is_cancelled (job))
+		return TRUE;
+
+	pk_alpm_transaction_prefetch (job);
 	if (pk_backend_job_is_cancelled (job))
 		return TRUE;
 
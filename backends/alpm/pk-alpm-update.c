@@ -31,6 +31,8 @@
 #include <errno.h>
 
 #include "pk-backend-alpm.h"
+#include "pk-alpm-config.h"
+#include "pk-alpm-databases.h"
 #include "pk-alpm-error.h"
 #include "pk-alpm-packages.h"
 #include "pk-alpm-transaction.h"
@@ -272,8 +274,13 @@ pk_alpm_update_database (PkBackendJob *job, gint force, alpm_db_t *db, GError **
 		return TRUE;
 
 	result = alpm_db_update (force, db);
-	if (result > 0) {
+	if (result >= 0) {
+		/* the fetch callback does not report progress */
 		dlcb ("", 1, 1);
+	}
+	if (result == 0) {
+		/* the package cache of this db is reloaded */
+		pk_alpm_databases_invalidate (backend);
 	} else if (result < 0) {
 		g_set_error (error, PK_ALPM_ERROR, alpm_errno (priv->alpm), "[%s]: %s",
 				alpm_db_get_name (db),
@@ -284,6 +291,58 @@ pk_alpm_update_database (PkBackendJob *job, gint force, alpm_db_t *db, GError **
 	return pk_alpm_update_set_db_timestamp (db, error);
 }
 
+static gchar **
+pk_alpm_update_build_servers (alpm_db_t *db)
+{
+	const alpm_list_t *i;
+	GPtrArray *servers = g_ptr_array_new ();
+
+	for (i = alpm_db_get_servers (db); i != NULL; i = i->next)
+		g_ptr_array_add (servers, g_strdup (i->data));
+	g_ptr_array_add (servers, NULL);
+	return (gchar **) g_ptr_array_free (servers, FALSE);
+}
+
+static PkAlpmDownload *
+pk_alpm_update_prefetch_databases (PkBackendJob *job, gint force)
+{
+	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	PkAlpmDownload *download;
+	const alpm_list_t *i;
+	g_autofree gchar *syncpath = NULL;
+
+	syncpath = g_build_filename (alpm_option_get_dbpath (priv->alpm), "sync", NULL);
+	download = pk_alpm_download_new (priv->parallel_downloads);
+
+	/* fetch every stale database at once, alpm then picks them up */
+	for (i = alpm_get_syncdbs (priv->alpm); i != NULL; i = i->next) {
+		alpm_db_t *db = i->data;
+		g_auto(GStrv) servers = NULL;
+		g_autofree gchar *filename = NULL;
+		g_autofree gchar *signame = NULL;
+
+		if (pk_alpm_update_is_db_fresh (job, db))
+			continue;
+
+		servers = pk_alpm_update_build_servers (db);
+		filename = g_strconcat (alpm_db_get_name (db), ".db", NULL);
+		pk_alpm_download_add (download, filename, (const gchar *const *) servers,
+				      syncpath, force == 0);
+
+		if ((alpm_db_get_siglevel (db) & ALPM_SIG_DATABASE) != 0) {
+			signame = g_strconcat (filename, ".sig", NULL);
+			pk_alpm_download_add (download, signame, (const gchar *const *) servers,
+					      syncpath, FALSE);
+		}
+	}
+
+	/* anything that failed is tried again by alpm */
+	pk_alpm_download_run (download, pk_backend_job_get_cancellable (job),
+			      NULL, NULL, NULL);
+	return download;
+}
+
 static gboolean
 pk_alpm_update_databases (PkBackendJob *job, gint force, GError **error)
 {
@@ -292,6 +351,7 @@ pk_alpm_update_databases (PkBackendJob *job, gint force, GError **error)
 	alpm_cb_totaldl totaldlcb;
 	gboolean ret;
 	const alpm_list_t *i;
+	PkAlpmDownload *download;
 
 	if (!pk_alpm_transaction_initialize (job, 0, NULL, error))
 		return FALSE;
@@ -305,6 +365,9 @@ pk_alpm_update_databases (PkBackendJob *job, gint force, GError **error)
 	i = alpm_get_syncdbs (priv->alpm);
 	totaldlcb (-alpm_list_count (i));
 
+	download = pk_alpm_update_prefetch_databases (job, force);
+	pk_alpm_config_set_prefetched (priv->alpm, download);
+
 	for (; i != NULL; i = i->next) {
 		if (pk_backend_job_is_cancelled (job)) {
 			/* pretend to be finished */
@@ -320,6 +383,9 @@ pk_alpm_update_databases (PkBackendJob *job, gint force, GError **error)
 
 	totaldlcb (0);
 
+	pk_alpm_config_set_prefetched (priv->alpm, NULL);
+	pk_alpm_download_free (download);
+
 	if (i == NULL)
 		return pk_alpm_transaction_end (job, error);
 	pk_alpm_transaction_end (job, NULL);
@@ -330,17 +396,15 @@ static gboolean
 pk_alpm_pkg_is_ignorepkg (PkBackend *backend, alpm_pkg_t *pkg)
 {
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
-	const alpm_list_t *ignorepkgs, *ignoregroups, *i;
+	const alpm_list_t *i;
 
 	g_return_val_if_fail (pkg != NULL, TRUE);
 
-	ignorepkgs = alpm_option_get_ignorepkgs (priv->alpm);
-	if (alpm_list_find_str (ignorepkgs, alpm_pkg_get_name (pkg)) != NULL)
+	if (g_hash_table_contains (priv->ignorepkg_set, alpm_pkg_get_name (pkg)))
 		return TRUE;
 
-	ignoregroups = alpm_option_get_ignoregroups (priv->alpm);
 	for (i = alpm_pkg_get_groups (pkg); i != NULL; i = i->next) {
-		if (alpm_list_find_str (ignoregroups, i->data) != NULL)
+		if (g_hash_table_contains (priv->ignoregroup_set, i->data))
 			return TRUE;
 	}
 
@@ -348,28 +412,17 @@ pk_alpm_pkg_is_ignorepkg (PkBackend *backend, alpm_pkg_t *pkg)
 }
 
 static gboolean
-pk_alpm_pkg_is_syncfirst (alpm_list_t *syncfirsts, alpm_pkg_t *pkg)
+pk_alpm_pkg_is_syncfirst (GHashTable *syncfirsts, alpm_pkg_t *pkg)
 {
 	g_return_val_if_fail (pkg != NULL, FALSE);
-	if (alpm_list_find_str (syncfirsts, alpm_pkg_get_name (pkg)) != NULL)
-		return TRUE;
-	return FALSE;
-}
-
-static gboolean
-pk_alpm_pkg_replaces (alpm_pkg_t *pkg, const gchar *name)
-{
-	g_return_val_if_fail (pkg != NULL, FALSE);
-	g_return_val_if_fail (name != NULL, FALSE);
-
-	return alpm_list_find_str (alpm_pkg_get_replaces (pkg), name) != NULL;
+	return g_hash_table_contains (syncfirsts, alpm_pkg_get_name (pkg));
 }
 
 static alpm_pkg_t *
-pk_alpm_pkg_find_update (alpm_pkg_t *pkg, const alpm_list_t *dbs)
+pk_alpm_pkg_find_update (PkBackend *backend, alpm_pkg_t *pkg, const alpm_list_t *dbs)
 {
 	const gchar *name;
-	const alpm_list_t *i;
+	alpm_pkg_t *replacer;
 
 	g_return_val_if_fail (pkg != NULL, NULL);
 
@@ -386,11 +439,9 @@ pk_alpm_pkg_find_update (alpm_pkg_t *pkg, const alpm_list_t *dbs)
 			return NULL;
 		}
 
-		i = alpm_db_get_pkgcache (dbs->data);
-		for (; i != NULL; i = i->next) {
-			if (pk_alpm_pkg_replaces (i->data, name))
-				return i->data;
-		}
+		replacer = pk_alpm_databases_find_replacer (backend, dbs->data, name);
+		if (replacer != NULL)
+			return replacer;
 	}
 
 	return NULL;
@@ -433,14 +484,14 @@ pk_backend_get_updates_thread (PkBackendJob *job, GVariant* params, gpointer p)
 	syncdbs = alpm_get_syncdbs (priv->alpm);
 	for (i = alpm_db_get_pkgcache (priv->localdb); i != NULL; i = i->next) {
 		PkInfoEnum info = PK_INFO_ENUM_NORMAL;
-		alpm_pkg_t *upgrade = pk_alpm_pkg_find_update (i->data, syncdbs);
+		alpm_pkg_t *upgrade = pk_alpm_pkg_find_update (backend, i->data, syncdbs);
 		if (upgrade == NULL)
 			continue;
 		if (pk_backend_job_is_cancelled (job))
 			break;
 		if (pk_alpm_pkg_is_ignorepkg (backend, upgrade)) {
 			info = PK_INFO_ENUM_BLOCKED;
-		} else if (pk_alpm_pkg_is_syncfirst (priv->syncfirsts, upgrade)) {
+		} else if (pk_alpm_pkg_is_syncfirst (priv->syncfirst_set, upgrade)) {
 			info = PK_INFO_ENUM_IMPORTANT;
 		}
 
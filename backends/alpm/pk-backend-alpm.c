@@ -23,6 +23,7 @@
 
 #include <config.h>
 
+#include <curl/curl.h>
 #include <glib/gstdio.h>
 #include <glib/gthread.h>
 #include <syslog.h>
@@ -75,6 +76,16 @@ pk_alpm_logcb (alpm_loglevel_t level, const gchar *format, va_list args)
 	}
 }
 
+static GHashTable *
+pk_alpm_list_to_set (const alpm_list_t *list)
+{
+	GHashTable *set = g_hash_table_new_full (g_str_hash, g_str_equal,
+						 g_free, NULL);
+	for (; list != NULL; list = list->next)
+		g_hash_table_add (set, g_strdup (list->data));
+	return set;
+}
+
 static gboolean
 pk_alpm_initialize (PkBackend *backend, GError **error)
 {
@@ -88,6 +99,11 @@ pk_alpm_initialize (PkBackend *backend, GError **error)
 
 	alpm_option_set_logcb (priv->alpm, pk_alpm_logcb);
 
+	/* GetUpdates checks every upgrade against these */
+	priv->ignorepkg_set = pk_alpm_list_to_set (alpm_option_get_ignorepkgs (priv->alpm));
+	priv->ignoregroup_set = pk_alpm_list_to_set (alpm_option_get_ignoregroups (priv->alpm));
+	priv->syncfirst_set = pk_alpm_list_to_set (priv->syncfirsts);
+
 	priv->localdb = alpm_get_localdb (priv->alpm);
 	if (priv->localdb == NULL) {
 		alpm_errno_t errno = alpm_errno (priv->alpm);
@@ -147,6 +163,9 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	priv = g_new0 (PkBackendAlpmPrivate, 1);
 	pk_backend_set_user_data (backend, priv);
 
+	/* used by the downloader, reference counted by curl */
+	curl_global_init (CURL_GLOBAL_DEFAULT);
+
 	if (!pk_alpm_initialize (backend, &error))
 		g_error ("Failed to initialize alpm: %s", error->message);
 	if (!pk_alpm_initialize_databases (backend, &error))
@@ -174,8 +193,16 @@ pk_backend_destroy (PkBackend *backend)
 		alpm_release (priv->alpm);
 	}
 
+	curl_global_cleanup ();
+
 	FREELIST (priv->syncfirsts);
 	FREELIST (priv->holdpkgs);
+	if (priv->ignorepkg_set != NULL)
+		g_hash_table_unref (priv->ignorepkg_set);
+	if (priv->ignoregroup_set != NULL)
+		g_hash_table_unref (priv->ignoregroup_set);
+	if (priv->syncfirst_set != NULL)
+		g_hash_table_unref (priv->syncfirst_set);
 	g_free (priv);
 }
 
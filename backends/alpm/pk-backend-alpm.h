@@ -33,6 +33,11 @@ typedef struct {
 	GFileMonitor    *monitor;
 	alpm_list_t     *configured_repos; /* list of configured repos */
 	gboolean	localdb_changed;
+	guint		parallel_downloads;
+	GHashTable	*ignorepkg_set;
+	GHashTable	*ignoregroup_set;
+	GHashTable	*syncfirst_set;
+	GHashTable	*replaces;	/* sync db -> (replaced name -> pkg) */
 } PkBackendAlpmPrivate;
 
 void		 pk_alpm_run		(PkBackendJob *job, PkStatusEnum status,
@@ -46,9 +46,18 @@
 #include "dnf-backend-vendor.h"
 #include "dnf-backend.h"
 
+typedef enum {
+	DNF_SACK_SOURCE_NONE		= 0,
+	DNF_SACK_SOURCE_SYSTEM		= 1 << 0,
+	DNF_SACK_SOURCE_REMOTE		= 1 << 1,
+	DNF_SACK_SOURCE_ALL		= DNF_SACK_SOURCE_SYSTEM | DNF_SACK_SOURCE_REMOTE
+} DnfSackSource;
+
 typedef struct {
 	DnfSack		*sack;
-	gboolean	 valid;
+	DnfSackAddFlags	 flags;
+	guint		 system_generation;
+	guint		 remote_generation;
 	gchar		*key;
 } DnfSackCacheItem;
 
@@ -57,6 +66,9 @@ typedef struct {
 	DnfContext	*context;
 	GHashTable	*sack_cache;	/* of DnfSackCacheItem */
 	GMutex		 sack_mutex;
+	guint		 system_generation;
+	guint		 remote_generation;
+	guint		 appstream_generation;
 	GTimer		*repos_timer;
 	gchar		*release_ver;
 } PkBackendDnfPrivate;
@@ -99,27 +111,62 @@ pk_backend_supports_parallelization (PkBackend *backend)
 
 /**
  * pk_backend_sack_cache_invalidate:
+ *
+ * Marks the given sources as stale. Cached sacks are only rebuilt when a
+ * source they actually loaded has changed, so an rpmdb change does not
+ * invalidate the remote repo data and vice versa.
  **/
 static void
-pk_backend_sack_cache_invalidate (PkBackend *backend, const gchar *why)
+pk_backend_sack_cache_invalidate (PkBackend *backend,
+				  DnfSackSource sources,
+				  const gchar *why)
 {
-	GList *l;
-	DnfSackCacheItem *cache_item;
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
-	g_autoptr(GList) values = NULL;
 	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
 
-	/* set all the cached sacks as invalid */
-	values = g_hash_table_get_values (priv->sack_cache);
-	for (l = values; l != NULL; l = l->next) {
-		cache_item = l->data;
-		if (cache_item->valid) {
-			g_debug ("invalidating %s as %s", cache_item->key, why);
-			cache_item->valid = FALSE;
-		}
+	if (sources & DNF_SACK_SOURCE_SYSTEM) {
+		g_debug ("invalidating system repo as %s", why);
+		priv->system_generation++;
+	}
+	if (sources & DNF_SACK_SOURCE_REMOTE) {
+		g_debug ("invalidating remote repos as %s", why);
+		priv->remote_generation++;
 	}
 }
 
+/**
+ * dnf_sack_cache_item_is_valid:
+ *
+ * Must be called with the sack mutex held.
+ **/
+static gboolean
+dnf_sack_cache_item_is_valid (PkBackendDnfPrivate *priv,
+			      DnfSackCacheItem *cache_item,
+			      DnfSackSource sources)
+{
+	if (cache_item->sack == NULL)
+		return FALSE;
+	if ((sources & DNF_SACK_SOURCE_SYSTEM) > 0 &&
+	    cache_item->system_generation != priv->system_generation)
+		return FALSE;
+	if ((sources & DNF_SACK_SOURCE_REMOTE) > 0 &&
+	    (cache_item->flags & DNF_SACK_ADD_FLAG_REMOTE) > 0 &&
+	    cache_item->remote_generation != priv->remote_generation)
+		return FALSE;
+	return TRUE;
+}
+
+/**
+ * dnf_sack_cache_item_is_stale_cb:
+ **/
+static gboolean
+dnf_sack_cache_item_is_stale_cb (gpointer key, gpointer value, gpointer user_data)
+{
+	PkBackendDnfPrivate *priv = (PkBackendDnfPrivate *) user_data;
+	DnfSackCacheItem *cache_item = (DnfSackCacheItem *) value;
+	return !dnf_sack_cache_item_is_valid (priv, cache_item, DNF_SACK_SOURCE_ALL);
+}
+
 /**
  * pk_backend_yum_repos_changed_cb:
  **/
@@ -134,7 +181,9 @@ pk_backend_yum_repos_changed_cb (DnfRepoLoader *repo_loader, PkBackend *backend)
 	if (repos == NULL)
 		g_warning ("failed to reload repos: %s", error_local->message);
 
-	pk_backend_sack_cache_invalidate (backend, "yum.repos.d changed");
+	pk_backend_sack_cache_invalidate (backend,
+					  DNF_SACK_SOURCE_REMOTE,
+					  "yum.repos.d changed");
 	pk_backend_repo_list_changed (backend);
 }
 
@@ -157,7 +206,8 @@ pk_backend_context_invalidate_cb (DnfContext *context,
 				 const gchar *message,
 				 PkBackend *backend)
 {
-	pk_backend_sack_cache_invalidate (backend, message);
+	/* the context only emits this when the rpmdb has changed */
+	pk_backend_sack_cache_invalidate (backend, DNF_SACK_SOURCE_SYSTEM, message);
 	pk_backend_installed_db_changed (backend);
 }
 
@@ -314,10 +364,14 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	 *
 	 * notes:
 	 * - this deals with deallocating the sack when the backend is unloaded
-	 * - all the cached sacks are dropped on any transaction that can
-	 *   modify state or if the repos or rpmdb are changed
+	 * - the system repo and the remote repos are tracked with separate
+	 *   generation counters, so a sack is only dropped when a source it
+	 *   actually loaded has changed
+	 * - every sack contains the same system repo, so installed-only
+	 *   queries can be answered from any sack with a current rpmdb
 	 */
 	g_mutex_init (&priv->sack_mutex);
+	priv->appstream_generation = G_MAXUINT;
 	priv->sack_cache = g_hash_table_new_full (g_str_hash,
 						  g_str_equal,
 						  g_free,
@@ -563,10 +617,14 @@ static gboolean
 dnf_utils_add_remote (PkBackendJob *job,
 		      DnfSack *sack,
 		      DnfSackAddFlags flags,
+		      guint remote_generation,
 		      DnfState *state,
 		      GError **error)
 {
+	PkBackend *backend = pk_backend_job_get_backend (job);
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	gboolean refresh_appstream;
 	gboolean ret;
 	DnfState *state_local;
 	GPtrArray *repos;
@@ -596,11 +654,26 @@ dnf_utils_add_remote (PkBackendJob *job,
 	if (!ret)
 		return FALSE;
 
-	/* update the AppStream copies in /var */
-	for (guint i = 0; i < repos->len; i++) {
-		DnfRepo *repo = g_ptr_array_index (repos, i);
-		if (!dnf_utils_refresh_repo_appstream (repo, error))
-			return FALSE;
+	/* update the AppStream copies in /var, unless only the rpmdb has
+	 * changed since we last did this; claim the generation under the
+	 * lock so that parallel jobs do not both refresh */
+	g_mutex_lock (&priv->sack_mutex);
+	refresh_appstream = remote_generation != priv->appstream_generation;
+	if (refresh_appstream)
+		priv->appstream_generation = remote_generation;
+	g_mutex_unlock (&priv->sack_mutex);
+	if (refresh_appstream) {
+		for (guint i = 0; i < repos->len; i++) {
+			DnfRepo *repo = g_ptr_array_index (repos, i);
+			if (!dnf_utils_refresh_repo_appstream (repo, error)) {
+				g_mutex_lock (&priv->sack_mutex);
+				priv->appstream_generation = G_MAXUINT;
+				g_mutex_unlock (&priv->sack_mutex);
+				return FALSE;
+			}
+		}
+	} else {
+		g_debug ("remote repos unchanged, not refreshing AppStream");
 	}
 
 	/* done */
@@ -680,6 +753,9 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	DnfSackAddFlags flags = DNF_SACK_ADD_FLAG_FILELISTS;
 	DnfSackCacheItem *cache_item = NULL;
 	DnfState *state_local;
+	gboolean share_system = FALSE;
+	guint remote_generation;
+	guint system_generation;
 	PkBackend *backend = pk_backend_job_get_backend (job);
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
@@ -705,11 +781,21 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	case PK_ROLE_ENUM_GET_DETAILS:
 	case PK_ROLE_ENUM_WHAT_PROVIDES:
 		flags |= DNF_SACK_ADD_FLAG_UNAVAILABLE;
+		share_system = TRUE;
+		break;
+	case PK_ROLE_ENUM_GET_PACKAGES:
+	case PK_ROLE_ENUM_GET_FILES:
+		share_system = TRUE;
 		break;
 	default:
 		break;
 	}
 
+	/* read-only queries for installed packages filter on the system repo,
+	 * so any sack with an up to date rpmdb can be used */
+	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0)
+		share_system = FALSE;
+
 	/* media repos could disappear at any time */
 	if ((create_flags & DNF_CREATE_SACK_FLAG_USE_CACHE) > 0 &&
 	    dnf_repo_loader_has_removable_repos (dnf_context_get_repo_loader (job_data->context)) &&
@@ -728,22 +814,34 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 
 	/* do we have anything in the cache */
 	cache_key = dnf_utils_create_cache_key (dnf_context_get_release_ver (job_data->context), flags);
+	g_mutex_lock (&priv->sack_mutex);
+	system_generation = priv->system_generation;
+	remote_generation = priv->remote_generation;
 	if ((create_flags & DNF_CREATE_SACK_FLAG_USE_CACHE) > 0) {
-		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
 		cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
-		if (cache_item != NULL && cache_item->sack != NULL) {
-			if (cache_item->valid) {
-				ret = TRUE;
-				g_debug ("using cached sack %s", cache_key);
+		if (cache_item != NULL &&
+		    dnf_sack_cache_item_is_valid (priv, cache_item, DNF_SACK_SOURCE_ALL)) {
+			g_debug ("using cached sack %s", cache_key);
+			sack = g_object_ref (cache_item->sack);
+			g_mutex_unlock (&priv->sack_mutex);
+			return g_steal_pointer (&sack);
+		}
+
+		/* any other sack has an identical system repo */
+		if (share_system) {
+			GHashTableIter iter;
+			g_hash_table_iter_init (&iter, priv->sack_cache);
+			while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &cache_item)) {
+				if (!dnf_sack_cache_item_is_valid (priv, cache_item, DNF_SACK_SOURCE_SYSTEM))
+					continue;
+				g_debug ("using system repo from cached sack %s", cache_item->key);
 				sack = g_object_ref (cache_item->sack);
+				g_mutex_unlock (&priv->sack_mutex);
 				return g_steal_pointer (&sack);
-			} else {
-				/* we have to do this now rather than rely on the
-				 * callback of the hash table */
-				g_hash_table_remove (priv->sack_cache, cache_key);
 			}
 		}
 	}
+	g_mutex_unlock (&priv->sack_mutex);
 
 	/* update status */
 	dnf_state_action_start (state, DNF_STATE_ACTION_QUERY, NULL);
@@ -790,6 +888,7 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0) {
 		state_local = dnf_state_get_child (state);
 		ret = dnf_utils_add_remote (job, sack, flags,
+					    remote_generation,
 					    state_local, error);
 		if (!ret)
 			return NULL;
@@ -802,12 +901,17 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 
 	dnf_sack_filter_modules (sack, dnf_context_get_repos (job_data->context), install_root, NULL);
 
-	/* save in cache */
+	/* save in cache, dropping any sacks that can never be used again */
 	g_mutex_lock (&priv->sack_mutex);
+	g_hash_table_foreach_remove (priv->sack_cache,
+				     dnf_sack_cache_item_is_stale_cb,
+				     priv);
 	cache_item = g_slice_new (DnfSackCacheItem);
 	cache_item->key = g_strdup (cache_key);
 	cache_item->sack = g_object_ref (sack);
-	cache_item->valid = TRUE;
+	cache_item->flags = flags;
+	cache_item->system_generation = system_generation;
+	cache_item->remote_generation = remote_generation;
 	g_debug ("created cached sack %s", cache_item->key);
 	g_hash_table_insert (priv->sack_cache, g_strdup (cache_key), cache_item);
 	g_mutex_unlock (&priv->sack_mutex);
@@ -1648,6 +1752,52 @@ pk_backend_refresh_repo (PkBackendJob *job,
 	return dnf_state_done (state, error);
 }
 
+/**
+ * dnf_utils_add_command_index:
+ *
+ * Adds the executables of the available packages to the index the daemon
+ * saves for command-not-found.
+ */
+static void
+dnf_utils_add_command_index (PkBackendJob *job, DnfSack *sack)
+{
+	const gchar *dirs[] = { "/usr/bin", "/usr/sbin", "/bin", NULL };
+	guint i;
+	guint j;
+	guint k;
+	PkBitfield filters;
+
+	filters = pk_bitfield_from_enums (PK_FILTER_ENUM_NOT_INSTALLED,
+					  PK_FILTER_ENUM_NEWEST,
+					  PK_FILTER_ENUM_ARCH,
+					  PK_FILTER_ENUM_NOT_SOURCE, -1);
+	for (i = 0; dirs[i] != NULL; i++) {
+		HyQuery query;
+		g_autofree gchar *glob = g_strdup_printf ("%s/*", dirs[i]);
+		g_autoptr(GPtrArray) pkglist = NULL;
+
+		query = hy_query_create (sack);
+		hy_query_filter (query, HY_PKG_FILE, HY_GLOB, glob);
+		pkglist = dnf_utils_run_query_with_filters (job, sack, query, filters);
+		hy_query_free (query);
+		for (j = 0; j < pkglist->len; j++) {
+			DnfPackage *pkg = g_ptr_array_index (pkglist, j);
+			g_auto(GStrv) files = dnf_package_get_files (pkg);
+			for (k = 0; files[k] != NULL; k++) {
+				g_autofree gchar *dirname = g_path_get_dirname (files[k]);
+				g_autofree gchar *basename = NULL;
+
+				/* not in a subdirectory */
+				if (g_strcmp0 (dirname, dirs[i]) != 0)
+					continue;
+				basename = g_path_get_basename (files[k]);
+				pk_backend_job_add_command_index (job, basename,
+								  dnf_package_get_package_id (pkg));
+			}
+		}
+	}
+}
+
 /**
  * pk_backend_refresh_cache_thread:
  */
@@ -1777,6 +1927,11 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 		return;
 	}
 
+	/* the remote metadata may have changed, but the rpmdb has not */
+	pk_backend_sack_cache_invalidate (pk_backend_job_get_backend (job),
+					  DNF_SACK_SOURCE_REMOTE,
+					  "repo metadata refreshed");
+
 	/* regenerate the libsolv metadata */
 	state_local = dnf_state_get_child (job_data->state);
 	sack = dnf_utils_create_sack_for_filters (job, 0,
@@ -1787,6 +1942,9 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 		return;
 	}
 
+	/* the file lists are loaded now, so this is cheap */
+	dnf_utils_add_command_index (job, sack);
+
 	/* done */
 	ret = dnf_state_done (job_data->state, &error);
 	if (!ret) {
@@ -2406,40 +2564,16 @@ out:
 }
 
 /**
- * pk_backend_transaction_simulate:
+ * pk_backend_transaction_emit_goal:
  */
-static gboolean
-pk_backend_transaction_simulate (PkBackendJob *job,
-				 DnfState *state,
-				 GError **error)
+static void
+pk_backend_transaction_emit_goal (PkBackendJob *job)
 {
 	DnfDb *db;
 	GPtrArray *pkglist;
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
-	gboolean ret;
-	g_autoptr(GPtrArray) untrusted = NULL;
-
-	/* set state */
-	ret = dnf_state_set_steps (state, error,
-				   99, /* check for untrusted repos */
-				   1, /* emit */
-				   -1);
-	if (!ret)
-		return FALSE;
 
-	/* mark any explicitly-untrusted packages so that the transaction skips
-	 * straight to only_trusted=FALSE after simulate */
-	untrusted = pk_backend_transaction_check_untrusted_repos (job, error);
-	if (untrusted == NULL)
-		return FALSE;
-
-	/* done */
-	if (!dnf_state_done (state, error))
-		return FALSE;
-
-	/* emit what we're going to do */
 	db = dnf_transaction_get_db (job_data->transaction);
-	dnf_emit_package_array (job, PK_INFO_ENUM_UNTRUSTED, untrusted);
 
 	/* remove */
 	pkglist = hy_goal_list_erasures (job_data->goal, NULL);
@@ -2475,11 +2609,92 @@ pk_backend_transaction_simulate (PkBackendJob *job,
 	dnf_db_ensure_origin_pkglist (db, pkglist);
 	dnf_emit_package_list (job, PK_INFO_ENUM_DOWNGRADING, pkglist);
 	g_ptr_array_unref (pkglist);
+}
+
+/**
+ * pk_backend_transaction_simulate:
+ */
+static gboolean
+pk_backend_transaction_simulate (PkBackendJob *job,
+				 DnfState *state,
+				 GError **error)
+{
+	gboolean ret;
+	g_autoptr(GPtrArray) untrusted = NULL;
+
+	/* set state */
+	ret = dnf_state_set_steps (state, error,
+				   99, /* check for untrusted repos */
+				   1, /* emit */
+				   -1);
+	if (!ret)
+		return FALSE;
+
+	/* mark any explicitly-untrusted packages so that the transaction skips
+	 * straight to only_trusted=FALSE after simulate */
+	untrusted = pk_backend_transaction_check_untrusted_repos (job, error);
+	if (untrusted == NULL)
+		return FALSE;
+
+	/* done */
+	if (!dnf_state_done (state, error))
+		return FALSE;
+
+	/* emit what we're going to do */
+	dnf_emit_package_array (job, PK_INFO_ENUM_UNTRUSTED, untrusted);
+	pk_backend_transaction_emit_goal (job);
 
 	/* done */
 	return dnf_state_done (state, error);
 }
 
+/**
+ * pk_backend_transaction_emit_filenames:
+ */
+static void
+pk_backend_transaction_emit_filenames (PkBackendJob *job, GPtrArray *pkglist)
+{
+	DnfPackage *pkg;
+	guint i;
+
+	for (i = 0; i < pkglist->len; i++) {
+		const gchar *files[] = { NULL, NULL };
+		pkg = g_ptr_array_index (pkglist, i);
+		files[0] = dnf_package_get_filename (pkg);
+		if (files[0] == NULL)
+			continue;
+		pk_backend_job_files (job,
+				      dnf_package_get_package_id (pkg),
+				      (gchar **) files);
+	}
+}
+
+/**
+ * pk_backend_transaction_emit_downloads:
+ *
+ * Emits where each package of the goal was downloaded to, so the prepared
+ * update can be checked before it is committed.
+ */
+static void
+pk_backend_transaction_emit_downloads (PkBackendJob *job)
+{
+	GPtrArray *pkglist;
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+
+	pkglist = hy_goal_list_installs (job_data->goal, NULL);
+	pk_backend_transaction_emit_filenames (job, pkglist);
+	g_ptr_array_unref (pkglist);
+	pkglist = hy_goal_list_reinstalls (job_data->goal, NULL);
+	pk_backend_transaction_emit_filenames (job, pkglist);
+	g_ptr_array_unref (pkglist);
+	pkglist = hy_goal_list_upgrades (job_data->goal, NULL);
+	pk_backend_transaction_emit_filenames (job, pkglist);
+	g_ptr_array_unref (pkglist);
+	pkglist = hy_goal_list_downgrades (job_data->goal, NULL);
+	pk_backend_transaction_emit_filenames (job, pkglist);
+	g_ptr_array_unref (pkglist);
+}
+
 /**
  * pk_backend_transaction_download_commit:
  */
@@ -2604,6 +2819,13 @@ pk_backend_transaction_run (PkBackendJob *job,
 	if (!ret)
 		return FALSE;
 
+	/* the daemon saves the solved transaction for the offline update */
+	if (pk_bitfield_contain (job_data->transaction_flags,
+				 PK_TRANSACTION_FLAG_ENUM_ONLY_DOWNLOAD)) {
+		pk_backend_transaction_emit_goal (job);
+		pk_backend_transaction_emit_downloads (job);
+	}
+
 	/* done */
 	return dnf_state_done (state, error);
 }
@@ -3314,6 +3536,76 @@ pk_backend_install_files (PkBackend *backend, PkBackendJob *job,
 	pk_backend_job_thread_create (job, pk_backend_install_files_thread, NULL, NULL);
 }
 
+/**
+ * dnf_utils_goal_from_plan:
+ *
+ * Creates a goal that changes exactly the packages of the plan, so the
+ * solver has no choices left to make. Returns %NULL if the plan does not
+ * match the requested packages or a package is no longer available.
+ */
+static HyGoal
+dnf_utils_goal_from_plan (DnfSack *sack, gchar **package_ids, GPtrArray *plan)
+{
+	DnfPackage *pkg;
+	HyGoal goal;
+	PkPackage *item;
+	guint i;
+	g_autofree gchar **plan_ids = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) hash = NULL;
+
+	/* every requested package has to be part of the plan */
+	plan_ids = g_new0 (gchar *, plan->len + 1);
+	for (i = 0; i < plan->len; i++) {
+		item = g_ptr_array_index (plan, i);
+		plan_ids[i] = (gchar *) pk_package_get_id (item);
+	}
+	for (i = 0; package_ids[i] != NULL; i++) {
+		if (!g_strv_contains ((const gchar * const *) plan_ids, package_ids[i])) {
+			g_debug ("%s is not in the prepared plan", package_ids[i]);
+			return NULL;
+		}
+	}
+	hash = dnf_utils_find_package_ids (sack, plan_ids, &error);
+	if (hash == NULL) {
+		g_debug ("cannot use the prepared plan: %s", error->message);
+		return NULL;
+	}
+
+	goal = hy_goal_create (sack);
+	for (i = 0; i < plan->len; i++) {
+		item = g_ptr_array_index (plan, i);
+		pkg = g_hash_table_lookup (hash, pk_package_get_id (item));
+		if (pkg == NULL) {
+			g_debug ("%s from the prepared plan is not available",
+				 pk_package_get_id (item));
+			hy_goal_free (goal);
+			return NULL;
+		}
+		switch (pk_package_get_info (item)) {
+		case PK_INFO_ENUM_REMOVING:
+		case PK_INFO_ENUM_OBSOLETING:
+			hy_goal_erase (goal, pkg);
+			break;
+		case PK_INFO_ENUM_DOWNGRADING:
+			hy_goal_downgrade_to (goal, pkg);
+			break;
+		case PK_INFO_ENUM_UPDATING:
+			/* allow some packages to have multiple versions installed */
+			if (dnf_package_is_installonly (pkg))
+				hy_goal_install (goal, pkg);
+			else
+				hy_goal_upgrade_to (goal, pkg);
+			break;
+		default:
+			hy_goal_install (goal, pkg);
+			break;
+		}
+	}
+	g_debug ("using the prepared plan of %u packages", plan->len);
+	return goal;
+}
+
 /**
  * pk_backend_update_packages_thread:
  */
@@ -3323,6 +3615,7 @@ pk_backend_update_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 	DnfState *state_local;
 	DnfPackage *pkg;
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	GPtrArray *plan;
 	PkBitfield filters;
 	gboolean ret;
 	guint i;
@@ -3382,22 +3675,29 @@ pk_backend_update_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 		return;
 	}
 
+	/* use the transaction that was solved when the update was prepared */
+	plan = pk_backend_job_get_prepared_plan (job);
+	if (plan != NULL)
+		job_data->goal = dnf_utils_goal_from_plan (sack, package_ids, plan);
+
 	/* install packages */
-	job_data->goal = hy_goal_create (sack);
-	for (i = 0; package_ids[i] != NULL; i++) {
-		pkg = g_hash_table_lookup (hash, package_ids[i]);
-		if (pkg == NULL) {
-			pk_backend_job_error_code (job,
-						   PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
-						   "Failed to find %s", package_ids[i]);
-			return;
-		}
+	if (job_data->goal == NULL) {
+		job_data->goal = hy_goal_create (sack);
+		for (i = 0; package_ids[i] != NULL; i++) {
+			pkg = g_hash_table_lookup (hash, package_ids[i]);
+			if (pkg == NULL) {
+				pk_backend_job_error_code (job,
+							   PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
+							   "Failed to find %s", package_ids[i]);
+				return;
+			}
 
-		/* allow some packages to have multiple versions installed */
-		if (dnf_package_is_installonly (pkg))
-			hy_goal_install (job_data->goal, pkg);
-		else
-			hy_goal_upgrade_to (job_data->goal, pkg);
+			/* allow some packages to have multiple versions installed */
+			if (dnf_package_is_installonly (pkg))
+				hy_goal_install (job_data->goal, pkg);
+			else
+				hy_goal_upgrade_to (job_data->goal, pkg);
+		}
 	}
 
 	/* run transaction */
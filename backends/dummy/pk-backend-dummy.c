@@ -48,6 +48,7 @@ typedef struct {
 	gchar		**values;
 	PkBitfield	 filters;
 	gboolean	 fake_db_locked;
+	guint		 synthetic_size;
 } PkBackendDummyPrivate;
 
 typedef struct {
@@ -72,6 +73,13 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	priv->repo_enabled_devel = TRUE;
 	priv->repo_enabled_livna = TRUE;
 	priv->use_trusted = TRUE;
+
+	/* replace the hard-coded packages with a generated repository */
+	priv->synthetic_size = g_key_file_get_integer (conf, "Daemon",
+						       "DummySyntheticPackages",
+						       NULL);
+	if (priv->synthetic_size > 0)
+		g_debug ("using %u synthetic packages", priv->synthetic_size);
 }
 
 /**
@@ -120,6 +128,275 @@ pk_backend_get_mime_types (PkBackend *backend)
 	return g_strdupv ((gchar **) mime_types);
 }
 
+/**
+ * pk_backend_synthetic_is_installed:
+ *
+ * The synthetic repository is generated from the package index alone so
+ * that every run sees exactly the same packages: a quarter of them are
+ * installed, and every fifth installed package has an update.
+ */
+static gboolean
+pk_backend_synthetic_is_installed (guint idx)
+{
+	return idx % 4 == 0;
+}
+
+/**
+ * pk_backend_synthetic_has_update:
+ */
+static gboolean
+pk_backend_synthetic_has_update (guint idx)
+{
+	return idx % 20 == 0;
+}
+
+/**
+ * pk_backend_synthetic_get_name:
+ */
+static gchar *
+pk_backend_synthetic_get_name (guint idx)
+{
+	return g_strdup_printf ("synthetic%06u", idx);
+}
+
+/**
+ * pk_backend_synthetic_get_id:
+ */
+static gchar *
+pk_backend_synthetic_get_id (guint idx, gboolean update)
+{
+	if (update)
+		return g_strdup_printf ("synthetic%06u;1.1-1;x86_64;synthetic", idx);
+	if (pk_backend_synthetic_is_installed (idx))
+		return g_strdup_printf ("synthetic%06u;1.0-1;x86_64;installed", idx);
+	return g_strdup_printf ("synthetic%06u;1.0-1;x86_64;synthetic", idx);
+}
+
+/**
+ * pk_backend_synthetic_get_index:
+ *
+ * Accepts a package name or a package-id.
+ */
+static gboolean
+pk_backend_synthetic_get_index (const gchar *value, guint *idx)
+{
+	guint64 tmp;
+	gchar *endptr = NULL;
+
+	if (!g_str_has_prefix (value, "synthetic"))
+		return FALSE;
+	tmp = g_ascii_strtoull (value + 9, &endptr, 10);
+	if (endptr == value + 9 || (*endptr != '\0' && *endptr != ';'))
+		return FALSE;
+	if (tmp >= priv->synthetic_size)
+		return FALSE;
+	*idx = tmp;
+	return TRUE;
+}
+
+/**
+ * pk_backend_synthetic_package:
+ */
+static void
+pk_backend_synthetic_package (PkBackendJob *job, PkBitfield filters, guint idx)
+{
+	g_autofree gchar *package_id = NULL;
+	g_autofree gchar *summary = NULL;
+
+	if (pk_backend_synthetic_is_installed (idx)) {
+		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED))
+			return;
+	} else {
+		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
+			return;
+	}
+	package_id = pk_backend_synthetic_get_id (idx, FALSE);
+	summary = g_strdup_printf ("Synthetic package number %u", idx);
+	pk_backend_job_package (job,
+				pk_backend_synthetic_is_installed (idx) ?
+					PK_INFO_ENUM_INSTALLED : PK_INFO_ENUM_AVAILABLE,
+				package_id, summary);
+}
+
+/**
+ * pk_backend_synthetic_files:
+ */
+static void
+pk_backend_synthetic_files (PkBackendJob *job, const gchar *package_id, guint idx)
+{
+	g_autofree gchar *name = pk_backend_synthetic_get_name (idx);
+	gchar *files[5];
+
+	files[0] = g_strdup_printf ("/usr/bin/%s", name);
+	files[1] = g_strdup_printf ("/usr/lib64/lib%s.so.1", name);
+	files[2] = g_strdup_printf ("/usr/share/doc/%s/README", name);
+	files[3] = g_strdup_printf ("/usr/share/man/man1/%s.1.gz", name);
+	files[4] = NULL;
+	pk_backend_job_files (job, package_id, files);
+	g_free (files[0]);
+	g_free (files[1]);
+	g_free (files[2]);
+	g_free (files[3]);
+}
+
+/**
+ * pk_backend_synthetic_update_detail:
+ */
+static void
+pk_backend_synthetic_update_detail (PkBackendJob *job, const gchar *package_id, guint idx)
+{
+	g_autofree gchar *bugzilla_url = NULL;
+	g_autofree gchar *old_id = NULL;
+	g_autofree gchar *text = NULL;
+	gchar *bugzilla_urls[] = { NULL, NULL };
+	gchar *updates[] = { NULL, NULL };
+
+	old_id = pk_backend_synthetic_get_id (idx, FALSE);
+	bugzilla_url = g_strdup_printf ("https://bugs.example.com/%u", idx);
+	text = g_strdup_printf ("Fixes bug %u in synthetic%06u.", idx, idx);
+	updates[0] = old_id;
+	bugzilla_urls[0] = bugzilla_url;
+	pk_backend_job_update_detail (job, package_id, updates, NULL, NULL,
+				      bugzilla_urls, NULL, PK_RESTART_ENUM_NONE,
+				      text, NULL, PK_UPDATE_STATE_ENUM_STABLE,
+				      "2016-01-01T00:00:00Z", NULL);
+}
+
+/**
+ * pk_backend_synthetic_thread:
+ *
+ * Answers the queries from the synthetic repository. Package N depends
+ * on package N/2, so the dependencies form a tree rooted at package 0.
+ */
+static void
+pk_backend_synthetic_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	gboolean recursive = FALSE;
+	guint i;
+	guint idx;
+	guint j;
+	PkBitfield filters = 0;
+	PkRoleEnum role;
+	PkBackendDummyJobData *job_data = pk_backend_job_get_user_data (job);
+	g_autofree gchar **values = NULL;
+
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+	pk_backend_job_set_allow_cancel (job, TRUE);
+
+	role = pk_backend_job_get_role (job);
+	switch (role) {
+	case PK_ROLE_ENUM_GET_PACKAGES:
+	case PK_ROLE_ENUM_GET_UPDATES:
+		g_variant_get (params, "(t)", &filters);
+		break;
+	case PK_ROLE_ENUM_DEPENDS_ON:
+		g_variant_get (params, "(t^a&sb)", &filters, &values, &recursive);
+		break;
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_GET_FILES:
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+		g_variant_get (params, "(^a&s)", &values);
+		break;
+	default:
+		g_variant_get (params, "(t^a&s)", &filters, &values);
+		break;
+	}
+
+	switch (role) {
+	case PK_ROLE_ENUM_GET_PACKAGES:
+		for (i = 0; i < priv->synthetic_size; i++) {
+			if (i % 1000 == 0 &&
+			    g_cancellable_is_cancelled (job_data->cancellable))
+				break;
+			pk_backend_synthetic_package (job, filters, i);
+		}
+		break;
+	case PK_ROLE_ENUM_SEARCH_NAME:
+		for (i = 0; i < priv->synthetic_size; i++) {
+			g_autofree gchar *name = NULL;
+			if (i % 1000 == 0 &&
+			    g_cancellable_is_cancelled (job_data->cancellable))
+				break;
+			name = pk_backend_synthetic_get_name (i);
+			for (j = 0; values[j] != NULL; j++) {
+				if (g_strstr_len (name, -1, values[j]) == NULL)
+					break;
+			}
+			if (values[j] == NULL)
+				pk_backend_synthetic_package (job, filters, i);
+		}
+		break;
+	case PK_ROLE_ENUM_RESOLVE:
+		for (i = 0; values[i] != NULL; i++) {
+			if (pk_backend_synthetic_get_index (values[i], &idx))
+				pk_backend_synthetic_package (job, filters, idx);
+		}
+		break;
+	case PK_ROLE_ENUM_DEPENDS_ON:
+		for (i = 0; values[i] != NULL; i++) {
+			if (!pk_backend_synthetic_get_index (values[i], &idx))
+				continue;
+			while (idx > 0) {
+				idx /= 2;
+				pk_backend_synthetic_package (job, filters, idx);
+				if (!recursive)
+					break;
+			}
+		}
+		break;
+	case PK_ROLE_ENUM_GET_FILES:
+		for (i = 0; values[i] != NULL; i++) {
+			if (pk_backend_synthetic_get_index (values[i], &idx))
+				pk_backend_synthetic_files (job, values[i], idx);
+		}
+		break;
+	case PK_ROLE_ENUM_GET_DETAILS:
+		for (i = 0; values[i] != NULL; i++) {
+			g_autofree gchar *description = NULL;
+			if (!pk_backend_synthetic_get_index (values[i], &idx))
+				continue;
+			description = g_strdup_printf ("Package number %u of the "
+						       "synthetic repository.", idx);
+			pk_backend_job_details (job, values[i],
+						"Synthetic package", "GPL2",
+						PK_GROUP_ENUM_SYSTEM, description,
+						"https://www.example.com/",
+						(idx % 100 + 1) * 1024);
+		}
+		break;
+	case PK_ROLE_ENUM_GET_UPDATES:
+		for (i = 0; i < priv->synthetic_size; i += 20) {
+			g_autofree gchar *package_id = NULL;
+			g_autofree gchar *summary = NULL;
+			package_id = pk_backend_synthetic_get_id (i, TRUE);
+			summary = g_strdup_printf ("Synthetic package number %u", i);
+			pk_backend_job_package (job,
+						i % 60 == 0 ? PK_INFO_ENUM_SECURITY :
+							      PK_INFO_ENUM_NORMAL,
+						package_id, summary);
+		}
+		break;
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+		for (i = 0; values[i] != NULL; i++) {
+			if (!pk_backend_synthetic_get_index (values[i], &idx))
+				continue;
+			if (pk_backend_synthetic_has_update (idx))
+				pk_backend_synthetic_update_detail (job, values[i], idx);
+		}
+		break;
+	default:
+		pk_backend_job_error_code (job, PK_ERROR_ENUM_NOT_SUPPORTED,
+					   "%s is not supported by the synthetic repository",
+					   pk_role_enum_to_string (role));
+		break;
+	}
+	if (g_cancellable_is_cancelled (job_data->cancellable)) {
+		pk_backend_job_error_code (job,
+					   PK_ERROR_ENUM_TRANSACTION_CANCELLED,
+					   "The task was stopped successfully");
+	}
+}
+
 /**
  * pk_backend_cancel_timeout:
  */
@@ -164,6 +441,11 @@ pk_backend_cancel (PkBackend *backend, PkBackendJob *job)
 void
 pk_backend_depends_on (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **package_ids, gboolean recursive)
 {
+	if (priv->synthetic_size > 0) {
+		pk_backend_job_thread_create (job, pk_backend_synthetic_thread, NULL, NULL);
+		return;
+	}
+
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
 	if (g_strcmp0 (package_ids[0], "scribus;1.3.4-1.fc8;i386;fedora") == 0) {
@@ -220,6 +502,11 @@ pk_backend_get_details (PkBackend *backend, PkBackendJob *job, gchar **package_i
 	guint len;
 	const gchar *package_id;
 
+	if (priv->synthetic_size > 0) {
+		pk_backend_job_thread_create (job, pk_backend_synthetic_thread, NULL, NULL);
+		return;
+	}
+
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, 0);
 
@@ -304,6 +591,11 @@ pk_backend_get_files (PkBackend *backend, PkBackendJob *job, gchar **package_ids
 	const gchar *package_id;
 	const gchar *to_strv[4];
 
+	if (priv->synthetic_size > 0) {
+		pk_backend_job_thread_create (job, pk_backend_synthetic_thread, NULL, NULL);
+		return;
+	}
+
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
 	len = g_strv_length (package_ids);
@@ -478,6 +770,12 @@ void
 pk_backend_get_update_detail (PkBackend *backend, PkBackendJob *job, gchar **package_ids)
 {
 	PkBackendDummyJobData *job_data = pk_backend_job_get_user_data (job);
+
+	if (priv->synthetic_size > 0) {
+		pk_backend_job_thread_create (job, pk_backend_synthetic_thread, NULL, NULL);
+		return;
+	}
+
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	priv->package_ids = package_ids;
 	job_data->signal_timeout = g_timeout_add (500, pk_backend_get_update_detail_timeout, job);
@@ -526,6 +824,12 @@ void
 pk_backend_get_updates (PkBackend *backend, PkBackendJob *job, PkBitfield filters)
 {
 	PkBackendDummyJobData *job_data = pk_backend_job_get_user_data (job);
+
+	if (priv->synthetic_size > 0) {
+		pk_backend_job_thread_create (job, pk_backend_synthetic_thread, NULL, NULL);
+		return;
+	}
+
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, PK_BACKEND_PERCENTAGE_INVALID);
 	/* check network state */
@@ -895,6 +1199,11 @@ pk_backend_resolve_thread (PkBackendJob *job, GVariant *params, gpointer user_da
 void
 pk_backend_resolve (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **packages)
 {
+	if (priv->synthetic_size > 0) {
+		pk_backend_job_thread_create (job, pk_backend_synthetic_thread, NULL, NULL);
+		return;
+	}
+
 	pk_backend_job_thread_create (job, pk_backend_resolve_thread, NULL, NULL);
 }
 
@@ -1048,6 +1357,11 @@ pk_backend_search_names_thread (PkBackendJob *job, GVariant *params, gpointer us
 void
 pk_backend_search_names (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
 {
+	if (priv->synthetic_size > 0) {
+		pk_backend_job_thread_create (job, pk_backend_synthetic_thread, NULL, NULL);
+		return;
+	}
+
 	pk_backend_job_set_percentage (job, PK_BACKEND_PERCENTAGE_INVALID);
 	pk_backend_job_set_allow_cancel (job, TRUE);
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
@@ -1575,6 +1889,11 @@ pk_backend_what_provides (PkBackend *backend, PkBackendJob *job, PkBitfield filt
 void
 pk_backend_get_packages (PkBackend *backend, PkBackendJob *job, PkBitfield filters)
 {
+	if (priv->synthetic_size > 0) {
+		pk_backend_job_thread_create (job, pk_backend_synthetic_thread, NULL, NULL);
+		return;
+	}
+
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_REQUEST);
 	pk_backend_job_package (job, PK_INFO_ENUM_INSTALLED,
 				"update1;2.19.1-4.fc8;i386;fedora",
@@ -1583,15 +1902,33 @@ pk_backend_get_packages (PkBackend *backend, PkBackendJob *job, PkBitfield filte
 }
 
 /**
- * pk_backend_download_packages:
+ * pk_backend_download_packages_thread:
  */
-void
-pk_backend_download_packages (PkBackend *backend, PkBackendJob *job, gchar **package_ids, const gchar *directory)
+static void
+pk_backend_download_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
+	const gchar *directory = (const gchar *) user_data;
 	gchar *filename;
 	gchar *to_strv[] = { NULL, NULL };
+	PkBackendDummyJobData *job_data = pk_backend_job_get_user_data (job);
 
-	pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD);
+	/* report progress as often as a real download does */
+	for (job_data->progress_percentage = 0;
+	     job_data->progress_percentage <= 100;
+	     job_data->progress_percentage += 2) {
+		if (g_cancellable_is_cancelled (job_data->cancellable)) {
+			pk_backend_job_error_code (job,
+						   PK_ERROR_ENUM_TRANSACTION_CANCELLED,
+						   "The task was stopped successfully");
+			return;
+		}
+		pk_backend_job_set_percentage (job, job_data->progress_percentage);
+		pk_backend_job_set_speed (job, 250000 + job_data->progress_percentage * 1000);
+		pk_backend_job_set_download_size_remaining (job, (100 - job_data->progress_percentage) * 1000);
+
+		/* sleep 5 milliseconds */
+		g_usleep (5000);
+	}
 
 	/* first package */
 	filename = g_build_filename (directory, "powertop-1.8-1.fc8.rpm", NULL);
@@ -1610,8 +1947,18 @@ pk_backend_download_packages (PkBackend *backend, PkBackendJob *job, gchar **pac
 	to_strv[0] = filename;
 	pk_backend_job_files (job, "powertop-common;1.8-1.fc8;i386;fedora", to_strv);
 	g_free (filename);
+}
 
-	pk_backend_job_finished (job);
+/**
+ * pk_backend_download_packages:
+ */
+void
+pk_backend_download_packages (PkBackend *backend, PkBackendJob *job, gchar **package_ids, const gchar *directory)
+{
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD);
+	pk_backend_job_set_allow_cancel (job, TRUE);
+	pk_backend_job_thread_create (job, pk_backend_download_packages_thread,
+				      g_strdup (directory), g_free);
 }
 
 static gboolean
@@ -38,11 +38,19 @@
 #include <vfile/vfile.h>
 #include <sigint/sigint.h>
 
+#include "pk-poldek-index.h"
+
+#define POLDEK_CACHE_DIR	"/var/cache/poldek"
+#define POLDEK_RPMDB_FILE	"/var/lib/rpm/Packages"
+
 static gchar* poldek_pkg_evr (const struct pkg *pkg);
+static tn_array* poldek_get_installed_packages (void);
 static void poldek_backend_package (PkBackendJob *job, struct pkg *pkg, PkInfoEnum infoenum, PkBitfield filters);
 static long do_get_bytes_to_download (struct poldek_ts *ts, tn_array *pkgs);
 static gint do_get_files_to_download (const struct poldek_ts *ts, const gchar *mark);
 static void pb_load_packages (PkBackendJob *job);
+static void poldek_reload (PkBackendJob *job, gboolean load_packages);
+static void pb_watch_cache_dir (GFile *directory);
 static void poldek_backend_set_allow_cancel (PkBackendJob *job, gboolean allow_cancel, gboolean reset);
 
 static void pb_error_show (PkBackendJob *job, PkErrorEnum errorcode);
@@ -77,12 +85,27 @@ typedef struct {
 	tn_array			*to_remove_pkgs;
 
 	guint				to_install;
+
+	/* name-EVR of the installed packages, see pkg_is_installed() */
+	GHashTable			*installed_nevr;
+	gboolean			 installed_changing;
 } PkBackendPoldekJobData;
 
 typedef struct {
 	struct poldek_ctx	*ctx;
 	struct poclidek_ctx	*cctx;
 	struct pkgdb		*db;
+	/* poclidek directory, e.g. "installed" -> PkPoldekIndex */
+	GHashTable		*indexes;
+
+	/* the package sets stay loaded until these are set by the monitors */
+	gboolean		 loaded;
+	gint			 installed_changed;
+	gint			 available_changed;
+	GPtrArray		*monitors;
+	/* when the pkgdir indexes were last read, older changes are ignored */
+	gint64			 available_loaded;
+	GMutex			 available_mutex;
 } PkBackendPoldekPriv;
 
 typedef struct {
@@ -624,6 +647,11 @@ ts_confirm (void *data, struct poldek_ts *ts)
 	size_t		i = 0;
 	gint		result = 1;
 
+	/* the snapshot goes stale as soon as the rpmdb is modified */
+	job_data->installed_changing = TRUE;
+	g_atomic_int_set (&priv->installed_changed, TRUE);
+	g_clear_pointer (&job_data->installed_nevr, g_hash_table_unref);
+
 	ipkgs = poldek_ts_get_summary (ts, "I");
 	dpkgs = poldek_ts_get_summary (ts, "D");
 	rpkgs = poldek_ts_get_summary (ts, "R");
@@ -792,15 +820,20 @@ do_post_search_process (tn_array *installed, tn_array *available)
 		packages = n_ref (available);
 
 		if (installed != NULL) {
+			GHashTable *seen = pk_poldek_nevr_set_new (available);
+
 			for (i = 0; i < n_array_size (installed); i++) {
 				struct pkg *pkg = n_array_nth (installed, i);
 
 				/* check for duplicates */
-				if (poldek_pkg_in_array (pkg, packages, (tn_fn_cmp)pkg_cmp_name_evr) == FALSE)
+				if (pk_poldek_nevr_set_contains (seen, pkg) == FALSE) {
+					pk_poldek_nevr_set_add (seen, pkg);
 					n_array_push (packages, pkg_link (pkg));
-
+				}
 			}
 
+			g_hash_table_unref (seen);
+
 			n_array_sort_ex (packages, (tn_fn_cmp)pkg_cmp_name_evr_rev_recno);
 		}
 
@@ -820,13 +853,33 @@ pk_backend_poldek_open_pkgdb (void)
 	}
 }
 
+/**
+ * pkg_is_installed:
+ *
+ * Query results are checked against a snapshot of the installed set taken
+ * on first use, rather than asking the rpmdb once per package. Once a
+ * transaction has started the rpmdb is queried directly again.
+ **/
 static gboolean
-pkg_is_installed (struct pkg *pkg)
+pkg_is_installed (PkBackendJob *job, struct pkg *pkg)
 {
+	PkBackendPoldekJobData *job_data = pk_backend_job_get_user_data (job);
 	gint cmprc, is_installed = 0;
 
 	g_return_val_if_fail (pkg != NULL, FALSE);
 
+	if (job_data->installed_nevr == NULL && !job_data->installed_changing) {
+		tn_array *dbpkgs;
+
+		if ((dbpkgs = poldek_get_installed_packages ()) != NULL) {
+			job_data->installed_nevr = pk_poldek_nevr_set_new (dbpkgs);
+			n_array_free (dbpkgs);
+		}
+	}
+
+	if (job_data->installed_nevr != NULL)
+		return pk_poldek_nevr_set_contains (job_data->installed_nevr, pkg);
+
 	pk_backend_poldek_open_pkgdb ();
 
 	if (priv->db) {
@@ -1031,6 +1084,38 @@ poldek_get_installed_packages (void)
 	return poclidek_get_dent_packages (priv->cctx, POCLIDEK_INSTALLEDDIR);
 }
 
+/**
+ * poldek_get_index:
+ *
+ * Returns the lookup tables for a poclidek directory, e.g. "installed",
+ * "all-avail" or a source name, building them on first use. The tables
+ * are dropped whenever the package sets are reloaded.
+ */
+static PkPoldekIndex*
+poldek_get_index (const gchar *dir)
+{
+	PkPoldekIndex *index;
+	tn_array *pkgs;
+	gchar *path;
+
+	if ((index = g_hash_table_lookup (priv->indexes, dir)) != NULL)
+		return index;
+
+	path = g_strdup_printf ("/%s", dir);
+	pkgs = poclidek_get_dent_packages (priv->cctx, path);
+	g_free (path);
+
+	if (pkgs == NULL)
+		return NULL;
+
+	index = pk_poldek_index_new (pkgs);
+	n_array_free (pkgs);
+
+	g_hash_table_insert (priv->indexes, g_strdup (dir), index);
+
+	return index;
+}
+
 static tn_array*
 poldek_pkg_get_cves_from_pld_changelog (struct pkg *pkg, time_t since)
 {
@@ -1154,7 +1239,7 @@ poldek_pkg_is_gui (struct pkg *pkg)
 }
 
 static void
-do_newest (tn_array *pkgs)
+do_newest (PkBackendJob *job, tn_array *pkgs)
 {
 	guint i = 1;
 
@@ -1165,7 +1250,7 @@ do_newest (tn_array *pkgs)
 		if (pkg_cmp_name (pkgs->data[i - 1], pkgs->data[i]) == 0) {
 			struct pkg *pkg = n_array_nth (pkgs, i);
 
-			if (!pkg_is_installed (pkg)) {
+			if (!pkg_is_installed (job, pkg)) {
 				n_array_remove_nth (pkgs, i);
 				continue;
 			}
@@ -1182,14 +1267,14 @@ do_newest (tn_array *pkgs)
  *
  **/
 static void
-do_filtering (tn_array *packages, PkBitfield filters)
+do_filtering (PkBackendJob *job, tn_array *packages, PkBitfield filters)
 {
 	guint	i = 0;
 
 	g_return_if_fail (packages != NULL);
 
 	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NEWEST))
-		do_newest (packages);
+		do_newest (job, packages);
 
 	while (i < n_array_size (packages)) {
 		struct pkg     *pkg = n_array_nth (packages, i);
@@ -1223,95 +1308,65 @@ do_filtering (tn_array *packages, PkBitfield filters)
 }
 
 /**
- * do_requires:
+ * do_requires_add:
  */
 static void
-do_requires (tn_array *installed, tn_array *available, tn_array *requires,
-	     struct pkg *pkg, PkBitfield filters, gboolean recursive)
+do_requires_add (PkPoldekIndex *index, tn_array *requires, GHashTable *visited,
+		 struct pkg *pkg)
 {
-	tn_array	*tmp = NULL;
+	tn_array	*requirers;
 	size_t		i;
 
-	tmp = n_array_new (2, NULL, NULL);
-
-	/* if ~installed doesn't exists in filters, we can query installed */
-	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED)) {
-		for (i = 0; i < n_array_size (installed); i++) {
-			struct pkg      *ipkg = n_array_nth (installed, i);
-			size_t j;
-
-			/* self match */
-			if (pkg_cmp_name_evr (pkg, ipkg) == 0)
-				continue;
-
-			/* skip when there is no reqs */
-			if (!ipkg->reqs)
-				continue;
-
-			/* package already added to the array */
-			if (poldek_pkg_in_array (ipkg, requires, (tn_fn_cmp)pkg_cmp_name_evr_rev))
-				continue;
+	requirers = pk_poldek_index_get_requirers (index, pkg);
 
-			for (j = 0; j < n_array_size (ipkg->reqs); j++) {
-				struct capreq   *req = n_array_nth (ipkg->reqs, j);
+	for (i = 0; i < n_array_size (requirers); i++) {
+		struct pkg	*rpkg = n_array_nth (requirers, i);
 
-				if (capreq_is_rpmlib (req))
-					continue;
-				else if (capreq_is_file (req))
-					continue;
+		/* package already added to the array */
+		if (pk_poldek_nevr_set_contains (visited, rpkg))
+			continue;
 
-				if (pkg_satisfies_req (pkg, req, 1)) {
-					n_array_push (requires, pkg_link (ipkg));
-					n_array_push (tmp, pkg_link (ipkg));
-					break;
-				}
-			}
-		}
+		pk_poldek_nevr_set_add (visited, rpkg);
+		n_array_push (requires, pkg_link (rpkg));
 	}
-	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED)) {
-		for (i = 0; i < n_array_size (available); i++) {
-			struct pkg      *apkg = n_array_nth (available, i);
-			size_t j;
 
-			/* self match */
-			if (pkg_cmp_name_evr (pkg, apkg) == 0)
-				continue;
+	n_array_free (requirers);
+}
 
-			if (!apkg->reqs)
-				continue;
+/**
+ * do_requires:
+ *
+ * When recursive, the packages appended to @requires are themselves
+ * looked up until no new requirers are found.
+ */
+static void
+do_requires (PkPoldekIndex *installed, PkPoldekIndex *available, tn_array *requires,
+	     struct pkg *pkg, PkBitfield filters, gboolean recursive)
+{
+	GHashTable	*visited;
+	size_t		i;
 
-			/* package already added to the array */
-			if (poldek_pkg_in_array (apkg, requires, (tn_fn_cmp)pkg_cmp_name_evr_rev))
-				continue;
+	visited = pk_poldek_nevr_set_new (NULL);
+	pk_poldek_nevr_set_add (visited, pkg);
 
-			for (j = 0; j < n_array_size (apkg->reqs); j++) {
-				struct capreq   *req = n_array_nth (apkg->reqs, j);
+	i = n_array_size (requires);
 
-				if (capreq_is_rpmlib (req))
-					continue;
-				else if (capreq_is_file (req))
-					continue;
+	/* if ~installed doesn't exists in filters, we can query installed */
+	if (installed && !pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED))
+		do_requires_add (installed, requires, visited, pkg);
+	if (available && !pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
+		do_requires_add (available, requires, visited, pkg);
 
-				if (pkg_satisfies_req (pkg, req, 1)) {
-					n_array_push (requires, pkg_link (apkg));
-					n_array_push (tmp, pkg_link (apkg));
-					break;
-				}
-			}
-		}
-	}
+	for (; recursive && i < n_array_size (requires); i++) {
+		struct pkg	*p = n_array_nth (requires, i);
 
-	/* FIXME: recursive takes too much time for available packages, so don't use it */
-	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED)) {
-		if (recursive && tmp && n_array_size (tmp) > 0) {
-			for (i = 0; i < n_array_size (tmp); i++) {
-				struct pkg	*p = n_array_nth (tmp, i);
-				do_requires (installed, available, requires, p, filters, recursive);
-			}
-		}
+		if (installed && !pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED))
+			do_requires_add (installed, requires, visited, p);
+		if (available && !pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
+			do_requires_add (available, requires, visited, p);
 	}
 
-	n_array_free (tmp);
+	g_hash_table_unref (visited);
 }
 
 /**
@@ -1425,7 +1480,7 @@ do_depends (tn_array *installed, tn_array *available, tn_array *depends, struct
 }
 
 static gchar*
-package_id_from_pkg (struct pkg *pkg, const gchar *repo, PkBitfield filters)
+package_id_from_pkg (PkBackendJob *job, struct pkg *pkg, const gchar *repo, PkBitfield filters)
 {
 	gchar *evr, *package_id, *poldek_dir;
 
@@ -1439,7 +1494,7 @@ package_id_from_pkg (struct pkg *pkg, const gchar *repo, PkBitfield filters)
 		/* when filters contain PK_FILTER_ENUM_NOT_INSTALLED package
 		 * can't be marked as installed */
 		if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED) &&
-		    pkg_is_installed (pkg)) {
+		    pkg_is_installed (job, pkg)) {
 			poldek_dir = g_strdup ("installed");
 		} else {
 			if (pkg->pkgdir && pkg->pkgdir->name) {
@@ -1476,7 +1531,7 @@ poldek_backend_package (PkBackendJob *job, struct pkg *pkg, PkInfoEnum infoenum,
 		} else if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED)) {
 			infoenum = PK_INFO_ENUM_AVAILABLE;
 		} else {
-			if (pkg_is_installed (pkg)) {
+			if (pkg_is_installed (job, pkg)) {
 				infoenum = PK_INFO_ENUM_INSTALLED;
 			} else {
 				infoenum = PK_INFO_ENUM_AVAILABLE;
@@ -1484,7 +1539,7 @@ poldek_backend_package (PkBackendJob *job, struct pkg *pkg, PkInfoEnum infoenum,
 		}
 	}
 
-	package_id = package_id_from_pkg (pkg, NULL, filters);
+	package_id = package_id_from_pkg (job, pkg, NULL, filters);
 
 	if ((pkgu = pkg_uinf_i18n (job, pkg))) {
 		pk_backend_job_package (job, infoenum, package_id, pkguinf_get (pkgu, PKGUINF_SUMMARY));
@@ -1509,21 +1564,33 @@ poldek_get_pkg_from_package_id (const gchar *package_id)
 	g_return_val_if_fail (package_id != NULL, NULL);
 
 	if ((parts = pk_package_id_split (package_id))) {
-		tn_array *packages = NULL;
+		PkPoldekIndex *index;
 		gchar    *vr = NULL;
+		gchar    *nvra = NULL;
 
 		vr = poldek_get_vr_from_package_id_evr (parts[PK_PACKAGE_ID_VERSION]);
+		nvra = g_strdup_printf ("%s-%s.%s", parts[PK_PACKAGE_ID_NAME],
+						    vr,
+						    parts[PK_PACKAGE_ID_ARCH]);
+
+		if ((index = poldek_get_index (parts[PK_PACKAGE_ID_DATA]))) {
+			if ((pkg = pk_poldek_index_lookup_nvra (index, nvra)))
+				pkg = pkg_link (pkg);
+		} else {
+			tn_array *packages = NULL;
+
+			/* not a directory we can index, let poclidek find it */
+			if ((packages = execute_packages_command ("cd /%s; ls -q %s", parts[PK_PACKAGE_ID_DATA], nvra))) {
+				if (n_array_size (packages) > 0) {
+					/* only one package is needed */
+					pkg = pkg_link (n_array_nth (packages, 0));
+				}
 
-		if ((packages = execute_packages_command ("cd /%s; ls -q %s-%s.%s", parts[PK_PACKAGE_ID_DATA],
-										    parts[PK_PACKAGE_ID_NAME],
-										    vr,
-										    parts[PK_PACKAGE_ID_ARCH]))) {
-			if (n_array_size (packages) > 0) {
-				/* only one package is needed */
-				pkg = pkg_link (n_array_nth (packages, 0));
+				n_array_free (packages);
 			}
 		}
 
+		g_free (nvra);
 		g_free (vr);
 		g_strfreev (parts);
 	}
@@ -1531,45 +1598,30 @@ poldek_get_pkg_from_package_id (const gchar *package_id)
 	return pkg;
 }
 
+/**
+ * do_search_native:
+ *
+ * SearchName, SearchDetails and Resolve don't need poclidek to parse a
+ * command line, so look the packages up directly.
+ */
 static tn_array*
-do_search_details (const gchar *tree, gchar **values)
+do_search_native (PkRoleEnum role, const gchar *dir, gchar **values)
 {
-	guint i;
-	tn_array *pkgs = NULL;
+	PkPoldekIndex *index;
 
-	g_return_val_if_fail (tree != NULL, NULL);
-	g_return_val_if_fail (values != NULL, NULL);
-
-	pkgs = execute_packages_command ("%s; search -qsd *%s*", tree, values[0]);
-
-	if (g_strv_length (values) > 1) {
-		GString *pkgnames = NULL;
-
-		pkgnames = g_string_new ("");
-
-		for (i = 1; pkgs && i < g_strv_length (values); i++) {
-			guint j;
-
-			g_string_truncate (pkgnames, 0);
-
-			/* create string from pkgs names */
-			for (j = 0; j < n_array_size (pkgs); j++) {
-				struct pkg *pkg = n_array_nth (pkgs, j);
-
-				g_string_append (pkgnames, pkg_id (pkg));
-				g_string_append_c (pkgnames, ' ');
-			}
-
-			n_array_free (pkgs);
-
-			pkgs = execute_packages_command ("%s; search -qsd \"*%s*\" %s",
-							 tree, values[i], pkgnames->str);
-		}
+	if ((index = poldek_get_index (dir)) == NULL)
+		return NULL;
 
-		g_string_free (pkgnames, TRUE);
+	switch (role) {
+		case PK_ROLE_ENUM_SEARCH_NAME:
+			return pk_poldek_index_search_names (index, values);
+		case PK_ROLE_ENUM_SEARCH_DETAILS:
+			return pk_poldek_index_search_details (index, values);
+		case PK_ROLE_ENUM_RESOLVE:
+			return pk_poldek_index_resolve (index, values);
+		default:
+			return NULL;
 	}
-
-	return pkgs;
 }
 
 /**
@@ -1586,6 +1638,7 @@ search_package_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 	tn_array	       *pkgs = NULL;
 	gchar		      **values = NULL;
 	gchar		       *search;
+	gboolean		native;
 
 	role = pk_backend_job_get_role (job);
 
@@ -1609,16 +1662,8 @@ search_package_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 
 	pb_load_packages (job);
 
-	/* SearchName */
-	if (role == PK_ROLE_ENUM_SEARCH_NAME) {
-		search = g_strjoinv ("*", values);
-
-		search_cmd_installed = g_strdup_printf ("ls -q *%s*", search);
-		search_cmd_available = g_strdup (search_cmd_installed);
-
-		g_free (search);
 	/* SearchGroup */
-	} else if (role == PK_ROLE_ENUM_SEARCH_GROUP) {
+	if (role == PK_ROLE_ENUM_SEARCH_GROUP) {
 		GString	*command;
 		guint		i;
 
@@ -1705,31 +1750,27 @@ search_package_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 		search_cmd_installed = g_strdup_printf ("search -qp --perlre /%s/", search);
 		search_cmd_available = g_strdup_printf ("search -qp --perlre /%s/", search);
 
-		g_free (search);
-	/* Resolve */
-	} else if (role == PK_ROLE_ENUM_RESOLVE) {
-		search = g_strjoinv(" ", values);
-
-		search_cmd_installed = g_strdup_printf ("ls -q %s", search);
-		search_cmd_available = g_strdup (search_cmd_installed);
-
 		g_free (search);
 	}
 
-	if ((search_cmd_installed != NULL && search_cmd_available != NULL) || role == PK_ROLE_ENUM_SEARCH_DETAILS) {
+	native = (role == PK_ROLE_ENUM_SEARCH_NAME ||
+		  role == PK_ROLE_ENUM_SEARCH_DETAILS ||
+		  role == PK_ROLE_ENUM_RESOLVE);
+
+	if ((search_cmd_installed != NULL && search_cmd_available != NULL) || native) {
 		tn_array *installed = NULL;
 		tn_array *available = NULL;
 
 		if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED)) {
-			if (role == PK_ROLE_ENUM_SEARCH_DETAILS)
-				installed = do_search_details ("cd /installed", values);
+			if (native)
+				installed = do_search_native (role, "installed", values);
 			else
 				installed = execute_packages_command ("cd /installed; %s", search_cmd_installed);
 		}
 
 		if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED)) {
-			if (role == PK_ROLE_ENUM_SEARCH_DETAILS)
-				available = do_search_details ("cd /all-avail", values);
+			if (native)
+				available = do_search_native (role, "all-avail", values);
 			else
 				available = execute_packages_command ("cd /all-avail; %s", search_cmd_available);
 		}
@@ -1741,23 +1782,19 @@ search_package_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 
 		/* filter out installed packages from available */
 		} else if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED) && available) {
-			tn_array *dbpkgs = NULL;
 			guint i;
 
-			dbpkgs = poldek_get_installed_packages ();
 			pkgs = n_array_new (4, (tn_fn_free)pkg_free, NULL);
 
 			for (i = 0; i < n_array_size (available); i++) {
 				struct pkg *pkg = n_array_nth (available, i);
 
 				/* drop installed packages */
-				if (!poldek_pkg_in_array (pkg, dbpkgs, (tn_fn_cmp)pkg_cmp_name_evr)) {
+				if (!pkg_is_installed (job, pkg)) {
 					n_array_push (pkgs, pkg_link (pkg));
 				}
 			}
 
-			n_array_free (dbpkgs);
-
 		} else if (available) {
 			pkgs = n_ref (available);
 
@@ -1771,7 +1808,7 @@ search_package_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 			n_array_free (available);
 	}
 
-	do_filtering (pkgs, filters);
+	do_filtering (job, pkgs, filters);
 
 	if (pkgs && n_array_size (pkgs) > 0) {
 		guint	i;
@@ -1970,17 +2007,173 @@ do_simulate_packages (PkBackendJob *job, GVariant *params, gpointer user_data)
 	poldek_ts_free (ts);
 }
 
+/**
+ * pb_cache_index_is_newer:
+ *
+ * The events for the indexes written by a refresh only arrive after the
+ * refresh has read them again, so only changes made since the indexes
+ * were last read mean they have to be read again.
+ */
+static gboolean
+pb_cache_index_is_newer (GFile *file)
+{
+	GFileInfo	*info;
+	gint64		 mtime;
+	gint64		 loaded;
+
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+				  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+	/* removed */
+	if (info == NULL)
+		return TRUE;
+
+	mtime = (gint64) g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+		g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	g_object_unref (info);
+
+	g_mutex_lock (&priv->available_mutex);
+	loaded = priv->available_loaded;
+	g_mutex_unlock (&priv->available_mutex);
+
+	return mtime >= loaded;
+}
+
+/**
+ * pb_cache_changed_cb:
+ *
+ * Called when something in the poldek cache directory changes. Only
+ * pkgdir indexes matter, downloaded packages are stored there too.
+ */
+static void
+pb_cache_changed_cb (GFileMonitor *monitor, GFile *file, GFile *other_file,
+		     GFileMonitorEvent event_type, gpointer user_data)
+{
+	gchar	*basename;
+
+	/* a new source was added */
+	if (event_type == G_FILE_MONITOR_EVENT_CREATED &&
+	    g_file_query_file_type (file, G_FILE_QUERY_INFO_NONE, NULL) == G_FILE_TYPE_DIRECTORY) {
+		pb_watch_cache_dir (file);
+		return;
+	}
+
+	basename = g_file_get_basename (file);
+
+	if (g_str_has_prefix (basename, "packages.") &&
+	    pb_cache_index_is_newer (file)) {
+		g_debug ("pkgdir index %s changed", basename);
+		g_atomic_int_set (&priv->available_changed, TRUE);
+	}
+
+	g_free (basename);
+}
+
+static void
+pb_watch_cache_dir (GFile *directory)
+{
+	GFileMonitor	*monitor;
+	GError		*error = NULL;
+
+	monitor = g_file_monitor_directory (directory, G_FILE_MONITOR_NONE, NULL, &error);
+	if (monitor == NULL) {
+		g_warning ("failed to setup monitor: %s", error->message);
+		g_error_free (error);
+		return;
+	}
+
+	g_signal_connect (monitor, "changed", G_CALLBACK (pb_cache_changed_cb), NULL);
+	g_ptr_array_add (priv->monitors, monitor);
+}
+
+/**
+ * pb_watch_cache:
+ *
+ * Each source keeps its indexes in its own subdirectory of the cache.
+ */
+static void
+pb_watch_cache (void)
+{
+	GFileEnumerator	*enumerator;
+	GFileInfo	*info;
+	GFile		*cache;
+
+	cache = g_file_new_for_path (POLDEK_CACHE_DIR);
+
+	pb_watch_cache_dir (cache);
+
+	enumerator = g_file_enumerate_children (cache,
+						G_FILE_ATTRIBUTE_STANDARD_NAME ","
+						G_FILE_ATTRIBUTE_STANDARD_TYPE,
+						G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	if (enumerator != NULL) {
+		while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL) {
+			if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+				GFile *child = g_file_get_child (cache, g_file_info_get_name (info));
+
+				pb_watch_cache_dir (child);
+				g_object_unref (child);
+			}
+			g_object_unref (info);
+		}
+		g_object_unref (enumerator);
+	}
+
+	g_object_unref (cache);
+}
+
+static void
+pb_rpmdb_changed_cb (PkBackend *backend, gpointer data)
+{
+	g_debug ("rpmdb changed");
+	g_atomic_int_set (&priv->installed_changed, TRUE);
+}
+
+/**
+ * pb_load_packages:
+ *
+ * The package sets are kept loaded between jobs, and only read again
+ * once the pkgdir indexes or the rpmdb have changed on disk.
+ */
 static void
 pb_load_packages (PkBackendJob *job)
 {
 	gboolean	allow_cancel = pk_backend_job_get_allow_cancel (job);
+	gboolean	available_changed, installed_changed;
+
+	available_changed = g_atomic_int_compare_and_exchange (&priv->available_changed, TRUE, FALSE);
+	installed_changed = g_atomic_int_compare_and_exchange (&priv->installed_changed, TRUE, FALSE);
+
+	if (priv->loaded && !available_changed && !installed_changed)
+		return;
 
 	/* this operation can't be cancelled, so if enabled, set allow_cancel to FALSE */
 	if (allow_cancel)
 		poldek_backend_set_allow_cancel (job, FALSE, FALSE);
 
+	/* anything written to the indexes from now on is read again later */
+	if (!priv->loaded || available_changed) {
+		g_mutex_lock (&priv->available_mutex);
+		priv->available_loaded = g_get_real_time ();
+		g_mutex_unlock (&priv->available_mutex);
+	}
+
+	/* poldek can't reload its sources in place */
+	if (priv->loaded && available_changed)
+		poldek_reload (job, FALSE);
+
 	/* load information about installed and available packages */
-	poclidek_load_packages (priv->cctx, POCLIDEK_LOAD_ALL);
+	if (!priv->loaded)
+		poclidek_load_packages (priv->cctx, POCLIDEK_LOAD_ALL);
+	else
+		poclidek_load_packages (priv->cctx, POCLIDEK_LOAD_INSTALLED | POCLIDEK_LOAD_RELOAD);
+
+	priv->loaded = TRUE;
+
+	/* the package sets may have been replaced */
+	g_hash_table_remove_all (priv->indexes);
 
 	if (allow_cancel)
 		poldek_backend_set_allow_cancel (job, TRUE, FALSE);
@@ -2273,6 +2466,9 @@ do_poldek_destroy (PkBackend *backend)
 		priv->db = NULL;
 	}
 
+	g_hash_table_remove_all (priv->indexes);
+	priv->loaded = FALSE;
+
 	poclidek_free (priv->cctx);
 	poldek_free (priv->ctx);
 
@@ -2284,6 +2480,9 @@ poldek_reload (PkBackendJob *job, gboolean load_packages) {
 	do_poldek_destroy (pk_backend_job_get_backend (job));
 	do_poldek_init (pk_backend_job_get_backend (job));
 
+	/* the new context doesn't know about the running job */
+	poldek_configure (priv->ctx, POLDEK_CONF_TSCONFIRM_CB, ts_confirm, job);
+
 	if (load_packages)
 		pb_load_packages (job);
 }
@@ -2329,9 +2528,16 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	pberror->tslog = g_string_new ("");
 
 	priv = g_new0 (PkBackendPoldekPriv, 1);
+	priv->indexes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					       (GDestroyNotify) pk_poldek_index_free);
+	priv->monitors = g_ptr_array_new_with_free_func (g_object_unref);
+	g_mutex_init (&priv->available_mutex);
 
 	do_poldek_init (backend);
 
+	pb_watch_cache ();
+	pk_backend_watch_file (backend, POLDEK_RPMDB_FILE, pb_rpmdb_changed_cb, NULL);
+
 	g_debug ("backend initalize end");
 }
 /**
@@ -2342,6 +2548,9 @@ pk_backend_destroy (PkBackend *backend)
 {
 	do_poldek_destroy (backend);
 
+	g_hash_table_destroy (priv->indexes);
+	g_ptr_array_unref (priv->monitors);
+	g_mutex_clear (&priv->available_mutex);
 	g_free (priv);
 
 	/* release PbError struct */
@@ -2386,6 +2595,9 @@ pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 	n_array_cfree (&job_data->to_update_pkgs);
 	n_array_cfree (&job_data->to_remove_pkgs);
 
+	if (job_data->installed_nevr != NULL)
+		g_hash_table_unref (job_data->installed_nevr);
+
 	g_free (job_data);
 
 	// close pkgdb as well
@@ -2507,7 +2719,7 @@ backend_download_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 			gchar *to_strv[] = { NULL, NULL };
 			gchar buf[256];
 
-			package_id = package_id_from_pkg (pkg, NULL, PK_FILTER_ENUM_NONE);
+			package_id = package_id_from_pkg (job, pkg, NULL, PK_FILTER_ENUM_NONE);
 			path = g_build_filename (destdir, pkg_filename (pkg, buf, sizeof (buf)), NULL);
 			to_strv[0] = path;
 
@@ -2743,7 +2955,7 @@ backend_get_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_
 
 	packages = do_post_search_process (installed, available);
 
-	do_filtering (packages, filters);
+	do_filtering (job, packages, filters);
 
 	pk_backend_job_set_percentage (job, 10);
 
@@ -2787,7 +2999,7 @@ static void
 backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
 	struct pkg	*pkg;
-	tn_array	*reqpkgs, *available, *installed;
+	tn_array	*reqpkgs;
 	size_t		i;
 	gchar **package_ids;
 	PkBitfield filters;
@@ -2800,13 +3012,14 @@ backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 
 	pb_load_packages (job);
 
-	reqpkgs = n_array_new (2, NULL, NULL);
+	reqpkgs = n_array_new (2, (tn_fn_free)pkg_free, NULL);
 
-	pkg = poldek_get_pkg_from_package_id (package_ids[0]);
-	installed = poldek_get_installed_packages ();
-	available = poldek_get_avail_packages (priv->ctx);
-
-	do_requires (installed, available, reqpkgs, pkg, filters, recursive);
+	if ((pkg = poldek_get_pkg_from_package_id (package_ids[0])) != NULL) {
+		do_requires (poldek_get_index ("installed"),
+			     poldek_get_index ("all-avail"),
+			     reqpkgs, pkg, filters, recursive);
+		pkg_free (pkg);
+	}
 
 	/* sort output */
 	n_array_sort_ex(reqpkgs, (tn_fn_cmp)pkg_cmp_name_evr_rev);
@@ -2818,8 +3031,6 @@ backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 	}
 
 	n_array_free (reqpkgs);
-	n_array_free (installed);
-	n_array_free (available);
 }
 
 void
@@ -2836,7 +3047,7 @@ pk_backend_required_by (PkBackend *backend, PkBackendJob *job, PkBitfield filter
  * pk_backend_get_update_detail:
  */
 static GPtrArray *
-get_obsoletedby_pkg (struct pkg *pkg)
+get_obsoletedby_pkg (PkBackendJob *job, struct pkg *pkg)
 {
 	GPtrArray *obsoletes = NULL;
 	tn_array *dbpkgs;
@@ -2856,7 +3067,7 @@ get_obsoletedby_pkg (struct pkg *pkg)
 		struct pkg *dbpkg = n_array_nth (dbpkgs, i);
 
 		if (pkg_caps_obsoletes_pkg_caps (pkg, dbpkg)) {
-			g_ptr_array_add (obsoletes, package_id_from_pkg (dbpkg, "installed", 0));
+			g_ptr_array_add (obsoletes, package_id_from_pkg (job, dbpkg, "installed", 0));
 		}
 	}
 
@@ -2901,9 +3112,9 @@ backend_get_update_detail_thread (PkBackendJob *job, GVariant *params, gpointer
 				upkg = poldek_get_pkg_from_package_id (package_ids[n]);
 
 				updates = g_ptr_array_new ();
-				g_ptr_array_add (updates, package_id_from_pkg (pkg, "installed", 0));
+				g_ptr_array_add (updates, package_id_from_pkg (job, pkg, "installed", 0));
 
-				obsoletes = get_obsoletedby_pkg (upkg);
+				obsoletes = get_obsoletedby_pkg (job, upkg);
 
 				if ((upkg_uinf = pkg_uinf (upkg)) != NULL) {
 					changes = pkguinf_get_changelog (upkg_uinf, pkg->btime);
@@ -2980,12 +3191,14 @@ backend_get_updates_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 
 	if ((packages = execute_packages_command ("cd /all-avail; ls -q -u")) != NULL) {
 		tn_array *secupgrades = NULL;
+		GHashTable *security = NULL;
 		guint i;
 
 		/* GetUpdates returns only the newest packages */
-		do_newest (packages);
+		do_newest (job, packages);
 
 		secupgrades = poldek_get_security_updates ();
+		security = pk_poldek_nevr_set_new (secupgrades);
 
 		for (i = 0; i < n_array_size (packages); i++) {
 			struct pkg *pkg = n_array_nth (packages, i);
@@ -2996,12 +3209,13 @@ backend_get_updates_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 			/* mark held packages as blocked */
 			if (pkg->flags & PKG_HELD)
 				poldek_backend_package (job, pkg, PK_INFO_ENUM_BLOCKED, PK_FILTER_ENUM_NONE);
-			else if (poldek_pkg_in_array (pkg, secupgrades, (tn_fn_cmp)pkg_cmp_name_evr))
+			else if (pk_poldek_nevr_set_contains (security, pkg))
 				poldek_backend_package (job, pkg, PK_INFO_ENUM_SECURITY, PK_FILTER_ENUM_NONE);
 			else
 				poldek_backend_package (job, pkg, PK_INFO_ENUM_NORMAL, PK_FILTER_ENUM_NONE);
 		}
 
+		g_hash_table_unref (security);
 		n_array_cfree (&secupgrades);
 		n_array_free (packages);
 	}
@@ -0,0 +1,306 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Marcin Banasiak <megabajt@pld-linux.org>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * "ids" compares looking packages up through poclidek commands, which is
+ * what the backend used to do for every package-id, with the native
+ * lookup tables in pk-poldek-index.c, using the system poldek
+ * configuration.
+ *
+ * "requires" times a recursive RequiredBy over a synthetic repository,
+ * scanning every package as the backend used to and with the reverse
+ * requirement index.
+ */
+
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include <capreq.h>
+#include <poldek.h>
+#include <poclidek/poclidek.h>
+
+#include "pk-poldek-index.h"
+
+#define PK_POLDEK_BENCHMARK_LOOKUPS	500
+#define PK_POLDEK_BENCHMARK_PACKAGES	5000
+
+static tn_array *
+pk_poldek_benchmark_rcmd (struct poclidek_ctx *cctx, const gchar *command)
+{
+	struct poclidek_rcmd *rcmd;
+	tn_array *packages = NULL;
+
+	rcmd = poclidek_rcmd_new (cctx, NULL);
+	if (poclidek_rcmd_execline (rcmd, command))
+		packages = poclidek_rcmd_get_packages (rcmd);
+	poclidek_rcmd_free (rcmd);
+
+	return packages;
+}
+
+static int
+pk_poldek_benchmark_ids (void)
+{
+	struct poldek_ctx *ctx;
+	struct poclidek_ctx *cctx;
+	PkPoldekIndex *index;
+	tn_array *pkgs;
+	GPtrArray *keys;
+	GTimer *timer;
+	gdouble elapsed_rcmd;
+	gdouble elapsed_build;
+	gdouble elapsed_index;
+	guint found_rcmd = 0;
+	guint found_index = 0;
+	guint i;
+
+	poldeklib_init ();
+	ctx = poldek_new (0);
+	poldek_load_config (ctx, "/etc/poldek/poldek.conf", NULL, 0);
+	poldek_setup (ctx);
+	cctx = poclidek_new (ctx);
+	poldek_configure (ctx, POLDEK_CONF_OPT, POLDEK_OP_UNIQN, 0);
+	poclidek_load_packages (cctx, POCLIDEK_LOAD_ALL);
+
+	pkgs = poclidek_get_dent_packages (cctx, "/all-avail");
+	if (pkgs == NULL || n_array_size (pkgs) == 0) {
+		g_printerr ("No available packages, refresh the poldek cache first\n");
+		return 1;
+	}
+
+	/* spread the lookups over the whole set */
+	keys = g_ptr_array_new_with_free_func (g_free);
+	for (i = 0; i < n_array_size (pkgs) && keys->len < PK_POLDEK_BENCHMARK_LOOKUPS; i++) {
+		guint nth = (guint) (((guint64) i * n_array_size (pkgs)) / PK_POLDEK_BENCHMARK_LOOKUPS);
+		if (nth >= n_array_size (pkgs))
+			break;
+		g_ptr_array_add (keys, pk_poldek_index_pkg_nvra (n_array_nth (pkgs, nth)));
+	}
+
+	timer = g_timer_new ();
+	for (i = 0; i < keys->len; i++) {
+		g_autofree gchar *command = NULL;
+		tn_array *found;
+
+		command = g_strdup_printf ("cd /all-avail; ls -q %s",
+					   (const gchar *) g_ptr_array_index (keys, i));
+		found = pk_poldek_benchmark_rcmd (cctx, command);
+		if (found != NULL) {
+			if (n_array_size (found) > 0)
+				found_rcmd++;
+			n_array_free (found);
+		}
+	}
+	elapsed_rcmd = g_timer_elapsed (timer, NULL);
+
+	g_timer_reset (timer);
+	index = pk_poldek_index_new (pkgs);
+	elapsed_build = g_timer_elapsed (timer, NULL);
+
+	g_timer_reset (timer);
+	for (i = 0; i < keys->len; i++) {
+		if (pk_poldek_index_lookup_nvra (index, g_ptr_array_index (keys, i)) != NULL)
+			found_index++;
+	}
+	elapsed_index = g_timer_elapsed (timer, NULL);
+
+	g_print ("packages:      %u\n", n_array_size (pkgs));
+	g_print ("lookups:       %u\n", keys->len);
+	g_print ("poclidek:      %.3fms (%u found)\n", elapsed_rcmd * 1000, found_rcmd);
+	g_print ("index build:   %.3fms\n", elapsed_build * 1000);
+	g_print ("index lookups: %.3fms (%u found)\n", elapsed_index * 1000, found_index);
+
+	pk_poldek_index_free (index);
+	g_ptr_array_unref (keys);
+	g_timer_destroy (timer);
+	n_array_free (pkgs);
+	poclidek_free (cctx);
+	poldek_free (ctx);
+
+	return 0;
+}
+
+/*
+ * Package n provides libn.so.1 and requires the library of package
+ * (n - 1) / 2, so every package ends up requiring package 0.
+ */
+static tn_array *
+pk_poldek_benchmark_synthetic_repo (guint n_pkgs)
+{
+	tn_array *pkgs;
+	guint i;
+
+	pkgs = n_array_new (n_pkgs, (tn_fn_free) pkg_free, NULL);
+
+	for (i = 0; i < n_pkgs; i++) {
+		struct pkg *pkg;
+		gchar *name;
+		gchar *lib;
+
+		name = g_strdup_printf ("synthetic%u", i);
+		pkg = pkg_new (name, 0, "1.0", "1", "x86_64", "linux");
+
+		lib = g_strdup_printf ("lib%u.so.1", i);
+		pkg->caps = capreq_arr_new (1);
+		n_array_push (pkg->caps, capreq_new (NULL, lib, 0, NULL, NULL, 0, 0));
+		n_array_sort (pkg->caps);
+		g_free (lib);
+
+		pkg->reqs = capreq_arr_new (2);
+		n_array_push (pkg->reqs, capreq_new (NULL, "rpmlib(PayloadIsXz)", 0, NULL, NULL, 0, 0));
+		if (i > 0) {
+			lib = g_strdup_printf ("lib%u.so.1", (i - 1) / 2);
+			n_array_push (pkg->reqs, capreq_new (NULL, lib, 0, NULL, NULL, 0, 0));
+			g_free (lib);
+		}
+
+		n_array_push (pkgs, pkg);
+		g_free (name);
+	}
+
+	return pkgs;
+}
+
+/* what do_requires() used to do for each package */
+static void
+pk_poldek_benchmark_scan (tn_array *pkgs, tn_array *requires, GHashTable *visited,
+			  struct pkg *pkg)
+{
+	guint i;
+	guint j;
+
+	for (i = 0; i < n_array_size (pkgs); i++) {
+		struct pkg *rpkg = n_array_nth (pkgs, i);
+
+		if (rpkg == pkg || rpkg->reqs == NULL)
+			continue;
+		if (pk_poldek_nevr_set_contains (visited, rpkg))
+			continue;
+
+		for (j = 0; j < n_array_size (rpkg->reqs); j++) {
+			struct capreq *req = n_array_nth (rpkg->reqs, j);
+
+			if (capreq_is_rpmlib (req) || capreq_is_file (req))
+				continue;
+
+			if (pkg_satisfies_req (pkg, req, 1)) {
+				pk_poldek_nevr_set_add (visited, rpkg);
+				n_array_push (requires, pkg_link (rpkg));
+				break;
+			}
+		}
+	}
+}
+
+static int
+pk_poldek_benchmark_requires (guint n_pkgs)
+{
+	PkPoldekIndex *index;
+	GHashTable *visited;
+	tn_array *pkgs;
+	tn_array *requires;
+	GTimer *timer;
+	gdouble elapsed_scan;
+	gdouble elapsed_index;
+	guint found_scan;
+	guint found_index;
+	guint i;
+	guint j;
+
+	poldeklib_init ();
+	pkgs = pk_poldek_benchmark_synthetic_repo (n_pkgs);
+	timer = g_timer_new ();
+
+	requires = n_array_new (n_pkgs, (tn_fn_free) pkg_free, NULL);
+	visited = pk_poldek_nevr_set_new (NULL);
+	pk_poldek_nevr_set_add (visited, n_array_nth (pkgs, 0));
+	pk_poldek_benchmark_scan (pkgs, requires, visited, n_array_nth (pkgs, 0));
+	for (i = 0; i < n_array_size (requires); i++)
+		pk_poldek_benchmark_scan (pkgs, requires, visited, n_array_nth (requires, i));
+	found_scan = n_array_size (requires);
+	g_hash_table_unref (visited);
+	n_array_free (requires);
+	elapsed_scan = g_timer_elapsed (timer, NULL);
+
+	g_timer_reset (timer);
+	index = pk_poldek_index_new (pkgs);
+	requires = n_array_new (n_pkgs, (tn_fn_free) pkg_free, NULL);
+	visited = pk_poldek_nevr_set_new (NULL);
+	pk_poldek_nevr_set_add (visited, n_array_nth (pkgs, 0));
+	n_array_push (requires, pkg_link (n_array_nth (pkgs, 0)));
+	for (i = 0; i < n_array_size (requires); i++) {
+		tn_array *requirers;
+
+		requirers = pk_poldek_index_get_requirers (index, n_array_nth (requires, i));
+		for (j = 0; j < n_array_size (requirers); j++) {
+			struct pkg *rpkg = n_array_nth (requirers, j);
+
+			if (pk_poldek_nevr_set_contains (visited, rpkg))
+				continue;
+			pk_poldek_nevr_set_add (visited, rpkg);
+			n_array_push (requires, pkg_link (rpkg));
+		}
+		n_array_free (requirers);
+	}
+	/* don't count the package itself */
+	found_index = n_array_size (requires) - 1;
+	g_hash_table_unref (visited);
+	n_array_free (requires);
+	elapsed_index = g_timer_elapsed (timer, NULL);
+
+	g_print ("packages:      %u\n", n_pkgs);
+	g_print ("full scan:     %.3fms (%u found)\n", elapsed_scan * 1000, found_scan);
+	g_print ("index:         %.3fms (%u found)\n", elapsed_index * 1000, found_index);
+
+	pk_poldek_index_free (index);
+	n_array_free (pkgs);
+	g_timer_destroy (timer);
+
+	if (found_scan != n_pkgs - 1 || found_index != n_pkgs - 1) {
+		g_printerr ("Expected %u packages to require synthetic0\n", n_pkgs - 1);
+		return 1;
+	}
+
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	if (argc < 2 || g_strcmp0 (argv[1], "ids") == 0)
+		return pk_poldek_benchmark_ids ();
+
+	if (g_strcmp0 (argv[1], "requires") == 0) {
+		guint n_pkgs = PK_POLDEK_BENCHMARK_PACKAGES;
+
+		if (argc > 2)
+			n_pkgs = (guint) atoi (argv[2]);
+		if (n_pkgs < 2) {
+			g_printerr ("At least two packages are needed\n");
+			return 1;
+		}
+		return pk_poldek_benchmark_requires (n_pkgs);
+	}
+
+	g_printerr ("Usage: %s [ids|requires [PACKAGES]]\n", argv[0]);
+	return 1;
+}
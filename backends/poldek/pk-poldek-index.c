@@ -0,0 +1,395 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Marcin Banasiak <megabajt@pld-linux.org>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include <capreq.h>
+#include <pkgu.h>
+
+#include "pk-poldek-index.h"
+
+/**
+ * pk_poldek_index_pkg_nvra:
+ *
+ * Returns the key used by the NVRA table, in the same format as
+ * poldek_get_nvra_from_package_id(), e.g. "foo-1.0-1.i686".
+ **/
+gchar *
+pk_poldek_index_pkg_nvra (const struct pkg *pkg)
+{
+	return g_strdup_printf ("%s-%s-%s.%s", pkg->name, pkg->ver, pkg->rel, pkg_arch (pkg));
+}
+
+/**
+ * pk_poldek_index_new:
+ *
+ * Builds the name and NVRA tables for a package set. The index keeps its
+ * own reference to the array, so it stays valid even if poclidek drops it.
+ **/
+PkPoldekIndex *
+pk_poldek_index_new (tn_array *pkgs)
+{
+	PkPoldekIndex *index;
+	guint i;
+
+	index = g_new0 (PkPoldekIndex, 1);
+	index->pkgs = n_ref (pkgs);
+	index->nvra = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	index->names = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+					      (GDestroyNotify) g_ptr_array_unref);
+
+	for (i = 0; i < n_array_size (pkgs); i++) {
+		struct pkg *pkg = n_array_nth (pkgs, i);
+		GPtrArray *same_name;
+		gchar *nvra;
+
+		/* the first of several epochs wins, as the package-id has no epoch */
+		nvra = pk_poldek_index_pkg_nvra (pkg);
+		if (g_hash_table_contains (index->nvra, nvra))
+			g_free (nvra);
+		else
+			g_hash_table_insert (index->nvra, nvra, pkg);
+
+		same_name = g_hash_table_lookup (index->names, pkg->name);
+		if (same_name == NULL) {
+			same_name = g_ptr_array_new ();
+			g_hash_table_insert (index->names, pkg->name, same_name);
+		}
+		g_ptr_array_add (same_name, pkg);
+	}
+
+	return index;
+}
+
+/**
+ * pk_poldek_index_free:
+ **/
+void
+pk_poldek_index_free (PkPoldekIndex *index)
+{
+	if (index == NULL)
+		return;
+
+	g_hash_table_unref (index->nvra);
+	g_hash_table_unref (index->names);
+	if (index->requirers != NULL)
+		g_hash_table_unref (index->requirers);
+	n_array_free (index->pkgs);
+	g_free (index);
+}
+
+/**
+ * pk_poldek_index_lookup_nvra:
+ *
+ * Returns: (transfer none): the package, or %NULL
+ **/
+struct pkg *
+pk_poldek_index_lookup_nvra (PkPoldekIndex *index, const gchar *nvra)
+{
+	return g_hash_table_lookup (index->nvra, nvra);
+}
+
+/**
+ * pk_poldek_index_build_requirers:
+ *
+ * Maps each required capability name to the packages requiring it. File
+ * and rpmlib() requirements are left out, as RequiredBy ignores them.
+ **/
+static void
+pk_poldek_index_build_requirers (PkPoldekIndex *index)
+{
+	guint i;
+	guint j;
+
+	index->requirers = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+						  (GDestroyNotify) g_ptr_array_unref);
+
+	for (i = 0; i < n_array_size (index->pkgs); i++) {
+		struct pkg *pkg = n_array_nth (index->pkgs, i);
+
+		if (pkg->reqs == NULL)
+			continue;
+
+		for (j = 0; j < n_array_size (pkg->reqs); j++) {
+			struct capreq *req = n_array_nth (pkg->reqs, j);
+			GPtrArray *requirers;
+
+			if (capreq_is_rpmlib (req) || capreq_is_file (req))
+				continue;
+
+			requirers = g_hash_table_lookup (index->requirers, capreq_name (req));
+			if (requirers == NULL) {
+				requirers = g_ptr_array_new ();
+				g_hash_table_insert (index->requirers, (gpointer) capreq_name (req), requirers);
+			}
+
+			/* several versioned requirements on the same name */
+			if (requirers->len > 0 &&
+			    g_ptr_array_index (requirers, requirers->len - 1) == pkg)
+				continue;
+
+			g_ptr_array_add (requirers, pkg);
+		}
+	}
+}
+
+static void
+pk_poldek_index_add_requirers (PkPoldekIndex *index, struct pkg *pkg,
+			       const gchar *name, GHashTable *seen, tn_array *pkgs)
+{
+	GPtrArray *requirers;
+	guint i;
+	guint j;
+
+	if ((requirers = g_hash_table_lookup (index->requirers, name)) == NULL)
+		return;
+
+	for (i = 0; i < requirers->len; i++) {
+		struct pkg *rpkg = g_ptr_array_index (requirers, i);
+
+		if (!g_hash_table_add (seen, rpkg))
+			continue;
+
+		/* self match */
+		if (pkg_cmp_name_evr (pkg, rpkg) == 0)
+			continue;
+
+		for (j = 0; j < n_array_size (rpkg->reqs); j++) {
+			struct capreq *req = n_array_nth (rpkg->reqs, j);
+
+			if (capreq_is_rpmlib (req) || capreq_is_file (req))
+				continue;
+
+			if (pkg_satisfies_req (pkg, req, 1)) {
+				n_array_push (pkgs, pkg_link (rpkg));
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * pk_poldek_index_get_requirers:
+ *
+ * Finds the packages in the set with a requirement @pkg satisfies. Only
+ * the packages requiring the name or one of the capabilities of @pkg are
+ * checked, rather than every package in the set.
+ **/
+tn_array *
+pk_poldek_index_get_requirers (PkPoldekIndex *index, struct pkg *pkg)
+{
+	GHashTable *seen;
+	tn_array *pkgs;
+	guint i;
+
+	if (index->requirers == NULL)
+		pk_poldek_index_build_requirers (index);
+
+	pkgs = n_array_new (4, (tn_fn_free) pkg_free, NULL);
+	seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	pk_poldek_index_add_requirers (index, pkg, pkg->name, seen, pkgs);
+
+	if (pkg->caps != NULL) {
+		for (i = 0; i < n_array_size (pkg->caps); i++) {
+			struct capreq *cap = n_array_nth (pkg->caps, i);
+
+			pk_poldek_index_add_requirers (index, pkg, capreq_name (cap), seen, pkgs);
+		}
+	}
+
+	g_hash_table_unref (seen);
+
+	return pkgs;
+}
+
+/**
+ * pk_poldek_index_resolve:
+ *
+ * Equivalent of "ls -q name1 name2 ..." for plain package names.
+ **/
+tn_array *
+pk_poldek_index_resolve (PkPoldekIndex *index, gchar **names)
+{
+	tn_array *pkgs;
+	guint i;
+	guint j;
+
+	pkgs = n_array_new (4, (tn_fn_free) pkg_free, NULL);
+
+	for (i = 0; names[i] != NULL; i++) {
+		GPtrArray *same_name = g_hash_table_lookup (index->names, names[i]);
+
+		if (same_name == NULL)
+			continue;
+
+		for (j = 0; j < same_name->len; j++)
+			n_array_push (pkgs, pkg_link (g_ptr_array_index (same_name, j)));
+	}
+
+	return pkgs;
+}
+
+/**
+ * pk_poldek_index_search_names:
+ *
+ * Equivalent of "ls -q *value1*value2*", but only matching the name and
+ * not the version.
+ **/
+tn_array *
+pk_poldek_index_search_names (PkPoldekIndex *index, gchar **values)
+{
+	GPatternSpec *pattern;
+	tn_array *pkgs;
+	gchar *joined;
+	gchar *glob;
+	guint i;
+
+	joined = g_strjoinv ("*", values);
+	glob = g_strdup_printf ("*%s*", joined);
+	pattern = g_pattern_spec_new (glob);
+
+	pkgs = n_array_new (4, (tn_fn_free) pkg_free, NULL);
+
+	for (i = 0; i < n_array_size (index->pkgs); i++) {
+		struct pkg *pkg = n_array_nth (index->pkgs, i);
+
+		if (g_pattern_match_string (pattern, pkg->name))
+			n_array_push (pkgs, pkg_link (pkg));
+	}
+
+	g_pattern_spec_free (pattern);
+	g_free (glob);
+	g_free (joined);
+
+	return pkgs;
+}
+
+/**
+ * pk_poldek_index_search_details:
+ *
+ * Equivalent of "search -qsd *value*" repeated for each value, i.e. every
+ * value has to appear in the summary or the description. Each package is
+ * only looked at once, rather than once per value.
+ **/
+tn_array *
+pk_poldek_index_search_details (PkPoldekIndex *index, gchar **values)
+{
+	GPatternSpec **patterns;
+	tn_array *pkgs;
+	guint n_values;
+	guint i;
+	guint j;
+
+	n_values = g_strv_length (values);
+	patterns = g_new0 (GPatternSpec *, n_values);
+	for (j = 0; j < n_values; j++) {
+		gchar *glob = g_strdup_printf ("*%s*", values[j]);
+		patterns[j] = g_pattern_spec_new (glob);
+		g_free (glob);
+	}
+
+	pkgs = n_array_new (4, (tn_fn_free) pkg_free, NULL);
+
+	for (i = 0; i < n_array_size (index->pkgs); i++) {
+		struct pkg *pkg = n_array_nth (index->pkgs, i);
+		struct pkguinf *pkgu;
+		const gchar *summary;
+		const gchar *description;
+		gboolean matches = TRUE;
+
+		if ((pkgu = pkg_uinf (pkg)) == NULL)
+			continue;
+
+		summary = pkguinf_get (pkgu, PKGUINF_SUMMARY);
+		description = pkguinf_get (pkgu, PKGUINF_DESCRIPTION);
+
+		for (j = 0; j < n_values && matches; j++) {
+			matches = (summary != NULL && g_pattern_match_string (patterns[j], summary)) ||
+				  (description != NULL && g_pattern_match_string (patterns[j], description));
+		}
+
+		if (matches)
+			n_array_push (pkgs, pkg_link (pkg));
+
+		pkguinf_free (pkgu);
+	}
+
+	for (j = 0; j < n_values; j++)
+		g_pattern_spec_free (patterns[j]);
+	g_free (patterns);
+
+	return pkgs;
+}
+
+/**
+ * pk_poldek_nevr_set_new:
+ *
+ * Builds a set of the name-epoch:version-release of each package, i.e.
+ * the fields compared by pkg_cmp_name_evr().
+ **/
+GHashTable *
+pk_poldek_nevr_set_new (tn_array *pkgs)
+{
+	GHashTable *set;
+	guint i;
+
+	set = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	if (pkgs == NULL)
+		return set;
+
+	for (i = 0; i < n_array_size (pkgs); i++)
+		pk_poldek_nevr_set_add (set, n_array_nth (pkgs, i));
+
+	return set;
+}
+
+/**
+ * pk_poldek_nevr_set_add:
+ **/
+void
+pk_poldek_nevr_set_add (GHashTable *set, const struct pkg *pkg)
+{
+	g_hash_table_add (set, g_strdup_printf ("%s-%d:%s-%s", pkg->name,
+						pkg->epoch, pkg->ver, pkg->rel));
+}
+
+/**
+ * pk_poldek_nevr_set_contains:
+ *
+ * Returns: %TRUE if a package with the same name and EVR is in @set
+ **/
+gboolean
+pk_poldek_nevr_set_contains (GHashTable *set, const struct pkg *pkg)
+{
+	gchar *nevr;
+	gboolean ret;
+
+	if (set == NULL)
+		return FALSE;
+
+	nevr = g_strdup_printf ("%s-%d:%s-%s", pkg->name, pkg->epoch, pkg->ver, pkg->rel);
+	ret = g_hash_table_contains (set, nevr);
+	g_free (nevr);
+
+	return ret;
+}
@@ -0,0 +1,62 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Marcin Banasiak <megabajt@pld-linux.org>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_POLDEK_INDEX_H
+#define __PK_POLDEK_INDEX_H
+
+#include <glib.h>
+
+#include <trurl/narray.h>
+#include <pkg.h>
+
+G_BEGIN_DECLS
+
+/* lookup tables over one loaded package set, e.g. /installed */
+typedef struct {
+	tn_array	*pkgs;
+	GHashTable	*nvra;
+	GHashTable	*names;
+	GHashTable	*requirers;	/* built on first use */
+} PkPoldekIndex;
+
+PkPoldekIndex	*pk_poldek_index_new		(tn_array	*pkgs);
+void		 pk_poldek_index_free		(PkPoldekIndex	*index);
+gchar		*pk_poldek_index_pkg_nvra	(const struct pkg *pkg);
+struct pkg	*pk_poldek_index_lookup_nvra	(PkPoldekIndex	*index,
+						 const gchar	*nvra);
+tn_array	*pk_poldek_index_get_requirers	(PkPoldekIndex	*index,
+						 struct pkg	*pkg);
+tn_array	*pk_poldek_index_resolve	(PkPoldekIndex	*index,
+						 gchar		**names);
+tn_array	*pk_poldek_index_search_names	(PkPoldekIndex	*index,
+						 gchar		**values);
+tn_array	*pk_poldek_index_search_details	(PkPoldekIndex	*index,
+						 gchar		**values);
+
+GHashTable	*pk_poldek_nevr_set_new		(tn_array	*pkgs);
+void		 pk_poldek_nevr_set_add		(GHashTable	*set,
+						 const struct pkg *pkg);
+gboolean	 pk_poldek_nevr_set_contains	(GHashTable	*set,
+						 const struct pkg *pkg);
+
+G_END_DECLS
+
+#endif /* __PK_POLDEK_INDEX_H */
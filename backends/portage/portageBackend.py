@@ -210,6 +210,133 @@ class PortageBridge():
         self.settings.lock()
 
 
+class PortageNameIndex(object):
+
+    '''
+    Category/package names of the installed and available trees, kept by
+    the long-lived dispatcher until vardb or a repository changes.
+    '''
+
+    def __init__(self, vardb, portdb):
+        self.installed = frozenset(vardb.cp_all())
+        self.available = frozenset(portdb.cp_all())
+        self.all = self.installed | self.available
+
+        self._lists = {}
+        # category -> [(package name, cp), ...]
+        self.by_category = defaultdict(list)
+        for cp in sorted(self.all):
+            cat, pn = portage.versions.catsplit(cp)
+            self.by_category[cat].append((pn, cp))
+
+    def get_cp_set(self, filters):
+        if FILTER_INSTALLED in filters:
+            return self.installed
+        elif FILTER_NOT_INSTALLED in filters:
+            return self.available
+        return self.all
+
+    def get_cp_list(self, filters):
+        cp_set = self.get_cp_set(filters)
+        key = id(cp_set)
+        if key not in self._lists:
+            self._lists[key] = sorted(cp_set)
+        return self._lists[key]
+
+    def iter_names(self, filters, category=None):
+        '''
+        Yields (package name, cp) for every cp matching filters, optionally
+        restricted to one category.
+        '''
+        cp_set = self.get_cp_set(filters)
+        if category is not None:
+            categories = [category]
+        else:
+            categories = sorted(self.by_category)
+
+        for cat in categories:
+            for pn, cp in self.by_category.get(cat, []):
+                if cp in cp_set:
+                    yield pn, cp
+
+
+class PortageFileIndex(object):
+
+    '''
+    Installed files of every package in vardb, by full path and by lower
+    case basename. Only packages whose CONTENTS changed are read again.
+    '''
+
+    def __init__(self, get_contents):
+        # get_contents(cpv) returns the paths owned by cpv
+        self._get_contents = get_contents
+        self._vdb_mtime = None
+        # cpv -> (CONTENTS mtime, paths)
+        self._packages = {}
+        self.by_path = defaultdict(set)
+        self.by_basename = defaultdict(set)
+
+    def _add(self, cpv, mtime):
+        paths = list(self._get_contents(cpv))
+        self._packages[cpv] = (mtime, paths)
+        for path in paths:
+            self.by_path[path].add(cpv)
+            self.by_basename[os.path.basename(path).lower()].add(path)
+
+    def _remove(self, cpv):
+        mtime, paths = self._packages.pop(cpv)
+        for path in paths:
+            owners = self.by_path[path]
+            owners.discard(cpv)
+            if not owners:
+                del self.by_path[path]
+                basename = os.path.basename(path).lower()
+                self.by_basename[basename].discard(path)
+                if not self.by_basename[basename]:
+                    del self.by_basename[basename]
+
+    def update(self, vardb, vdb_path):
+        # portage bumps the vardb directory on every merge and unmerge
+        try:
+            vdb_mtime = os.stat(vdb_path).st_mtime
+        except OSError:
+            vdb_mtime = None
+        if vdb_mtime is not None and vdb_mtime == self._vdb_mtime:
+            return
+        self._vdb_mtime = vdb_mtime
+
+        installed = set(vardb.cpv_all())
+        for cpv in list(self._packages):
+            if cpv not in installed:
+                self._remove(cpv)
+
+        for cpv in installed:
+            try:
+                mtime = os.stat(vardb.getpath(cpv, filename="CONTENTS")).st_mtime
+            except OSError:
+                mtime = None
+            if cpv in self._packages:
+                if self._packages[cpv][0] == mtime:
+                    continue
+                self._remove(cpv)
+            self._add(cpv, mtime)
+
+    def search(self, key):
+        '''
+        Returns the set of cpv owning key if it is a full path, otherwise
+        owning a file whose path ends with "/" + key, ignoring case.
+        '''
+        if key.startswith("/"):
+            return set(self.by_path.get(key, ()))
+
+        suffix = "/" + key.lower()
+        cpvs = set()
+        for path in self.by_basename.get(os.path.basename(suffix), ()):
+            if path.lower().endswith(suffix):
+                cpvs.update(self.by_path[path])
+        return cpvs
+
+
 class PackageKitPortageMixin(object):
 
     def __init__(self):
@@ -223,9 +350,14 @@ class PackageKitPortageMixin(object):
         self._elog_messages = []
         self._error_message = ""
         self._error_phase = ""
+        self._name_index = None
+        self._name_index_stamp = None
+        self._file_index = PortageFileIndex(self._get_file_list)
 
     # TODO: should be removed when using non-verbose function API
     def _block_output(self):
+        # send what we have before a long call hides the output
+        self._flush_output()
         sys.stdout = self._dev_null
         sys.stderr = self._dev_null
 
@@ -233,6 +365,7 @@ class PackageKitPortageMixin(object):
     def _unblock_output(self):
         sys.stdout = sys.__stdout__
         sys.stderr = sys.__stderr__
+        self._flush_output()
 
     def _is_only_trusted(self, transaction_flags):
         return (TRANSACTION_FLAG_ONLY_TRUSTED in transaction_flags) or (
@@ -609,28 +742,44 @@ class PackageKitPortageMixin(object):
 
         return cpv_list
 
+    def _get_name_index_stamp(self):
+        '''
+        Portage bumps the vardb directory on every merge and unmerge, and
+        cp_all() of a repository is the listing of its category directories.
+        '''
+        paths = [os.path.join(self.pvar.settings['EROOT'], portage.VDB_PATH)]
+        for repo in self.pvar.portdb.porttrees:
+            paths.append(os.path.join(repo, "metadata", "timestamp.chk"))
+            for cat in self._get_portage_categories():
+                paths.append(os.path.join(repo, cat))
+
+        stamp = [id(self.pvar.vardb), id(self.pvar.portdb)]
+        for path in paths:
+            try:
+                stamp.append(os.stat(path).st_mtime)
+            except OSError:
+                stamp.append(None)
+
+        return tuple(stamp)
+
+    def _get_name_index(self):
+        stamp = self._get_name_index_stamp()
+        if self._name_index is None or stamp != self._name_index_stamp:
+            self._name_index = PortageNameIndex(self.pvar.vardb,
+                                                self.pvar.portdb)
+            self._name_index_stamp = stamp
+
+        return self._name_index
+
     def _get_all_cp(self, filters):
         # NOTES:
-        # returns a list of cp
+        # returns a sorted list of cp, shared with later calls
         #
         # FILTERS:
         # - installed: ok
         # - free: ok (should be done with cpv)
         # - newest: ok (should be finished with cpv)
-        cp_list = []
-
-        if FILTER_INSTALLED in filters:
-            cp_list = self.pvar.vardb.cp_all()
-        elif FILTER_NOT_INSTALLED in filters:
-            cp_list = self.pvar.portdb.cp_all()
-        else:
-            # need installed packages first
-            cp_list = self.pvar.vardb.cp_all()
-            for cp in self.pvar.portdb.cp_all():
-                if cp not in cp_list:
-                    cp_list.append(cp)
-
-        return cp_list
+        return self._get_name_index().get_cp_list(filters)
 
     def _get_all_cpv(self, cp, filters, filter_newest=True):
         # NOTES:
@@ -1569,20 +1718,15 @@ class PackageKitPortageBackend(PackageKitPortageMixin, PackageKitBaseBackend):
         self.status(STATUS_QUERY)
         self.allow_cancel(True)
 
-        cp_list = self._get_all_cp(filters)
-        progress = PackagekitProgress(compute_equal_steps(cp_list))
+        cp_set = self._get_name_index().get_cp_set(filters)
+        progress = PackagekitProgress(compute_equal_steps(pkgs))
         self.percentage(progress.percent)
 
-        reg_expr = []
-        for pkg in pkgs:
-            reg_expr.append("^" + re.escape(pkg) + "$")
-        reg_expr = "|".join(reg_expr)
-
         # specifications says "be case sensitive"
-        s = re.compile(reg_expr)
-
-        for percentage, cp in izip(progress, cp_list):
-            if s.match(cp):
+        resolved = set()
+        for percentage, cp in izip(progress, pkgs):
+            if cp in cp_set and cp not in resolved:
+                resolved.add(cp)
                 for cpv in self._get_all_cpv(cp, filters):
                     self._package(cpv)
 
@@ -1653,29 +1797,18 @@ class PackageKitPortageBackend(PackageKitPortageMixin, PackageKitBaseBackend):
                        "search-file isn't available with ~installed filter")
             return
 
-        cpv_list = self.pvar.vardb.cpv_all()
-        is_full_path = True
+        self._file_index.update(
+            self.pvar.vardb,
+            os.path.join(self.pvar.settings['EROOT'], portage.VDB_PATH))
 
         progress = PackagekitProgress(compute_equal_steps(values))
         self.percentage(progress.percent)
 
         for percentage, key in izip(progress, values):
-
-            if key[0] != "/":
-                is_full_path = False
-                key = re.escape(key)
-                searchre = re.compile("/" + key + "$", re.IGNORECASE)
-
             # free filter
-            cpv_list = self._filter_free(cpv_list, filters)
-            nb_cpv = float(len(cpv_list))
-
-            for cpv in cpv_list:
-                for f in self._get_file_list(cpv):
-                    if (is_full_path and key == f) \
-                            or (not is_full_path and searchre.search(f)):
-                        self._package(cpv)
-                        break
+            for cpv in self._filter_free(sorted(self._file_index.search(key)),
+                                         filters):
+                self._package(cpv)
 
             self.percentage(percentage)
 
@@ -1686,16 +1819,19 @@ class PackageKitPortageBackend(PackageKitPortageMixin, PackageKitBaseBackend):
         self.status(STATUS_QUERY)
         self.allow_cancel(True)
 
-        cp_list = self._get_all_cp(filters)
+        index = self._get_name_index()
 
-        progress = PackagekitProgress(compute_equal_steps(cp_list))
+        # groups are per category, no need to look at every cp
+        categories = [cat for cat in sorted(index.by_category)
+                      if self._get_pk_group(cat) in groups]
+
+        progress = PackagekitProgress(compute_equal_steps(categories))
         self.percentage(progress.percent)
 
-        for percentage, cp in izip(progress, cp_list):
-            for group in groups:
-                if self._get_pk_group(cp) == group:
-                    for cpv in self._get_all_cpv(cp, filters):
-                        self._package(cpv)
+        for percentage, cat in izip(progress, categories):
+            for pn, cp in index.iter_names(filters, category=cat):
+                for cpv in self._get_all_cpv(cp, filters):
+                    self._package(cpv)
 
             self.percentage(percentage)
 
@@ -1730,18 +1866,13 @@ class PackageKitPortageBackend(PackageKitPortageMixin, PackageKitBaseBackend):
             k = re.escape(k)
             search_list.append(re.compile(k, re.IGNORECASE))
 
-        cp_list = self._get_all_cp(filters)
+        names = list(self._get_name_index().iter_names(
+            filters, category=category_filter))
 
-        progress = PackagekitProgress(compute_equal_steps(cp_list))
+        progress = PackagekitProgress(compute_equal_steps(names))
         self.percentage(progress.percent)
 
-        for percentage, cp in izip(progress, cp_list):
-            if category_filter:
-                cat, pkg_name = portage.versions.catsplit(cp)
-                if cat != category_filter:
-                    continue
-            else:
-                pkg_name = portage.versions.catsplit(cp)[1]
+        for percentage, (pkg_name, cp) in izip(progress, names):
             found = True
 
             # pkg name has to correspond to _every_ keys
@@ -0,0 +1,229 @@
+#!/usr/bin/python2
+# -*- coding: utf-8 -*-
+# vim:set shiftwidth=4 tabstop=4 expandtab:
+#
+# Licensed under the GNU General Public License Version 2
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Times the indexes of portageBackend.py against the code they replaced:
+#
+#   ./portageBenchmark.py names [PACKAGES]
+#       cp merging and Resolve on a synthetic tree
+#   ./portageBenchmark.py files [PACKAGES]
+#       SearchFile on a fixture vardb, also checking incremental updates
+
+import os
+import re
+import shutil
+import sys
+import tempfile
+import time
+
+from packagekit.enums import FILTER_NONE
+from portageBackend import PortageFileIndex, PortageNameIndex
+
+
+class SyntheticDbapi(object):
+
+    def __init__(self, cp_list):
+        self._cp_list = sorted(cp_list)
+
+    def cp_all(self):
+        return list(self._cp_list)
+
+
+def synthetic_tree(n_packages):
+    '''
+    Returns (vardb, portdb) with n_packages available packages spread over
+    150 categories, a fifth of them installed plus a few installed only.
+    '''
+    available = ["cat-%i/pkg%i" % (i % 150, i) for i in range(n_packages)]
+    installed = available[::5] + ["cat-%i/gone%i" % (i % 150, i)
+                                  for i in range(n_packages // 100)]
+    return SyntheticDbapi(installed), SyntheticDbapi(available)
+
+
+def old_get_all_cp(vardb, portdb):
+    cp_list = vardb.cp_all()
+    for cp in portdb.cp_all():
+        if cp not in cp_list:
+            cp_list.append(cp)
+    return cp_list
+
+
+def old_resolve(cp_list, pkgs):
+    s = re.compile("|".join(["^" + re.escape(pkg) + "$" for pkg in pkgs]))
+    return [cp for cp in cp_list if s.match(cp)]
+
+
+def new_resolve(index, pkgs):
+    cp_set = index.get_cp_set([FILTER_NONE])
+    return [cp for cp in pkgs if cp in cp_set]
+
+
+def timed(func, *args):
+    start = time.time()
+    ret = func(*args)
+    return ret, (time.time() - start) * 1000
+
+
+def benchmark_names(n_packages):
+    vardb, portdb = synthetic_tree(n_packages)
+    pkgs = ["cat-%i/pkg%i" % (i % 150, i)
+            for i in range(0, n_packages, n_packages // 50 or 1)]
+
+    old_cp, old_merge_ms = timed(old_get_all_cp, vardb, portdb)
+    index, index_ms = timed(PortageNameIndex, vardb, portdb)
+    new_cp = index.get_cp_list([FILTER_NONE])
+
+    old_found, old_resolve_ms = timed(old_resolve, old_cp, pkgs)
+    new_found, new_resolve_ms = timed(new_resolve, index, pkgs)
+
+    print("packages:         %i" % len(new_cp))
+    print("list merge:       %.3fms" % old_merge_ms)
+    print("name index:       %.3fms" % index_ms)
+    print("regex resolve:    %.3fms (%i found)" %
+          (old_resolve_ms, len(old_found)))
+    print("set resolve:      %.3fms (%i found)" %
+          (new_resolve_ms, len(new_found)))
+
+    if sorted(old_cp) != new_cp or sorted(old_found) != sorted(new_found):
+        print("results differ")
+        return 1
+
+    return 0
+
+
+class FixtureVardb(object):
+
+    '''
+    The part of vardbapi used by PortageFileIndex, over a directory laid
+    out like /var/db/pkg.
+    '''
+
+    def __init__(self, root):
+        self.root = root
+        self.reads = 0
+
+    def cpv_all(self):
+        return ["%s/%s" % (cat, pv)
+                for cat in sorted(os.listdir(self.root))
+                for pv in sorted(os.listdir(os.path.join(self.root, cat)))]
+
+    def getpath(self, cpv, filename=None):
+        return os.path.join(self.root, cpv, filename or "")
+
+    def get_contents(self, cpv):
+        self.reads += 1
+        with open(self.getpath(cpv, "CONTENTS")) as f:
+            return [line.split(" ")[1] for line in f if line.strip()]
+
+    def write_contents(self, cpv, paths):
+        if not os.path.isdir(self.getpath(cpv)):
+            os.makedirs(self.getpath(cpv))
+        with open(self.getpath(cpv, "CONTENTS"), "w") as f:
+            for path in paths:
+                f.write("obj %s 0123456789abcdef 1500000000\n" % path)
+
+    def touch(self, cpv=None):
+        # mtimes may have a one second resolution
+        stamp = time.time() + 10 + self.reads
+        if cpv is not None:
+            os.utime(self.getpath(cpv, "CONTENTS"), (stamp, stamp))
+        os.utime(self.root, (stamp, stamp))
+
+
+def old_search_file(vardb, key):
+    if key[0] == "/":
+        return set(cpv for cpv in vardb.cpv_all()
+                   if key in vardb.get_contents(cpv))
+    searchre = re.compile("/" + re.escape(key) + "$", re.IGNORECASE)
+    return set(cpv for cpv in vardb.cpv_all()
+               if any(searchre.search(f) for f in vardb.get_contents(cpv)))
+
+
+def benchmark_files(n_packages):
+    root = tempfile.mkdtemp()
+    try:
+        vardb = FixtureVardb(root)
+        for i in range(n_packages):
+            vardb.write_contents(
+                "cat-%i/pkg%i-1.0" % (i % 150, i),
+                ["/usr/bin/pkg%i" % i, "/usr/share/doc/pkg%i/README" % i] +
+                ["/usr/lib/pkg%i/module%i.so" % (i, j) for j in range(100)])
+        vardb.write_contents("sys-apps/coreutils-8.0", ["/bin/ls", "/bin/Cat"])
+        vardb.touch()
+
+        keys = ["/bin/ls", "cat", "bin/pkg7", "README", "/usr/bin/nothing"]
+        expected = [set(["sys-apps/coreutils-8.0"]),
+                    set(["sys-apps/coreutils-8.0"]),
+                    set(["cat-7/pkg7-1.0"]),
+                    set(["cat-%i/pkg%i-1.0" % (i % 150, i)
+                         for i in range(n_packages)]),
+                    set()]
+
+        start = time.time()
+        old = [old_search_file(vardb, key) for key in keys]
+        old_ms = (time.time() - start) * 1000
+
+        index = PortageFileIndex(vardb.get_contents)
+        start = time.time()
+        index.update(vardb, root)
+        build_ms = (time.time() - start) * 1000
+        start = time.time()
+        new = [index.search(key) for key in keys]
+        search_ms = (time.time() - start) * 1000
+
+        # a re-merged and a removed package
+        vardb.reads = 0
+        vardb.write_contents("sys-apps/coreutils-8.0", ["/bin/cat"])
+        vardb.touch("sys-apps/coreutils-8.0")
+        shutil.rmtree(vardb.getpath("cat-7/pkg7-1.0"))
+        index.update(vardb, root)
+        updated = [index.search(key) for key in ["/bin/ls", "cat", "bin/pkg7"]]
+
+        print("packages:         %i" % (n_packages + 1))
+        print("files:            %i" % len(index.by_path))
+        print("scan (%i keys):    %.3fms" % (len(keys), old_ms))
+        print("index build:      %.3fms" % build_ms)
+        print("index (%i keys):   %.3fms" % (len(keys), search_ms))
+
+        if old != expected or new != expected:
+            print("results differ")
+            return 1
+        if vardb.reads != 1 or \
+                updated != [set(), set(["sys-apps/coreutils-8.0"]), set()]:
+            print("incremental update failed")
+            return 1
+    finally:
+        shutil.rmtree(root)
+
+    return 0
+
+
+def main():
+    mode = sys.argv[1] if len(sys.argv) > 1 else "names"
+    if mode == "names":
+        n_packages = int(sys.argv[2]) if len(sys.argv) > 2 else 20000
+        return benchmark_names(n_packages)
+    if mode == "files":
+        n_packages = int(sys.argv[2]) if len(sys.argv) > 2 else 1000
+        return benchmark_files(n_packages)
+    print("Usage: %s [names|files] [PACKAGES]" % sys.argv[0])
+    return 1
+
+if __name__ == "__main__":
+    sys.exit(main())
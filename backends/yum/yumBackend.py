@@ -62,6 +62,7 @@ import ConfigParser
 
 from yumFilter import *
 from yumComps import *
+from yumUpdateInfo import *
 
 # Global vars
 yumbase = None
@@ -262,6 +263,11 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
             self.doLock()
 
         self.package_summary_cache = {}
+        self._installed_map = None
+        self._installed_map_stamp = None
+        self.updateinfo = yumUpdateInfo()
+        if not self.updateinfo.connect():
+            self.updateinfo = None
         self.comps = yumComps(self.yumbase)
         if not self.comps.connect():
             self.refresh_cache(True)
@@ -442,6 +448,53 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
         for (pkg, status) in lst:
             self._show_package(pkg, status)
 
+    def _get_rpmdb_stamp(self):
+        '''
+        Something that changes whenever a package is installed or removed
+        '''
+        dbpath = os.path.join(self.yumbase.conf.installroot, 'var/lib/rpm')
+        stamp = [id(self.yumbase.rpmdb)]
+        for path in [dbpath, os.path.join(dbpath, 'Packages')]:
+            try:
+                st = os.stat(path)
+            except OSError:
+                stamp.append(None)
+            else:
+                stamp.append((st.st_mtime, st.st_size, st.st_ino))
+        return tuple(stamp)
+
+    def _check_installed_map(self):
+        '''
+        Drop the installed map if the rpmdb changed since it was built
+        '''
+        if self._installed_map is None:
+            return
+        if self._get_rpmdb_stamp() != self._installed_map_stamp:
+            self._installed_map = None
+
+    def _get_installed_map(self):
+        '''
+        Returns (by_pkgtup, by_name) of everything in the rpmdb, built with
+        one pass over it and kept until the rpmdb changes
+        '''
+        if self._installed_map is not None:
+            return self._installed_map
+
+        stamp = self._get_rpmdb_stamp()
+        by_pkgtup = {}
+        by_name = {}
+        try:
+            for po in self.yumbase.rpmdb:
+                by_pkgtup[po.pkgtup] = po
+                by_name.setdefault(po.name, []).append(po)
+        except exceptions.IOError, e:
+            raise PkError(ERROR_NO_SPACE_ON_DEVICE, "Disk error: %s" % _to_unicode(e))
+        except Exception, e:
+            raise PkError(ERROR_INTERNAL_ERROR, _format_str(traceback.format_exc()))
+        self._installed_map = (by_pkgtup, by_name)
+        self._installed_map_stamp = stamp
+        return self._installed_map
+
     def search_name(self, filters, values):
         '''
         Implement the search-name functionality
@@ -496,15 +549,9 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
 
     def _get_installed_from_names(self, name_list):
         found = []
+        by_name = self._get_installed_map()[1]
         for package in name_list:
-            try:
-                pkgs = self.yumbase.rpmdb.searchNevra(name=package)
-            except exceptions.IOError, e:
-                raise PkError(ERROR_NO_SPACE_ON_DEVICE, "Disk error: %s" % _to_unicode(e))
-            except Exception, e:
-                raise PkError(ERROR_INTERNAL_ERROR, _format_str(traceback.format_exc()))
-            else:
-                found.extend(pkgs)
+            found.extend(by_name.get(package, []))
         return found
 
     def _get_available_from_names(self, name_list):
@@ -574,9 +621,9 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
     def _handle_repo_group_search(self, repo_id, filters):
         """
         Handle the special repo groups
-        This is much slower than using _handle_repo_group_search_using_yumdb()
-        as we have to resolve each package in the repo to see if it's
-        installed.
+        This has to look up each package in the repo to see if it's
+        installed, whereas _handle_repo_group_search_using_yumdb() only
+        looks at the installed packages.
         Of course, on RHEL5, there is no yumdb.
         """
         self.percentage(None)
@@ -607,15 +654,11 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
         except Exception, e:
             raise PkError(ERROR_INTERNAL_ERROR, _format_str(traceback.format_exc()))
 
+        by_pkgtup = self._get_installed_map()[0]
         for pkg in repos[0].sack:
-            try:
-                instpo = self.yumbase.rpmdb.searchNevra(name=pkg.name, epoch=pkg.epoch, ver=pkg.ver, rel=pkg.rel, arch=pkg.arch)
-            except exceptions.IOError, e:
-                raise PkError(ERROR_NO_SPACE_ON_DEVICE, "Disk error: %s" % _to_unicode(e))
-            except Exception, e:
-                raise PkError(ERROR_INTERNAL_ERROR, _format_str(traceback.format_exc()))
-            if self._is_inst(pkg):
-                installed.append(instpo[0])
+            instpo = by_pkgtup.get(pkg.pkgtup)
+            if instpo:
+                installed.append(instpo)
             else:
                 available.append(pkg)
 
@@ -645,15 +688,11 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
         else:
             installed = []
             available = []
+            by_pkgtup = self._get_installed_map()[0]
             for pkg in pkgs:
-                try:
-                    instpo = self.yumbase.rpmdb.searchNevra(name=pkg.name, epoch=pkg.epoch, ver=pkg.ver, rel=pkg.rel, arch=pkg.arch)
-                except exceptions.IOError, e:
-                    raise PkError(ERROR_NO_SPACE_ON_DEVICE, "Disk error: %s" % _to_unicode(e))
-                except Exception, e:
-                    raise PkError(ERROR_INTERNAL_ERROR, _format_str(traceback.format_exc()))
-                if len(instpo) > 0:
-                    installed.append(instpo[0])
+                instpo = by_pkgtup.get(pkg.pkgtup)
+                if instpo:
+                    installed.append(instpo)
                 else:
                     available.append(pkg)
 
@@ -1323,12 +1362,10 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
     def _is_inst(self, pkg):
         # search only for requested arch
         try:
-            ret = self.yumbase.rpmdb.installed(po=pkg)
-        except exceptions.IOError, e:
-            self.error(ERROR_NO_SPACE_ON_DEVICE, "Disk error: %s" % _to_unicode(e))
-        except Exception, e:
-            self.error(ERROR_INTERNAL_ERROR, _format_str(traceback.format_exc()))
-        return ret
+            by_pkgtup = self._get_installed_map()[0]
+        except PkError, e:
+            self.error(e.code, e.details)
+        return pkg.pkgtup in by_pkgtup
 
     def _is_inst_arch(self, pkg):
         # search for a requested arch first
@@ -1361,11 +1398,11 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
 
         # everything installed that matches the name
         try:
-            installedByKey = self.yumbase.rpmdb.searchNevra(name=pkg.name, arch=pkg.arch)
-        except exceptions.IOError, e:
-            self.error(ERROR_NO_SPACE_ON_DEVICE, "Disk error: %s" % _to_unicode(e))
-        except Exception, e:
-            self.error(ERROR_INTERNAL_ERROR, _format_str(traceback.format_exc()))
+            by_name = self._get_installed_map()[1]
+        except PkError, e:
+            self.error(e.code, e.details)
+        installedByKey = [instpo for instpo in by_name.get(pkg.name, [])
+                          if instpo.arch == pkg.arch]
         comparable = []
         for instpo in installedByKey:
             if rpmUtils.arch.isMultiLibArch(instpo.arch) == rpmUtils.arch.isMultiLibArch(pkg.arch):
@@ -1795,6 +1832,10 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
             # update the comps groups too
             self.comps.refresh()
 
+            # and parse the new updateinfo now rather than on the next query
+            self._updateMetadata = None
+            self._get_update_metadata()
+
     def resolve(self, filters, packages):
         '''
         Implement the resolve functionality
@@ -1823,11 +1864,9 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
             # Get installed packages
             if FILTER_NOT_INSTALLED not in filters:
                 try:
-                    pkgs = self.yumbase.rpmdb.searchNevra(name=package)
-                except exceptions.IOError, e:
-                    self.error(ERROR_NO_SPACE_ON_DEVICE, "Disk error: %s" % _to_unicode(e))
-                except Exception, e:
-                    self.error(ERROR_INTERNAL_ERROR, _format_str(traceback.format_exc()))
+                    pkgs = self._get_installed_from_names([package])
+                except PkError, e:
+                    self.error(e.code, e.details)
                 else:
                     pkgfilter.add_installed(pkgs)
 
@@ -2234,6 +2273,7 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
         try:
             self.yumbase.conf.skip_broken = 0
             self.yumbase.rpmdb.auto_close = False
+            self._installed_map = None
             rc, msgs = self.yumbase.buildTransaction()
             message = _format_msgs(msgs)
         except yum.Errors.RepoError, e:
@@ -2745,6 +2785,7 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
 
         # update the comps groups too
         self.comps.refresh()
+        self._updateMetadata = None
 
     def get_repo_list(self, filters):
         '''
@@ -2799,6 +2840,15 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
             return ""
 
     def _get_update_metadata(self):
+        if not self._updateMetadata and self.updateinfo:
+            # only parses the repos whose updateinfo changed
+            try:
+                if self.updateinfo.refresh(self.yumbase.repos.listEnabled()):
+                    self._updateMetadata = self.updateinfo
+            except exceptions.IOError, e:
+                self.error(ERROR_NO_SPACE_ON_DEVICE, "Disk error: %s" % _to_unicode(e))
+            except Exception, e:
+                pass # fall back to parsing in memory
         if not self._updateMetadata:
             self._updateMetadata = UpdateMetadata()
             for repo in self.yumbase.repos.listEnabled():
@@ -3035,6 +3085,9 @@ class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
         # clear previous transaction data
         self.yumbase._tsInfo = None
 
+        # something else may have changed the rpmdb since the last request
+        self._check_installed_map()
+
         # auto_close is good for ad-hoc queries, but shouldn't be used
         # when running a transaction
         self.yumbase.rpmdb.auto_close = True
@@ -0,0 +1,224 @@
+#!/usr/bin/python
+# Licensed under the GNU General Public License Version 2
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+import sqlite3
+import marshal
+import os
+import sys
+from yum.update_md import UpdateMetadata, UpdateNotice, UpdateNoticeException
+from yum.Errors import YumBaseError
+from rpmUtils.miscutils import compareEVR
+
+__DB_VER__ = '1'
+
+def _log(msg):
+    ''' stdout is the protocol channel of the backend, so log to stderr '''
+    sys.stderr.write('yumUpdateInfo: %s\n' % msg)
+
+class yumUpdateInfo:
+
+    '''
+    The parsed updateinfo of each repo, stored so that helpers do not have
+    to decompress and parse the XML again on every start. A repo is only
+    parsed again when the checksum of its updateinfo changes.
+    '''
+
+    def __init__(self, db = None):
+        self.cursor = None
+        self.connection = None
+        if not db:
+            db = '/var/cache/PackageKit/updateinfo.sqlite'
+        self.db = db
+        self._notices = {}
+
+        # ensure the directory exists
+        dirname = os.path.dirname(db)
+        if not os.path.isdir(dirname):
+            os.makedirs(dirname)
+
+    def connect(self):
+        ''' connect to database '''
+        try:
+            # will be created if it does not exist
+            self.connection = sqlite3.connect(self.db)
+            self.cursor = self.connection.cursor()
+        except sqlite3.Error, e:
+            _log('cannot connect to database %s: %s' % (self.db, str(e)))
+            return False
+
+        try:
+            version = None
+            # Get the current database version
+            self.cursor.execute('SELECT version FROM version')
+            for row in self.cursor:
+                version = str(row[0])
+                break
+            # Check if we have the right DB version
+            if not version or version != __DB_VER__:
+                if version:
+                    _log("wrong database version: %s needs %s" % (version, __DB_VER__))
+                return self._make_database_tables()
+        except sqlite3.DatabaseError, e:
+            # We couldn't get the version, so create a new database
+            return self._make_database_tables()
+
+        return True
+
+    def _make_database_tables(self):
+        ''' Setup a database for the parsed update notices '''
+        try: # kill the old db
+            self.connection.close()
+            if os.path.exists(self.db):
+                os.unlink(self.db) # kill the db
+            self.connection = sqlite3.connect(self.db)
+            self.cursor = self.connection.cursor()
+            self.cursor.execute('CREATE TABLE repos (repoid TEXT PRIMARY KEY, checksum TEXT);')
+            self.cursor.execute('CREATE TABLE notices (id INTEGER PRIMARY KEY, repoid TEXT, data BLOB);')
+            self.cursor.execute('CREATE TABLE packages (name TEXT, arch TEXT, epoch TEXT, version TEXT, release TEXT, notice INTEGER);')
+            self.cursor.execute('CREATE INDEX packages_name ON packages (name, arch);')
+            self.cursor.execute('CREATE INDEX notices_repoid ON notices (repoid);')
+            self.cursor.execute('CREATE TABLE version (version TEXT);')
+            self.cursor.execute('INSERT INTO version values(?);', __DB_VER__)
+            self.connection.commit()
+        except (OSError, sqlite3.Error), e:
+            _log('cannot create database %s: %s' % (self.db, str(e)))
+            self.cursor = None
+            return False
+        return True
+
+    def _get_checksum(self, repo):
+        ''' the checksum of the updateinfo in repomd.xml, or None '''
+        try:
+            data = repo.repoXML.repoData.get('updateinfo')
+        except YumBaseError, e:
+            _log('cannot get the metadata of %s: %s' % (repo.id, str(e)))
+            return None
+        if not data:
+            return None
+        return data.checksum[1]
+
+    def _remove_repo(self, repoid):
+        self.cursor.execute('DELETE FROM packages WHERE notice IN (SELECT id FROM notices WHERE repoid = ?);', (repoid,))
+        self.cursor.execute('DELETE FROM notices WHERE repoid = ?;', (repoid,))
+        self.cursor.execute('DELETE FROM repos WHERE repoid = ?;', (repoid,))
+
+    def _parse_repo(self, repo):
+        ''' the parsed updateinfo of the repo, or None if it has none '''
+        md = UpdateMetadata()
+        try:
+            md.add(repo)
+        except (YumBaseError, UpdateNoticeException, SyntaxError, IOError), e:
+            _log('cannot parse the updateinfo of %s: %s' % (repo.id, str(e)))
+            return None
+        return md
+
+    def _add_repo(self, repo, md, checksum):
+        for notice in md.notices:
+            self.cursor.execute('INSERT INTO notices (repoid, data) values(?, ?);',
+                                (repo.id, buffer(marshal.dumps(notice.get_metadata()))))
+            notice_id = self.cursor.lastrowid
+            for upkg in notice['pkglist']:
+                for pkg in upkg['packages']:
+                    self.cursor.execute('INSERT INTO packages values(?, ?, ?, ?, ?, ?);',
+                                        (pkg['name'], pkg['arch'], pkg['epoch'] or '0',
+                                         pkg['version'], pkg['release'], notice_id))
+        self.cursor.execute('INSERT INTO repos values(?, ?);', (repo.id, checksum))
+
+    def refresh(self, repos):
+        '''
+        Parse the updateinfo of the repos that changed since they were
+        stored, and forget the repos that are not in the list any more.
+        Returns False if nothing could be stored.
+        '''
+        if not self.cursor:
+            return False
+
+        stored = {}
+        self.cursor.execute('SELECT repoid, checksum FROM repos;')
+        for (repoid, checksum) in self.cursor.fetchall():
+            stored[repoid] = checksum
+
+        changed = False
+        for repo in repos:
+            checksum = self._get_checksum(repo)
+            if checksum and stored.pop(repo.id, None) == checksum:
+                continue
+            changed = True
+            md = None
+            if checksum:
+                md = self._parse_repo(repo)
+
+            # each repo is replaced in one transaction, so a failure
+            # cannot leave notices without their packages behind
+            try:
+                self._remove_repo(repo.id)
+                if md:
+                    self._add_repo(repo, md, checksum)
+                self.connection.commit()
+            except sqlite3.Error, e:
+                self.connection.rollback()
+                _log('cannot store the updateinfo of %s: %s' % (repo.id, str(e)))
+                return False
+        try:
+            for repoid in stored.keys():
+                self._remove_repo(repoid)
+                changed = True
+            self.connection.commit()
+        except sqlite3.Error, e:
+            self.connection.rollback()
+            _log('cannot remove old repos: %s' % str(e))
+            return False
+
+        if changed:
+            self._notices = {}
+        return True
+
+    def _get_notice_by_id(self, notice_id):
+        if notice_id not in self._notices:
+            self.cursor.execute('SELECT data FROM notices WHERE id = ?;', (notice_id,))
+            row = self.cursor.fetchone()
+            if not row:
+                return None
+            notice = UpdateNotice()
+            notice._md = marshal.loads(str(row[0]))
+            self._notices[notice_id] = notice
+        return self._notices[notice_id]
+
+    def get_notice(self, nvr):
+        ''' Same as UpdateMetadata.get_notice() '''
+        name, version, release = nvr
+        self.cursor.execute('SELECT notice FROM packages WHERE name = ? AND version = ? AND release = ? LIMIT 1;',
+                            (name, version, release))
+        row = self.cursor.fetchone()
+        if not row:
+            return None
+        return self._get_notice_by_id(row[0])
+
+    def get_applicable_notices(self, pkgtup):
+        ''' Same as UpdateMetadata.get_applicable_notices() '''
+        name, arch, epoch, version, release = pkgtup
+        self.cursor.execute('SELECT epoch, version, release, notice FROM packages WHERE name = ? AND arch = ?;',
+                            (name, arch))
+        ret = []
+        for (e, v, r, notice_id) in self.cursor.fetchall():
+            if compareEVR((e, v, r), (epoch, version, release)) <= 0:
+                continue
+            notice = self._get_notice_by_id(notice_id)
+            if notice:
+                ret.append(((name, arch, e, v, r), notice))
+        ret.sort(lambda x, y: compareEVR(x[0][2:], y[0][2:]), reverse=True)
+        return ret
@@ -0,0 +1,72 @@
+#!/usr/bin/python
+# Licensed under the GNU General Public License Version 2
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+from yumUpdateInfo import *
+from yum.update_md import UpdateMetadata
+import os
+import time
+import yum
+
+def main():
+    _yb = yum.YumBase()
+    _db = "/tmp/updateinfo.sqlite"
+    _repos = _yb.repos.listEnabled()
+
+    # what every helper start used to do
+    _start = time.time()
+    _md = UpdateMetadata()
+    for _repo in _repos:
+        try:
+            _md.add(_repo)
+        except Exception, e:
+            pass
+    print "parse xml: %.3fs" % (time.time() - _start)
+
+    _info = yumUpdateInfo(_db)
+    assert _info.connect()
+    _start = time.time()
+    assert _info.refresh(_repos)
+    print "store:     %.3fs" % (time.time() - _start)
+    _start = time.time()
+    assert _info.refresh(_repos)
+    print "unchanged: %.3fs" % (time.time() - _start)
+
+    # every installed package has the same notices as without the cache
+    _found = 0
+    _start = time.time()
+    for _pkg in _yb.rpmdb:
+        _notices = _info.get_applicable_notices(_pkg.pkgtup)
+        assert [(t, n['update_id']) for (t, n) in _notices] == \
+               [(t, n['update_id']) for (t, n) in _md.get_applicable_notices(_pkg.pkgtup)], \
+               "different notices for %s" % _pkg
+        for (_t, _notice) in _notices:
+            _nvr = (_t[0], _t[3], _t[4])
+            assert (_info.get_notice(_nvr) is None) == (_md.get_notice(_nvr) is None), \
+                   "notice missing for %s" % str(_nvr)
+        _found += len(_notices)
+    print "lookups:   %.3fs (%i notices)" % (time.time() - _start, _found)
+
+    # a new connection uses the stored notices
+    _info = yumUpdateInfo(_db)
+    assert _info.connect()
+    for _pkg in _yb.rpmdb:
+        assert len(_info.get_applicable_notices(_pkg.pkgtup)) == \
+               len(_md.get_applicable_notices(_pkg.pkgtup))
+    os.unlink(_db) # kill the db
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,154 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <locale.h>
+#include <sys/resource.h>
+#include <glib.h>
+#include <packagekit-glib2/packagekit.h>
+
+/**
+ * pk_benchmark_get_cpu_time:
+ *
+ * Return value: the user and system time of this process in microseconds
+ **/
+static guint64
+pk_benchmark_get_cpu_time (struct rusage *usage)
+{
+	getrusage (RUSAGE_SELF, usage);
+	return (guint64) (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * G_USEC_PER_SEC +
+		usage->ru_utime.tv_usec + usage->ru_stime.tv_usec;
+}
+
+/**
+ * pk_benchmark_get_values:
+ *
+ * Every tenth package of the synthetic repository of the dummy backend,
+ * the same values that 'packagekit-direct benchmark' uses.
+ **/
+static gchar **
+pk_benchmark_get_values (gboolean package_ids)
+{
+	gchar **values;
+	guint i;
+
+	values = g_new0 (gchar *, 101);
+	for (i = 0; i < 100; i++) {
+		if (package_ids) {
+			values[i] = g_strdup_printf ("synthetic%06u;1.0-1;x86_64;synthetic",
+						     i * 10);
+		} else {
+			values[i] = g_strdup_printf ("synthetic%06u", i * 10);
+		}
+	}
+	return values;
+}
+
+/**
+ * pk_benchmark_get_results_size:
+ **/
+static guint
+pk_benchmark_get_results_size (PkResults *results)
+{
+	g_autoptr(GPtrArray) files = NULL;
+	g_autoptr(PkPackageSack) sack = NULL;
+
+	sack = pk_results_get_package_sack (results);
+	files = pk_results_get_files_array (results);
+	return pk_package_sack_get_size (sack) + files->len;
+}
+
+/**
+ * main:
+ **/
+int
+main (int argc, char *argv[])
+{
+	gint64 wall_time;
+	guint64 cpu_time;
+	PkRoleEnum role;
+	struct rusage usage;
+	gchar *search[] = { "synthetic00", NULL };
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkClient) client = NULL;
+	g_autoptr(PkResults) results = NULL;
+	g_auto(GStrv) names = NULL;
+	g_auto(GStrv) package_ids = NULL;
+
+	setlocale (LC_ALL, "");
+
+	if (argc != 2) {
+		g_print ("Usage: %s get-packages|search-name|resolve|get-files|get-updates\n",
+			 argv[0]);
+		return EXIT_FAILURE;
+	}
+	role = pk_role_enum_from_string (argv[1]);
+	names = pk_benchmark_get_values (FALSE);
+	package_ids = pk_benchmark_get_values (TRUE);
+
+	client = pk_client_new ();
+	pk_client_set_background (client, FALSE);
+	pk_client_set_interactive (client, FALSE);
+
+	cpu_time = pk_benchmark_get_cpu_time (&usage);
+	wall_time = g_get_monotonic_time ();
+	switch (role) {
+	case PK_ROLE_ENUM_GET_PACKAGES:
+		results = pk_client_get_packages (client, 0, NULL,
+						  NULL, NULL, &error);
+		break;
+	case PK_ROLE_ENUM_SEARCH_NAME:
+		results = pk_client_search_names (client, 0, search, NULL,
+						  NULL, NULL, &error);
+		break;
+	case PK_ROLE_ENUM_RESOLVE:
+		results = pk_client_resolve (client, 0, names, NULL,
+					     NULL, NULL, &error);
+		break;
+	case PK_ROLE_ENUM_GET_FILES:
+		results = pk_client_get_files (client, package_ids, NULL,
+					       NULL, NULL, &error);
+		break;
+	case PK_ROLE_ENUM_GET_UPDATES:
+		results = pk_client_get_updates (client, 0, NULL,
+						 NULL, NULL, &error);
+		break;
+	default:
+		g_print ("Cannot benchmark %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	if (results == NULL) {
+		g_print ("Failed to %s: %s\n", argv[1], error->message);
+		return EXIT_FAILURE;
+	}
+	wall_time = g_get_monotonic_time () - wall_time;
+	cpu_time = pk_benchmark_get_cpu_time (&usage) - cpu_time;
+
+	g_print ("%s\tresults=%u\twall=%.3fs\tcpu=%.3fs\tpeak-rss=%likB\n",
+		 pk_role_enum_to_string (role),
+		 pk_benchmark_get_results_size (results),
+		 (gdouble) wall_time / G_USEC_PER_SEC,
+		 (gdouble) cpu_time / G_USEC_PER_SEC,
+		 usage.ru_maxrss);
+	return EXIT_SUCCESS;
+}
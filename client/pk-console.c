@@ -1480,6 +1480,7 @@ pk_console_get_summary (PkConsoleCtx *ctx)
 	g_string_append_printf (string, "  %s\n", "get-filters");
 	g_string_append_printf (string, "  %s\n", "get-transactions");
 	g_string_append_printf (string, "  %s\n", "get-time");
+	g_string_append_printf (string, "  %s\n", "get-metrics");
 
 	if (pk_bitfield_contain (ctx->roles, PK_ROLE_ENUM_SEARCH_NAME) ||
 	    pk_bitfield_contain (ctx->roles, PK_ROLE_ENUM_SEARCH_DETAILS) ||
@@ -1570,6 +1571,29 @@ out:
 	g_main_loop_quit (ctx->loop);
 }
 
+/**
+ * pk_console_get_metrics_cb:
+ **/
+static void
+pk_console_get_metrics_cb (GObject *object, GAsyncResult *res, gpointer data)
+{
+	PkConsoleCtx *ctx = (PkConsoleCtx *) data;
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *metrics = NULL;
+
+	/* get the results */
+	metrics = pk_control_get_metrics_finish (ctx->control, res, &error);
+	if (metrics == NULL) {
+		/* TRANSLATORS: the daemon keeps statistics about the
+		 * transactions it has run */
+		g_print ("%s: %s\n", _("Failed to get the daemon metrics"), error->message);
+		goto out;
+	}
+	g_print ("%s", metrics);
+out:
+	g_main_loop_quit (ctx->loop);
+}
+
 /**
  * pk_console_offline_get_prepared:
  **/
@@ -2175,6 +2199,11 @@ main (int argc, char *argv[])
 							ctx->cancellable,
 							pk_console_get_time_since_action_cb, ctx);
 
+	} else if (strcmp (mode, "get-metrics") == 0) {
+		pk_control_get_metrics_async (ctx->control,
+					      ctx->cancellable,
+					      pk_console_get_metrics_cb, ctx);
+
 	} else if (strcmp (mode, "quit") == 0) {
 		pk_control_suggest_daemon_quit (ctx->control,
 						ctx->cancellable,
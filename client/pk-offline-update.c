@@ -385,6 +385,68 @@ pk_offline_update_get_action (void)
 	return action;
 }
 
+/**
+ * pk_offline_update_is_prepared_current:
+ *
+ * The prepared update can be used as it is if nothing has been installed
+ * or removed since it was solved. Updates prepared by an older version
+ * have no fingerprint and are always used as they are.
+ **/
+static gboolean
+pk_offline_update_is_prepared_current (void)
+{
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *fingerprint = NULL;
+	g_autofree gchar *fingerprint_prepared = NULL;
+
+	fingerprint_prepared = pk_offline_get_prepared_fingerprint (&error);
+	if (fingerprint_prepared == NULL)
+		return TRUE;
+	fingerprint = pk_offline_get_package_db_fingerprint ();
+	return g_strcmp0 (fingerprint, fingerprint_prepared) == 0;
+}
+
+/**
+ * pk_offline_update_resolve_prepared:
+ *
+ * Drops the prepared package-ids that are no longer offered as updates,
+ * for instance because they have been installed since. Only the exact
+ * versions that were downloaded are kept, and the metadata is never
+ * refreshed as there may be no network.
+ **/
+static gchar **
+pk_offline_update_resolve_prepared (PkTask *task, gchar **package_ids, GError **error)
+{
+	GPtrArray *array;
+	PkPackage *pkg;
+	guint i;
+	g_autoptr(PkPackageSack) sack = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	pk_client_set_cache_age (PK_CLIENT (task), G_MAXUINT);
+	results = pk_client_get_updates (PK_CLIENT (task),
+					 pk_bitfield_value (PK_FILTER_ENUM_NONE),
+					 NULL, /* GCancellable */
+					 NULL, NULL, /* progress */
+					 error);
+	if (results == NULL)
+		return NULL;
+	sack = pk_results_get_package_sack (results);
+	array = g_ptr_array_new ();
+	for (i = 0; package_ids[i] != NULL; i++) {
+		pkg = pk_package_sack_find_by_id (sack, package_ids[i]);
+		if (pkg == NULL) {
+			sd_journal_print (LOG_INFO, "%s no longer needs updating",
+					  package_ids[i]);
+			continue;
+		}
+		g_ptr_array_add (array, g_strdup (package_ids[i]));
+		g_object_unref (pkg);
+	}
+	g_ptr_array_add (array, NULL);
+	return (gchar **) g_ptr_array_free (array, FALSE);
+}
+
 static gboolean
 pk_offline_update_do_update (PkTask *task, PkProgressBar *progressbar, GError **error)
 {
@@ -398,6 +460,39 @@ pk_offline_update_do_update (PkTask *task, PkProgressBar *progressbar, GError **
 		return FALSE;
 	}
 
+	/* the backend can commit the transaction it solved when the update
+	 * was prepared, as long as nothing has changed since */
+	if (pk_offline_update_is_prepared_current ()) {
+		g_autofree gchar *plan = NULL;
+		g_autoptr(GError) error_local = NULL;
+		plan = pk_offline_get_prepared_plan (&error_local);
+		if (plan == NULL) {
+			sd_journal_print (LOG_INFO, "not using the prepared plan: %s",
+					  error_local->message);
+		}
+		pk_client_set_prepared_plan (PK_CLIENT (task), plan);
+	} else {
+		g_auto(GStrv) package_ids_tmp = NULL;
+		sd_journal_print (LOG_INFO,
+				  "package database changed since the update was "
+				  "prepared, resolving the packages again");
+		package_ids_tmp = pk_offline_update_resolve_prepared (task, package_ids, error);
+		if (package_ids_tmp == NULL) {
+			g_prefix_error (error, "failed to resolve prepared update: ");
+			return FALSE;
+		}
+		g_strfreev (package_ids);
+		package_ids = g_steal_pointer (&package_ids_tmp);
+		if (package_ids[0] == NULL) {
+			sd_journal_print (LOG_INFO, "no prepared packages need updating");
+			results = pk_results_new ();
+			pk_results_set_role (results, PK_ROLE_ENUM_UPDATE_PACKAGES);
+			pk_results_set_exit_code (results, PK_EXIT_ENUM_SUCCESS);
+			pk_offline_update_write_results (results);
+			return TRUE;
+		}
+	}
+
 	/* TRANSLATORS: we've started doing offline updates */
 	pk_offline_update_set_plymouth_msg (_("Installing updates; this could take a while..."));
 	pk_offline_update_write_dummy_results ();
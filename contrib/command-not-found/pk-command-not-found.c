@@ -30,6 +30,7 @@
 #include <glib/gi18n.h>
 #include <packagekit-glib2/packagekit.h>
 #include <packagekit-glib2/packagekit-private.h>
+#include <packagekit-glib2/pk-command-index-private.h>
 
 #define PK_MAX_PATH_LEN 1023
 
@@ -470,6 +471,26 @@ pk_cnf_cancel_cb (GCancellable *_cancellable)
 	return FALSE;
 }
 
+/**
+ * pk_cnf_find_indexed:
+ *
+ * Find software we could install using the index the daemon writes after
+ * refreshing the metadata, which needs no transaction at all
+ **/
+static gchar **
+pk_cnf_find_indexed (const gchar *cmd)
+{
+	gchar **package_ids;
+	g_autoptr(GError) error = NULL;
+
+	package_ids = pk_command_index_lookup (PK_COMMAND_INDEX_FILENAME, cmd, &error);
+	if (package_ids == NULL) {
+		g_debug ("no command index: %s", error->message);
+		return NULL;
+	}
+	return package_ids;
+}
+
 /**
  * pk_cnf_find_available:
  *
@@ -887,9 +908,12 @@ main (int argc, char *argv[])
 		goto out;
 
 	/* only search using PackageKit if configured to do so */
-	} else if (config->software_source_search &&
-		   pk_cnf_is_backend_fast_enough_to_do_search ()) {
-		package_ids = pk_cnf_find_available (argv[1], config->max_search_time);
+	} else if (config->software_source_search) {
+		/* an index with no match is as good as a search */
+		package_ids = pk_cnf_find_indexed (argv[1]);
+		if (package_ids == NULL &&
+		    pk_cnf_is_backend_fast_enough_to_do_search ())
+			package_ids = pk_cnf_find_available (argv[1], config->max_search_time);
 		if (package_ids == NULL)
 			goto out;
 		len = g_strv_length (package_ids);
@@ -0,0 +1,14 @@
+#!/bin/sh
+# Licensed under the GNU General Public License Version 2
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+
+# trivial dispatcher that echoes each command back, used to measure the
+# round trip latency of PkSpawn
+echo "ready"
+while read line
+do
+	echo "${line}"
+done
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Licensed under the GNU General Public License Version 2
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+
+# switches to the framed protocol and then writes frames that are split
+# across writes, and several frames in a single write
+time=0.2
+
+echo "framed"
+
+# opcode 1 with the fields 'abc' and 'de', split inside a length and a field
+printf '\001\002\000\000'
+sleep ${time}
+printf '\000\003abc\000\000\000\002d'
+sleep ${time}
+printf 'e'
+sleep ${time}
+
+# opcode 3 with one empty field, then opcode 15 with no fields
+printf '\003\001\000\000\000\000\017\000'
@@ -66,6 +66,7 @@ struct _PkClientPrivate
 	gboolean		 interactive;
 	gboolean		 idle;
 	guint			 cache_age;
+	gchar			*prepared_plan;
 };
 
 enum {
@@ -75,6 +76,7 @@ enum {
 	PROP_INTERACTIVE,
 	PROP_IDLE,
 	PROP_CACHE_AGE,
+	PROP_PREPARED_PLAN,
 	PROP_LAST
 };
 
@@ -170,6 +172,9 @@ pk_client_get_property (GObject *object, guint prop_id, GValue *value, GParamSpe
 	case PROP_CACHE_AGE:
 		g_value_set_uint (value, priv->cache_age);
 		break;
+	case PROP_PREPARED_PLAN:
+		g_value_set_string (value, priv->prepared_plan);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -199,6 +204,10 @@ pk_client_set_property (GObject *object, guint prop_id, const GValue *value, GPa
 	case PROP_CACHE_AGE:
 		priv->cache_age = g_value_get_uint (value);
 		break;
+	case PROP_PREPARED_PLAN:
+		g_free (priv->prepared_plan);
+		priv->prepared_plan = g_strdup (g_value_get_string (value));
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -1462,27 +1471,11 @@ pk_client_set_role (PkClientState *state, PkRoleEnum role)
 }
 
 /*
- * pk_client_set_hints_cb:
+ * pk_client_call_role:
  **/
 static void
-pk_client_set_hints_cb (GObject *source_object,
-			GAsyncResult *res,
-			gpointer user_data)
+pk_client_call_role (PkClientState *state)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
-	PkClientState *state = (PkClientState *) user_data;
-	g_autoptr(GError) error = NULL;
-	g_autoptr(GVariant) value = NULL;
-
-	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
-	if (value == NULL) {
-		/* fix up the D-Bus error */
-		pk_client_fixup_dbus_error (error);
-		pk_client_state_finish (state, error);
-		return;
-	}
-
 	/* we'll have results from now on */
 	state->results = pk_results_new ();
 	g_object_set (state->results,
@@ -1951,6 +1944,7 @@ pk_client_create_helper_socket (PkClientState *state)
 {
 	gboolean ret = FALSE;
 	g_autoptr(GError) error = NULL;
+	g_autofree gchar *guid = NULL;
 	g_autofree gchar *socket_filename = NULL;
 	g_autofree gchar *socket_id = NULL;
 	g_auto(GStrv) argv = NULL;
@@ -1977,8 +1971,10 @@ pk_client_create_helper_socket (PkClientState *state)
 	/* create object */
 	state->client_helper = pk_client_helper_new ();
 
-	/* create socket to read from /tmp */
-	socket_id = g_strdup_printf ("gpk-%s.socket", &state->tid[1]);
+	/* create socket to read from /tmp; there is no tid yet as the
+	 * hint is sent when the transaction is created */
+	guid = g_dbus_generate_guid ();
+	socket_id = g_strdup_printf ("gpk-%s.socket", guid);
 	socket_filename = g_build_filename (g_get_tmp_dir (), socket_id, NULL);
 
 	/* start the helper process */
@@ -1993,27 +1989,15 @@ pk_client_create_helper_socket (PkClientState *state)
 }
 
 /*
- * pk_client_get_proxy_cb:
+ * pk_client_get_hints:
  **/
-static void
-pk_client_get_proxy_cb (GObject *object,
-			GAsyncResult *res,
-			gpointer user_data)
+static gchar **
+pk_client_get_hints (PkClientState *state)
 {
 	gchar *hint;
-	PkClientState *state = (PkClientState *) user_data;
-	g_autoptr(GError) error = NULL;
-	g_autoptr(GPtrArray) array = NULL;
-
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL)
-		g_error ("Cannot connect to PackageKit on %s", state->tid);
-
-	/* connect */
-	pk_client_proxy_connect (state);
+	GPtrArray *array;
 
-	/* get hints */
-	array = g_ptr_array_new_with_free_func (g_free);
+	array = g_ptr_array_new ();
 
 	/* locale */
 	if (state->client->priv->locale != NULL) {
@@ -2038,6 +2022,14 @@ pk_client_get_proxy_cb (GObject *object,
 		g_ptr_array_add (array, hint);
 	}
 
+	/* prepared-plan */
+	if (state->client->priv->prepared_plan != NULL &&
+	    state->role == PK_ROLE_ENUM_UPDATE_PACKAGES) {
+		hint = g_strdup_printf ("prepared-plan=%s",
+					state->client->priv->prepared_plan);
+		g_ptr_array_add (array, hint);
+	}
+
 	/* create socket for roles that need interaction */
 	if (state->role == PK_ROLE_ENUM_INSTALL_FILES ||
 	    state->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
@@ -2048,19 +2040,33 @@ pk_client_get_proxy_cb (GObject *object,
 			g_ptr_array_add (array, hint);
 	}
 
-	/* set hints */
 	g_ptr_array_add (array, NULL);
-	g_dbus_proxy_call (state->proxy, "SetHints",
-			   g_variant_new ("(^a&s)",
-					  array->pdata),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-			   state->cancellable,
-			   pk_client_set_hints_cb,
-			   state);
+	return (gchar **) g_ptr_array_free (array, FALSE);
+}
+
+/*
+ * pk_client_get_proxy_cb:
+ **/
+static void
+pk_client_get_proxy_cb (GObject *object,
+			GAsyncResult *res,
+			gpointer user_data)
+{
+	PkClientState *state = (PkClientState *) user_data;
+	g_autoptr(GError) error = NULL;
+
+	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (state->proxy == NULL)
+		g_error ("Cannot connect to PackageKit on %s", state->tid);
+
+	/* connect */
+	pk_client_proxy_connect (state);
 
 	/* track state */
 	g_ptr_array_add (state->client->priv->calls, state);
+
+	/* the hints were set when the transaction was created */
+	pk_client_call_role (state);
 }
 
 /*
@@ -2072,7 +2078,7 @@ pk_client_get_tid_cb (GObject *object, GAsyncResult *res, PkClientState *state)
 	PkControl *control = PK_CONTROL (object);
 	g_autoptr(GError) error = NULL;
 
-	state->tid = pk_control_get_tid_finish (control, res, &error);
+	state->tid = pk_control_get_tid_with_hints_finish (control, res, &error);
 	if (state->tid == NULL) {
 		pk_client_state_finish (state, error);
 		return;
@@ -2092,6 +2098,22 @@ pk_client_get_tid_cb (GObject *object, GAsyncResult *res, PkClientState *state)
 				  state);
 }
 
+/*
+ * pk_client_create_transaction:
+ **/
+static void
+pk_client_create_transaction (PkClientState *state, GCancellable *cancellable)
+{
+	g_auto(GStrv) hints = NULL;
+
+	hints = pk_client_get_hints (state);
+	pk_control_get_tid_with_hints_async (state->client->priv->control,
+					     hints,
+					     cancellable,
+					     (GAsyncReadyCallback) pk_client_get_tid_cb,
+					     state);
+}
+
 /**
  * pk_client_generic_finish:
  * @client: a valid #PkClient instance
@@ -2182,10 +2204,7 @@ pk_client_resolve_async (PkClient *client, PkBitfield filters, gchar **packages,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2249,10 +2268,7 @@ pk_client_search_names_async (PkClient *client, PkBitfield filters, gchar **valu
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2317,10 +2333,7 @@ pk_client_search_details_async (PkClient *client, PkBitfield filters, gchar **va
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2383,10 +2396,7 @@ pk_client_search_groups_async (PkClient *client, PkBitfield filters, gchar **val
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2449,10 +2459,7 @@ pk_client_search_files_async (PkClient *client, PkBitfield filters, gchar **valu
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2515,10 +2522,7 @@ pk_client_get_details_async (PkClient *client, gchar **package_ids, GCancellable
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2585,10 +2589,7 @@ pk_client_get_details_local_async (PkClient *client, gchar **files, GCancellable
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2655,10 +2656,7 @@ pk_client_get_files_local_async (PkClient *client, gchar **files, GCancellable *
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2721,10 +2719,7 @@ pk_client_get_update_detail_async (PkClient *client, gchar **package_ids, GCance
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2788,10 +2783,7 @@ pk_client_download_packages_async (PkClient *client, gchar **package_ids, const
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2852,10 +2844,7 @@ pk_client_get_updates_async (PkClient *client, PkBitfield filters, GCancellable
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2916,10 +2905,7 @@ pk_client_get_old_transactions_async (PkClient *client, guint number, GCancellab
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2985,10 +2971,7 @@ pk_client_depends_on_async (PkClient *client, PkBitfield filters, gchar **packag
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3049,10 +3032,7 @@ pk_client_get_packages_async (PkClient *client, PkBitfield filters, GCancellable
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3118,10 +3098,7 @@ pk_client_required_by_async (PkClient *client, PkBitfield filters, gchar **packa
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3189,10 +3166,7 @@ pk_client_what_provides_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3252,10 +3226,7 @@ pk_client_get_distro_upgrades_async (PkClient *client, GCancellable *cancellable
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3317,10 +3288,7 @@ pk_client_get_files_async (PkClient *client, gchar **package_ids, GCancellable *
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3379,10 +3347,7 @@ pk_client_get_categories_async (PkClient *client, GCancellable *cancellable,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3459,10 +3424,7 @@ pk_client_remove_packages_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3526,10 +3488,7 @@ pk_client_refresh_cache_async (PkClient *client, gboolean force, GCancellable *c
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3593,10 +3552,7 @@ pk_client_install_packages_async (PkClient *client, PkBitfield transaction_flags
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3661,10 +3617,7 @@ pk_client_install_signature_async (PkClient *client, PkSigTypeEnum type, const g
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3733,10 +3686,7 @@ pk_client_update_packages_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /*
@@ -3756,10 +3706,7 @@ pk_client_copy_native_finished_cb (GFile *file, GAsyncResult *res, PkClientState
 	/* no more copies pending? */
 	if (--state->refcount == 0) {
 		/* now get tid and continue on our merry way */
-		pk_control_get_tid_async (state->client->priv->control,
-					  state->cancellable,
-					  (GAsyncReadyCallback) pk_client_get_tid_cb,
-					  state);
+		pk_client_create_transaction (state, state->cancellable);
 	}
 }
 
@@ -3899,10 +3846,7 @@ pk_client_install_files_async (PkClient *client,
 	/* nothing to copy, common case */
 	if (state->refcount == 0) {
 		/* just get tid */
-		pk_control_get_tid_async (client->priv->control,
-					  cancellable,
-					  (GAsyncReadyCallback) pk_client_get_tid_cb,
-					  state);
+		pk_client_create_transaction (state, cancellable);
 		return;
 	}
 
@@ -3968,10 +3912,7 @@ pk_client_accept_eula_async (PkClient *client, const gchar *eula_id, GCancellabl
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -4032,10 +3973,7 @@ pk_client_get_repo_list_async (PkClient *client, PkBitfield filters, GCancellabl
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -4098,10 +4036,7 @@ pk_client_repo_enable_async (PkClient *client, const gchar *repo_id, gboolean en
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -4167,10 +4102,7 @@ pk_client_repo_set_data_async (PkClient *client, const gchar *repo_id, const gch
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -4241,10 +4173,7 @@ pk_client_repo_remove_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -4316,10 +4245,7 @@ pk_client_upgrade_system_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -4384,7 +4310,7 @@ pk_client_repair_system_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control, cancellable, (GAsyncReadyCallback) pk_client_get_tid_cb, state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**********************************************************************/
@@ -4845,6 +4771,44 @@ pk_client_get_cache_age (PkClient *client)
 	return client->priv->cache_age;
 }
 
+/**
+ * pk_client_set_prepared_plan:
+ * @client: a valid #PkClient instance
+ * @prepared_plan: (nullable): the transaction solved when the update was
+ * prepared, or %NULL
+ *
+ * Sets the solved transaction to send with pk_client_update_packages(), so
+ * the backend can commit it without solving it again. Only the offline
+ * update, which runs as root, is allowed to use this.
+ *
+ * Since: 1.1.11
+ **/
+void
+pk_client_set_prepared_plan (PkClient *client, const gchar *prepared_plan)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+	g_free (client->priv->prepared_plan);
+	client->priv->prepared_plan = g_strdup (prepared_plan);
+	g_object_notify (G_OBJECT (client), "prepared-plan");
+}
+
+/**
+ * pk_client_get_prepared_plan:
+ * @client: a valid #PkClient instance
+ *
+ * Gets the solved transaction sent with pk_client_update_packages().
+ *
+ * Return value: the prepared plan, or %NULL if unset
+ *
+ * Since: 1.1.11
+ **/
+const gchar *
+pk_client_get_prepared_plan (PkClient *client)
+{
+	g_return_val_if_fail (PK_IS_CLIENT (client), NULL);
+	return client->priv->prepared_plan;
+}
+
 /*
  * pk_client_class_init:
  **/
@@ -4908,6 +4872,16 @@ pk_client_class_init (PkClientClass *klass)
 				   0, G_MAXUINT, 0,
 				   G_PARAM_READWRITE);
 	g_object_class_install_property (object_class, PROP_CACHE_AGE, pspec);
+
+	/**
+	 * PkClient:prepared-plan:
+	 *
+	 * Since: 1.1.11
+	 */
+	pspec = g_param_spec_string ("prepared-plan", NULL, NULL,
+				     NULL,
+				     G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_PREPARED_PLAN, pspec);
 }
 
 /*
@@ -4943,6 +4917,7 @@ pk_client_finalize (GObject *object)
 	pk_client_cancel_all_dbus_methods (client);
 
 	g_free (client->priv->locale);
+	g_free (client->priv->prepared_plan);
 	g_object_unref (priv->control);
 	g_ptr_array_unref (priv->calls);
 
@@ -426,6 +426,9 @@ gboolean	 pk_client_get_idle			(PkClient		*client);
 void		 pk_client_set_cache_age		(PkClient		*client,
 							 guint			 cache_age);
 guint		 pk_client_get_cache_age		(PkClient		*client);
+void		 pk_client_set_prepared_plan		(PkClient		*client,
+							 const gchar		*prepared_plan);
+const gchar	*pk_client_get_prepared_plan		(PkClient		*client);
 
 G_END_DECLS
 
@@ -0,0 +1,222 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "pk-command-index-private.h"
+
+/*
+ * The index is a flat file so that it can be mapped and searched without
+ * parsing anything:
+ *
+ *   "PKCMDIX1"			magic and format version
+ *   guint32			number of entries, little endian
+ *   entries			pairs of guint32 offsets of the command and
+ *				package ID, sorted by command
+ *   strings			NUL terminated, package IDs are shared
+ */
+#define PK_COMMAND_INDEX_MAGIC		"PKCMDIX1"
+#define PK_COMMAND_INDEX_MAGIC_LEN	8
+#define PK_COMMAND_INDEX_HEADER_LEN	(PK_COMMAND_INDEX_MAGIC_LEN + 4)
+
+/**
+ * pk_command_index_append_u32:
+ **/
+static void
+pk_command_index_append_u32 (GString *str, guint32 value)
+{
+	guint32 value_le = GUINT32_TO_LE (value);
+	g_string_append_len (str, (const gchar *) &value_le, sizeof (value_le));
+}
+
+/**
+ * pk_command_index_save:
+ * @filename: the index file to write
+ * @index: (element-type utf8 GPtrArray): command to array of package IDs
+ * @error: A #GError or %NULL
+ *
+ * Writes a new index, replacing any old one atomically.
+ *
+ * Return value: %TRUE for success, else %FALSE and @error set
+ **/
+gboolean
+pk_command_index_save (const gchar *filename, GHashTable *index, GError **error)
+{
+	GList *l;
+	GPtrArray *package_ids;
+	guint i;
+	guint n_entries = 0;
+	g_autoptr(GHashTable) offsets = NULL;
+	g_autoptr(GList) commands = NULL;
+	g_autoptr(GString) entries = NULL;
+	g_autoptr(GString) strings = NULL;
+	g_autoptr(GString) data = NULL;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (index != NULL, FALSE);
+
+	/* count first, as the string offsets depend on the table size */
+	commands = g_list_sort (g_hash_table_get_keys (index), (GCompareFunc) g_strcmp0);
+	for (l = commands; l != NULL; l = l->next) {
+		package_ids = g_hash_table_lookup (index, l->data);
+		n_entries += package_ids->len;
+	}
+
+	offsets = g_hash_table_new (g_str_hash, g_str_equal);
+	entries = g_string_new (NULL);
+	strings = g_string_new (NULL);
+	for (l = commands; l != NULL; l = l->next) {
+		const gchar *command = l->data;
+		guint32 command_offset;
+
+		package_ids = g_hash_table_lookup (index, command);
+		if (package_ids->len == 0)
+			continue;
+		command_offset = PK_COMMAND_INDEX_HEADER_LEN + n_entries * 8 + strings->len;
+		g_string_append_len (strings, command, strlen (command) + 1);
+		for (i = 0; i < package_ids->len; i++) {
+			const gchar *package_id = g_ptr_array_index (package_ids, i);
+			gpointer offset;
+			if (!g_hash_table_lookup_extended (offsets, package_id, NULL, &offset)) {
+				offset = GUINT_TO_POINTER (PK_COMMAND_INDEX_HEADER_LEN + n_entries * 8 + strings->len);
+				g_string_append_len (strings, package_id, strlen (package_id) + 1);
+				g_hash_table_insert (offsets, (gpointer) package_id, offset);
+			}
+			pk_command_index_append_u32 (entries, command_offset);
+			pk_command_index_append_u32 (entries, GPOINTER_TO_UINT (offset));
+		}
+	}
+
+	data = g_string_new (PK_COMMAND_INDEX_MAGIC);
+	pk_command_index_append_u32 (data, n_entries);
+	g_string_append_len (data, entries->str, entries->len);
+	g_string_append_len (data, strings->str, strings->len);
+	return g_file_set_contents (filename, data->str, data->len, error);
+}
+
+/**
+ * pk_command_index_get_string:
+ *
+ * Gets a string from the mapped file, checking it is NUL terminated
+ * within the file so a truncated index cannot make us read past the end.
+ **/
+static const gchar *
+pk_command_index_get_string (const gchar *data, gsize len, guint32 offset)
+{
+	if (offset >= len)
+		return NULL;
+	if (memchr (data + offset, '\0', len - offset) == NULL)
+		return NULL;
+	return data + offset;
+}
+
+/**
+ * pk_command_index_get_entry:
+ **/
+static const gchar *
+pk_command_index_get_entry (const gchar *data, gsize len, guint idx, guint field)
+{
+	guint32 offset;
+	memcpy (&offset, data + PK_COMMAND_INDEX_HEADER_LEN + idx * 8 + field * 4, 4);
+	return pk_command_index_get_string (data, len, GUINT32_FROM_LE (offset));
+}
+
+/**
+ * pk_command_index_lookup:
+ * @filename: the index file to read
+ * @command: a command name, e.g. "gnome-power-statistics"
+ * @error: A #GError or %NULL
+ *
+ * Finds the packages providing a command using a binary search of the
+ * mapped index, without contacting the daemon.
+ *
+ * Return value: (transfer full): the package IDs, which may be empty, or
+ * %NULL if the index could not be read
+ **/
+gchar **
+pk_command_index_lookup (const gchar *filename, const gchar *command, GError **error)
+{
+	const gchar *data;
+	const gchar *tmp;
+	gsize len;
+	guint32 n_entries;
+	guint hi;
+	guint lo = 0;
+	g_autoptr(GMappedFile) mapped = NULL;
+	g_autoptr(GPtrArray) package_ids = NULL;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+	g_return_val_if_fail (command != NULL, NULL);
+
+	mapped = g_mapped_file_new (filename, FALSE, error);
+	if (mapped == NULL)
+		return NULL;
+	data = g_mapped_file_get_contents (mapped);
+	len = g_mapped_file_get_length (mapped);
+	if (len < PK_COMMAND_INDEX_HEADER_LEN ||
+	    memcmp (data, PK_COMMAND_INDEX_MAGIC, PK_COMMAND_INDEX_MAGIC_LEN) != 0) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "%s is not a command index", filename);
+		return NULL;
+	}
+	memcpy (&n_entries, data + PK_COMMAND_INDEX_MAGIC_LEN, 4);
+	n_entries = GUINT32_FROM_LE (n_entries);
+	if (n_entries > (len - PK_COMMAND_INDEX_HEADER_LEN) / 8) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "%s is truncated", filename);
+		return NULL;
+	}
+
+	/* find the first entry that is not less than the command */
+	hi = n_entries;
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+		tmp = pk_command_index_get_entry (data, len, mid, 0);
+		if (tmp == NULL) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "%s is corrupt", filename);
+			return NULL;
+		}
+		if (g_strcmp0 (tmp, command) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* all the matching entries are adjacent */
+	package_ids = g_ptr_array_new_with_free_func (g_free);
+	for (; lo < n_entries; lo++) {
+		tmp = pk_command_index_get_entry (data, len, lo, 0);
+		if (g_strcmp0 (tmp, command) != 0)
+			break;
+		tmp = pk_command_index_get_entry (data, len, lo, 1);
+		if (tmp == NULL)
+			continue;
+		g_ptr_array_add (package_ids, g_strdup (tmp));
+	}
+	g_ptr_array_add (package_ids, NULL);
+	return (gchar **) g_ptr_array_free (g_steal_pointer (&package_ids), FALSE);
+}
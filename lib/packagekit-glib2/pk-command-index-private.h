@@ -0,0 +1,45 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined (__PACKAGEKIT_H_INSIDE__) && !defined (PK_COMPILATION)
+#error "Only <packagekit.h> can be included directly."
+#endif
+
+#ifndef __PK_COMMAND_INDEX_PRIVATE_H
+#define __PK_COMMAND_INDEX_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* written by the daemon after RefreshCache, read by command-not-found */
+#define PK_COMMAND_INDEX_FILENAME	"/var/lib/PackageKit/command-index"
+
+gboolean		 pk_command_index_save		(const gchar		*filename,
+							 GHashTable		*index,
+							 GError			**error);
+gchar			**pk_command_index_lookup	(const gchar		*filename,
+							 const gchar		*command,
+							 GError			**error);
+
+G_END_DECLS
+
+#endif /* __PK_COMMAND_INDEX_PRIVATE_H */
@@ -67,6 +67,7 @@ struct _PkControlPrivate
 	gchar			**mime_types;
 	gboolean		 connected;
 	gboolean		 locked;
+	gboolean		 create_with_hints_unsupported;
 	PkNetworkEnum		 network_state;
 	gchar			*distro_id;
 	guint			 transaction_list_changed_id;
@@ -112,8 +113,10 @@ G_DEFINE_TYPE (PkControl, pk_control, G_TYPE_OBJECT)
 typedef struct {
 	gboolean		 ret;
 	gchar			*tid;
+	gchar			**hints;
 	gchar			**transaction_list;
 	gchar			*daemon_state;
+	gchar			*metrics;
 	guint			 time;
 	gulong			 cancellable_id;
 	GCancellable		*call;
@@ -612,6 +615,279 @@ pk_control_get_tid_finish (PkControl *control,
 
 /**********************************************************************/
 
+/*
+ * pk_control_get_tid_with_hints_state_finish:
+ **/
+static void
+pk_control_get_tid_with_hints_state_finish (PkControlState *state,
+					    const GError *error)
+{
+	/* get result */
+	if (error == NULL) {
+		g_simple_async_result_set_op_res_gpointer (state->res,
+							   g_strdup (state->tid),
+							   g_free);
+	} else {
+		g_simple_async_result_set_from_error (state->res, error);
+	}
+
+	/* remove from list */
+	g_ptr_array_remove (state->control->priv->calls, state);
+
+	/* complete */
+	g_simple_async_result_complete_in_idle (state->res);
+
+	/* deallocate */
+	if (state->cancellable != NULL) {
+		g_cancellable_disconnect (state->cancellable,
+					  state->cancellable_id);
+		g_object_unref (state->cancellable);
+	}
+	g_free (state->tid);
+	g_strfreev (state->hints);
+	g_object_unref (state->res);
+	g_object_unref (state->control);
+	if (state->proxy != NULL)
+		g_object_unref (state->proxy);
+	g_slice_free (PkControlState, state);
+}
+
+/*
+ * pk_control_get_tid_with_hints_set_hints_cb:
+ **/
+static void
+pk_control_get_tid_with_hints_set_hints_cb (GObject *source_object,
+					    GAsyncResult *res,
+					    gpointer user_data)
+{
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	PkControlState *state = (PkControlState *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	/* get the result */
+	value = g_dbus_connection_call_finish (connection, res, &error);
+	if (value == NULL) {
+		/* fix up the D-Bus error */
+		pk_control_fixup_dbus_error (error);
+		pk_control_get_tid_with_hints_state_finish (state, error);
+		return;
+	}
+
+	/* we're done */
+	pk_control_get_tid_with_hints_state_finish (state, NULL);
+}
+
+static void pk_control_get_tid_with_hints_internal (PkControlState *state);
+
+/*
+ * pk_control_get_tid_with_hints_cb:
+ **/
+static void
+pk_control_get_tid_with_hints_cb (GObject *source_object,
+				  GAsyncResult *res,
+				  gpointer user_data)
+{
+	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	PkControlState *state = (PkControlState *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	/* get the result */
+	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	if (value == NULL) {
+		/* an older daemon, so use the two step version from now on */
+		if (!state->control->priv->create_with_hints_unsupported &&
+		    g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD)) {
+			g_debug ("no CreateTransactionWithHints, falling back");
+			state->control->priv->create_with_hints_unsupported = TRUE;
+			pk_control_get_tid_with_hints_internal (state);
+			return;
+		}
+
+		/* fix up the D-Bus error */
+		pk_control_fixup_dbus_error (error);
+		pk_control_get_tid_with_hints_state_finish (state, error);
+		return;
+	}
+
+	/* save results */
+	g_variant_get (value, "(o)", &state->tid);
+
+	/* the daemon already applied the hints */
+	if (!state->control->priv->create_with_hints_unsupported) {
+		pk_control_get_tid_with_hints_state_finish (state, NULL);
+		return;
+	}
+
+	/* set them on the new transaction ourselves */
+	g_dbus_connection_call (g_dbus_proxy_get_connection (proxy),
+				PK_DBUS_SERVICE,
+				state->tid,
+				PK_DBUS_INTERFACE_TRANSACTION,
+				"SetHints",
+				g_variant_new ("(^as)", state->hints),
+				NULL,
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CONTROL_DBUS_METHOD_TIMEOUT,
+				state->cancellable,
+				pk_control_get_tid_with_hints_set_hints_cb,
+				state);
+}
+
+/*
+ * pk_control_get_tid_with_hints_internal:
+ **/
+static void
+pk_control_get_tid_with_hints_internal (PkControlState *state)
+{
+	if (state->control->priv->create_with_hints_unsupported) {
+		g_dbus_proxy_call (state->control->priv->proxy,
+				   "CreateTransaction",
+				   NULL,
+				   G_DBUS_CALL_FLAGS_NONE,
+				   PK_CONTROL_DBUS_METHOD_TIMEOUT,
+				   state->cancellable,
+				   pk_control_get_tid_with_hints_cb,
+				   state);
+		return;
+	}
+	g_dbus_proxy_call (state->control->priv->proxy,
+			   "CreateTransactionWithHints",
+			   g_variant_new ("(^as)", state->hints),
+			   G_DBUS_CALL_FLAGS_NONE,
+			   PK_CONTROL_DBUS_METHOD_TIMEOUT,
+			   state->cancellable,
+			   pk_control_get_tid_with_hints_cb,
+			   state);
+}
+
+/*
+ * pk_control_get_tid_with_hints_proxy_cb:
+ **/
+static void
+pk_control_get_tid_with_hints_proxy_cb (GObject *source_object,
+					GAsyncResult *res,
+					gpointer user_data)
+{
+	g_autoptr(GError) error = NULL;
+	PkControlState *state = (PkControlState *) user_data;
+
+	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (state->proxy == NULL) {
+		pk_control_get_tid_with_hints_state_finish (state, error);
+		return;
+	}
+	pk_control_proxy_connect (state);
+	pk_control_get_tid_with_hints_internal (state);
+}
+
+/**
+ * pk_control_get_tid_with_hints_async:
+ * @control: a valid #PkControl instance
+ * @hints: (array zero-terminated=1): hints such as "locale=en_GB.utf8"
+ * @cancellable: a #GCancellable or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Gets a transacton ID from the daemon, with @hints already set on
+ * the new transaction. This is one round trip to the daemon where
+ * pk_control_get_tid_async() and a SetHints() call are two.
+ *
+ * Since: 1.1.11
+ **/
+void
+pk_control_get_tid_with_hints_async (PkControl *control,
+				     gchar **hints,
+				     GCancellable *cancellable,
+				     GAsyncReadyCallback callback,
+				     gpointer user_data)
+{
+	PkControlState *state;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GSimpleAsyncResult) res = NULL;
+
+	g_return_if_fail (PK_IS_CONTROL (control));
+	g_return_if_fail (hints != NULL);
+	g_return_if_fail (callback != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	res = g_simple_async_result_new (G_OBJECT (control),
+					 callback,
+					 user_data,
+					 pk_control_get_tid_with_hints_async);
+
+	/* save state */
+	state = g_slice_new0 (PkControlState);
+	state->res = g_object_ref (res);
+	state->control = g_object_ref (control);
+	state->hints = g_strdupv (hints);
+	if (cancellable != NULL)
+		state->cancellable = g_object_ref (cancellable);
+
+	/* check not already cancelled */
+	if (cancellable != NULL &&
+	    g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+		pk_control_get_tid_with_hints_state_finish (state, error);
+		return;
+	}
+
+	/* skip straight to the D-Bus method if already connection */
+	if (control->priv->proxy != NULL) {
+		pk_control_get_tid_with_hints_internal (state);
+	} else {
+		g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+					  G_DBUS_PROXY_FLAGS_NONE,
+					  NULL,
+					  PK_DBUS_SERVICE,
+					  PK_DBUS_PATH,
+					  PK_DBUS_INTERFACE,
+					  control->priv->cancellable,
+					  pk_control_get_tid_with_hints_proxy_cb,
+					  state);
+	}
+
+	/* track state */
+	g_ptr_array_add (control->priv->calls, state);
+}
+
+/**
+ * pk_control_get_tid_with_hints_finish:
+ * @control: a valid #PkControl instance
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: the ID, or %NULL if unset, free with g_free()
+ *
+ * Since: 1.1.11
+ **/
+gchar *
+pk_control_get_tid_with_hints_finish (PkControl *control,
+				      GAsyncResult *res,
+				      GError **error)
+{
+	GSimpleAsyncResult *simple;
+	gpointer source_tag;
+
+	g_return_val_if_fail (PK_IS_CONTROL (control), NULL);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	simple = G_SIMPLE_ASYNC_RESULT (res);
+	source_tag = g_simple_async_result_get_source_tag (simple);
+
+	g_return_val_if_fail (source_tag == pk_control_get_tid_with_hints_async, NULL);
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+
+	return g_strdup (g_simple_async_result_get_op_res_gpointer (simple));
+}
+
+/**********************************************************************/
+
 
 /*
  * pk_control_suggest_daemon_quit_state_finish:
@@ -1008,6 +1284,206 @@ pk_control_get_daemon_state_finish (PkControl *control,
 
 /**********************************************************************/
 
+/*
+ * pk_control_get_metrics_state_finish:
+ **/
+static void
+pk_control_get_metrics_state_finish (PkControlState *state, const GError *error)
+{
+	/* get result */
+	if (state->metrics != NULL) {
+		g_simple_async_result_set_op_res_gpointer (state->res,
+							   g_strdup (state->metrics), g_free);
+	} else {
+		g_simple_async_result_set_from_error (state->res, error);
+	}
+
+	/* remove from list */
+	g_ptr_array_remove (state->control->priv->calls, state);
+
+	/* complete */
+	g_simple_async_result_complete_in_idle (state->res);
+
+	/* deallocate */
+	if (state->cancellable != NULL) {
+		g_cancellable_disconnect (state->cancellable,
+					  state->cancellable_id);
+		g_object_unref (state->cancellable);
+	}
+	g_free (state->metrics);
+	g_object_unref (state->res);
+	g_object_unref (state->control);
+	if (state->proxy != NULL)
+		g_object_unref (state->proxy);
+	g_slice_free (PkControlState, state);
+}
+
+/*
+ * pk_control_get_metrics_cb:
+ **/
+static void
+pk_control_get_metrics_cb (GObject *source_object,
+			   GAsyncResult *res,
+			   gpointer user_data)
+{
+	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	PkControlState *state = (PkControlState *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	/* get the result */
+	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	if (value == NULL) {
+		/* fix up the D-Bus error */
+		pk_control_fixup_dbus_error (error);
+		pk_control_get_metrics_state_finish (state, error);
+		return;
+	}
+
+	/* save results */
+	g_variant_get (value, "(s)", &state->metrics);
+
+	/* we're done */
+	pk_control_get_metrics_state_finish (state, NULL);
+}
+
+/*
+ * pk_control_get_metrics_internal:
+ **/
+static void
+pk_control_get_metrics_internal (PkControlState *state)
+{
+	g_dbus_proxy_call (state->control->priv->proxy,
+			   "GetMetrics",
+			   NULL,
+			   G_DBUS_CALL_FLAGS_NONE,
+			   PK_CONTROL_DBUS_METHOD_TIMEOUT,
+			   state->cancellable,
+			   pk_control_get_metrics_cb,
+			   state);
+}
+
+/*
+ * pk_control_get_metrics_proxy_cb:
+ **/
+static void
+pk_control_get_metrics_proxy_cb (GObject *source_object,
+				 GAsyncResult *res,
+				 gpointer user_data)
+{
+	g_autoptr(GError) error = NULL;
+	PkControlState *state = (PkControlState *) user_data;
+
+	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (state->proxy == NULL) {
+		pk_control_get_metrics_state_finish (state, error);
+		return;
+	}
+	pk_control_proxy_connect (state);
+	pk_control_get_metrics_internal (state);
+}
+
+/**
+ * pk_control_get_metrics_async:
+ * @control: a valid #PkControl instance
+ * @cancellable: a #GCancellable or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Gets the per-role latency and throughput metrics from the daemon, in the
+ * Prometheus text format.
+ *
+ * Since: 1.1.11
+ **/
+void
+pk_control_get_metrics_async (PkControl *control,
+			      GCancellable *cancellable,
+			      GAsyncReadyCallback callback,
+			      gpointer user_data)
+{
+	PkControlState *state;
+	g_autoptr(GSimpleAsyncResult) res = NULL;
+	g_autoptr(GError) error = NULL;
+
+	g_return_if_fail (PK_IS_CONTROL (control));
+	g_return_if_fail (callback != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	res = g_simple_async_result_new (G_OBJECT (control),
+					 callback,
+					 user_data,
+					 pk_control_get_metrics_async);
+
+	/* save state */
+	state = g_slice_new0 (PkControlState);
+	state->res = g_object_ref (res);
+	state->control = g_object_ref (control);
+	if (cancellable != NULL)
+		state->cancellable = g_object_ref (cancellable);
+
+	/* check not already cancelled */
+	if (cancellable != NULL &&
+	    g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+		pk_control_get_metrics_state_finish (state, error);
+		return;
+	}
+
+	/* skip straight to the D-Bus method if already connection */
+	if (control->priv->proxy != NULL) {
+		pk_control_get_metrics_internal (state);
+	} else {
+		g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+					  G_DBUS_PROXY_FLAGS_NONE,
+					  NULL,
+					  PK_DBUS_SERVICE,
+					  PK_DBUS_PATH,
+					  PK_DBUS_INTERFACE,
+					  control->priv->cancellable,
+					  pk_control_get_metrics_proxy_cb,
+					  state);
+	}
+
+	/* track state */
+	g_ptr_array_add (control->priv->calls, state);
+}
+
+/**
+ * pk_control_get_metrics_finish:
+ * @control: a valid #PkControl instance
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: the metrics text, or %NULL if unset, free with g_free()
+ *
+ * Since: 1.1.11
+ **/
+gchar *
+pk_control_get_metrics_finish (PkControl *control,
+			       GAsyncResult *res,
+			       GError **error)
+{
+	GSimpleAsyncResult *simple;
+	gpointer source_tag;
+
+	g_return_val_if_fail (PK_IS_CONTROL (control), NULL);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	simple = G_SIMPLE_ASYNC_RESULT (res);
+	source_tag = g_simple_async_result_get_source_tag (simple);
+
+	g_return_val_if_fail (source_tag == pk_control_get_metrics_async, NULL);
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+
+	return g_strdup (g_simple_async_result_get_op_res_gpointer (simple));
+}
+
+/**********************************************************************/
+
 
 /*
  * pk_control_set_proxy_state_finish:
@@ -2396,6 +2872,9 @@ pk_control_name_vanished_cb (GDBusConnection *connection,
 	 * GDBus.Error:org.freedesktop.DBus.Error.ServiceUnknown if we try to
 	 * use this after the server has restarted */
 	pk_control_proxy_destroy (control);
+
+	/* the next daemon may be a different version */
+	control->priv->create_with_hints_unsupported = FALSE;
 }
 
 /*
@@ -103,6 +103,14 @@ void		 pk_control_get_tid_async		(PkControl		*control,
 gchar		*pk_control_get_tid_finish		(PkControl		*control,
 							 GAsyncResult		*res,
 							 GError			**error);
+void		 pk_control_get_tid_with_hints_async	(PkControl		*control,
+							 gchar			**hints,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+gchar		*pk_control_get_tid_with_hints_finish	(PkControl		*control,
+							 GAsyncResult		*res,
+							 GError			**error);
 void		 pk_control_suggest_daemon_quit_async	(PkControl		*control,
 							 GCancellable		*cancellable,
 							 GAsyncReadyCallback	 callback,
@@ -117,6 +125,13 @@ void		 pk_control_get_daemon_state_async	(PkControl		*control,
 gchar		*pk_control_get_daemon_state_finish	(PkControl		*control,
 							 GAsyncResult		*res,
 							 GError			**error);
+void		 pk_control_get_metrics_async		(PkControl		*control,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+gchar		*pk_control_get_metrics_finish		(PkControl		*control,
+							 GAsyncResult		*res,
+							 GError			**error);
 void		 pk_control_set_proxy_async		(PkControl		*control,
 							 const gchar		*proxy_http,
 							 const gchar		*proxy_ftp,
@@ -30,6 +30,7 @@
 
 #include "pk-offline.h"
 #include "pk-offline-private.h"
+#include "pk-package-id.h"
 
 /*
  * pk_offline_auth_set_action:
@@ -307,7 +308,183 @@ pk_offline_auth_trigger_upgrade (PkOfflineAction action, GError **error)
 gboolean
 pk_offline_auth_set_prepared_ids (gchar **package_ids, GError **error)
 {
+	return pk_offline_auth_set_prepared_plan (package_ids, NULL, NULL, NULL, error);
+}
+
+/*
+ * pk_offline_is_plan_info:
+ **/
+static gboolean
+pk_offline_is_plan_info (PkInfoEnum info)
+{
+	switch (info) {
+	case PK_INFO_ENUM_INSTALLING:
+	case PK_INFO_ENUM_UPDATING:
+	case PK_INFO_ENUM_DOWNGRADING:
+	case PK_INFO_ENUM_REINSTALLING:
+	case PK_INFO_ENUM_REMOVING:
+	case PK_INFO_ENUM_OBSOLETING:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * pk_offline_is_plan_download:
+ **/
+static gboolean
+pk_offline_is_plan_download (PkInfoEnum info)
+{
+	return info != PK_INFO_ENUM_REMOVING && info != PK_INFO_ENUM_OBSOLETING;
+}
+
+/*
+ * pk_offline_plan_to_string:
+ * @plan: (element-type PkPackage): the packages of a solved transaction
+ *
+ * Converts the packages to the value of the "prepared-plan" hint, e.g.
+ * "updating:hal;0.1.2;i386;fedora,removing:dave;0.1.1;i386;installed".
+ * Packages that are not part of the transaction, for instance the ones
+ * that were only downloading, are ignored.
+ *
+ * Return value: the plan, or %NULL if @plan has no packages to change
+ *
+ * Since: 1.1.11
+ **/
+gchar *
+pk_offline_plan_to_string (GPtrArray *plan)
+{
+	PkPackage *package;
+	guint i;
+	g_autoptr(GHashTable) seen = NULL;
+	g_autoptr(GString) string = NULL;
+
+	seen = g_hash_table_new (g_str_hash, g_str_equal);
+	string = g_string_new ("");
+	for (i = 0; i < plan->len; i++) {
+		package = g_ptr_array_index (plan, i);
+		if (!pk_offline_is_plan_info (pk_package_get_info (package)))
+			continue;
+		if (!g_hash_table_add (seen, (gpointer) pk_package_get_id (package)))
+			continue;
+		if (string->len > 0)
+			g_string_append_c (string, ',');
+		g_string_append_printf (string, "%s:%s",
+					pk_info_enum_to_string (pk_package_get_info (package)),
+					pk_package_get_id (package));
+	}
+	if (string->len == 0)
+		return NULL;
+	return g_string_free (g_steal_pointer (&string), FALSE);
+}
+
+/*
+ * pk_offline_plan_from_string:
+ * @plan: the value of the "prepared-plan" hint
+ * @error: A #GError or %NULL
+ *
+ * Parses a plan written by pk_offline_plan_to_string().
+ *
+ * Return value: (element-type PkPackage): the packages, or %NULL if
+ * @plan is invalid
+ *
+ * Since: 1.1.11
+ **/
+GPtrArray *
+pk_offline_plan_from_string (const gchar *plan, GError **error)
+{
+	PkInfoEnum info;
+	guint i;
+	g_autoptr(GPtrArray) array = NULL;
+	g_auto(GStrv) items = NULL;
+
+	g_return_val_if_fail (plan != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	items = g_strsplit (plan, ",", -1);
+	for (i = 0; items[i] != NULL; i++) {
+		PkPackage *package;
+		g_auto(GStrv) split = g_strsplit (items[i], ":", 2);
+
+		if (g_strv_length (split) == 2)
+			info = pk_info_enum_from_string (split[0]);
+		else
+			info = PK_INFO_ENUM_UNKNOWN;
+		if (!pk_offline_is_plan_info (info) ||
+		    !pk_package_id_check (split[1])) {
+			g_set_error (error,
+				     PK_OFFLINE_ERROR,
+				     PK_OFFLINE_ERROR_INVALID_VALUE,
+				     "Invalid plan item %s", items[i]);
+			return NULL;
+		}
+		package = pk_package_new ();
+		if (!pk_package_set_id (package, split[1], error)) {
+			g_object_unref (package);
+			return NULL;
+		}
+		pk_package_set_info (package, info);
+		g_ptr_array_add (array, package);
+	}
+	if (array->len == 0) {
+		g_set_error_literal (error,
+				     PK_OFFLINE_ERROR,
+				     PK_OFFLINE_ERROR_INVALID_VALUE,
+				     "The plan has no packages");
+		return NULL;
+	}
+	return g_steal_pointer (&array);
+}
+
+/*
+ * pk_offline_get_file_checksum:
+ **/
+static gchar *
+pk_offline_get_file_checksum (const gchar *filename, GError **error)
+{
+	g_autoptr(GMappedFile) file = NULL;
+
+	file = g_mapped_file_new (filename, FALSE, error);
+	if (file == NULL)
+		return NULL;
+	return g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+					    (const guchar *) g_mapped_file_get_contents (file),
+					    g_mapped_file_get_length (file));
+}
+
+/*
+ * pk_offline_auth_set_prepared_plan:
+ * @package_ids: Array of package-ids
+ * @plan: (element-type PkPackage) (nullable): the solved transaction
+ * @files: (element-type PkFiles) (nullable): the downloaded files of @plan
+ * @fingerprint: The package database fingerprint the update was solved
+ *               against, or %NULL
+ * @error: A #GError or %NULL
+ *
+ * Saves the package-ids to a prepared transaction file, along with the
+ * solved transaction and the state of the package database it was solved
+ * against. The plan is only saved if every package it installs has a
+ * downloaded file, and a checksum of each file is saved with it.
+ *
+ * Return value: %TRUE for success, else %FALSE and @error set
+ *
+ * Since: 1.1.11
+ **/
+gboolean
+pk_offline_auth_set_prepared_plan (gchar **package_ids,
+				   GPtrArray *plan,
+				   GPtrArray *files,
+				   const gchar *fingerprint,
+				   GError **error)
+{
+	PkPackage *package;
+	guint i;
+	guint j;
 	g_autofree gchar *data = NULL;
+	g_autofree gchar *plan_str = NULL;
+	g_autoptr(GHashTable) hash = NULL;
 	g_autoptr(GKeyFile) keyfile = NULL;
 
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
@@ -315,9 +492,242 @@ pk_offline_auth_set_prepared_ids (gchar **package_ids, GError **error)
 	data = g_strjoinv (",", package_ids);
 	keyfile = g_key_file_new ();
 	g_key_file_set_string (keyfile, "update", "prepared_ids", data);
+	if (fingerprint != NULL)
+		g_key_file_set_string (keyfile, "update", "fingerprint", fingerprint);
+	if (plan != NULL)
+		plan_str = pk_offline_plan_to_string (plan);
+	if (plan_str == NULL || files == NULL)
+		goto out;
+
+	/* find the downloaded files of each package */
+	hash = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < files->len; i++) {
+		PkFiles *item = g_ptr_array_index (files, i);
+		if (pk_files_get_package_id (item) == NULL)
+			continue;
+		g_hash_table_insert (hash,
+				     (gpointer) pk_files_get_package_id (item),
+				     pk_files_get_files (item));
+	}
+	for (i = 0; i < plan->len; i++) {
+		gchar **filenames;
+		package = g_ptr_array_index (plan, i);
+		if (!pk_offline_is_plan_info (pk_package_get_info (package)) ||
+		    !pk_offline_is_plan_download (pk_package_get_info (package)))
+			continue;
+		filenames = g_hash_table_lookup (hash, pk_package_get_id (package));
+		if (filenames == NULL || filenames[0] == NULL) {
+			g_debug ("no download for %s, not saving the plan",
+				 pk_package_get_id (package));
+			g_key_file_remove_group (keyfile, "checksums", NULL);
+			goto out;
+		}
+		for (j = 0; filenames[j] != NULL; j++) {
+			g_autofree gchar *checksum = NULL;
+			g_autoptr(GError) error_local = NULL;
+			checksum = pk_offline_get_file_checksum (filenames[j], &error_local);
+			if (checksum == NULL) {
+				g_debug ("not saving the plan: %s", error_local->message);
+				g_key_file_remove_group (keyfile, "checksums", NULL);
+				goto out;
+			}
+			g_key_file_set_string (keyfile, "checksums", filenames[j], checksum);
+		}
+	}
+	g_key_file_set_string (keyfile, "update", "plan", plan_str);
+out:
 	return g_key_file_save_to_file (keyfile, PK_OFFLINE_PREPARED_FILENAME, error);
 }
 
+/*
+ * pk_offline_get_prepared_fingerprint:
+ * @error: A #GError or %NULL
+ *
+ * Gets the package database fingerprint the prepared update was solved
+ * against.
+ *
+ * Return value: the fingerprint, or %NULL if the prepared update does not
+ * have one
+ *
+ * Since: 1.1.11
+ **/
+gchar *
+pk_offline_get_prepared_fingerprint (GError **error)
+{
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GKeyFile) keyfile = NULL;
+
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	keyfile = g_key_file_new ();
+	if (!g_key_file_load_from_file (keyfile, PK_OFFLINE_PREPARED_FILENAME,
+					G_KEY_FILE_NONE, &error_local)) {
+		g_set_error (error,
+			     PK_OFFLINE_ERROR,
+			     PK_OFFLINE_ERROR_FAILED,
+			     "Failed to read %s: %s",
+			     PK_OFFLINE_PREPARED_FILENAME,
+			     error_local->message);
+		return NULL;
+	}
+	if (!g_key_file_has_key (keyfile, "update", "fingerprint", NULL)) {
+		g_set_error (error,
+			     PK_OFFLINE_ERROR,
+			     PK_OFFLINE_ERROR_NO_DATA,
+			     "The prepared update has no fingerprint");
+		return NULL;
+	}
+	return g_key_file_get_string (keyfile, "update", "fingerprint", error);
+}
+
+/*
+ * pk_offline_get_prepared_plan:
+ * @error: A #GError or %NULL
+ *
+ * Gets the solved transaction of the prepared update, in the format used
+ * by the "prepared-plan" hint. The downloaded files are checked against
+ * the checksums saved with the plan first, so the plan is only returned
+ * if it can be committed as it is.
+ *
+ * Return value: the plan, or %NULL if the prepared update does not have
+ * one or a downloaded file has changed
+ *
+ * Since: 1.1.11
+ **/
+gchar *
+pk_offline_get_prepared_plan (GError **error)
+{
+	guint i;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GKeyFile) keyfile = NULL;
+	g_auto(GStrv) filenames = NULL;
+
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	keyfile = g_key_file_new ();
+	if (!g_key_file_load_from_file (keyfile, PK_OFFLINE_PREPARED_FILENAME,
+					G_KEY_FILE_NONE, &error_local)) {
+		g_set_error (error,
+			     PK_OFFLINE_ERROR,
+			     PK_OFFLINE_ERROR_FAILED,
+			     "Failed to read %s: %s",
+			     PK_OFFLINE_PREPARED_FILENAME,
+			     error_local->message);
+		return NULL;
+	}
+	if (!g_key_file_has_key (keyfile, "update", "plan", NULL)) {
+		g_set_error (error,
+			     PK_OFFLINE_ERROR,
+			     PK_OFFLINE_ERROR_NO_DATA,
+			     "The prepared update has no plan");
+		return NULL;
+	}
+
+	/* the downloads must not have changed since the plan was saved */
+	filenames = g_key_file_get_keys (keyfile, "checksums", NULL, NULL);
+	for (i = 0; filenames != NULL && filenames[i] != NULL; i++) {
+		g_autofree gchar *checksum = NULL;
+		g_autofree gchar *checksum_prepared = NULL;
+		checksum_prepared = g_key_file_get_string (keyfile, "checksums",
+							   filenames[i], NULL);
+		checksum = pk_offline_get_file_checksum (filenames[i], &error_local);
+		if (checksum == NULL) {
+			g_set_error (error,
+				     PK_OFFLINE_ERROR,
+				     PK_OFFLINE_ERROR_FAILED,
+				     "Failed to check %s: %s",
+				     filenames[i], error_local->message);
+			return NULL;
+		}
+		if (g_strcmp0 (checksum, checksum_prepared) != 0) {
+			g_set_error (error,
+				     PK_OFFLINE_ERROR,
+				     PK_OFFLINE_ERROR_FAILED,
+				     "%s has changed since the update was prepared",
+				     filenames[i]);
+			return NULL;
+		}
+	}
+	return g_key_file_get_string (keyfile, "update", "plan", error);
+}
+
+/*
+ * pk_offline_checksum_stat:
+ **/
+static void
+pk_offline_checksum_stat (GChecksum *checksum, const gchar *filename)
+{
+	GStatBuf buf;
+	g_autofree gchar *tmp = NULL;
+
+	if (g_stat (filename, &buf) != 0)
+		return;
+	tmp = g_strdup_printf ("%s:%" G_GINT64_FORMAT ".%09li:%" G_GUINT64_FORMAT ":%" G_GINT64_FORMAT ";",
+			       filename,
+			       (gint64) buf.st_mtime,
+			       (glong) buf.st_mtim.tv_nsec,
+			       (guint64) buf.st_ino,
+			       (gint64) buf.st_size);
+	g_checksum_update (checksum, (const guchar *) tmp, -1);
+}
+
+/*
+ * pk_offline_sort_filename_cb:
+ **/
+static gint
+pk_offline_sort_filename_cb (gconstpointer a, gconstpointer b)
+{
+	return g_strcmp0 (*((const gchar **) a), *((const gchar **) b));
+}
+
+/*
+ * pk_offline_get_package_db_fingerprint:
+ *
+ * Gets a fingerprint of the installed package database, which changes
+ * whenever a package is installed or removed by any tool. Only the
+ * modification time, inode and size of the database files are used, so
+ * this is cheap enough to call when the system is starting.
+ *
+ * Return value: the fingerprint
+ *
+ * Since: 1.1.11
+ **/
+gchar *
+pk_offline_get_package_db_fingerprint (void)
+{
+	const gchar *tmp;
+	guint i;
+	const gchar *filenames[] = {
+		PK_OFFLINE_DESTDIR "/var/lib/rpm/Packages",
+		PK_OFFLINE_DESTDIR "/var/lib/rpm/rpmdb.sqlite",
+		PK_OFFLINE_DESTDIR "/usr/lib/sysimage/rpm/rpmdb.sqlite",
+		PK_OFFLINE_DESTDIR "/var/lib/dpkg/status",
+		PK_OFFLINE_DESTDIR "/var/lib/pacman/local",
+		NULL };
+	g_autoptr(GChecksum) checksum = NULL;
+	g_autoptr(GDir) dir = NULL;
+	g_autoptr(GPtrArray) categories = NULL;
+
+	checksum = g_checksum_new (G_CHECKSUM_SHA256);
+	for (i = 0; filenames[i] != NULL; i++)
+		pk_offline_checksum_stat (checksum, filenames[i]);
+
+	/* portage has a directory for each category, and only the directory
+	 * of the category changes when a package in it is updated */
+	dir = g_dir_open (PK_OFFLINE_DESTDIR "/var/db/pkg", 0, NULL);
+	if (dir == NULL)
+		return g_strdup (g_checksum_get_string (checksum));
+	categories = g_ptr_array_new_with_free_func (g_free);
+	while ((tmp = g_dir_read_name (dir)) != NULL) {
+		g_ptr_array_add (categories,
+				 g_build_filename (PK_OFFLINE_DESTDIR "/var/db/pkg", tmp, NULL));
+	}
+	g_ptr_array_sort (categories, pk_offline_sort_filename_cb);
+	for (i = 0; i < categories->len; i++)
+		pk_offline_checksum_stat (checksum, g_ptr_array_index (categories, i));
+	return g_strdup (g_checksum_get_string (checksum));
+}
+
 /*
  * pk_offline_auth_set_prepared_upgrade:
  * @name: Distro name to upgrade to
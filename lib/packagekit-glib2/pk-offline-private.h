@@ -70,6 +70,20 @@ gboolean		 pk_offline_auth_trigger_upgrade
 							 GError			**error);
 gboolean		 pk_offline_auth_set_prepared_ids(gchar			**package_ids,
 							 GError			**error);
+gboolean		 pk_offline_auth_set_prepared_plan
+							(gchar			**package_ids,
+							 GPtrArray		 *plan,
+							 GPtrArray		 *files,
+							 const gchar		 *fingerprint,
+							 GError			**error);
+gchar			*pk_offline_get_prepared_fingerprint
+							(GError			**error);
+gchar			*pk_offline_get_prepared_plan	(GError			**error);
+gchar			*pk_offline_plan_to_string	(GPtrArray		*plan);
+GPtrArray		*pk_offline_plan_from_string	(const gchar		*plan,
+							 GError			**error);
+gchar			*pk_offline_get_package_db_fingerprint
+							(void);
 gboolean		 pk_offline_auth_set_prepared_upgrade
 							(const gchar		 *name,
 							 const gchar		 *release_ver,
@@ -723,6 +723,206 @@ pk_test_client_func (void)
 #endif
 }
 
+/**
+ * pk_test_transaction_commit:
+ *
+ * Runs a quick role on the transaction so the daemon does not keep it
+ * around until the commit timeout.
+ **/
+static void
+pk_test_transaction_commit (const gchar *tid)
+{
+	GDBusConnection *connection;
+	GError *error = NULL;
+	GVariant *value;
+
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	g_assert_no_error (error);
+	value = g_dbus_connection_call_sync (connection,
+					     PK_DBUS_SERVICE,
+					     tid,
+					     PK_DBUS_INTERFACE_TRANSACTION,
+					     "GetRepoList",
+					     g_variant_new ("(t)", (guint64) 0),
+					     NULL,
+					     G_DBUS_CALL_FLAGS_NONE,
+					     -1, NULL, &error);
+	g_assert_no_error (error);
+	g_variant_unref (value);
+	g_object_unref (connection);
+}
+
+static void
+pk_test_client_latency_get_tid_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	gchar **tid = (gchar **) user_data;
+	GError *error = NULL;
+
+	*tid = pk_control_get_tid_finish (PK_CONTROL (object), res, &error);
+	g_assert_no_error (error);
+	g_assert (*tid != NULL);
+	_g_test_loop_quit ();
+}
+
+static void
+pk_test_client_latency_get_tid_with_hints_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	gchar **tid = (gchar **) user_data;
+	GError *error = NULL;
+
+	*tid = pk_control_get_tid_with_hints_finish (PK_CONTROL (object), res, &error);
+	g_assert_no_error (error);
+	g_assert (*tid != NULL);
+	_g_test_loop_quit ();
+}
+
+static void
+pk_test_client_latency_get_tid_with_invalid_hints_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	gchar *tid;
+	GError *error = NULL;
+
+	tid = pk_control_get_tid_with_hints_finish (PK_CONTROL (object), res, &error);
+	g_assert (error != NULL);
+	g_assert (tid == NULL);
+	g_error_free (error);
+	_g_test_loop_quit ();
+}
+
+static void
+pk_test_client_latency_func (void)
+{
+	GDBusProxy *proxy;
+	GError *error = NULL;
+	GPtrArray *tids;
+	GVariant *value;
+	PkControl *control;
+	gchar *tid = NULL;
+	gdouble elapsed;
+	gdouble elapsed_legacy;
+	guint i;
+	const guint LOOP_SIZE = 20;
+	const gchar *hints[] = { "locale=en_GB.utf8",
+				 "background=false",
+				 "interactive=false",
+				 NULL };
+	const gchar *hints_invalid[] = { "background=maybe", NULL };
+
+	control = pk_control_new ();
+	g_assert (control != NULL);
+	tids = g_ptr_array_new_with_free_func (g_free);
+
+	/* warm up the control proxy */
+	pk_control_get_tid_async (control, NULL,
+				  pk_test_client_latency_get_tid_cb, &tid);
+	_g_test_loop_run_with_timeout (5000);
+	g_ptr_array_add (tids, tid);
+
+	/* the hints are checked when the transaction is created */
+	pk_control_get_tid_with_hints_async (control, (gchar **) hints_invalid, NULL,
+					     pk_test_client_latency_get_tid_with_invalid_hints_cb,
+					     NULL);
+	_g_test_loop_run_with_timeout (5000);
+
+	/* how PkClient used to start a transaction */
+	g_test_timer_start ();
+	for (i = 0; i < LOOP_SIZE; i++) {
+		pk_control_get_tid_async (control, NULL,
+					  pk_test_client_latency_get_tid_cb, &tid);
+		_g_test_loop_run_with_timeout (5000);
+		proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
+						       G_DBUS_PROXY_FLAGS_NONE,
+						       NULL,
+						       PK_DBUS_SERVICE,
+						       tid,
+						       PK_DBUS_INTERFACE_TRANSACTION,
+						       NULL,
+						       &error);
+		g_assert_no_error (error);
+		value = g_dbus_proxy_call_sync (proxy, "SetHints",
+						g_variant_new ("(^as)", hints),
+						G_DBUS_CALL_FLAGS_NONE,
+						-1, NULL, &error);
+		g_assert_no_error (error);
+		g_variant_unref (value);
+		g_object_unref (proxy);
+		g_ptr_array_add (tids, tid);
+	}
+	elapsed_legacy = g_test_timer_elapsed ();
+
+	/* and how it does now */
+	g_test_timer_start ();
+	for (i = 0; i < LOOP_SIZE; i++) {
+		pk_control_get_tid_with_hints_async (control, (gchar **) hints, NULL,
+						     pk_test_client_latency_get_tid_with_hints_cb,
+						     &tid);
+		_g_test_loop_run_with_timeout (5000);
+		proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
+						       G_DBUS_PROXY_FLAGS_NONE,
+						       NULL,
+						       PK_DBUS_SERVICE,
+						       tid,
+						       PK_DBUS_INTERFACE_TRANSACTION,
+						       NULL,
+						       &error);
+		g_assert_no_error (error);
+		g_object_unref (proxy);
+		g_ptr_array_add (tids, tid);
+	}
+	elapsed = g_test_timer_elapsed ();
+
+	/* both ways created every transaction */
+	g_assert_cmpint (tids->len, ==, LOOP_SIZE * 2 + 1);
+
+	/* two round trips per transaction rather than three, but only
+	 * reported as the time depends too much on the machine */
+	g_test_message ("transaction setup took %.2fms, was %.2fms",
+			elapsed * 1000.f / LOOP_SIZE,
+			elapsed_legacy * 1000.f / LOOP_SIZE);
+
+	/* don't leave the transactions waiting to be committed */
+	for (i = 0; i < tids->len; i++)
+		pk_test_transaction_commit (g_ptr_array_index (tids, i));
+
+	g_ptr_array_unref (tids);
+	g_object_unref (control);
+}
+
+static void
+pk_test_client_progress_func (void)
+{
+	GError *error = NULL;
+	PkClient *client;
+	PkResults *results;
+	gchar **values;
+
+	client = pk_client_new ();
+	g_assert (client != NULL);
+
+	/* the dummy backend moves the percentage on every 200ms */
+	_progress_cb = 0;
+	_status_cb = 0;
+	_allow_cancel_cb = 0;
+	values = g_strsplit ("vips-doc", " ", -1);
+	results = pk_client_what_provides (client,
+					   pk_bitfield_value (PK_FILTER_ENUM_NONE),
+					   values, NULL,
+					   (PkProgressCallback) pk_test_client_progress_cb, NULL,
+					   &error);
+	g_assert_no_error (error);
+	g_assert (results != NULL);
+	g_assert_cmpint (pk_results_get_exit_code (results), ==, PK_EXIT_ENUM_SUCCESS);
+
+	/* the changes arrived while it was running */
+	g_assert_cmpint (_progress_cb, >, 1);
+	g_assert_cmpint (_status_cb, >, 0);
+	g_assert_cmpint (_allow_cancel_cb, >, 0);
+
+	g_strfreev (values);
+	g_object_unref (results);
+	g_object_unref (client);
+}
+
 static void
 pk_test_console_func (void)
 {
@@ -955,6 +1155,58 @@ pk_test_control_func (void)
 	g_object_unref (control);
 }
 
+static void
+pk_test_control_burst_get_tid_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	GPtrArray *tids = (GPtrArray *) user_data;
+	GError *error = NULL;
+	gchar *tid;
+
+	tid = pk_control_get_tid_finish (PK_CONTROL (object), res, &error);
+	g_assert_no_error (error);
+	g_assert (tid != NULL);
+	g_ptr_array_add (tids, tid);
+	if (--_refcount == 0)
+		_g_test_loop_quit ();
+}
+
+static void
+pk_test_control_burst_func (void)
+{
+	GHashTable *unique;
+	GPtrArray *tids;
+	PkControl *control;
+	guint i;
+	const guint BURST_SIZE = 50;
+
+	control = pk_control_new ();
+	g_assert (control != NULL);
+	tids = g_ptr_array_new_with_free_func (g_free);
+
+	/* a client burst of CreateTransaction calls, all in flight at once */
+	_refcount = BURST_SIZE;
+	for (i = 0; i < BURST_SIZE; i++) {
+		pk_control_get_tid_async (control, NULL,
+					  pk_test_control_burst_get_tid_cb, tids);
+	}
+	_g_test_loop_run_with_timeout (10000);
+
+	/* every call got a transaction of its own */
+	g_assert_cmpint (tids->len, ==, BURST_SIZE);
+	unique = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < tids->len; i++)
+		g_hash_table_add (unique, g_ptr_array_index (tids, i));
+	g_assert_cmpint (g_hash_table_size (unique), ==, BURST_SIZE);
+
+	/* and each of them is usable */
+	for (i = 0; i < tids->len; i++)
+		pk_test_transaction_commit (g_ptr_array_index (tids, i));
+
+	g_hash_table_unref (unique);
+	g_ptr_array_unref (tids);
+	g_object_unref (control);
+}
+
 static void
 pk_test_package_sack_resolve_cb (GObject *object, GAsyncResult *res, gpointer user_data)
 {
@@ -1435,9 +1687,12 @@ main (int argc, char **argv)
 	/* tests go here */
 	if(0) g_test_add_func ("/packagekit-glib2/offline", pk_test_offline_func);
 	g_test_add_func ("/packagekit-glib2/control", pk_test_control_func);
+	g_test_add_func ("/packagekit-glib2/control-burst", pk_test_control_burst_func);
 	g_test_add_func ("/packagekit-glib2/transaction-list", pk_test_transaction_list_func);
 	g_test_add_func ("/packagekit-glib2/client-helper", pk_test_client_helper_func);
 	g_test_add_func ("/packagekit-glib2/client", pk_test_client_func);
+	g_test_add_func ("/packagekit-glib2/client-latency", pk_test_client_latency_func);
+	g_test_add_func ("/packagekit-glib2/client-progress", pk_test_client_progress_func);
 	g_test_add_func ("/packagekit-glib2/package-sack", pk_test_package_sack_func);
 	g_test_add_func ("/packagekit-glib2/task", pk_test_task_func);
 	g_test_add_func ("/packagekit-glib2/task-wrapper", pk_test_task_wrapper_func);
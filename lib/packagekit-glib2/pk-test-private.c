@@ -22,7 +22,10 @@
 #include "config.h"
 
 #include <glib-object.h>
+#include <glib/gstdio.h>
+#include <string.h>
 
+#include "pk-command-index-private.h"
 #include "pk-common.h"
 #include "pk-debug.h"
 #include "pk-enum.h"
@@ -608,8 +611,14 @@ pk_test_offline_func (void)
 	guint64 mtime;
 	PkOfflineAction action;
 	PkPackage *pkg;
+	PkFiles *item;
+	GPtrArray *plan_tmp;
+	const gchar *download[] = { PK_OFFLINE_DESTDIR "/powertop-0.1.3.rpm", NULL };
+	g_autofree gchar *fingerprint = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GFileMonitor) monitor = NULL;
+	g_autoptr(GPtrArray) files = NULL;
+	g_autoptr(GPtrArray) plan = NULL;
 	g_autoptr(PkError) pk_error = NULL;
 	g_autoptr(PkPackageSack) sack = NULL;
 	g_autoptr(PkResults) results = NULL;
@@ -688,6 +697,118 @@ pk_test_offline_func (void)
 	g_assert (sack != NULL);
 	g_assert_cmpint (pk_package_sack_get_size (sack), ==, 1);
 
+	/* no fingerprint when only the ids were saved */
+	tmp = pk_offline_get_prepared_fingerprint (&error);
+	g_assert_error (error, PK_OFFLINE_ERROR, PK_OFFLINE_ERROR_NO_DATA);
+	g_assert (tmp == NULL);
+	g_clear_error (&error);
+
+	/* the fingerprint does not change when nothing is installed */
+	fingerprint = pk_offline_get_package_db_fingerprint ();
+	g_assert_cmpint (strlen (fingerprint), ==, 64);
+	tmp = pk_offline_get_package_db_fingerprint ();
+	g_assert_cmpstr (tmp, ==, fingerprint);
+	g_free (tmp);
+
+	/* updating a portage package only changes its category directory */
+	g_mkdir_with_parents (PK_OFFLINE_DESTDIR "/var/db/pkg/sys-power/powertop-0.1.2", 0755);
+	tmp = pk_offline_get_package_db_fingerprint ();
+	g_assert_cmpstr (tmp, !=, fingerprint);
+	g_free (fingerprint);
+	fingerprint = tmp;
+	g_usleep (20 * 1000); /* directory timestamps follow the kernel tick */
+	g_mkdir (PK_OFFLINE_DESTDIR "/var/db/pkg/sys-power/powertop-0.1.3", 0755);
+	tmp = pk_offline_get_package_db_fingerprint ();
+	g_assert_cmpstr (tmp, !=, fingerprint);
+	g_free (fingerprint);
+	fingerprint = tmp;
+
+	/* the plan only has the packages that are changed */
+	plan = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	pkg = pk_package_new ();
+	pk_package_set_id (pkg, "powertop;0.1.3;i386;fedora", NULL);
+	pk_package_set_info (pkg, PK_INFO_ENUM_DOWNLOADING);
+	g_ptr_array_add (plan, pkg);
+	pkg = pk_package_new ();
+	pk_package_set_id (pkg, "powertop;0.1.3;i386;fedora", NULL);
+	pk_package_set_info (pkg, PK_INFO_ENUM_UPDATING);
+	g_ptr_array_add (plan, pkg);
+	pkg = pk_package_new ();
+	pk_package_set_id (pkg, "powertop-libs;0.1.2;i386;installed", NULL);
+	pk_package_set_info (pkg, PK_INFO_ENUM_OBSOLETING);
+	g_ptr_array_add (plan, pkg);
+	tmp = pk_offline_plan_to_string (plan);
+	g_assert_cmpstr (tmp, ==, "updating:powertop;0.1.3;i386;fedora,"
+				  "obsoleting:powertop-libs;0.1.2;i386;installed");
+	plan_tmp = pk_offline_plan_from_string (tmp, &error);
+	g_assert_no_error (error);
+	g_assert (plan_tmp != NULL);
+	g_assert_cmpint (plan_tmp->len, ==, 2);
+	pkg = g_ptr_array_index (plan_tmp, 1);
+	g_assert_cmpint (pk_package_get_info (pkg), ==, PK_INFO_ENUM_OBSOLETING);
+	g_assert_cmpstr (pk_package_get_id (pkg), ==, "powertop-libs;0.1.2;i386;installed");
+	g_ptr_array_unref (plan_tmp);
+	g_free (tmp);
+	plan_tmp = pk_offline_plan_from_string ("downloading:powertop;0.1.3;i386;fedora", &error);
+	g_assert_error (error, PK_OFFLINE_ERROR, PK_OFFLINE_ERROR_INVALID_VALUE);
+	g_assert (plan_tmp == NULL);
+	g_clear_error (&error);
+	plan_tmp = pk_offline_plan_from_string ("updating:powertop", &error);
+	g_assert_error (error, PK_OFFLINE_ERROR, PK_OFFLINE_ERROR_INVALID_VALUE);
+	g_assert (plan_tmp == NULL);
+	g_clear_error (&error);
+
+	/* the plan is not saved without the downloaded files */
+	ret = pk_offline_auth_set_prepared_plan ((gchar **) package_ids, plan,
+						 NULL, fingerprint, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	tmp = pk_offline_get_prepared_plan (&error);
+	g_assert_error (error, PK_OFFLINE_ERROR, PK_OFFLINE_ERROR_NO_DATA);
+	g_assert (tmp == NULL);
+	g_clear_error (&error);
+
+	/* save the plan with the fingerprint and the downloads */
+	ret = g_file_set_contents (PK_OFFLINE_DESTDIR "/powertop-0.1.3.rpm",
+				   "powertop", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	files = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	item = pk_files_new ();
+	g_object_set (item,
+		      "package-id", "powertop;0.1.3;i386;fedora",
+		      "files", download,
+		      NULL);
+	g_ptr_array_add (files, item);
+	ret = pk_offline_auth_set_prepared_plan ((gchar **) package_ids, plan,
+						 files, fingerprint, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	tmp = pk_offline_get_prepared_fingerprint (&error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (tmp, ==, fingerprint);
+	g_free (tmp);
+	tmp = pk_offline_get_prepared_plan (&error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (tmp, ==, "updating:powertop;0.1.3;i386;fedora,"
+				  "obsoleting:powertop-libs;0.1.2;i386;installed");
+	g_free (tmp);
+
+	/* the plan cannot be used when a download has changed */
+	ret = g_file_set_contents (PK_OFFLINE_DESTDIR "/powertop-0.1.3.rpm",
+				   "powertap", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	tmp = pk_offline_get_prepared_plan (&error);
+	g_assert_error (error, PK_OFFLINE_ERROR, PK_OFFLINE_ERROR_FAILED);
+	g_assert (tmp == NULL);
+	g_clear_error (&error);
+	package_ids_tmp = pk_offline_get_prepared_ids (&error);
+	g_assert_no_error (error);
+	g_assert_cmpint (g_strv_length (package_ids_tmp), ==, 1);
+	g_assert_cmpstr (package_ids_tmp[0], ==, "powertop;0.1.3;i386;fedora");
+	g_strfreev (package_ids_tmp);
+
 	/* check monitor */
 	monitor = pk_offline_get_prepared_monitor (NULL, &error);
 	g_assert_no_error (error);
@@ -909,6 +1030,73 @@ pk_test_offline_upgrade_func (void)
 	g_assert (!g_file_test (PK_OFFLINE_RESULTS_FILENAME, G_FILE_TEST_EXISTS));
 }
 
+static void
+pk_test_command_index_func (void)
+{
+	const gchar *filename = "/tmp/PackageKit-self-test-command-index";
+	gboolean ret;
+	gdouble elapsed;
+	GPtrArray *package_ids;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) index = NULL;
+	g_auto(GStrv) found = NULL;
+	g_auto(GStrv) missing = NULL;
+	g_auto(GStrv) multiple = NULL;
+
+	index = g_hash_table_new_full (g_str_hash, g_str_equal,
+				       g_free, (GDestroyNotify) g_ptr_array_unref);
+	package_ids = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (package_ids, g_strdup ("powertop;2.8-1.fc24;x86_64;fedora"));
+	g_hash_table_insert (index, g_strdup ("powertop"), package_ids);
+	package_ids = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (package_ids, g_strdup ("vim-enhanced;8.0-1.fc24;x86_64;fedora"));
+	g_ptr_array_add (package_ids, g_strdup ("vim-X11;8.0-1.fc24;x86_64;fedora"));
+	g_hash_table_insert (index, g_strdup ("vim"), package_ids);
+	package_ids = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (package_ids, g_strdup ("vim-enhanced;8.0-1.fc24;x86_64;fedora"));
+	g_hash_table_insert (index, g_strdup ("vimdiff"), package_ids);
+
+	/* no index yet */
+	g_unlink (filename);
+	missing = pk_command_index_lookup (filename, "powertop", &error);
+	g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+	g_assert (missing == NULL);
+	g_clear_error (&error);
+
+	ret = pk_command_index_save (filename, index, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* single match */
+	g_test_timer_start ();
+	found = pk_command_index_lookup (filename, "powertop", &error);
+	elapsed = g_test_timer_elapsed ();
+	g_assert_no_error (error);
+	g_assert (found != NULL);
+	g_assert_cmpint (g_strv_length (found), ==, 1);
+	g_assert_cmpstr (found[0], ==, "powertop;2.8-1.fc24;x86_64;fedora");
+	g_test_message ("command index lookup took %.3fms", elapsed * 1000);
+
+	/* several packages provide the command */
+	multiple = pk_command_index_lookup (filename, "vim", &error);
+	g_assert_no_error (error);
+	g_assert (multiple != NULL);
+	g_assert_cmpint (g_strv_length (multiple), ==, 2);
+	g_assert (g_strv_contains ((const gchar * const *) multiple,
+				   "vim-enhanced;8.0-1.fc24;x86_64;fedora"));
+	g_assert (g_strv_contains ((const gchar * const *) multiple,
+				   "vim-X11;8.0-1.fc24;x86_64;fedora"));
+
+	/* no match is not an error */
+	g_strfreev (missing);
+	missing = pk_command_index_lookup (filename, "vi", &error);
+	g_assert_no_error (error);
+	g_assert (missing != NULL);
+	g_assert_cmpint (g_strv_length (missing), ==, 0);
+
+	g_unlink (filename);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -932,6 +1120,7 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit-glib2/progress-bar", pk_test_progress_bar);
 	g_test_add_func ("/packagekit-glib2/offline", pk_test_offline_func);
 	g_test_add_func ("/packagekit-glib2/offline-upgrade", pk_test_offline_upgrade_func);
+	g_test_add_func ("/packagekit-glib2/command-index", pk_test_command_index_func);
 
 	return g_test_run ();
 }
@@ -27,12 +27,58 @@ from __future__ import print_function
 import sys
 import traceback
 import os.path
+import struct
+import threading
+import time
 
 from .enums import *
 
 PACKAGE_IDS_DELIM = '&'
 FILENAME_DELIM = '|'
 
+# opcodes of the framed protocol, these have to match the command table in
+# src/pk-backend-spawn.c; anything not listed is sent as opcode 0 with the
+# command name as the first field
+_FRAME_OPCODES = {
+    'package' : 1,
+    'details' : 2,
+    'finished' : 3,
+    'files' : 4,
+    'repo-detail' : 5,
+    'updatedetail' : 6,
+    'percentage' : 7,
+    'item-progress' : 8,
+    'error' : 9,
+    'requirerestart' : 10,
+    'status' : 11,
+    'speed' : 12,
+    'download-size-remaining' : 13,
+    'allow-cancel' : 14,
+    'no-percentage-updates' : 15,
+    'repo-signature-required' : 16,
+    'eula-required' : 17,
+    'media-change-required' : 18,
+    'distro-upgrade' : 19,
+    'category' : 20,
+}
+
+# commands the daemon has to see straight away; results such as package or
+# details lines are batched until one of these is sent
+_FLUSH_COMMANDS = frozenset((
+    'finished', 'error', 'percentage', 'no-percentage-updates', 'status',
+    'item-progress', 'speed', 'download-size-remaining', 'allow-cancel',
+    'repo-signature-required', 'eula-required', 'media-change-required',
+    'message', 'data',
+))
+
+# commands that are written out even while the backend is hiding output, as
+# the daemon waits for them to finish the transaction
+_FORCE_COMMANDS = frozenset(('finished', 'error'))
+
+# flush batched output when it gets this large or this old
+_FLUSH_SIZE = 64 * 1024
+_FLUSH_INTERVAL = 0.1
+
 def _to_unicode(txt, encoding='utf-8'):
     if isinstance(txt, str):
         if not isinstance(txt, str):
@@ -46,6 +92,11 @@ def _to_utf8(txt, errors='replace'):
         return txt.encode('utf-8', errors=errors)
     return str(txt)
 
+def _to_bytes(txt):
+    if isinstance(txt, bytes):
+        return txt
+    return (u'%s' % txt).encode('utf-8', 'replace')
+
 class PkError(Exception):
     def __init__(self, code, details):
         self.code = code
@@ -107,6 +158,92 @@ class PackageKitBaseBackend:
         except KeyError as e:
             pass
 
+        self._setup_output()
+
+    def _setup_output(self):
+        '''
+        Negotiate the framed protocol if the daemon offered it. Once agreed,
+        results are written to a private copy of stdout and file descriptor 1
+        is pointed at stderr, so stray prints cannot corrupt the frames.
+        '''
+        self._framed = False
+        self._out_fd = sys.stdout.fileno()
+        self._out_buf = []
+        self._out_len = 0
+        self._out_time = time.time()
+        self._out_lock = threading.RLock()
+        self._out_timer = None
+        if os.environ.get('PK_BACKEND_PROTOCOL') != 'framed':
+            return
+        sys.stdout.write("protocol\tframed\n")
+        sys.stdout.flush()
+        self._out_fd = os.dup(sys.stdout.fileno())
+        os.dup2(sys.stderr.fileno(), sys.stdout.fileno())
+        self._framed = True
+
+    def _emit(self, cmd, *fields):
+        '''
+        Queue a command for the daemon, flushing if it is time-critical or
+        enough output has been batched up
+        '''
+        if self._framed:
+            opcode = _FRAME_OPCODES.get(cmd, 0)
+            data = [_to_bytes(field) for field in fields]
+            if opcode == 0:
+                data.insert(0, _to_bytes(cmd))
+            frame = [struct.pack('>BB', opcode, len(data))]
+            for field in data:
+                frame.append(struct.pack('>I', len(field)))
+                frame.append(field)
+            frame = b''.join(frame)
+        else:
+            frame = _to_utf8("\t".join([cmd] + [u'%s' % field for field in fields]) + "\n")
+        with self._out_lock:
+            self._out_buf.append(frame)
+            self._out_len += len(frame)
+            if cmd in _FORCE_COMMANDS:
+                self._flush_output(force=True)
+            elif cmd in _FLUSH_COMMANDS or \
+               self._out_len >= _FLUSH_SIZE or \
+               time.time() - self._out_time >= _FLUSH_INTERVAL:
+                self._flush_output()
+            elif self._out_timer is None:
+                # a backend that goes quiet must not keep its last results
+                self._out_timer = threading.Timer(_FLUSH_INTERVAL, self._flush_output)
+                self._out_timer.daemon = True
+                self._out_timer.start()
+
+    def _is_output_blocked(self):
+        '''
+        If the backend is hiding the output of a library by replacing
+        sys.stdout, anything written now could interleave with it
+        '''
+        return sys.stdout is not sys.__stdout__
+
+    def _flush_output(self, force=False):
+        '''
+        Write out any batched commands, unless output is blocked
+        '''
+        with self._out_lock:
+            if self._out_timer is not None:
+                self._out_timer.cancel()
+                self._out_timer = None
+            if not self._out_buf:
+                self._out_time = time.time()
+                return
+            if not force and self._is_output_blocked():
+                return
+            self._out_time = time.time()
+            if self._framed:
+                data = b''.join(self._out_buf)
+            else:
+                sys.__stdout__.flush()
+                data = _to_bytes(''.join(self._out_buf))
+            while data:
+                data = data[os.write(self._out_fd, data):]
+            self._out_buf = []
+            self._out_len = 0
+
     def doLock(self):
         ''' Generic locking, overide and extend in child class'''
         self._locked = True
@@ -124,19 +261,17 @@ class PackageKitBaseBackend:
         @param percent: Progress percentage (int preferred)
         '''
         if percent == None:
-            sys.stdout.write(_to_utf8("no-percentage-updates\n"))
+            self._emit("no-percentage-updates")
         elif percent == 0 or percent > self.percentage_old:
-            sys.stdout.write(_to_utf8("percentage\t%i\n" % percent))
+            self._emit("percentage", "%i" % percent)
             self.percentage_old = percent
-        sys.stdout.flush()
 
     def speed(self, bps=0):
         '''
         Write progress speed
         @param bps: Progress speed (int, bytes per second)
         '''
-        sys.stdout.write(_to_utf8("speed\t%i\n" % bps))
-        sys.stdout.flush()
+        self._emit("speed", "%i" % bps)
 
     def item_progress(self, package_id, status, percent=None):
         '''
@@ -144,8 +279,7 @@ class PackageKitBaseBackend:
         @param package_id: The package ID name, e.g. openoffice-clipart;2.6.22;ppc64;fedora
         @param percent: percentage of the current item (int preferred)
         '''
-        sys.stdout.write(_to_utf8("item-progress\t%s\t%s\t%i\n" % (package_id, status, percent)))
-        sys.stdout.flush()
+        self._emit("item-progress", package_id, status, "%i" % percent)
 
     def error(self, err, description, exit=True):
         '''
@@ -159,8 +293,7 @@ class PackageKitBaseBackend:
             self.unLock()
 
         # this should be fast now
-        sys.stdout.write(_to_utf8("error\t%s\t%s\n" % (err, description)))
-        sys.stdout.flush()
+        self._emit("error", err, description)
         if exit:
             # Paradoxically, we don't want to print "finished" to stdout here.
             # Python takes an _enormous_ amount of time to exit, and leaves a
@@ -174,8 +307,7 @@ class PackageKitBaseBackend:
         send 'message' signal
         @param typ: MESSAGE_BROKEN_MIRROR
         '''
-        sys.stdout.write(_to_utf8("message\t%s\t%s\n" % (typ, msg)))
-        sys.stdout.flush()
+        self._emit("message", typ, msg)
 
     def package(self, package_id, status, summary):
         '''
@@ -184,8 +316,7 @@ class PackageKitBaseBackend:
         @param package_id: The package ID name, e.g. openoffice-clipart;2.6.22;ppc64;fedora
         @param summary: The package Summary
         '''
-        sys.stdout.write(_to_utf8("package\t%s\t%s\t%s\n" % (status, package_id, summary)))
-        sys.stdout.flush()
+        self._emit("package", status, package_id, summary)
 
     def media_change_required(self, mtype, id, text):
         '''
@@ -194,8 +325,7 @@ class PackageKitBaseBackend:
         @param id: the localised label of the media
         @param text: the localised text describing the media
         '''
-        sys.stdout.write(_to_utf8("media-change-required\t%s\t%s\t%s\n" % (mtype, id, text)))
-        sys.stdout.flush()
+        self._emit("media-change-required", mtype, id, text)
 
     def distro_upgrade(self, dtype, name, summary):
         '''
@@ -204,16 +334,14 @@ class PackageKitBaseBackend:
         @param name: The distro name, e.g. "fedora-9"
         @param summary: The localised distribution name and description
         '''
-        sys.stdout.write(_to_utf8("distro-upgrade\t%s\t%s\t%s\n" % (dtype, name, summary)))
-        sys.stdout.flush()
+        self._emit("distro-upgrade", dtype, name, summary)
 
     def status(self, state):
         '''
         send 'status' signal
         @param state: STATUS_DOWNLOAD, STATUS_INSTALL, STATUS_UPDATE, STATUS_REMOVE, STATUS_WAIT
         '''
-        sys.stdout.write(_to_utf8("status\t%s\n" % state))
-        sys.stdout.flush()
+        self._emit("status", state)
 
     def repo_detail(self, repoid, name, state):
         '''
@@ -221,16 +349,14 @@ class PackageKitBaseBackend:
         @param repoid: The repo id tag
         @param state: false is repo is disabled else true.
         '''
-        sys.stdout.write(_to_utf8("repo-detail\t%s\t%s\t%s\n" % (repoid, name, _bool_to_string(state))))
-        sys.stdout.flush()
+        self._emit("repo-detail", repoid, name, _bool_to_string(state))
 
     def data(self, data):
         '''
         send 'data' signal:
         @param data:  The current worked on package
         '''
-        sys.stdout.write(_to_utf8("data\t%s\n" % data))
-        sys.stdout.flush()
+        self._emit("data", data)
 
     def details(self, package_id, summary, package_license, group, desc, url, bytes):
         '''
@@ -243,16 +369,14 @@ class PackageKitBaseBackend:
         @param url: The upstream project homepage
         @param bytes: The size of the package, in bytes
         '''
-        sys.stdout.write(_to_utf8("details\t%s\t%s\t%s\t%s\t%s\t%s\t%ld\n" % (package_id, summary, package_license, group, desc, url, bytes)))
-        sys.stdout.flush()
+        self._emit("details", package_id, summary, package_license, group, desc, url, "%ld" % bytes)
 
     def files(self, package_id, file_list):
         '''
         Send 'files' signal
         @param file_list: List of the files in the package, separated by ';'
         '''
-        sys.stdout.write(_to_utf8("files\t%s\t%s\n" % (package_id, file_list)))
-        sys.stdout.flush()
+        self._emit("files", package_id, file_list)
 
     def category(self, parent_id, cat_id, name, summary, icon):
         '''
@@ -263,15 +387,13 @@ class PackageKitBaseBackend:
         summery   : a summary of the category in current locale.
         icon      : an icon name to represent the category
         '''
-        sys.stdout.write(_to_utf8("category\t%s\t%s\t%s\t%s\t%s\n" % (parent_id, cat_id, name, summary, icon)))
-        sys.stdout.flush()
+        self._emit("category", parent_id, cat_id, name, summary, icon)
 
     def finished(self):
         '''
         Send 'finished' signal
         '''
-        sys.stdout.write(_to_utf8("finished\n"))
-        sys.stdout.flush()
+        self._emit("finished")
 
     def update_detail(self, package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated):
         '''
@@ -289,8 +411,7 @@ class PackageKitBaseBackend:
         @param issued:
         @param updated:
         '''
-        sys.stdout.write(_to_utf8("updatedetail\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n" % (package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated)))
-        sys.stdout.flush()
+        self._emit("updatedetail", package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated)
 
     def require_restart(self, restart_type, details):
         '''
@@ -298,8 +419,7 @@ class PackageKitBaseBackend:
         @param restart_type: RESTART_SYSTEM, RESTART_APPLICATION, RESTART_SESSION
         @param details: Optional details about the restart
         '''
-        sys.stdout.write(_to_utf8("requirerestart\t%s\t%s\n" % (restart_type, details)))
-        sys.stdout.flush()
+        self._emit("requirerestart", restart_type, details)
 
     def allow_cancel(self, allow):
         '''
@@ -310,8 +430,7 @@ class PackageKitBaseBackend:
             data = 'true'
         else:
             data = 'false'
-        sys.stdout.write(_to_utf8("allow-cancel\t%s\n" % data))
-        sys.stdout.flush()
+        self._emit("allow-cancel", data)
 
     def repo_signature_required(self, package_id, repo_name, key_url, key_userid, key_id, key_fingerprint, key_timestamp, sig_type):
         '''
@@ -325,10 +444,8 @@ class PackageKitBaseBackend:
         @param key_timestamp:   Key timestamp
         @param sig_type:        Key type (GPG)
         '''
-        sys.stdout.write(_to_utf8("repo-signature-required\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n" % (
-            package_id, repo_name, key_url, key_userid, key_id, key_fingerprint, key_timestamp, sig_type
-            )))
-        sys.stdout.flush()
+        self._emit("repo-signature-required", package_id, repo_name, key_url,
+                   key_userid, key_id, key_fingerprint, key_timestamp, sig_type)
 
     def eula_required(self, eula_id, package_id, vendor_name, license_agreement):
         '''
@@ -338,10 +455,7 @@ class PackageKitBaseBackend:
         @param vendor_name:     Name of the vendor that wrote the EULA
         @param license_agreement: The license text
         '''
-        sys.stdout.write(_to_utf8("eula-required\t%s\t%s\t%s\t%s\n" % (
-            eula_id, package_id, vendor_name, license_agreement
-            )))
-        sys.stdout.flush()
+        self._emit("eula-required", eula_id, package_id, vendor_name, license_agreement)
 
 #
 # Backend Action Methods
@@ -728,6 +842,7 @@ class PackageKitBaseBackend:
         if len(args) > 0:
             self.dispatch_command(args[0], args[1:])
         while True:
+            self._flush_output()
             try:
                 line = sys.stdin.readline().strip('\n')
             except IOError as e:
@@ -742,6 +857,7 @@ class PackageKitBaseBackend:
         # unlock backend and exit with success
         if self.isLocked():
             self.unLock()
+        self._flush_output(force=True)
         sys.exit(0)
 
 
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Copyright (C) 2016 Richard Hughes <richard@hughsie.com>
+#
+# Licensed under the GNU General Public License Version 2
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# Runs each query against the synthetic repository of the dummy backend
+# at 1k, 10k and 100k packages, in a new process each time so that the
+# peak RSS belongs to that query alone.
+#
+# Set ALLOCS=1 to also count the allocations using valgrind, which makes
+# the times meaningless.
+#
+# The PkClient side is measured with ../client/pk-benchmark against a
+# running daemon configured with DefaultBackend=dummy and
+# DummySyntheticPackages=N in PackageKit.conf.
+
+ROLES="get-packages search-name resolve get-files get-updates"
+SIZES="1000 10000 100000"
+CONF=`mktemp`
+
+for SIZE in $SIZES; do
+    printf "[Daemon]\nDefaultBackend=dummy\nDummySyntheticPackages=$SIZE\n" > $CONF
+    echo "# $SIZE packages"
+    for ROLE in $ROLES; do
+        if [ "$ALLOCS" = "1" ]; then
+            ../libtool --mode=execute valgrind --tool=memcheck --leak-check=no \
+                ./packagekit-direct \
+                --config=$CONF benchmark $ROLE 2>&1 | \
+                grep -e "results=" -e "total heap usage"
+        else
+            ./packagekit-direct --config=$CONF benchmark $ROLE | grep "results="
+        fi
+    done
+done
+rm -f $CONF
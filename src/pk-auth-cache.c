@@ -0,0 +1,531 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "pk-auth-cache.h"
+
+#ifndef HAVE_POLKIT_0_114
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PolkitAuthorizationResult, g_object_unref)
+#endif
+
+#define PK_AUTH_CACHE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_AUTH_CACHE, PkAuthCachePrivate))
+
+/* the same as polkitd keeps a temporary authorization for */
+#define PK_AUTH_CACHE_MAX_AGE		300 /* s */
+
+struct PkAuthCachePrivate
+{
+	PolkitAuthority		*authority;
+	GDBusConnection		*connection;
+	GHashTable		*entries;	/* key -> PkAuthCacheEntry */
+	GHashTable		*retained;	/* action_id, may keep a yes */
+	guint			 generation;
+	guint			 owner_changed_id;
+	gulong			 changed_id;
+};
+
+typedef struct {
+	gchar				*sender;
+	PolkitAuthorizationResult	*result;
+	gint64				 timestamp;
+} PkAuthCacheEntry;
+
+typedef struct {
+	gchar			*key;
+	gchar			*sender;
+	gchar			*action_id;
+	guint			 generation;
+} PkAuthCacheHelper;
+
+G_DEFINE_TYPE (PkAuthCache, pk_auth_cache, G_TYPE_OBJECT)
+
+/**
+ * pk_auth_cache_entry_free:
+ **/
+static void
+pk_auth_cache_entry_free (PkAuthCacheEntry *entry)
+{
+	g_free (entry->sender);
+	g_object_unref (entry->result);
+	g_free (entry);
+}
+
+/**
+ * pk_auth_cache_helper_free:
+ **/
+static void
+pk_auth_cache_helper_free (PkAuthCacheHelper *helper)
+{
+	g_free (helper->key);
+	g_free (helper->sender);
+	g_free (helper->action_id);
+	g_free (helper);
+}
+
+/**
+ * pk_auth_cache_strcmp_cb:
+ **/
+static gint
+pk_auth_cache_strcmp_cb (gconstpointer a, gconstpointer b)
+{
+	return g_strcmp0 (*((const gchar **) a), *((const gchar **) b));
+}
+
+/**
+ * pk_auth_cache_get_key:
+ *
+ * The subject, the action and every detail, as a yes for one set of
+ * package IDs says nothing about another.
+ **/
+static gchar *
+pk_auth_cache_get_key (PolkitSubject *subject,
+		       const gchar *action_id,
+		       PolkitDetails *details)
+{
+	GString *key;
+	guint i;
+	g_autofree gchar *subject_str = NULL;
+	g_auto(GStrv) keys = NULL;
+
+	subject_str = polkit_subject_to_string (subject);
+	key = g_string_new (subject_str);
+	g_string_append_printf (key, "\n%s", action_id);
+	if (details == NULL)
+		return g_string_free (key, FALSE);
+
+	keys = polkit_details_get_keys (details);
+	if (keys == NULL)
+		return g_string_free (key, FALSE);
+	qsort (keys, g_strv_length (keys), sizeof (gchar *),
+	       pk_auth_cache_strcmp_cb);
+	for (i = 0; keys[i] != NULL; i++) {
+		g_string_append_printf (key, "\n%s=%s", keys[i],
+					polkit_details_lookup (details, keys[i]));
+	}
+	return g_string_free (key, FALSE);
+}
+
+/**
+ * pk_auth_cache_invalidate_sender_cb:
+ **/
+static gboolean
+pk_auth_cache_invalidate_sender_cb (gpointer key, gpointer value, gpointer user_data)
+{
+	PkAuthCacheEntry *entry = (PkAuthCacheEntry *) value;
+	return g_strcmp0 (entry->sender, (const gchar *) user_data) == 0;
+}
+
+/**
+ * pk_auth_cache_invalidate:
+ * @sender: the unique bus name, or %NULL for everything
+ *
+ * Forgets the retained results, and any answer still on its way.
+ **/
+void
+pk_auth_cache_invalidate (PkAuthCache *cache, const gchar *sender)
+{
+	g_return_if_fail (PK_IS_AUTH_CACHE (cache));
+
+	cache->priv->generation++;
+	if (sender == NULL) {
+		g_hash_table_remove_all (cache->priv->entries);
+		return;
+	}
+	g_hash_table_foreach_remove (cache->priv->entries,
+				     pk_auth_cache_invalidate_sender_cb,
+				     (gpointer) sender);
+}
+
+/**
+ * pk_auth_cache_set_retained:
+ *
+ * Only actions whose implicit authorization is a yes, or a challenge
+ * that polkitd retains itself, get their results retained here.
+ **/
+void
+pk_auth_cache_set_retained (PkAuthCache *cache,
+			    const gchar *action_id,
+			    gboolean retained)
+{
+	g_return_if_fail (PK_IS_AUTH_CACHE (cache));
+
+	if (retained) {
+		g_hash_table_add (cache->priv->retained, g_strdup (action_id));
+		return;
+	}
+	g_hash_table_remove (cache->priv->retained, action_id);
+	pk_auth_cache_invalidate (cache, NULL);
+}
+
+/**
+ * pk_auth_cache_get_size:
+ **/
+guint
+pk_auth_cache_get_size (PkAuthCache *cache)
+{
+	g_return_val_if_fail (PK_IS_AUTH_CACHE (cache), 0);
+	return g_hash_table_size (cache->priv->entries);
+}
+
+/**
+ * pk_auth_cache_check_cb:
+ **/
+static void
+pk_auth_cache_check_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	PkAuthCache *cache = PK_AUTH_CACHE (source);
+	PkAuthCacheEntry *entry;
+	PkAuthCacheHelper *helper;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTask) task = G_TASK (user_data);
+	g_autoptr(PolkitAuthorizationResult) result = NULL;
+
+	result = PK_AUTH_CACHE_GET_CLASS (cache)->check_authorization_finish (cache, res, &error);
+	if (result == NULL) {
+		g_task_return_error (task, g_steal_pointer (&error));
+		return;
+	}
+
+	/* not invalidated while polkitd was thinking about it */
+	helper = g_task_get_task_data (task);
+	if (helper->sender != NULL &&
+	    helper->generation == cache->priv->generation &&
+	    polkit_authorization_result_get_is_authorized (result) &&
+	    g_hash_table_contains (cache->priv->retained, helper->action_id)) {
+		entry = g_new0 (PkAuthCacheEntry, 1);
+		entry->sender = g_strdup (helper->sender);
+		entry->result = g_object_ref (result);
+		entry->timestamp = g_get_monotonic_time ();
+		g_hash_table_insert (cache->priv->entries,
+				     g_strdup (helper->key),
+				     entry);
+	}
+	g_task_return_pointer (task, g_steal_pointer (&result), g_object_unref);
+}
+
+/**
+ * pk_auth_cache_check_async:
+ *
+ * Like polkit_authority_check_authorization(), but without asking
+ * polkitd again when it said yes to the same question recently.
+ **/
+void
+pk_auth_cache_check_async (PkAuthCache *cache,
+			   PolkitSubject *subject,
+			   const gchar *action_id,
+			   PolkitDetails *details,
+			   PolkitCheckAuthorizationFlags flags,
+			   GCancellable *cancellable,
+			   GAsyncReadyCallback callback,
+			   gpointer user_data)
+{
+	GTask *task;
+	PkAuthCacheEntry *entry;
+	PkAuthCacheHelper *helper;
+
+	g_return_if_fail (PK_IS_AUTH_CACHE (cache));
+	g_return_if_fail (POLKIT_IS_SUBJECT (subject));
+	g_return_if_fail (action_id != NULL);
+
+	task = g_task_new (cache, cancellable, callback, user_data);
+	helper = g_new0 (PkAuthCacheHelper, 1);
+	helper->key = pk_auth_cache_get_key (subject, action_id, details);
+	helper->action_id = g_strdup (action_id);
+	helper->generation = cache->priv->generation;
+	g_task_set_task_data (task, helper, (GDestroyNotify) pk_auth_cache_helper_free);
+
+	/* only bus names go away when the caller disconnects */
+	if (POLKIT_IS_SYSTEM_BUS_NAME (subject)) {
+		helper->sender = g_strdup (polkit_system_bus_name_get_name (POLKIT_SYSTEM_BUS_NAME (subject)));
+	}
+
+	/* still retained? */
+	entry = g_hash_table_lookup (cache->priv->entries, helper->key);
+	if (entry != NULL &&
+	    g_get_monotonic_time () - entry->timestamp < PK_AUTH_CACHE_MAX_AGE * G_USEC_PER_SEC) {
+		g_debug ("using retained %s for %s", action_id, helper->sender);
+		g_task_return_pointer (task, g_object_ref (entry->result), g_object_unref);
+		g_object_unref (task);
+		return;
+	}
+	if (entry != NULL)
+		g_hash_table_remove (cache->priv->entries, helper->key);
+
+	PK_AUTH_CACHE_GET_CLASS (cache)->check_authorization (cache,
+							      subject,
+							      action_id,
+							      details,
+							      flags,
+							      cancellable,
+							      pk_auth_cache_check_cb,
+							      task);
+}
+
+/**
+ * pk_auth_cache_check_finish:
+ **/
+PolkitAuthorizationResult *
+pk_auth_cache_check_finish (PkAuthCache *cache,
+			    GAsyncResult *res,
+			    GError **error)
+{
+	g_return_val_if_fail (PK_IS_AUTH_CACHE (cache), NULL);
+	g_return_val_if_fail (g_task_is_valid (res, cache), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * pk_auth_cache_real_check_authorization_cb:
+ **/
+static void
+pk_auth_cache_real_check_authorization_cb (GObject *source,
+					   GAsyncResult *res,
+					   gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	PolkitAuthorizationResult *result;
+	GError *error = NULL;
+
+	result = polkit_authority_check_authorization_finish (POLKIT_AUTHORITY (source),
+							      res, &error);
+	if (result == NULL)
+		g_task_return_error (task, error);
+	else
+		g_task_return_pointer (task, result, g_object_unref);
+	g_object_unref (task);
+}
+
+/**
+ * pk_auth_cache_real_check_authorization:
+ **/
+static void
+pk_auth_cache_real_check_authorization (PkAuthCache *cache,
+					PolkitSubject *subject,
+					const gchar *action_id,
+					PolkitDetails *details,
+					PolkitCheckAuthorizationFlags flags,
+					GCancellable *cancellable,
+					GAsyncReadyCallback callback,
+					gpointer user_data)
+{
+	GTask *task;
+
+	task = g_task_new (cache, cancellable, callback, user_data);
+	polkit_authority_check_authorization (cache->priv->authority,
+					      subject,
+					      action_id,
+					      details,
+					      flags,
+					      cancellable,
+					      pk_auth_cache_real_check_authorization_cb,
+					      task);
+}
+
+/**
+ * pk_auth_cache_real_check_authorization_finish:
+ **/
+static PolkitAuthorizationResult *
+pk_auth_cache_real_check_authorization_finish (PkAuthCache *cache,
+					       GAsyncResult *res,
+					       GError **error)
+{
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * pk_auth_cache_enumerate_actions_cb:
+ **/
+static void
+pk_auth_cache_enumerate_actions_cb (GObject *source,
+				    GAsyncResult *res,
+				    gpointer user_data)
+{
+	GList *actions;
+	GList *l;
+	PkAuthCache *cache = PK_AUTH_CACHE (user_data);
+	PolkitImplicitAuthorization implicit;
+	g_autoptr(GError) error = NULL;
+
+	actions = polkit_authority_enumerate_actions_finish (POLKIT_AUTHORITY (source),
+							     res, &error);
+	if (error != NULL) {
+		g_warning ("failed to enumerate actions: %s", error->message);
+		g_object_unref (cache);
+		return;
+	}
+
+	g_hash_table_remove_all (cache->priv->retained);
+	for (l = actions; l != NULL; l = l->next) {
+		PolkitActionDescription *desc = POLKIT_ACTION_DESCRIPTION (l->data);
+		implicit = polkit_action_description_get_implicit_active (desc);
+		if (implicit != POLKIT_IMPLICIT_AUTHORIZATION_AUTHORIZED &&
+		    implicit != POLKIT_IMPLICIT_AUTHORIZATION_AUTHENTICATION_REQUIRED_RETAINED &&
+		    implicit != POLKIT_IMPLICIT_AUTHORIZATION_ADMINISTRATOR_AUTHENTICATION_REQUIRED_RETAINED)
+			continue;
+		pk_auth_cache_set_retained (cache,
+					    polkit_action_description_get_action_id (desc),
+					    TRUE);
+	}
+	g_list_free_full (actions, g_object_unref);
+	g_object_unref (cache);
+}
+
+/**
+ * pk_auth_cache_authority_changed_cb:
+ *
+ * Emitted for new rules, actions and session changes alike.
+ **/
+static void
+pk_auth_cache_authority_changed_cb (PolkitAuthority *authority, PkAuthCache *cache)
+{
+	g_debug ("authority changed, forgetting retained results");
+	g_hash_table_remove_all (cache->priv->retained);
+	pk_auth_cache_invalidate (cache, NULL);
+	polkit_authority_enumerate_actions (authority, NULL,
+					    pk_auth_cache_enumerate_actions_cb,
+					    g_object_ref (cache));
+}
+
+/**
+ * pk_auth_cache_name_owner_changed_cb:
+ **/
+static void
+pk_auth_cache_name_owner_changed_cb (GDBusConnection *connection,
+				     const gchar *sender_name,
+				     const gchar *object_path,
+				     const gchar *interface_name,
+				     const gchar *signal_name,
+				     GVariant *parameters,
+				     gpointer user_data)
+{
+	PkAuthCache *cache = PK_AUTH_CACHE (user_data);
+	const gchar *name;
+	const gchar *old_owner;
+	const gchar *new_owner;
+
+	g_variant_get (parameters, "(&s&s&s)", &name, &old_owner, &new_owner);
+	if (new_owner[0] == '\0')
+		pk_auth_cache_invalidate (cache, name);
+}
+
+/**
+ * pk_auth_cache_finalize:
+ **/
+static void
+pk_auth_cache_finalize (GObject *object)
+{
+	PkAuthCache *cache;
+
+	g_return_if_fail (PK_IS_AUTH_CACHE (object));
+	cache = PK_AUTH_CACHE (object);
+
+	if (cache->priv->owner_changed_id != 0) {
+		g_dbus_connection_signal_unsubscribe (cache->priv->connection,
+						      cache->priv->owner_changed_id);
+	}
+	if (cache->priv->changed_id != 0) {
+		g_signal_handler_disconnect (cache->priv->authority,
+					     cache->priv->changed_id);
+	}
+	if (cache->priv->connection != NULL)
+		g_object_unref (cache->priv->connection);
+	if (cache->priv->authority != NULL)
+		g_object_unref (cache->priv->authority);
+	g_hash_table_unref (cache->priv->entries);
+	g_hash_table_unref (cache->priv->retained);
+
+	G_OBJECT_CLASS (pk_auth_cache_parent_class)->finalize (object);
+}
+
+/**
+ * pk_auth_cache_class_init:
+ **/
+static void
+pk_auth_cache_class_init (PkAuthCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_auth_cache_finalize;
+	klass->check_authorization = pk_auth_cache_real_check_authorization;
+	klass->check_authorization_finish = pk_auth_cache_real_check_authorization_finish;
+	g_type_class_add_private (klass, sizeof (PkAuthCachePrivate));
+}
+
+/**
+ * pk_auth_cache_init:
+ **/
+static void
+pk_auth_cache_init (PkAuthCache *cache)
+{
+	cache->priv = PK_AUTH_CACHE_GET_PRIVATE (cache);
+	cache->priv->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+						      g_free,
+						      (GDestroyNotify) pk_auth_cache_entry_free);
+	cache->priv->retained = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, NULL);
+}
+
+/**
+ * pk_auth_cache_new:
+ * @authority: the authority to ask
+ * @connection: the system bus, to notice callers going away
+ *
+ * Return value: a new #PkAuthCache object.
+ **/
+PkAuthCache *
+pk_auth_cache_new (PolkitAuthority *authority, GDBusConnection *connection)
+{
+	PkAuthCache *cache;
+
+	g_return_val_if_fail (POLKIT_IS_AUTHORITY (authority), NULL);
+	g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), NULL);
+
+	cache = g_object_new (PK_TYPE_AUTH_CACHE, NULL);
+	cache->priv->authority = g_object_ref (authority);
+	cache->priv->connection = g_object_ref (connection);
+	cache->priv->changed_id =
+		g_signal_connect (authority, "changed",
+				  G_CALLBACK (pk_auth_cache_authority_changed_cb),
+				  cache);
+	cache->priv->owner_changed_id =
+		g_dbus_connection_signal_subscribe (connection,
+						    "org.freedesktop.DBus",
+						    "org.freedesktop.DBus",
+						    "NameOwnerChanged",
+						    "/org/freedesktop/DBus",
+						    NULL,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_auth_cache_name_owner_changed_cb,
+						    cache,
+						    NULL);
+
+	/* nothing is retained until we know which actions allow it */
+	polkit_authority_enumerate_actions (authority, NULL,
+					    pk_auth_cache_enumerate_actions_cb,
+					    g_object_ref (cache));
+	return cache;
+}
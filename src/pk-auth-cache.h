@@ -0,0 +1,90 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_AUTH_CACHE_H
+#define __PK_AUTH_CACHE_H
+
+#include <gio/gio.h>
+#include <polkit/polkit.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_AUTH_CACHE		(pk_auth_cache_get_type ())
+#define PK_AUTH_CACHE(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), PK_TYPE_AUTH_CACHE, PkAuthCache))
+#define PK_AUTH_CACHE_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), PK_TYPE_AUTH_CACHE, PkAuthCacheClass))
+#define PK_IS_AUTH_CACHE(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), PK_TYPE_AUTH_CACHE))
+#define PK_IS_AUTH_CACHE_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), PK_TYPE_AUTH_CACHE))
+#define PK_AUTH_CACHE_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), PK_TYPE_AUTH_CACHE, PkAuthCacheClass))
+
+typedef struct PkAuthCachePrivate PkAuthCachePrivate;
+
+typedef struct
+{
+	GObject			 parent;
+	PkAuthCachePrivate	*priv;
+} PkAuthCache;
+
+typedef struct
+{
+	GObjectClass		 parent_class;
+	/* the calls to the authority, only replaced in the self tests */
+	void			 (*check_authorization)	(PkAuthCache	*cache,
+							 PolkitSubject	*subject,
+							 const gchar	*action_id,
+							 PolkitDetails	*details,
+							 PolkitCheckAuthorizationFlags flags,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+	PolkitAuthorizationResult *(*check_authorization_finish) (PkAuthCache	*cache,
+							 GAsyncResult	*res,
+							 GError		**error);
+} PkAuthCacheClass;
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkAuthCache, g_object_unref)
+#endif
+
+GType		 pk_auth_cache_get_type		(void);
+PkAuthCache	*pk_auth_cache_new		(PolkitAuthority *authority,
+						 GDBusConnection *connection);
+
+void		 pk_auth_cache_check_async	(PkAuthCache	*cache,
+						 PolkitSubject	*subject,
+						 const gchar	*action_id,
+						 PolkitDetails	*details,
+						 PolkitCheckAuthorizationFlags flags,
+						 GCancellable	*cancellable,
+						 GAsyncReadyCallback callback,
+						 gpointer	 user_data);
+PolkitAuthorizationResult *pk_auth_cache_check_finish (PkAuthCache	*cache,
+						 GAsyncResult	*res,
+						 GError		**error);
+void		 pk_auth_cache_set_retained	(PkAuthCache	*cache,
+						 const gchar	*action_id,
+						 gboolean	 retained);
+void		 pk_auth_cache_invalidate	(PkAuthCache	*cache,
+						 const gchar	*sender);
+guint		 pk_auth_cache_get_size		(PkAuthCache	*cache);
+
+G_END_DECLS
+
+#endif /* __PK_AUTH_CACHE_H */
@@ -93,6 +93,7 @@ struct PkBackendJobPrivate
 	guint			 speed;
 	guint			 uid;
 	GVariant		*params;
+	GPtrArray		*prepared_plan;
 	GCancellable		*cancellable;
 	PkBackend		*backend;
 	PkBackendJobVFuncItem	 vfunc_items[PK_BACKEND_SIGNAL_LAST];
@@ -104,6 +105,7 @@ struct PkBackendJobPrivate
 	gboolean		 interactive;
 	gboolean		 locked;
 	GHashTable		*emitted;
+	GHashTable		*command_index;
 	PkErrorEnum		 last_error_code;
 	PkRoleEnum		 role;
 	PkStatusEnum		 status;
@@ -494,6 +496,38 @@ pk_backend_job_set_cache_age (PkBackendJob *job, guint cache_age)
 	job->priv->cache_age = cache_age;
 }
 
+/**
+ * pk_backend_job_get_prepared_plan:
+ *
+ * Gets the transaction that was solved when the update was prepared, so
+ * the backend does not have to solve it again.
+ *
+ * Return value: (element-type PkPackage): the packages to change, or %NULL
+ **/
+GPtrArray *
+pk_backend_job_get_prepared_plan (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), NULL);
+	return job->priv->prepared_plan;
+}
+
+/**
+ * pk_backend_job_set_prepared_plan:
+ **/
+void
+pk_backend_job_set_prepared_plan (PkBackendJob *job, GPtrArray *prepared_plan)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+
+	if (job->priv->prepared_plan != NULL)
+		g_ptr_array_unref (job->priv->prepared_plan);
+	job->priv->prepared_plan = NULL;
+	if (prepared_plan != NULL)
+		job->priv->prepared_plan = g_ptr_array_ref (prepared_plan);
+	g_debug ("prepared-plan changed to %u packages",
+		 prepared_plan != NULL ? prepared_plan->len : 0);
+}
+
 /**
  * pk_backend_job_set_user_data:
  **/
@@ -791,6 +825,56 @@ pk_backend_job_get_locked (PkBackendJob *job)
 	return job->priv->locked;
 }
 
+/**
+ * pk_backend_job_add_command_index:
+ * @job: a #PkBackendJob
+ * @command: the basename of an executable, e.g. "powertop"
+ * @package_id: the package providing it
+ *
+ * Adds an executable to the command index. A backend should add every
+ * executable in /usr/bin, /usr/sbin and /bin provided by the available
+ * packages while doing RefreshCache, and the daemon saves the index for
+ * command-not-found when the job succeeds.
+ *
+ * Only backends whose repository metadata has file lists can do this
+ * without downloading the packages; at the moment that is only dnf.
+ **/
+void
+pk_backend_job_add_command_index (PkBackendJob *job,
+				  const gchar *command,
+				  const gchar *package_id)
+{
+	GPtrArray *package_ids;
+
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (command != NULL);
+	g_return_if_fail (package_id != NULL);
+
+	if (job->priv->command_index == NULL) {
+		job->priv->command_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+								  g_free, (GDestroyNotify) g_ptr_array_unref);
+	}
+	package_ids = g_hash_table_lookup (job->priv->command_index, command);
+	if (package_ids == NULL) {
+		package_ids = g_ptr_array_new_with_free_func (g_free);
+		g_hash_table_insert (job->priv->command_index, g_strdup (command), package_ids);
+	}
+	g_ptr_array_add (package_ids, g_strdup (package_id));
+}
+
+/**
+ * pk_backend_job_get_command_index:
+ *
+ * Return value: (transfer none): the command index, or %NULL if the
+ * backend did not build one
+ **/
+GHashTable *
+pk_backend_job_get_command_index (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), NULL);
+	return job->priv->command_index;
+}
+
 /* simple helper to work around the GThread one pointer limit */
 typedef struct {
 	PkBackend		*backend;
@@ -1828,8 +1912,12 @@ pk_backend_job_finalize (GObject *object)
 	g_free (job->priv->locale);
 	g_free (job->priv->frontend_socket);
 	g_hash_table_unref (job->priv->emitted);
+	if (job->priv->command_index != NULL)
+		g_hash_table_unref (job->priv->command_index);
 	if (job->priv->params != NULL)
 		g_variant_unref (job->priv->params);
+	if (job->priv->prepared_plan != NULL)
+		g_ptr_array_unref (job->priv->prepared_plan);
 	g_timer_destroy (job->priv->timer);
 	g_key_file_unref (job->priv->conf);
 	g_object_unref (job->priv->cancellable);
@@ -105,6 +105,10 @@ void		 pk_backend_job_set_interactive		(PkBackendJob	*job,
 void		 pk_backend_job_set_locked		(PkBackendJob	*job,
 							 gboolean	 locked);
 gboolean	 pk_backend_job_get_locked		(PkBackendJob	*job);
+void		 pk_backend_job_add_command_index	(PkBackendJob	*job,
+							 const gchar	*command,
+							 const gchar	*package_id);
+GHashTable	*pk_backend_job_get_command_index	(PkBackendJob	*job);
 void		 pk_backend_job_set_role		(PkBackendJob	*job,
 							 PkRoleEnum	 role);
 PkRoleEnum	 pk_backend_job_get_role		(PkBackendJob	*job);
@@ -135,6 +139,8 @@ void		 pk_backend_job_set_frontend_socket	(PkBackendJob	*job,
 							 const gchar	*frontend_socket);
 void		 pk_backend_job_set_cache_age		(PkBackendJob	*job,
 							 guint		 cache_age);
+void		 pk_backend_job_set_prepared_plan	(PkBackendJob	*job,
+							 GPtrArray	*prepared_plan);
 const gchar	*pk_backend_job_get_proxy_ftp		(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_proxy_http		(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_proxy_https		(PkBackendJob	*job);
@@ -144,6 +150,7 @@ const gchar	*pk_backend_job_get_pac			(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_locale		(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_frontend_socket	(PkBackendJob	*job);
 guint		 pk_backend_job_get_cache_age		(PkBackendJob	*job);
+GPtrArray	*pk_backend_job_get_prepared_plan	(PkBackendJob	*job);
 
 /* transaction vfuncs */
 typedef void	 (*PkBackendJobVFunc)			(PkBackendJob	*job,
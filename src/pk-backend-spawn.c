@@ -65,6 +65,7 @@ struct PkBackendSpawnPrivate
 	gboolean		 finished;
 	gboolean		 allow_sigkill;
 	gboolean		 is_busy;
+	gboolean		 use_framed;
 	PkBackendSpawnFilterFunc stdout_func;
 	PkBackendSpawnFilterFunc stderr_func;
 };
@@ -139,433 +140,705 @@ pk_backend_spawn_start_kill_timer (PkBackendSpawn *backend_spawn)
 }
 
 /**
- * pk_backend_spawn_parse_stdout:
+ * pk_backend_spawn_cmd_package:
  **/
 static gboolean
-pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
-			       PkBackendJob *job,
-			       const gchar *line,
-			       GError **error)
+pk_backend_spawn_cmd_package (PkBackendSpawn *backend_spawn,
+			      PkBackendJob *job,
+			      gchar **sections,
+			      GError **error)
 {
-	guint size;
-	gchar *command;
-	gchar *text;
-	guint64 speed;
-	guint64 download_size_remaining;
 	PkInfoEnum info;
-	PkRestartEnum restart;
+
+	if (pk_package_id_check (sections[2]) == FALSE) {
+		g_set_error_literal (error, 1, 0, "invalid package_id");
+		return FALSE;
+	}
+	info = pk_info_enum_from_string (sections[1]);
+	if (info == PK_INFO_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Info enum not recognised, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
+	g_strdelimit (sections[3], PK_UNSAFE_DELIMITERS, ' ');
+	if (!g_utf8_validate (sections[3], -1, NULL)) {
+		g_set_error (error, 1, 0,
+			     "text '%s' was not valid UTF8!",
+			     sections[3]);
+		return FALSE;
+	}
+	pk_backend_job_package (job, info, sections[2], sections[3]);
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_cmd_details:
+ **/
+static gboolean
+pk_backend_spawn_cmd_details (PkBackendSpawn *backend_spawn,
+			      PkBackendJob *job,
+			      gchar **sections,
+			      GError **error)
+{
+	gchar *text;
 	PkGroupEnum group;
 	gulong package_size;
+
+	group = pk_group_enum_from_string (sections[4]);
+
+	/* ITS4: ignore, checked for overflow */
+	package_size = atol (sections[7]);
+	if (package_size > 1073741824) {
+		g_set_error_literal (error, 1, 0,
+				     "package size cannot be that large");
+		return FALSE;
+	}
+	g_strdelimit (sections[5], PK_UNSAFE_DELIMITERS, ' ');
+	if (!g_utf8_validate (sections[4], -1, NULL)) {
+		g_set_error (error, 1, 0,
+			     "text '%s' was not valid UTF8!",
+			     sections[5]);
+		return FALSE;
+	}
+	text = g_strdup (sections[5]);
+	/* convert ; to \n as we can't emit them on stdout */
+	g_strdelimit (text, ";", '\n');
+	pk_backend_job_details (job, sections[1], sections[2], sections[3],
+				group, text, sections[6], package_size);
+	g_free (text);
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_cmd_finished:
+ **/
+static gboolean
+pk_backend_spawn_cmd_finished (PkBackendSpawn *backend_spawn,
+			       PkBackendJob *job,
+			       gchar **sections,
+			       GError **error)
+{
+	PkBackendSpawnPrivate *priv = backend_spawn->priv;
+
+	pk_backend_job_finished (job);
+	priv->is_busy = FALSE;
+
+	/* from this point on, we can start the kill timer */
+	pk_backend_spawn_start_kill_timer (backend_spawn);
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_cmd_files:
+ **/
+static gboolean
+pk_backend_spawn_cmd_files (PkBackendSpawn *backend_spawn,
+			    PkBackendJob *job,
+			    gchar **sections,
+			    GError **error)
+{
+	g_auto(GStrv) tmp = NULL;
+
+	tmp = g_strsplit (sections[2], ";", -1);
+	pk_backend_job_files (job, sections[1], tmp);
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_cmd_repo_detail:
+ **/
+static gboolean
+pk_backend_spawn_cmd_repo_detail (PkBackendSpawn *backend_spawn,
+				  PkBackendJob *job,
+				  gchar **sections,
+				  GError **error)
+{
+	g_strdelimit (sections[2], PK_UNSAFE_DELIMITERS, ' ');
+	if (!g_utf8_validate (sections[2], -1, NULL)) {
+		g_set_error (error, 1, 0,
+			     "text '%s' was not valid UTF8!",
+			     sections[2]);
+		return FALSE;
+	}
+	if (g_strcmp0 (sections[3], "true") == 0) {
+		pk_backend_job_repo_detail (job, sections[1], sections[2], TRUE);
+	} else if (g_strcmp0 (sections[3], "false") == 0) {
+		pk_backend_job_repo_detail (job, sections[1], sections[2], FALSE);
+	} else {
+		g_set_error (error, 1, 0, "invalid qualifier '%s'", sections[3]);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_cmd_updatedetail:
+ **/
+static gboolean
+pk_backend_spawn_cmd_updatedetail (PkBackendSpawn *backend_spawn,
+				   PkBackendJob *job,
+				   gchar **sections,
+				   GError **error)
+{
+	PkRestartEnum restart;
+	PkUpdateStateEnum update_state_enum;
+	g_auto(GStrv) updates = NULL;
+	g_auto(GStrv) obsoletes = NULL;
+	g_auto(GStrv) vendor_urls = NULL;
+	g_auto(GStrv) bugzilla_urls = NULL;
+	g_auto(GStrv) cve_urls = NULL;
+
+	restart = pk_restart_enum_from_string (sections[7]);
+	if (restart == PK_RESTART_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Restart enum not recognised, and hence ignored: '%s'", sections[7]);
+		return FALSE;
+	}
+	g_strdelimit (sections[12], PK_UNSAFE_DELIMITERS, ' ');
+	if (!g_utf8_validate (sections[12], -1, NULL)) {
+		g_set_error (error, 1, 0,
+			     "text '%s' was not valid UTF8!",
+			     sections[12]);
+		return FALSE;
+	}
+	update_state_enum = pk_update_state_enum_from_string (sections[10]);
+	/* convert ; to \n as we can't emit them on stdout */
+	g_strdelimit (sections[8], ";", '\n');
+	g_strdelimit (sections[9], ";", '\n');
+	updates = g_strsplit (sections[2], "&", -1);
+	obsoletes = g_strsplit (sections[3], "&", -1);
+	vendor_urls = g_strsplit (sections[4], ";", -1);
+	bugzilla_urls = g_strsplit (sections[5], ";", -1);
+	cve_urls = g_strsplit (sections[6], ";", -1);
+	pk_backend_job_update_detail (job,
+				  sections[1],
+				  updates,
+				  obsoletes,
+				  vendor_urls,
+				  bugzilla_urls,
+				  cve_urls,
+				  restart,
+				  sections[8],
+				  sections[9],
+				  update_state_enum,
+				  sections[11],
+				  sections[12]);
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_cmd_percentage:
+ **/
+static gboolean
+pk_backend_spawn_cmd_percentage (PkBackendSpawn *backend_spawn,
+				 PkBackendJob *job,
+				 gchar **sections,
+				 GError **error)
+{
+	gint percentage;
+
+	if (!pk_strtoint (sections[1], &percentage)) {
+		g_set_error (error, 1, 0, "invalid percentage value %s", sections[1]);
+		return FALSE;
+	} else if (percentage < 0 || percentage > 100) {
+		g_set_error (error, 1, 0, "invalid percentage value %i", percentage);
+		return FALSE;
+	} else {
+		pk_backend_job_set_percentage (job, percentage);
+	}
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_cmd_item_progress:
+ **/
+static gboolean
+pk_backend_spawn_cmd_item_progress (PkBackendSpawn *backend_spawn,
+				    PkBackendJob *job,
+				    gchar **sections,
+				    GError **error)
+{
 	gint percentage;
-	PkErrorEnum error_enum;
 	PkStatusEnum status_enum;
+
+	if (!pk_package_id_check (sections[1])) {
+		g_set_error (error, 1, 0, "invalid package_id");
+		return FALSE;
+	}
+	status_enum = pk_status_enum_from_string (sections[2]);
+	if (status_enum == PK_STATUS_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Status enum not recognised, and hence ignored: '%s'", sections[2]);
+		return FALSE;
+	}
+	if (!pk_strtoint (sections[3], &percentage)) {
+		g_set_error (error, 1, 0, "invalid item-progress value %s", sections[3]);
+		return FALSE;
+	}
+	if (percentage < 0 || percentage > 100) {
+		g_set_error (error, 1, 0, "invalid item-progress value %i", percentage);
+		return FALSE;
+	}
+	pk_backend_job_set_item_progress (job,
+					  sections[1],
+					  status_enum,
+					  percentage);
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_cmd_error:
+ **/
+static gboolean
+pk_backend_spawn_cmd_error (PkBackendSpawn *backend_spawn,
+			    PkBackendJob *job,
+			    gchar **sections,
+			    GError **error)
+{
+	gchar *text;
+	PkErrorEnum error_enum;
+
+	error_enum = pk_error_enum_from_string (sections[1]);
+	if (error_enum == PK_ERROR_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Error enum not recognised, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
+	/* convert back all the ;'s to newlines */
+	text = g_strdup (sections[2]);
+
+	/* convert ; to \n as we can't emit them on stdout */
+	g_strdelimit (text, ";", '\n');
+
+	/* convert % else we try to format them */
+	g_strdelimit (text, "%", '$');
+
+	pk_backend_job_error_code (job, error_enum, "%s", text);
+	g_free (text);
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_cmd_requirerestart:
+ **/
+static gboolean
+pk_backend_spawn_cmd_requirerestart (PkBackendSpawn *backend_spawn,
+				     PkBackendJob *job,
+				     gchar **sections,
+				     GError **error)
+{
 	PkRestartEnum restart_enum;
-	PkSigTypeEnum sig_type;
-	PkUpdateStateEnum update_state_enum;
-	PkMediaTypeEnum media_type_enum;
-	PkDistroUpgradeEnum distro_upgrade_enum;
-	PkBackendSpawnPrivate *priv = backend_spawn->priv;
-	g_auto(GStrv) sections = NULL;
 
-	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
+	restart_enum = pk_restart_enum_from_string (sections[1]);
+	if (restart_enum == PK_RESTART_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Restart enum not recognised, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
+	if (!pk_package_id_check (sections[2])) {
+		g_set_error (error, 1, 0, "invalid package_id");
+		return FALSE;
+	}
+	pk_backend_job_require_restart (job, restart_enum, sections[2]);
+	return TRUE;
+}
 
-	/* check if output line */
-	if (line == NULL)
+/**
+ * pk_backend_spawn_cmd_status:
+ **/
+static gboolean
+pk_backend_spawn_cmd_status (PkBackendSpawn *backend_spawn,
+			     PkBackendJob *job,
+			     gchar **sections,
+			     GError **error)
+{
+	PkStatusEnum status_enum;
+
+	status_enum = pk_status_enum_from_string (sections[1]);
+	if (status_enum == PK_STATUS_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Status enum not recognised, and hence ignored: '%s'", sections[1]);
 		return FALSE;
+	}
+	pk_backend_job_set_status (job, status_enum);
+	return TRUE;
+}
 
-	/* split by tab */
-	sections = g_strsplit (line, "\t", 0);
-	command = sections[0];
+/**
+ * pk_backend_spawn_cmd_speed:
+ **/
+static gboolean
+pk_backend_spawn_cmd_speed (PkBackendSpawn *backend_spawn,
+			    PkBackendJob *job,
+			    gchar **sections,
+			    GError **error)
+{
+	guint64 speed;
 
-	/* get size */
-	size = g_strv_length (sections);
+	if (!pk_strtouint64 (sections[1], &speed)) {
+		g_set_error (error, 1, 0,
+			     "failed to parse speed: '%s'",
+			     sections[1]);
+		return FALSE;
+	}
+	pk_backend_job_set_speed (job, speed);
+	return TRUE;
+}
 
-	if (g_strcmp0 (command, "package") == 0) {
-		if (size != 4) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (pk_package_id_check (sections[2]) == FALSE) {
-			g_set_error_literal (error, 1, 0, "invalid package_id");
-			return FALSE;
-		}
-		info = pk_info_enum_from_string (sections[1]);
-		if (info == PK_INFO_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Info enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		g_strdelimit (sections[3], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[3], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[3]);
-			return FALSE;
-		}
-		pk_backend_job_package (job, info, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "details") == 0) {
-		if (size != 8) {
-			g_set_error (error, 1, 0,
-				     "invalid command'%s', size %i",
-				     command, size);
-			return FALSE;
-		}
-		group = pk_group_enum_from_string (sections[4]);
+/**
+ * pk_backend_spawn_cmd_download_size_remaining:
+ **/
+static gboolean
+pk_backend_spawn_cmd_download_size_remaining (PkBackendSpawn *backend_spawn,
+					      PkBackendJob *job,
+					      gchar **sections,
+					      GError **error)
+{
+	guint64 download_size_remaining;
 
-		/* ITS4: ignore, checked for overflow */
-		package_size = atol (sections[7]);
-		if (package_size > 1073741824) {
-			g_set_error_literal (error, 1, 0,
-					     "package size cannot be that large");
-			return FALSE;
-		}
-		g_strdelimit (sections[5], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[4], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[5]);
-			return FALSE;
-		}
-		text = g_strdup (sections[5]);
-		/* convert ; to \n as we can't emit them on stdout */
-		g_strdelimit (text, ";", '\n');
-		pk_backend_job_details (job, sections[1], sections[2], sections[3],
-					group, text, sections[6], package_size);
-		g_free (text);
-	} else if (g_strcmp0 (command, "finished") == 0) {
-		if (size != 1) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		pk_backend_job_finished (job);
-		priv->is_busy = FALSE;
+	if (!pk_strtouint64 (sections[1], &download_size_remaining)) {
+		g_set_error (error, 1, 0,
+			     "failed to parse download_size_remaining: '%s'",
+			     sections[1]);
+		return FALSE;
+	}
+	pk_backend_job_set_download_size_remaining (job, download_size_remaining);
+	return TRUE;
+}
 
-		/* from this point on, we can start the kill timer */
-		pk_backend_spawn_start_kill_timer (backend_spawn);
+/**
+ * pk_backend_spawn_cmd_allow_cancel:
+ **/
+static gboolean
+pk_backend_spawn_cmd_allow_cancel (PkBackendSpawn *backend_spawn,
+				   PkBackendJob *job,
+				   gchar **sections,
+				   GError **error)
+{
+	if (g_strcmp0 (sections[1], "true") == 0) {
+		pk_backend_job_set_allow_cancel (job, TRUE);
+	} else if (g_strcmp0 (sections[1], "false") == 0) {
+		pk_backend_job_set_allow_cancel (job, FALSE);
+	} else {
+		g_set_error (error, 1, 0, "invalid section '%s'", sections[1]);
+		return FALSE;
+	}
+	return TRUE;
+}
 
-	} else if (g_strcmp0 (command, "files") == 0) {
-		g_auto(GStrv) tmp = NULL;
-		if (size != 3) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		tmp = g_strsplit (sections[2], ";", -1);
-		pk_backend_job_files (job, sections[1], tmp);
-	} else if (g_strcmp0 (command, "repo-detail") == 0) {
-		if (size != 4) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		g_strdelimit (sections[2], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[2], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[2]);
-			return FALSE;
-		}
-		if (g_strcmp0 (sections[3], "true") == 0) {
-			pk_backend_job_repo_detail (job, sections[1], sections[2], TRUE);
-		} else if (g_strcmp0 (sections[3], "false") == 0) {
-			pk_backend_job_repo_detail (job, sections[1], sections[2], FALSE);
-		} else {
-			g_set_error (error, 1, 0, "invalid qualifier '%s'", sections[3]);
-			return FALSE;
-		}
-	} else if (g_strcmp0 (command, "updatedetail") == 0) {
-		g_auto(GStrv) updates = NULL;
-		g_auto(GStrv) obsoletes = NULL;
-		g_auto(GStrv) vendor_urls = NULL;
-		g_auto(GStrv) bugzilla_urls = NULL;
-		g_auto(GStrv) cve_urls = NULL;
-		if (size != 13) {
-			g_set_error (error, 1, 0, "invalid command '%s', size %i", command, size);
-			return FALSE;
-		}
-		restart = pk_restart_enum_from_string (sections[7]);
-		if (restart == PK_RESTART_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Restart enum not recognised, and hence ignored: '%s'", sections[7]);
-			return FALSE;
-		}
-		g_strdelimit (sections[12], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[12], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[12]);
-			return FALSE;
-		}
-		update_state_enum = pk_update_state_enum_from_string (sections[10]);
-		/* convert ; to \n as we can't emit them on stdout */
-		g_strdelimit (sections[8], ";", '\n');
-		g_strdelimit (sections[9], ";", '\n');
-		updates = g_strsplit (sections[2], "&", -1);
-		obsoletes = g_strsplit (sections[3], "&", -1);
-		vendor_urls = g_strsplit (sections[4], ";", -1);
-		bugzilla_urls = g_strsplit (sections[5], ";", -1);
-		cve_urls = g_strsplit (sections[6], ";", -1);
-		pk_backend_job_update_detail (job,
-					  sections[1],
-					  updates,
-					  obsoletes,
-					  vendor_urls,
-					  bugzilla_urls,
-					  cve_urls,
-					  restart,
-					  sections[8],
-					  sections[9],
-					  update_state_enum,
-					  sections[11],
-					  sections[12]);
-	} else if (g_strcmp0 (command, "percentage") == 0) {
-		if (size != 2) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (!pk_strtoint (sections[1], &percentage)) {
-			g_set_error (error, 1, 0, "invalid percentage value %s", sections[1]);
-			return FALSE;
-		} else if (percentage < 0 || percentage > 100) {
-			g_set_error (error, 1, 0, "invalid percentage value %i", percentage);
-			return FALSE;
-		} else {
-			pk_backend_job_set_percentage (job, percentage);
-		}
-	} else if (g_strcmp0 (command, "item-progress") == 0) {
-		if (size != 4) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (!pk_package_id_check (sections[1])) {
-			g_set_error (error, 1, 0, "invalid package_id");
-			return FALSE;
-		}
-		status_enum = pk_status_enum_from_string (sections[2]);
-		if (status_enum == PK_STATUS_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Status enum not recognised, and hence ignored: '%s'", sections[2]);
-			return FALSE;
-		}
-		if (!pk_strtoint (sections[3], &percentage)) {
-			g_set_error (error, 1, 0, "invalid item-progress value %s", sections[3]);
-			return FALSE;
-		}
-		if (percentage < 0 || percentage > 100) {
-			g_set_error (error, 1, 0, "invalid item-progress value %i", percentage);
-			return FALSE;
-		}
-		pk_backend_job_set_item_progress (job,
-						  sections[1],
-						  status_enum,
-						  percentage);
-	} else if (g_strcmp0 (command, "error") == 0) {
-		if (size != 3) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		error_enum = pk_error_enum_from_string (sections[1]);
-		if (error_enum == PK_ERROR_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Error enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		/* convert back all the ;'s to newlines */
-		text = g_strdup (sections[2]);
+/**
+ * pk_backend_spawn_cmd_no_percentage_updates:
+ **/
+static gboolean
+pk_backend_spawn_cmd_no_percentage_updates (PkBackendSpawn *backend_spawn,
+					    PkBackendJob *job,
+					    gchar **sections,
+					    GError **error)
+{
+	pk_backend_job_set_percentage (job, PK_BACKEND_PERCENTAGE_INVALID);
+	return TRUE;
+}
 
-		/* convert ; to \n as we can't emit them on stdout */
-		g_strdelimit (text, ";", '\n');
+/**
+ * pk_backend_spawn_cmd_repo_signature_required:
+ **/
+static gboolean
+pk_backend_spawn_cmd_repo_signature_required (PkBackendSpawn *backend_spawn,
+					      PkBackendJob *job,
+					      gchar **sections,
+					      GError **error)
+{
+	PkSigTypeEnum sig_type;
 
-		/* convert % else we try to format them */
-		g_strdelimit (text, "%", '$');
+	sig_type = pk_sig_type_enum_from_string (sections[8]);
+	if (sig_type == PK_SIGTYPE_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Sig enum not recognised, and hence ignored: '%s'", sections[8]);
+		return FALSE;
+	}
+	if (pk_strzero (sections[1])) {
+		g_set_error (error, 1, 0, "package_id blank, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
+	if (pk_strzero (sections[2])) {
+		g_set_error (error, 1, 0, "repository name blank, and hence ignored: '%s'", sections[2]);
+		return FALSE;
+	}
 
-		pk_backend_job_error_code (job, error_enum, "%s", text);
-		g_free (text);
-	} else if (g_strcmp0 (command, "requirerestart") == 0) {
-		if (size != 3) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		restart_enum = pk_restart_enum_from_string (sections[1]);
-		if (restart_enum == PK_RESTART_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Restart enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		if (!pk_package_id_check (sections[2])) {
-			g_set_error (error, 1, 0, "invalid package_id");
-			return FALSE;
-		}
-		pk_backend_job_require_restart (job, restart_enum, sections[2]);
-	} else if (g_strcmp0 (command, "status") == 0) {
-		if (size != 2) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		status_enum = pk_status_enum_from_string (sections[1]);
-		if (status_enum == PK_STATUS_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Status enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		pk_backend_job_set_status (job, status_enum);
-	} else if (g_strcmp0 (command, "speed") == 0) {
-		if (size != 2) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (!pk_strtouint64 (sections[1], &speed)) {
-			g_set_error (error, 1, 0,
-				     "failed to parse speed: '%s'",
-				     sections[1]);
-			return FALSE;
-		}
-		pk_backend_job_set_speed (job, speed);
-	} else if (g_strcmp0 (command, "download-size-remaining") == 0) {
-		if (size != 2) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (!pk_strtouint64 (sections[1], &download_size_remaining)) {
-			g_set_error (error, 1, 0,
-				     "failed to parse download_size_remaining: '%s'",
-				     sections[1]);
-			return FALSE;
-		}
-		pk_backend_job_set_download_size_remaining (job, download_size_remaining);
-	} else if (g_strcmp0 (command, "allow-cancel") == 0) {
-		if (size != 2) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (g_strcmp0 (sections[1], "true") == 0) {
-			pk_backend_job_set_allow_cancel (job, TRUE);
-		} else if (g_strcmp0 (sections[1], "false") == 0) {
-			pk_backend_job_set_allow_cancel (job, FALSE);
-		} else {
-			g_set_error (error, 1, 0, "invalid section '%s'", sections[1]);
-			return FALSE;
-		}
-	} else if (g_strcmp0 (command, "no-percentage-updates") == 0) {
-		if (size != 1) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		pk_backend_job_set_percentage (job, PK_BACKEND_PERCENTAGE_INVALID);
-	} else if (g_strcmp0 (command, "repo-signature-required") == 0) {
+	/* pass _all_ of the data */
+	pk_backend_job_repo_signature_required (job, sections[1],
+						  sections[2], sections[3], sections[4],
+						  sections[5], sections[6], sections[7], sig_type);
+	return TRUE;
+}
 
-		if (size != 9) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
+/**
+ * pk_backend_spawn_cmd_eula_required:
+ **/
+static gboolean
+pk_backend_spawn_cmd_eula_required (PkBackendSpawn *backend_spawn,
+				    PkBackendJob *job,
+				    gchar **sections,
+				    GError **error)
+{
+	if (pk_strzero (sections[1])) {
+		g_set_error (error, 1, 0, "eula_id blank, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
 
-		sig_type = pk_sig_type_enum_from_string (sections[8]);
-		if (sig_type == PK_SIGTYPE_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Sig enum not recognised, and hence ignored: '%s'", sections[8]);
-			return FALSE;
-		}
-		if (pk_strzero (sections[1])) {
-			g_set_error (error, 1, 0, "package_id blank, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		if (pk_strzero (sections[2])) {
-			g_set_error (error, 1, 0, "repository name blank, and hence ignored: '%s'", sections[2]);
-			return FALSE;
-		}
+	if (pk_strzero (sections[2])) {
+		g_set_error (error, 1, 0, "package_id blank, and hence ignored: '%s'", sections[2]);
+		return FALSE;
+	}
 
-		/* pass _all_ of the data */
-		pk_backend_job_repo_signature_required (job, sections[1],
-							  sections[2], sections[3], sections[4],
-							  sections[5], sections[6], sections[7], sig_type);
-	} else if (g_strcmp0 (command, "eula-required") == 0) {
+	if (pk_strzero (sections[4])) {
+		g_set_error (error, 1, 0, "agreement name blank, and hence ignored: '%s'", sections[4]);
+		return FALSE;
+	}
 
-		if (size != 5) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
+	pk_backend_job_eula_required (job, sections[1], sections[2], sections[3], sections[4]);
+	return TRUE;
+}
 
-		if (pk_strzero (sections[1])) {
-			g_set_error (error, 1, 0, "eula_id blank, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
+/**
+ * pk_backend_spawn_cmd_media_change_required:
+ **/
+static gboolean
+pk_backend_spawn_cmd_media_change_required (PkBackendSpawn *backend_spawn,
+					    PkBackendJob *job,
+					    gchar **sections,
+					    GError **error)
+{
+	PkMediaTypeEnum media_type_enum;
 
-		if (pk_strzero (sections[2])) {
-			g_set_error (error, 1, 0, "package_id blank, and hence ignored: '%s'", sections[2]);
-			return FALSE;
-		}
+	media_type_enum = pk_media_type_enum_from_string (sections[1]);
+	if (media_type_enum == PK_MEDIA_TYPE_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "media type enum not recognised, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
 
-		if (pk_strzero (sections[4])) {
-			g_set_error (error, 1, 0, "agreement name blank, and hence ignored: '%s'", sections[4]);
-			return FALSE;
-		}
+	pk_backend_job_media_change_required (job, media_type_enum, sections[2], sections[3]);
+	return TRUE;
+}
 
-		pk_backend_job_eula_required (job, sections[1], sections[2], sections[3], sections[4]);
-	} else if (g_strcmp0 (command, "media-change-required") == 0) {
+/**
+ * pk_backend_spawn_cmd_distro_upgrade:
+ **/
+static gboolean
+pk_backend_spawn_cmd_distro_upgrade (PkBackendSpawn *backend_spawn,
+				     PkBackendJob *job,
+				     gchar **sections,
+				     GError **error)
+{
+	PkDistroUpgradeEnum distro_upgrade_enum;
 
-		if (size != 4) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
+	distro_upgrade_enum = pk_distro_upgrade_enum_from_string (sections[1]);
+	if (distro_upgrade_enum == PK_DISTRO_UPGRADE_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "distro upgrade enum not recognised, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
+	g_strdelimit (sections[3], PK_UNSAFE_DELIMITERS, ' ');
+	if (!g_utf8_validate (sections[3], -1, NULL)) {
+		g_set_error (error, 1, 0,
+			     "text '%s' was not valid UTF8!",
+			     sections[3]);
+		return FALSE;
+	}
 
-		media_type_enum = pk_media_type_enum_from_string (sections[1]);
-		if (media_type_enum == PK_MEDIA_TYPE_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "media type enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
+	pk_backend_job_distro_upgrade (job, distro_upgrade_enum, sections[2], sections[3]);
+	return TRUE;
+}
 
-		pk_backend_job_media_change_required (job, media_type_enum, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "distro-upgrade") == 0) {
+/**
+ * pk_backend_spawn_cmd_category:
+ **/
+static gboolean
+pk_backend_spawn_cmd_category (PkBackendSpawn *backend_spawn,
+			       PkBackendJob *job,
+			       gchar **sections,
+			       GError **error)
+{
+	if (g_strcmp0 (sections[1], sections[2]) == 0) {
+		g_set_error_literal (error, 1, 0, "cat_id cannot be the same as parent_id");
+		return FALSE;
+	}
+	if (pk_strzero (sections[2])) {
+		g_set_error_literal (error, 1, 0, "cat_id cannot not blank");
+		return FALSE;
+	}
+	if (pk_strzero (sections[3])) {
+		g_set_error_literal (error, 1, 0, "name cannot not blank");
+		return FALSE;
+	}
+	g_strdelimit (sections[4], PK_UNSAFE_DELIMITERS, ' ');
+	if (!g_utf8_validate (sections[4], -1, NULL)) {
+		g_set_error (error, 1, 0,
+			     "text '%s' was not valid UTF8!",
+			     sections[4]);
+		return FALSE;
+	}
+	if (pk_strzero (sections[5])) {
+		g_set_error_literal (error, 1, 0, "icon cannot not blank");
+		return FALSE;
+	}
+	if (g_str_has_prefix (sections[5], "/")) {
+		g_set_error (error, 1, 0, "icon '%s' should be a named icon, not a path", sections[5]);
+		return FALSE;
+	}
+	pk_backend_job_category (job, sections[1], sections[2], sections[3], sections[4], sections[5]);
+	return TRUE;
+}
 
-		if (size != 4) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
+/**
+ * pk_backend_spawn_cmd_protocol:
+ *
+ * Sent by the backend in the text protocol to switch to the framed protocol.
+ **/
+static gboolean
+pk_backend_spawn_cmd_protocol (PkBackendSpawn *backend_spawn,
+			       PkBackendJob *job,
+			       gchar **sections,
+			       GError **error)
+{
+	PkBackendSpawnPrivate *priv = backend_spawn->priv;
 
-		distro_upgrade_enum = pk_distro_upgrade_enum_from_string (sections[1]);
-		if (distro_upgrade_enum == PK_DISTRO_UPGRADE_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "distro upgrade enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		g_strdelimit (sections[3], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[3], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[3]);
-			return FALSE;
-		}
+	if (g_strcmp0 (sections[1], "framed") != 0 || !priv->use_framed) {
+		g_set_error (error, 1, 0, "protocol '%s' was not offered", sections[1]);
+		return FALSE;
+	}
+	g_debug ("backend switched to the framed protocol");
+	pk_spawn_set_framed (priv->spawn, TRUE);
+	return TRUE;
+}
 
-		pk_backend_job_distro_upgrade (job, distro_upgrade_enum, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "category") == 0) {
+typedef gboolean (*PkBackendSpawnCommandFunc)	(PkBackendSpawn	*backend_spawn,
+						 PkBackendJob	*job,
+						 gchar		**sections,
+						 GError		**error);
+
+typedef struct {
+	const gchar			*name;
+	guint				 size;	/* including the command */
+	PkBackendSpawnCommandFunc	 func;
+} PkBackendSpawnCommand;
+
+/* the index is the opcode used in the framed protocol, so only ever append,
+ * and keep in sync with lib/python/packagekit/backend.py */
+static const PkBackendSpawnCommand pk_backend_spawn_commands[] = {
+	{ NULL,				0,	NULL },	/* named command */
+	{ "package",			4,	pk_backend_spawn_cmd_package },
+	{ "details",			8,	pk_backend_spawn_cmd_details },
+	{ "finished",			1,	pk_backend_spawn_cmd_finished },
+	{ "files",			3,	pk_backend_spawn_cmd_files },
+	{ "repo-detail",		4,	pk_backend_spawn_cmd_repo_detail },
+	{ "updatedetail",		13,	pk_backend_spawn_cmd_updatedetail },
+	{ "percentage",			2,	pk_backend_spawn_cmd_percentage },
+	{ "item-progress",		4,	pk_backend_spawn_cmd_item_progress },
+	{ "error",			3,	pk_backend_spawn_cmd_error },
+	{ "requirerestart",		3,	pk_backend_spawn_cmd_requirerestart },
+	{ "status",			2,	pk_backend_spawn_cmd_status },
+	{ "speed",			2,	pk_backend_spawn_cmd_speed },
+	{ "download-size-remaining",	2,	pk_backend_spawn_cmd_download_size_remaining },
+	{ "allow-cancel",		2,	pk_backend_spawn_cmd_allow_cancel },
+	{ "no-percentage-updates",	1,	pk_backend_spawn_cmd_no_percentage_updates },
+	{ "repo-signature-required",	9,	pk_backend_spawn_cmd_repo_signature_required },
+	{ "eula-required",		5,	pk_backend_spawn_cmd_eula_required },
+	{ "media-change-required",	4,	pk_backend_spawn_cmd_media_change_required },
+	{ "distro-upgrade",		4,	pk_backend_spawn_cmd_distro_upgrade },
+	{ "category",			6,	pk_backend_spawn_cmd_category },
+	{ "protocol",			2,	pk_backend_spawn_cmd_protocol },
+};
 
-		if (size != 6) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (g_strcmp0 (sections[1], sections[2]) == 0) {
-			g_set_error_literal (error, 1, 0, "cat_id cannot be the same as parent_id");
-			return FALSE;
-		}
-		if (pk_strzero (sections[2])) {
-			g_set_error_literal (error, 1, 0, "cat_id cannot not blank");
-			return FALSE;
-		}
-		if (pk_strzero (sections[3])) {
-			g_set_error_literal (error, 1, 0, "name cannot not blank");
-			return FALSE;
-		}
-		g_strdelimit (sections[4], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[4], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[4]);
-			return FALSE;
-		}
-		if (pk_strzero (sections[5])) {
-			g_set_error_literal (error, 1, 0, "icon cannot not blank");
+static GHashTable *pk_backend_spawn_command_hash = NULL;
+
+/**
+ * pk_backend_spawn_dispatch:
+ **/
+static gboolean
+pk_backend_spawn_dispatch (PkBackendSpawn *backend_spawn,
+			   PkBackendJob *job,
+			   const PkBackendSpawnCommand *cmd,
+			   gchar **sections,
+			   guint size,
+			   GError **error)
+{
+	if (size != cmd->size) {
+		g_set_error (error, 1, 0, "invalid command '%s', size %i", cmd->name, size);
+		return FALSE;
+	}
+	return cmd->func (backend_spawn, job, sections, error);
+}
+
+/**
+ * pk_backend_spawn_parse_stdout:
+ **/
+static gboolean
+pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
+			       PkBackendJob *job,
+			       const gchar *line,
+			       GError **error)
+{
+	const PkBackendSpawnCommand *cmd;
+	g_auto(GStrv) sections = NULL;
+
+	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
+
+	/* check if output line */
+	if (line == NULL)
+		return FALSE;
+
+	/* split by tab */
+	sections = g_strsplit (line, "\t", 0);
+	if (sections[0] == NULL) {
+		g_set_error_literal (error, 1, 0, "no command");
+		return FALSE;
+	}
+	cmd = g_hash_table_lookup (pk_backend_spawn_command_hash, sections[0]);
+	if (cmd == NULL) {
+		g_set_error (error, 1, 0, "invalid command '%s'", sections[0]);
+		return FALSE;
+	}
+	return pk_backend_spawn_dispatch (backend_spawn, job, cmd, sections,
+					  g_strv_length (sections), error);
+}
+
+/**
+ * pk_backend_spawn_parse_frame:
+ *
+ * Each frame has already been split into fields by PkSpawn, so only the
+ * opcode has to be looked up. Opcode zero carries the command name as the
+ * first field, for commands that do not have an opcode assigned.
+ **/
+static gboolean
+pk_backend_spawn_parse_frame (PkBackendSpawn *backend_spawn,
+			      PkBackendJob *job,
+			      guint opcode,
+			      gchar **fields,
+			      guint n_fields,
+			      GError **error)
+{
+	const PkBackendSpawnCommand *cmd;
+	g_autofree gchar **sections = NULL;
+
+	if (opcode == 0) {
+		if (n_fields == 0) {
+			g_set_error_literal (error, 1, 0, "no command name in frame");
 			return FALSE;
 		}
-		if (g_str_has_prefix (sections[5], "/")) {
-			g_set_error (error, 1, 0, "icon '%s' should be a named icon, not a path", sections[5]);
+		cmd = g_hash_table_lookup (pk_backend_spawn_command_hash, fields[0]);
+		if (cmd == NULL) {
+			g_set_error (error, 1, 0, "invalid command '%s'", fields[0]);
 			return FALSE;
 		}
-		pk_backend_job_category (job, sections[1], sections[2], sections[3], sections[4], sections[5]);
-	} else {
-		g_set_error (error, 1, 0, "invalid command '%s'", command);
+		return pk_backend_spawn_dispatch (backend_spawn, job, cmd,
+						  fields, n_fields, error);
+	}
+	if (opcode >= G_N_ELEMENTS (pk_backend_spawn_commands)) {
+		g_set_error (error, 1, 0, "invalid opcode %u", opcode);
 		return FALSE;
 	}
-	return TRUE;
+
+	/* the handlers expect the command name as the first section */
+	cmd = &pk_backend_spawn_commands[opcode];
+	sections = g_new (gchar *, n_fields + 2);
+	sections[0] = (gchar *) cmd->name;
+	memcpy (&sections[1], fields, sizeof (gchar *) * n_fields);
+	sections[n_fields + 1] = NULL;
+	return pk_backend_spawn_dispatch (backend_spawn, job, cmd,
+					  sections, n_fields + 1, error);
 }
 
 /**
@@ -643,6 +916,42 @@ pk_backend_spawn_stdout_cb (PkBackendSpawn *spawn, const gchar *line, PkBackendS
 		g_warning ("failed to parse: %s: %s", line, error->message);
 }
 
+/**
+ * pk_backend_spawn_inject_frame:
+ * @fields: the NULL terminated fields of the frame
+ **/
+gboolean
+pk_backend_spawn_inject_frame (PkBackendSpawn *backend_spawn,
+			       PkBackendJob *job,
+			       guint opcode,
+			       gchar **fields,
+			       GError **error)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
+	return pk_backend_spawn_parse_frame (backend_spawn, job, opcode, fields,
+					     g_strv_length (fields), error);
+}
+
+/**
+ * pk_backend_spawn_stdout_frame_cb:
+ **/
+static void
+pk_backend_spawn_stdout_frame_cb (PkSpawn *spawn,
+				  guint opcode,
+				  GPtrArray *fields,
+				  PkBackendSpawn *backend_spawn)
+{
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	ret = pk_backend_spawn_inject_frame (backend_spawn,
+					     backend_spawn->priv->job,
+					     opcode,
+					     (gchar **) fields->pdata,
+					     &error);
+	if (!ret)
+		g_warning ("failed to parse frame %u: %s", opcode, error->message);
+}
+
 /**
  * pk_backend_spawn_stderr_cb:
  **/
@@ -787,6 +1096,16 @@ pk_backend_spawn_get_envp (PkBackendSpawn *backend_spawn)
 			      g_strdup ("UID"),
 			      g_strdup_printf ("%u", pk_backend_job_get_uid (priv->job)));
 
+	/* PK_BACKEND_PROTOCOL, the stdout filter only works on text lines */
+	priv->use_framed = priv->stdout_func == NULL &&
+			   g_key_file_get_boolean (priv->conf, "Daemon",
+						   "BackendFramedProtocol", NULL);
+	if (priv->use_framed) {
+		g_hash_table_replace (env_table,
+				      g_strdup ("PK_BACKEND_PROTOCOL"),
+				      g_strdup ("framed"));
+	}
+
 	/* CACHE_AGE */
 	cache_age = pk_backend_job_get_cache_age (priv->job);
 	if (cache_age == G_MAXUINT) {
@@ -1094,9 +1413,18 @@ pk_backend_spawn_finalize (GObject *object)
 static void
 pk_backend_spawn_class_init (PkBackendSpawnClass *klass)
 {
+	guint i;
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	object_class->finalize = pk_backend_spawn_finalize;
 	g_type_class_add_private (klass, sizeof (PkBackendSpawnPrivate));
+
+	/* used to look up commands sent using the text protocol */
+	pk_backend_spawn_command_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 1; i < G_N_ELEMENTS (pk_backend_spawn_commands); i++) {
+		g_hash_table_insert (pk_backend_spawn_command_hash,
+				     (gpointer) pk_backend_spawn_commands[i].name,
+				     (gpointer) &pk_backend_spawn_commands[i]);
+	}
 }
 
 /**
@@ -1122,6 +1450,8 @@ pk_backend_spawn_new (GKeyFile *conf)
 			  G_CALLBACK (pk_backend_spawn_exit_cb), backend_spawn);
 	g_signal_connect (backend_spawn->priv->spawn, "stdout",
 			  G_CALLBACK (pk_backend_spawn_stdout_cb), backend_spawn);
+	g_signal_connect (backend_spawn->priv->spawn, "stdout-frame",
+			  G_CALLBACK (pk_backend_spawn_stdout_frame_cb), backend_spawn);
 	g_signal_connect (backend_spawn->priv->spawn, "stderr",
 			  G_CALLBACK (pk_backend_spawn_stderr_cb), backend_spawn);
 	return PK_BACKEND_SPAWN (backend_spawn);
@@ -207,6 +207,7 @@ struct PkBackendPrivate
 	guint			 repo_list_changed_id;
 	guint			 installed_db_changed_id;
 	guint			 updates_changed_id;
+	gint			 state_generation;	/* atomic */
 };
 
 G_DEFINE_TYPE (PkBackend, pk_backend, G_TYPE_OBJECT)
@@ -635,6 +636,34 @@ pk_backend_unload (PkBackend *backend)
 	return TRUE;
 }
 
+/**
+ * pk_backend_state_changed:
+ *
+ * Bumps the state generation, so that anything remembered about the
+ * package database or the repositories is known to be out of date.
+ *
+ * This function can be called on any thread.
+ **/
+void
+pk_backend_state_changed (PkBackend *backend)
+{
+	g_return_if_fail (PK_IS_BACKEND (backend));
+	g_atomic_int_inc (&backend->priv->state_generation);
+}
+
+/**
+ * pk_backend_get_state_generation:
+ *
+ * Return value: a number that changes every time the package database or
+ * the repositories may have changed.
+ **/
+guint
+pk_backend_get_state_generation (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), 0);
+	return (guint) g_atomic_int_get (&backend->priv->state_generation);
+}
+
 /**
  * pk_backend_repo_list_changed_cb:
  **/
@@ -660,6 +689,8 @@ pk_backend_repo_list_changed (PkBackend *backend)
 	g_return_if_fail (PK_IS_BACKEND (backend));
 	g_return_if_fail (backend->priv->loaded);
 
+	pk_backend_state_changed (backend);
+
 	/* already scheduled */
 	if (backend->priv->repo_list_changed_id != 0)
 		return;
@@ -678,6 +709,8 @@ pk_backend_updates_changed (PkBackend *backend)
 	g_return_val_if_fail (PK_IS_BACKEND (backend), FALSE);
 	g_return_val_if_fail (pk_is_thread_default (), FALSE);
 
+	pk_backend_state_changed (backend);
+
 	g_debug ("emitting updates-changed");
 	g_signal_emit (backend, signals [SIGNAL_UPDATES_CHANGED], 0);
 	return TRUE;
@@ -758,6 +791,8 @@ pk_backend_installed_db_changed (PkBackend *backend)
 	g_return_if_fail (PK_IS_BACKEND (backend));
 	g_return_if_fail (backend->priv->loaded);
 
+	pk_backend_state_changed (backend);
+
 	/* already scheduled */
 	if (backend->priv->installed_db_changed_id != 0)
 		return;
@@ -85,6 +85,8 @@ gboolean	 pk_backend_is_implemented		(PkBackend	*backend,
 gchar		*pk_backend_get_accepted_eula_string	(PkBackend	*backend);
 void		 pk_backend_repo_list_changed		(PkBackend      *backend);
 void		 pk_backend_installed_db_changed	(PkBackend      *backend);
+void		 pk_backend_state_changed		(PkBackend	*backend);
+guint		 pk_backend_get_state_generation	(PkBackend	*backend);
 
 
 gboolean	 pk_backend_updates_changed		(PkBackend	*backend);
@@ -38,175 +38,496 @@
 struct PkDbusPrivate
 {
 	GDBusConnection		*connection;
-	GDBusProxy		*proxy_pid;
-	GDBusProxy		*proxy_uid;
 	GDBusProxy		*proxy_session;
+	GHashTable		*credentials;	/* unique name -> PkDbusCredentials */
+	guint			 owner_changed_id;
 };
 
+typedef struct {
+	guint			 refcount;
+	PkDbus			*dbus;		/* owned while a lookup is running */
+	gchar			*sender;
+	guint			 uid;
+	guint			 pid;
+	gchar			*cmdline;
+	gchar			*session;
+	gboolean		 done;
+	GPtrArray		*tasks;		/* of GTask, waiting for the lookup */
+} PkDbusCredentials;
+
 static gpointer pk_dbus_object = NULL;
 
 G_DEFINE_TYPE (PkDbus, pk_dbus, G_TYPE_OBJECT)
 
 /**
- * pk_dbus_get_uid:
- * @dbus: the #PkDbus instance
- * @sender: the sender
+ * pk_dbus_credentials_new:
+ **/
+static PkDbusCredentials *
+pk_dbus_credentials_new (PkDbus *dbus, const gchar *sender)
+{
+	PkDbusCredentials *creds;
+	creds = g_new0 (PkDbusCredentials, 1);
+	creds->refcount = 1;
+	creds->dbus = dbus;
+	creds->sender = g_strdup (sender);
+	creds->uid = G_MAXUINT;
+	creds->pid = G_MAXUINT;
+	creds->tasks = g_ptr_array_new ();
+	return creds;
+}
+
+/**
+ * pk_dbus_credentials_ref:
+ **/
+static PkDbusCredentials *
+pk_dbus_credentials_ref (PkDbusCredentials *creds)
+{
+	creds->refcount++;
+	return creds;
+}
+
+/**
+ * pk_dbus_credentials_unref:
+ **/
+static void
+pk_dbus_credentials_unref (PkDbusCredentials *creds)
+{
+	if (--creds->refcount > 0)
+		return;
+	g_assert (creds->tasks->len == 0);
+	g_ptr_array_unref (creds->tasks);
+	g_free (creds->sender);
+	g_free (creds->cmdline);
+	g_free (creds->session);
+	g_free (creds);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkDbusCredentials, pk_dbus_credentials_unref)
+
+/**
+ * pk_dbus_credentials_new_self_check:
  *
- * Gets the process UID.
+ * The fixed credentials the test suite uses as a fake sender.
+ **/
+static PkDbusCredentials *
+pk_dbus_credentials_new_self_check (PkDbus *dbus, const gchar *sender)
+{
+	PkDbusCredentials *creds;
+	g_debug ("using self-check shortcut");
+	creds = pk_dbus_credentials_new (dbus, sender);
+	creds->uid = 500;
+	creds->pid = G_MAXUINT - 1;
+	creds->cmdline = g_strdup ("/usr/sbin/packagekit");
+	creds->session = g_strdup ("xxx");
+	creds->done = TRUE;
+	return creds;
+}
+
+#ifdef HAVE_SYSTEMD
+static gchar *
+pk_dbus_make_logind_session_id (const gchar *session)
+{
+	g_assert (session != NULL);
+	return g_strdup_printf ("/org/freedesktop/logind/session-%s", session);
+}
+
+/**
+ * pk_dbus_get_session_systemd:
+ **/
+static gchar *
+pk_dbus_get_session_systemd (guint pid)
+{
+	g_autofree gchar *session_id = NULL;
+	uid_t uid;
+
+	/* do process -> pid -> same session */
+	if (sd_pid_get_session (pid, &session_id) >= 0)
+		return pk_dbus_make_logind_session_id (session_id);
+
+	/* do process -> uid -> graphical session */
+	if (sd_pid_get_owner_uid (pid, &uid) < 0)
+		return NULL;
+	if (sd_uid_get_display (uid, &session_id) >= 0)
+		return pk_dbus_make_logind_session_id (session_id);
+
+	return NULL;
+}
+#endif
+
+/**
+ * pk_dbus_credentials_set_reply:
  *
- * Return value: the UID, or %G_MAXUINT if it could not be obtained
+ * Takes the uid and pid from a GetConnectionCredentials() reply and fills
+ * in everything that can be found out locally from the pid.
  **/
-guint
-pk_dbus_get_uid (PkDbus *dbus, const gchar *sender)
+static void
+pk_dbus_credentials_set_reply (PkDbusCredentials *creds, GVariant *value)
 {
-	guint uid = G_MAXUINT;
 	g_autoptr(GError) error = NULL;
-	g_autoptr(GVariant) value = NULL;
+	g_autoptr(GVariant) dict = NULL;
+	g_autofree gchar *filename = NULL;
 
-	g_return_val_if_fail (PK_IS_DBUS (dbus), G_MAXUINT);
-	g_return_val_if_fail (sender != NULL, G_MAXUINT);
+	dict = g_variant_get_child_value (value, 0);
+	if (!g_variant_lookup (dict, "UnixUserID", "u", &creds->uid))
+		g_warning ("no uid for %s", creds->sender);
+	if (!g_variant_lookup (dict, "ProcessID", "u", &creds->pid)) {
+		g_warning ("failed to get PID for %s", creds->sender);
+		return;
+	}
 
-	/* set in the test suite */
-	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0) {
-		g_debug ("using self-check shortcut");
-		return 500;
+	/* get command line from proc */
+	filename = g_strdup_printf ("/proc/%u/cmdline", creds->pid);
+	if (!g_file_get_contents (filename, &creds->cmdline, NULL, &error))
+		g_warning ("failed to get cmdline: %s", error->message);
+
+#ifdef HAVE_SYSTEMD
+	/* logind keeps this in /run, so no round trip is needed */
+	creds->session = pk_dbus_get_session_systemd (creds->pid);
+	if (creds->session == NULL)
+		g_warning ("failed to get session for pid %u", creds->pid);
+#endif
+}
+
+/**
+ * pk_dbus_credentials_done:
+ *
+ * Completes everybody who is waiting for the lookup. Failed lookups are
+ * not cached, so the next caller asks the bus again.
+ **/
+static void
+pk_dbus_credentials_done (PkDbusCredentials *creds, const GError *error)
+{
+	PkDbusPrivate *priv = creds->dbus->priv;
+	guint i;
+	g_autoptr(GPtrArray) tasks = NULL;
+
+	if (error == NULL) {
+		creds->done = TRUE;
+	} else if (g_hash_table_lookup (priv->credentials, creds->sender) == creds) {
+		g_hash_table_remove (priv->credentials, creds->sender);
 	}
-	value = g_dbus_proxy_call_sync (dbus->priv->proxy_uid,
-					"GetConnectionUnixUser",
-					g_variant_new ("(s)",
-						       sender),
-					G_DBUS_CALL_FLAGS_NONE,
-					2000,
-					NULL,
-					&error);
-	if (value == NULL) {
-		g_warning ("Failed to get uid for %s: %s",
-			   sender, error->message);
-		return G_MAXUINT;
+
+	/* the callbacks may start new lookups for the same sender */
+	tasks = creds->tasks;
+	creds->tasks = g_ptr_array_new ();
+	for (i = 0; i < tasks->len; i++) {
+		GTask *task = g_ptr_array_index (tasks, i);
+		if (error != NULL)
+			g_task_return_error (task, g_error_copy (error));
+		else
+			g_task_return_boolean (task, TRUE);
+		g_object_unref (task);
 	}
-	g_variant_get (value, "(u)", &uid);
-	return uid;
 }
 
 /**
- * pk_dbus_get_pid:
- * @dbus: the #PkDbus instance
- * @sender: the sender, usually got from dbus_g_method_get_dbus()
- *
- * Gets the process ID.
+ * pk_dbus_credentials_lookup_done:
  *
- * Return value: the PID, or %G_MAXUINT if it could not be obtained
+ * Finishes the async lookup, and drops the references to the credentials
+ * and the #PkDbus object that it took when it started.
  **/
-static guint
-pk_dbus_get_pid (PkDbus *dbus, const gchar *sender)
+static void
+pk_dbus_credentials_lookup_done (PkDbusCredentials *creds, const GError *error)
 {
-	guint pid = G_MAXUINT;
+	PkDbus *dbus = creds->dbus;
+
+	pk_dbus_credentials_done (creds, error);
+	pk_dbus_credentials_unref (creds);
+	g_object_unref (dbus);
+}
+
+#ifndef HAVE_SYSTEMD
+/**
+ * pk_dbus_get_session_cb:
+ **/
+static void
+pk_dbus_get_session_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	PkDbusCredentials *creds = (PkDbusCredentials *) user_data;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GVariant) value = NULL;
 
-	g_return_val_if_fail (PK_IS_DBUS (dbus), G_MAXUINT);
-	g_return_val_if_fail (sender != NULL, G_MAXUINT);
+	value = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+	if (value == NULL) {
+		g_warning ("Failed to get session for %s: %s",
+			   creds->sender, error->message);
+	} else {
+		g_variant_get (value, "(o)", &creds->session);
+	}
+
+	/* a missing session is not fatal */
+	pk_dbus_credentials_lookup_done (creds, NULL);
+}
+#endif
+
+/**
+ * pk_dbus_get_connection_credentials_cb:
+ **/
+static void
+pk_dbus_get_connection_credentials_cb (GObject *source,
+				       GAsyncResult *res,
+				       gpointer user_data)
+{
+	PkDbusCredentials *creds = (PkDbusCredentials *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	value = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+	if (value == NULL) {
+		g_warning ("Failed to get credentials for %s: %s",
+			   creds->sender, error->message);
+		pk_dbus_credentials_lookup_done (creds, error);
+		return;
+	}
+	pk_dbus_credentials_set_reply (creds, value);
+
+#ifndef HAVE_SYSTEMD
+	/* get session from ConsoleKit */
+	if (creds->pid != G_MAXUINT && creds->dbus->priv->proxy_session != NULL) {
+		g_dbus_proxy_call (creds->dbus->priv->proxy_session,
+				   "GetSessionForUnixProcess",
+				   g_variant_new ("(u)", creds->pid),
+				   G_DBUS_CALL_FLAGS_NONE,
+				   2000,
+				   NULL,
+				   pk_dbus_get_session_cb,
+				   creds);
+		return;
+	}
+	g_warning ("no ConsoleKit, so cannot get session");
+#endif
+	pk_dbus_credentials_lookup_done (creds, NULL);
+}
+
+/**
+ * pk_dbus_get_credentials_async:
+ * @dbus: the #PkDbus instance
+ * @sender: the unique bus name of the caller
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Looks up the uid, pid, command line and session of the caller without
+ * blocking. The result is cached until the name leaves the bus, so that
+ * pk_dbus_get_uid(), pk_dbus_get_cmdline() and pk_dbus_get_session() then
+ * return without a round trip. Lookups for a sender that is already being
+ * looked up share the same bus call.
+ **/
+void
+pk_dbus_get_credentials_async (PkDbus *dbus,
+			       const gchar *sender,
+			       GCancellable *cancellable,
+			       GAsyncReadyCallback callback,
+			       gpointer user_data)
+{
+	PkDbusCredentials *creds;
+	PkDbusPrivate *priv;
+	GTask *task;
+
+	g_return_if_fail (PK_IS_DBUS (dbus));
+	g_return_if_fail (sender != NULL);
+
+	priv = dbus->priv;
+	task = g_task_new (dbus, cancellable, callback, user_data);
 
 	/* set in the test suite */
 	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0) {
 		g_debug ("using self-check shortcut");
-		return G_MAXUINT - 1;
+		g_task_return_boolean (task, TRUE);
+		g_object_unref (task);
+		return;
 	}
 
 	/* no connection to DBus */
-	if (dbus->priv->proxy_pid == NULL)
-		return G_MAXUINT;
+	if (priv->connection == NULL) {
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+					 "no connection to the system bus");
+		g_object_unref (task);
+		return;
+	}
 
-	/* get pid from DBus */
-	value = g_dbus_proxy_call_sync (dbus->priv->proxy_pid,
-					"GetConnectionUnixProcessID",
-					g_variant_new ("(s)",
-						       sender),
-					G_DBUS_CALL_FLAGS_NONE,
-					2000,
-					NULL,
-					&error);
-	if (value == NULL) {
-		g_warning ("Failed to get pid for %s: %s",
-			   sender, error->message);
-		return G_MAXUINT;
+	/* already known, or somebody is already asking */
+	creds = g_hash_table_lookup (priv->credentials, sender);
+	if (creds != NULL && creds->done) {
+		g_task_return_boolean (task, TRUE);
+		g_object_unref (task);
+		return;
+	}
+	if (creds != NULL) {
+		g_ptr_array_add (creds->tasks, task);
+		return;
 	}
-	g_variant_get (value, "(u)", &pid);
-	return pid;
+
+	/* only unique names are removed again by NameOwnerChanged */
+	creds = pk_dbus_credentials_new (dbus, sender);
+	g_ptr_array_add (creds->tasks, task);
+	if (sender[0] == ':') {
+		g_hash_table_insert (priv->credentials,
+				     creds->sender,
+				     pk_dbus_credentials_ref (creds));
+	}
+
+	/* the reply uses the object, so keep it around until then */
+	g_object_ref (dbus);
+	g_dbus_connection_call (priv->connection,
+				"org.freedesktop.DBus",
+				"/org/freedesktop/DBus",
+				"org.freedesktop.DBus",
+				"GetConnectionCredentials",
+				g_variant_new ("(s)", sender),
+				G_VARIANT_TYPE ("(a{sv})"),
+				G_DBUS_CALL_FLAGS_NONE,
+				2000,
+				NULL,
+				pk_dbus_get_connection_credentials_cb,
+				creds);
 }
 
 /**
- * pk_dbus_get_cmdline:
+ * pk_dbus_get_credentials_finish:
  * @dbus: the #PkDbus instance
- * @sender: the sender, usually got from dbus_g_method_get_dbus()
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
  *
- * Gets the command line for the ID.
+ * Gets the result of pk_dbus_get_credentials_async().
  *
- * Return value: the cmdline, or %NULL if it could not be obtained
+ * Return value: %TRUE if the credentials of the caller are now cached
  **/
-gchar *
-pk_dbus_get_cmdline (PkDbus *dbus, const gchar *sender)
+gboolean
+pk_dbus_get_credentials_finish (PkDbus *dbus, GAsyncResult *res, GError **error)
 {
-	gboolean ret;
-	gchar *cmdline = NULL;
-	guint pid;
-	g_autoptr(GError) error = NULL;
-	g_autofree gchar *filename = NULL;
+	g_return_val_if_fail (PK_IS_DBUS (dbus), FALSE);
+	g_return_val_if_fail (g_task_is_valid (res, dbus), FALSE);
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
 
-	g_return_val_if_fail (PK_IS_DBUS (dbus), NULL);
-	g_return_val_if_fail (sender != NULL, NULL);
+/**
+ * pk_dbus_get_credentials:
+ *
+ * Gets the cached credentials of the sender, asking the bus synchronously
+ * if nobody has looked them up yet.
+ *
+ * Return value: the credentials, or %NULL if they could not be obtained
+ **/
+static PkDbusCredentials *
+pk_dbus_get_credentials (PkDbus *dbus, const gchar *sender)
+{
+	PkDbusCredentials *creds;
+	PkDbusPrivate *priv = dbus->priv;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
 
 	/* set in the test suite */
-	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0) {
-		g_debug ("using self-check shortcut");
-		return g_strdup ("/usr/sbin/packagekit");
-	}
+	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0)
+		return pk_dbus_credentials_new_self_check (dbus, sender);
+
+	/* no connection to DBus */
+	if (priv->connection == NULL)
+		return NULL;
 
-	/* get pid */
-	pid = pk_dbus_get_pid (dbus, sender);
-	if (pid == G_MAXUINT) {
-		g_warning ("failed to get PID");
+	/* already looked up */
+	creds = g_hash_table_lookup (priv->credentials, sender);
+	if (creds != NULL && creds->done)
+		return pk_dbus_credentials_ref (creds);
+
+	value = g_dbus_connection_call_sync (priv->connection,
+					     "org.freedesktop.DBus",
+					     "/org/freedesktop/DBus",
+					     "org.freedesktop.DBus",
+					     "GetConnectionCredentials",
+					     g_variant_new ("(s)", sender),
+					     G_VARIANT_TYPE ("(a{sv})"),
+					     G_DBUS_CALL_FLAGS_NONE,
+					     2000,
+					     NULL,
+					     &error);
+	if (value == NULL) {
+		g_warning ("Failed to get credentials for %s: %s",
+			   sender, error->message);
 		return NULL;
 	}
+	creds = pk_dbus_credentials_new (dbus, sender);
+	pk_dbus_credentials_set_reply (creds, value);
 
-	/* get command line from proc */
-	filename = g_strdup_printf ("/proc/%i/cmdline", pid);
-	ret = g_file_get_contents (filename, &cmdline, NULL, &error);
-	if (!ret)
-		g_warning ("failed to get cmdline: %s", error->message);
-	return cmdline;
+#ifndef HAVE_SYSTEMD
+	/* get session from ConsoleKit */
+	if (creds->pid != G_MAXUINT && priv->proxy_session != NULL) {
+		g_autoptr(GVariant) session = NULL;
+		session = g_dbus_proxy_call_sync (priv->proxy_session,
+						  "GetSessionForUnixProcess",
+						  g_variant_new ("(u)",
+								 creds->pid),
+						  G_DBUS_CALL_FLAGS_NONE,
+						  2000,
+						  NULL,
+						  &error);
+		if (session == NULL) {
+			g_warning ("Failed to get session for %s: %s",
+				   sender, error->message);
+		} else {
+			g_variant_get (session, "(o)", &creds->session);
+		}
+	} else {
+		g_warning ("no ConsoleKit, so cannot get session");
+	}
+#endif
+	creds->done = TRUE;
+
+	/* leave a running async lookup alone */
+	if (sender[0] == ':' &&
+	    !g_hash_table_contains (priv->credentials, sender)) {
+		g_hash_table_insert (priv->credentials,
+				     creds->sender,
+				     pk_dbus_credentials_ref (creds));
+	}
+	return creds;
 }
 
-#ifdef HAVE_SYSTEMD
-static gchar *
-pk_dbus_make_logind_session_id (const gchar *session)
+/**
+ * pk_dbus_get_uid:
+ * @dbus: the #PkDbus instance
+ * @sender: the sender
+ *
+ * Gets the process UID.
+ *
+ * Return value: the UID, or %G_MAXUINT if it could not be obtained
+ **/
+guint
+pk_dbus_get_uid (PkDbus *dbus, const gchar *sender)
 {
-	g_assert (session != NULL);
-	return g_strdup_printf ("/org/freedesktop/logind/session-%s", session);
+	g_autoptr(PkDbusCredentials) creds = NULL;
+
+	g_return_val_if_fail (PK_IS_DBUS (dbus), G_MAXUINT);
+	g_return_val_if_fail (sender != NULL, G_MAXUINT);
+
+	creds = pk_dbus_get_credentials (dbus, sender);
+	if (creds == NULL)
+		return G_MAXUINT;
+	return creds->uid;
 }
 
 /**
- * pk_dbus_get_session_systemd:
+ * pk_dbus_get_cmdline:
+ * @dbus: the #PkDbus instance
+ * @sender: the sender, usually got from dbus_g_method_get_dbus()
+ *
+ * Gets the command line for the ID.
+ *
+ * Return value: the cmdline, or %NULL if it could not be obtained
  **/
-static gchar *
-pk_dbus_get_session_systemd (guint pid)
+gchar *
+pk_dbus_get_cmdline (PkDbus *dbus, const gchar *sender)
 {
-	g_autofree gchar *session_id = NULL;
-	uid_t uid;
+	g_autoptr(PkDbusCredentials) creds = NULL;
 
-	/* do process -> pid -> same session */
-	if (sd_pid_get_session (pid, &session_id) >= 0)
-		return pk_dbus_make_logind_session_id (session_id);
+	g_return_val_if_fail (PK_IS_DBUS (dbus), NULL);
+	g_return_val_if_fail (sender != NULL, NULL);
 
-	/* do process -> uid -> graphical session */
-	if (sd_pid_get_owner_uid (pid, &uid) < 0)
+	creds = pk_dbus_get_credentials (dbus, sender);
+	if (creds == NULL)
 		return NULL;
-	if (sd_uid_get_display (uid, &session_id) >= 0)
-		return pk_dbus_make_logind_session_id (session_id);
-
-	return NULL;
+	return g_strdup (creds->cmdline);
 }
-#endif
 
 /**
  * pk_dbus_get_session:
@@ -220,60 +541,38 @@ pk_dbus_get_session_systemd (guint pid)
 gchar *
 pk_dbus_get_session (PkDbus *dbus, const gchar *sender)
 {
-	gchar *session = NULL;
-#ifndef HAVE_SYSTEMD
-	g_autoptr(GError) error = NULL;
-#endif
-	guint pid;
-	g_autoptr(GVariant) value = NULL;
+	g_autoptr(PkDbusCredentials) creds = NULL;
 
 	g_return_val_if_fail (PK_IS_DBUS (dbus), NULL);
 	g_return_val_if_fail (sender != NULL, NULL);
 
-	/* set in the test suite */
-	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0) {
-		g_debug ("using self-check shortcut");
-		session = g_strdup ("xxx");
-		goto out;
-	}
-
-	/* no ConsoleKit? */
-	if (dbus->priv->proxy_session == NULL) {
-		g_warning ("no ConsoleKit, so cannot get session");
-		goto out;
-	}
-
-	/* get pid */
-	pid = pk_dbus_get_pid (dbus, sender);
-	if (pid == G_MAXUINT) {
-		g_warning ("failed to get PID");
-		goto out;
-	}
+	creds = pk_dbus_get_credentials (dbus, sender);
+	if (creds == NULL)
+		return NULL;
+	return g_strdup (creds->session);
+}
 
-	/* get session from systemd or ConsoleKit */
-#ifdef HAVE_SYSTEMD
-	session = pk_dbus_get_session_systemd (pid);
-	if (session == NULL)
-		g_warning ("failed to get session for pid %u", pid);
-#else
-	/* get session from ConsoleKit */
-	value = g_dbus_proxy_call_sync (dbus->priv->proxy_session,
-					"GetSessionForUnixProcess",
-					g_variant_new ("(u)",
-						       pid),
-					G_DBUS_CALL_FLAGS_NONE,
-					2000,
-					NULL,
-					&error);
-	if (value == NULL) {
-		g_warning ("Failed to get session for %s: %s",
-			   sender, error->message);
-		goto out;
-	}
-	g_variant_get (value, "(o)", &session);
-#endif
-out:
-	return session;
+/**
+ * pk_dbus_name_owner_changed_cb:
+ **/
+static void
+pk_dbus_name_owner_changed_cb (GDBusConnection *connection,
+			       const gchar *sender_name,
+			       const gchar *object_path,
+			       const gchar *interface_name,
+			       const gchar *signal_name,
+			       GVariant *parameters,
+			       gpointer user_data)
+{
+	PkDbus *dbus = PK_DBUS (user_data);
+	const gchar *name;
+	const gchar *old_owner;
+	const gchar *new_owner;
+
+	/* unique names are never reused, so forget them once they are gone */
+	g_variant_get (parameters, "(&s&s&s)", &name, &old_owner, &new_owner);
+	if (new_owner[0] == '\0')
+		g_hash_table_remove (dbus->priv->credentials, name);
 }
 
 /**
@@ -288,10 +587,15 @@ pk_dbus_finalize (GObject *object)
 	g_return_if_fail (PK_IS_DBUS (object));
 	dbus = PK_DBUS (object);
 
-	g_object_unref (dbus->priv->proxy_pid);
-	g_object_unref (dbus->priv->proxy_uid);
+	if (dbus->priv->owner_changed_id != 0) {
+		g_dbus_connection_signal_unsubscribe (dbus->priv->connection,
+						      dbus->priv->owner_changed_id);
+	}
 	if (dbus->priv->proxy_session != NULL)
 		g_object_unref (dbus->priv->proxy_session);
+	if (dbus->priv->connection != NULL)
+		g_object_unref (dbus->priv->connection);
+	g_hash_table_unref (dbus->priv->credentials);
 
 	G_OBJECT_CLASS (pk_dbus_parent_class)->finalize (object);
 }
@@ -320,6 +624,8 @@ pk_dbus_init (PkDbus *dbus)
 {
 	g_autoptr(GError) error = NULL;
 	dbus->priv = PK_DBUS_GET_PRIVATE (dbus);
+	dbus->priv->credentials = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+							 (GDestroyNotify) pk_dbus_credentials_unref);
 
 	/* use the bus to get the uid */
 	dbus->priv->connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM,
@@ -329,38 +635,20 @@ pk_dbus_init (PkDbus *dbus)
 		return;
 	}
 
-	/* connect to DBus so we can get the pid */
-	dbus->priv->proxy_pid =
-		g_dbus_proxy_new_sync (dbus->priv->connection,
-				       G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
-				       G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
-				       NULL,
-				       "org.freedesktop.DBus",
-				       "/org/freedesktop/DBus/Bus",
-				       "org.freedesktop.DBus",
-				       NULL,
-				       &error);
-	if (dbus->priv->proxy_pid == NULL) {
-		g_warning ("cannot connect to DBus: %s", error->message);
-		return;
-	}
-
-	/* connect to DBus so we can get the uid */
-	dbus->priv->proxy_uid =
-		g_dbus_proxy_new_sync (dbus->priv->connection,
-				       G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
-				       G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
-				       NULL,
-				       "org.freedesktop.DBus",
-				       "/org/freedesktop/DBus",
-				       "org.freedesktop.DBus",
-				       NULL,
-				       &error);
-	if (dbus->priv->proxy_uid == NULL) {
-		g_warning ("cannot connect to DBus: %s", error->message);
-		return;
-	}
+	/* forget the credentials of callers that went away */
+	dbus->priv->owner_changed_id =
+		g_dbus_connection_signal_subscribe (dbus->priv->connection,
+						    "org.freedesktop.DBus",
+						    "org.freedesktop.DBus",
+						    "NameOwnerChanged",
+						    "/org/freedesktop/DBus",
+						    NULL,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_dbus_name_owner_changed_cb,
+						    dbus,
+						    NULL);
 
+#ifndef HAVE_SYSTEMD
 	/* use ConsoleKit to get the session */
 	dbus->priv->proxy_session =
 		g_dbus_proxy_new_sync (dbus->priv->connection,
@@ -376,6 +664,7 @@ pk_dbus_init (PkDbus *dbus)
 		g_warning ("cannot connect to DBus: %s", error->message);
 		return;
 	}
+#endif
 }
 
 /**
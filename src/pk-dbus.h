@@ -22,7 +22,7 @@
 #ifndef __PK_DBUS_H
 #define __PK_DBUS_H
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -59,6 +59,14 @@ gchar		*pk_dbus_get_cmdline		(PkDbus		*dbus,
 						 const gchar	*sender);
 gchar		*pk_dbus_get_session		(PkDbus		*dbus,
 						 const gchar	*sender);
+void		 pk_dbus_get_credentials_async	(PkDbus		*dbus,
+						 const gchar	*sender,
+						 GCancellable	*cancellable,
+						 GAsyncReadyCallback callback,
+						 gpointer	 user_data);
+gboolean	 pk_dbus_get_credentials_finish	(PkDbus		*dbus,
+						 GAsyncResult	*res,
+						 GError		**error);
 
 G_END_DECLS
 
@@ -22,6 +22,7 @@
 #include "config.h"
 
 #include <locale.h>
+#include <sys/resource.h>
 #include <glib.h>
 #include <glib-unix.h>
 #include <glib/gi18n.h>
@@ -44,6 +45,7 @@ typedef struct {
 	PkBackend		*backend;
 	PkBackendJob		*job;
 	gboolean		 value_only;
+	guint			 results;
 } PkDirectPrivate;
 
 typedef gboolean (*PkDirectCommandCb)	(PkDirectPrivate	*util,
@@ -353,6 +355,136 @@ pk_direct_repo_set_data (PkDirectPrivate *priv, gchar **values, GError **error)
 	return TRUE;
 }
 
+/**
+ * pk_direct_benchmark_result_cb:
+ **/
+static void
+pk_direct_benchmark_result_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkDirectPrivate *priv = (PkDirectPrivate *) user_data;
+	priv->results++;
+}
+
+/**
+ * pk_direct_get_cpu_time:
+ *
+ * Return value: the user and system time of this process in microseconds
+ **/
+static guint64
+pk_direct_get_cpu_time (struct rusage *usage)
+{
+	getrusage (RUSAGE_SELF, usage);
+	return (guint64) (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * G_USEC_PER_SEC +
+		usage->ru_utime.tv_usec + usage->ru_stime.tv_usec;
+}
+
+/**
+ * pk_direct_benchmark_get_values:
+ *
+ * Every tenth package of the synthetic repository of the dummy backend,
+ * so that the same values are valid for all repository sizes.
+ **/
+static gchar **
+pk_direct_benchmark_get_values (gboolean package_ids)
+{
+	gchar **values;
+	guint i;
+
+	values = g_new0 (gchar *, 101);
+	for (i = 0; i < 100; i++) {
+		if (package_ids) {
+			values[i] = g_strdup_printf ("synthetic%06u;1.0-1;x86_64;synthetic",
+						     i * 10);
+		} else {
+			values[i] = g_strdup_printf ("synthetic%06u", i * 10);
+		}
+	}
+	return values;
+}
+
+/**
+ * pk_direct_benchmark:
+ **/
+static gboolean
+pk_direct_benchmark (PkDirectPrivate *priv, gchar **values, GError **error)
+{
+	gint64 wall_time;
+	guint64 cpu_time;
+	PkRoleEnum role;
+	struct rusage usage;
+	const gchar *search[] = { "synthetic00", NULL };
+	g_auto(GStrv) names = NULL;
+	g_auto(GStrv) package_ids = NULL;
+
+	if (g_strv_length (values) < 1) {
+		g_set_error_literal (error,
+				     PK_ERROR,
+				     PK_ERROR_INVALID_ARGUMENTS,
+				     "Not enough arguments, expected: <role>");
+		return FALSE;
+	}
+	role = pk_role_enum_from_string (values[0]);
+	if (role != PK_ROLE_ENUM_GET_PACKAGES &&
+	    role != PK_ROLE_ENUM_SEARCH_NAME &&
+	    role != PK_ROLE_ENUM_RESOLVE &&
+	    role != PK_ROLE_ENUM_GET_FILES &&
+	    role != PK_ROLE_ENUM_GET_UPDATES) {
+		g_set_error (error,
+			     PK_ERROR,
+			     PK_ERROR_INVALID_ARGUMENTS,
+			     "Cannot benchmark %s, expected: get-packages, "
+			     "search-name, resolve, get-files or get-updates",
+			     values[0]);
+		return FALSE;
+	}
+	names = pk_direct_benchmark_get_values (FALSE);
+	package_ids = pk_direct_benchmark_get_values (TRUE);
+
+	/* only count what the backend finds */
+	pk_backend_job_set_vfunc (priv->job, PK_BACKEND_SIGNAL_PERCENTAGE,
+				  NULL, NULL);
+	pk_backend_job_set_vfunc (priv->job, PK_BACKEND_SIGNAL_STATUS_CHANGED,
+				  NULL, NULL);
+	pk_backend_job_set_vfunc (priv->job, PK_BACKEND_SIGNAL_PACKAGE,
+				  pk_direct_benchmark_result_cb, priv);
+	pk_backend_job_set_vfunc (priv->job, PK_BACKEND_SIGNAL_FILES,
+				  pk_direct_benchmark_result_cb, priv);
+
+	cpu_time = pk_direct_get_cpu_time (&usage);
+	wall_time = g_get_monotonic_time ();
+
+	pk_backend_start_job (priv->backend, priv->job);
+	switch (role) {
+	case PK_ROLE_ENUM_GET_PACKAGES:
+		pk_backend_get_packages (priv->backend, priv->job, 0);
+		break;
+	case PK_ROLE_ENUM_SEARCH_NAME:
+		pk_backend_search_names (priv->backend, priv->job, 0, (gchar **) search);
+		break;
+	case PK_ROLE_ENUM_RESOLVE:
+		pk_backend_resolve (priv->backend, priv->job, 0, names);
+		break;
+	case PK_ROLE_ENUM_GET_FILES:
+		pk_backend_get_files (priv->backend, priv->job, package_ids);
+		break;
+	default:
+		pk_backend_get_updates (priv->backend, priv->job, 0);
+		break;
+	}
+	g_main_loop_run (priv->loop);
+	pk_backend_stop_job (priv->backend, priv->job);
+
+	wall_time = g_get_monotonic_time () - wall_time;
+	cpu_time = pk_direct_get_cpu_time (&usage) - cpu_time;
+	g_print ("%s\tresults=%u\twall=%.3fs\tcpu=%.3fs\tpeak-rss=%likB\n",
+		 pk_role_enum_to_string (role),
+		 priv->results,
+		 (gdouble) wall_time / G_USEC_PER_SEC,
+		 (gdouble) cpu_time / G_USEC_PER_SEC,
+		 usage.ru_maxrss);
+	return TRUE;
+}
+
 /**
  * pk_direct_sigint_cb:
  **/
@@ -455,6 +587,9 @@ main (int argc, char *argv[])
 		{ "backend", '\0', 0, G_OPTION_ARG_STRING, &backend_name,
 		  /* TRANSLATORS: a backend is the system package tool, e.g. dnf, apt */
 		  _("Packaging backend to use, e.g. dummy"), NULL },
+		{ "config", '\0', 0, G_OPTION_ARG_FILENAME, &conf_filename,
+		  /* TRANSLATORS: the file used instead of PackageKit.conf */
+		  _("Config file to use instead of the system one"), NULL },
 		{ NULL }
 	};
 
@@ -500,6 +635,10 @@ main (int argc, char *argv[])
 		       /* TRANSLATORS: command description */
 		       _("Set repository options"),
 		       pk_direct_repo_set_data);
+	pk_direct_add (priv->cmd_array, "benchmark", "[ROLE]",
+		       /* TRANSLATORS: command description */
+		       _("Measure the time and memory a query takes"),
+		       pk_direct_benchmark);
 
 	/* sort by command name */
 	g_ptr_array_sort (priv->cmd_array,
@@ -523,7 +662,8 @@ main (int argc, char *argv[])
 
 	/* get values from the config file */
 	conf = g_key_file_new ();
-	conf_filename = pk_util_get_config_filename ();
+	if (conf_filename == NULL)
+		conf_filename = pk_util_get_config_filename ();
 	ret = g_key_file_load_from_file (conf, conf_filename,
 					 G_KEY_FILE_NONE, &error);
 	if (!ret) {
@@ -43,6 +43,7 @@
 #include <packagekit-glib2/pk-version.h>
 #include <polkit/polkit.h>
 
+#include "pk-auth-cache.h"
 #include "pk-backend.h"
 #include "pk-dbus.h"
 #include "pk-engine.h"
@@ -93,6 +94,7 @@ struct PkEnginePrivate
 	guint			 timeout_priority_id;
 	guint			 timeout_normal_id;
 	PolkitAuthority		*authority;
+	PkAuthCache		*auth_cache;
 	gboolean		 locked;
 	PkNetworkEnum		 network_state;
 	guint			 owner_id;
@@ -552,11 +554,28 @@ typedef struct {
 	gchar			*value6;
 } PkEngineDbusState;
 
+/**
+ * pk_engine_dbus_state_free:
+ **/
+static void
+pk_engine_dbus_state_free (PkEngineDbusState *state)
+{
+	g_object_unref (state->engine);
+	g_free (state->sender);
+	g_free (state->value1);
+	g_free (state->value2);
+	g_free (state->value3);
+	g_free (state->value4);
+	g_free (state->value5);
+	g_free (state->value6);
+	g_free (state);
+}
+
 /**
  * pk_engine_action_obtain_authorization:
  **/
 static void
-pk_engine_action_obtain_proxy_authorization_finished_cb (PolkitAuthority *authority,
+pk_engine_action_obtain_proxy_authorization_finished_cb (PkAuthCache *auth_cache,
 							 GAsyncResult *res,
 							 PkEngineDbusState *state)
 {
@@ -567,7 +586,7 @@ pk_engine_action_obtain_proxy_authorization_finished_cb (PolkitAuthority *author
 	g_autoptr(PolkitAuthorizationResult) result = NULL;
 
 	/* finish the call */
-	result = polkit_authority_check_authorization_finish (priv->authority, res, &error_local);
+	result = pk_auth_cache_check_finish (priv->auth_cache, res, &error_local);
 
 	/* failed */
 	if (result == NULL) {
@@ -618,15 +637,7 @@ pk_engine_action_obtain_proxy_authorization_finished_cb (PolkitAuthority *author
 	g_dbus_method_invocation_return_value (state->context, NULL);
 out:
 	/* unref state, we're done */
-	g_object_unref (state->engine);
-	g_free (state->sender);
-	g_free (state->value1);
-	g_free (state->value2);
-	g_free (state->value3);
-	g_free (state->value4);
-	g_free (state->value5);
-	g_free (state->value6);
-	g_free (state);
+	pk_engine_dbus_state_free (state);
 }
 
 /**
@@ -689,6 +700,50 @@ pk_engine_is_proxy_unchanged (PkEngine *engine, const gchar *sender,
 	return TRUE;
 }
 
+/**
+ * pk_engine_set_proxy_credentials_cb:
+ **/
+static void
+pk_engine_set_proxy_credentials_cb (GObject *source,
+				    GAsyncResult *res,
+				    gpointer user_data)
+{
+	PkEngineDbusState *state = (PkEngineDbusState *) user_data;
+	PkEnginePrivate *priv = state->engine->priv;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PolkitSubject) subject = NULL;
+
+	/* the checks below report a failed lookup themselves */
+	if (!pk_dbus_get_credentials_finish (priv->dbus, res, &error))
+		g_warning ("failed to look up %s: %s", state->sender, error->message);
+
+	/* is exactly the same proxy? */
+	if (pk_engine_is_proxy_unchanged (state->engine, state->sender,
+					  state->value1,
+					  state->value2,
+					  state->value3,
+					  state->value4,
+					  state->value5,
+					  state->value6)) {
+		g_debug ("not changing proxy as the same as before");
+		g_dbus_method_invocation_return_value (state->context, NULL);
+		pk_engine_dbus_state_free (state);
+		return;
+	}
+
+	/* check subject */
+	subject = polkit_system_bus_name_new (state->sender);
+
+	/* do authorization async */
+	pk_auth_cache_check_async (priv->auth_cache, subject,
+				   "org.freedesktop.packagekit.system-network-proxy-configure",
+				   NULL,
+				   POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
+				   NULL,
+				   (GAsyncReadyCallback) pk_engine_action_obtain_proxy_authorization_finished_cb,
+				   state);
+}
+
 /**
  * pk_engine_set_proxy:
  **/
@@ -704,10 +759,8 @@ pk_engine_set_proxy (PkEngine *engine,
 {
 	guint len;
 	GError *error = NULL;
-	gboolean ret;
 	const gchar *sender;
 	PkEngineDbusState *state;
-	g_autoptr(PolkitSubject) subject = NULL;
 
 	g_return_if_fail (PK_IS_ENGINE (engine));
 
@@ -742,23 +795,6 @@ pk_engine_set_proxy (PkEngine *engine,
 	/* save sender */
 	sender = g_dbus_method_invocation_get_sender (context);
 
-	/* is exactly the same proxy? */
-	ret = pk_engine_is_proxy_unchanged (engine, sender,
-					    proxy_http,
-					    proxy_https,
-					    proxy_ftp,
-					    proxy_socks,
-					    no_proxy,
-					    pac);
-	if (ret) {
-		g_debug ("not changing proxy as the same as before");
-		g_dbus_method_invocation_return_value (context, NULL);
-		goto out;
-	}
-
-	/* check subject */
-	subject = polkit_system_bus_name_new (sender);
-
 	/* cache state */
 	state = g_new0 (PkEngineDbusState, 1);
 	state->context = context;
@@ -771,14 +807,10 @@ pk_engine_set_proxy (PkEngine *engine,
 	state->value5 = g_strdup (no_proxy);
 	state->value6 = g_strdup (pac);
 
-	/* do authorization async */
-	polkit_authority_check_authorization (engine->priv->authority, subject,
-					      "org.freedesktop.packagekit.system-network-proxy-configure",
-					      NULL,
-					      POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
-					      NULL,
-					      (GAsyncReadyCallback) pk_engine_action_obtain_proxy_authorization_finished_cb,
-					      state);
+	/* the uid and session are needed before anything else */
+	pk_dbus_get_credentials_async (engine->priv->dbus, sender, NULL,
+				       pk_engine_set_proxy_credentials_cb,
+				       state);
 
 	/* reset the timer */
 	pk_engine_reset_timer (engine);
@@ -787,41 +819,38 @@ out:
 }
 
 /**
- * pk_engine_can_authorize:
+ * pk_engine_can_authorize_cb:
  **/
-static PkAuthorizeEnum
-pk_engine_can_authorize_action_id (PkEngine *engine,
-				   const gchar *action_id,
-				   const gchar *sender,
-				   GError **error)
+static void
+pk_engine_can_authorize_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 {
-	g_autoptr(PolkitAuthorizationResult) res = NULL;
-	g_autoptr(PolkitSubject) subject = NULL;
+	GDBusMethodInvocation *invocation = G_DBUS_METHOD_INVOCATION (user_data);
+	PkAuthorizeEnum result_enum;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PolkitAuthorizationResult) result = NULL;
 
-	/* check subject */
-	subject = polkit_system_bus_name_new (sender);
+	result = pk_auth_cache_check_finish (PK_AUTH_CACHE (source), res, &error);
+	if (result == NULL) {
+		g_dbus_method_invocation_return_error (invocation,
+						       PK_ENGINE_ERROR,
+						       PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
+						       "failed to check authorisation: %s",
+						       error->message);
+		return;
+	}
 
-	/* check authorization (okay being sync as there's no blocking on the user) */
-	res = polkit_authority_check_authorization_sync (engine->priv->authority,
-							 subject,
-							 action_id,
-							 NULL,
-							 POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE,
-							 NULL,
-							 error);
-	if (res == NULL)
-		return PK_AUTHORIZE_ENUM_UNKNOWN;
-
-	/* already yes */
-	if (polkit_authorization_result_get_is_authorized (res))
-		return PK_AUTHORIZE_ENUM_YES;
-
-	/* could be yes with user input */
-	if (polkit_authorization_result_get_is_challenge (res))
-		return PK_AUTHORIZE_ENUM_INTERACTIVE;
-
-	/* fall back to not letting user authenticate */
-	return PK_AUTHORIZE_ENUM_NO;
+	if (polkit_authorization_result_get_is_authorized (result)) {
+		/* already yes */
+		result_enum = PK_AUTHORIZE_ENUM_YES;
+	} else if (polkit_authorization_result_get_is_challenge (result)) {
+		/* could be yes with user input */
+		result_enum = PK_AUTHORIZE_ENUM_INTERACTIVE;
+	} else {
+		/* fall back to not letting user authenticate */
+		result_enum = PK_AUTHORIZE_ENUM_NO;
+	}
+	g_dbus_method_invocation_return_value (invocation,
+					       g_variant_new ("(u)", result_enum));
 }
 
 /**
@@ -1189,29 +1218,16 @@ pk_engine_daemon_get_property (GDBusConnection *connection_, const gchar *sender
 	return NULL;
 }
 
-/**
- * pk_engine_package_name_in_strv:
- **/
-static gboolean
-pk_engine_package_name_in_strv (gchar **strv, PkPackage *pkg)
-{
-	guint i;
-	for (i = 0; strv[i] != NULL; i++) {
-		if (g_strcmp0 (strv[i], pk_package_get_name (pkg)) == 0)
-			return TRUE;
-	}
-	return FALSE;
-}
-
 /**
  * pk_engine_get_package_history_pkg:
  *
  * Create a 'a{sv}' GVariant instance from all the PkTransactionPast data
  **/
 static GVariant *
-pk_engine_get_package_history_pkg (PkTransactionPast *item, PkPackage *pkg)
+pk_engine_get_package_history_pkg (PkTransactionDbHistoryItem *item)
 {
 	GVariantBuilder builder;
+	PkPackage *pkg = item->package;
 	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
 	g_variant_builder_add (&builder, "{sv}", "info",
 			       g_variant_new_uint32 (pk_package_get_info (pkg)));
@@ -1220,9 +1236,9 @@ pk_engine_get_package_history_pkg (PkTransactionPast *item, PkPackage *pkg)
 	g_variant_builder_add (&builder, "{sv}", "version",
 			       g_variant_new_string (pk_package_get_version (pkg)));
 	g_variant_builder_add (&builder, "{sv}", "timestamp",
-			       g_variant_new_uint64 (pk_transaction_past_get_timestamp (item)));
+			       g_variant_new_uint64 (item->timestamp));
 	g_variant_builder_add (&builder, "{sv}", "user-id",
-			       g_variant_new_uint32 (pk_transaction_past_get_uid (item)));
+			       g_variant_new_uint32 (item->uid));
 	return g_variant_builder_end (&builder);
 }
 
@@ -1256,24 +1272,23 @@ pk_engine_get_package_history (PkEngine *engine,
 			       guint max_size,
 			       GError **error)
 {
-	const gchar *data;
 	const gchar *pkgname;
-	gboolean ret;
 	gchar *key;
-	gint64 timestamp;
 	GList *l;
-	GList *list;
 	GPtrArray *array = NULL;
 	guint i;
 	GVariantBuilder builder;
 	GVariant *value = NULL;
-	PkTransactionPast *item;
+	PkTransactionDbHistoryItem *item;
 	g_autoptr(GHashTable) deduplicate_hash = NULL;
 	g_autoptr(GHashTable) pkgname_hash = NULL;
 	g_autoptr(GList) keys = NULL;
-	g_autoptr(PkPackage) package_tmp = NULL;
+	g_autoptr(GPtrArray) history = NULL;
 
-	list = pk_transaction_db_get_list (engine->priv->transaction_db, max_size);
+	/* only the rows for these names are read, using the index */
+	history = pk_transaction_db_get_package_history (engine->priv->transaction_db,
+							 package_names,
+							 max_size);
 
 	/* simplify the loop */
 	if (max_size == 0)
@@ -1281,70 +1296,42 @@ pk_engine_get_package_history (PkEngine *engine,
 
 	pkgname_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
 	deduplicate_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-	package_tmp = pk_package_new ();
-	for (l = list; l != NULL; l = l->next) {
-		g_auto(GStrv) package_lines = NULL;
-		item = PK_TRANSACTION_PAST (l->data);
+	for (i = 0; i < history->len; i++) {
+		item = g_ptr_array_index (history, i);
+
+		/* not a state we care about */
+		if (!pk_engine_is_package_history_interesing (item->package))
+			continue;
 
-		/* ignore anything that failed */
-		if (!pk_transaction_past_get_succeeded (item))
+		/* transactions without a timestamp are not interesting */
+		if (item->timestamp == 0)
 			continue;
 
-		/* split up data */
-		data = pk_transaction_past_get_data (item);
-		if (data == NULL)
+		/* de-duplicate the entry, in the case of multiarch */
+		key = g_strdup_printf ("%s-%" G_GINT64_FORMAT,
+				       pk_package_get_name (item->package),
+				       item->timestamp);
+		if (g_hash_table_lookup (deduplicate_hash, key) != NULL) {
+			g_free (key);
 			continue;
-		package_lines = g_strsplit (data, "\n", -1);
-		for (i = 0; package_lines[i] != NULL; i++) {
-			g_autoptr(GError) error_local = NULL;
-			ret = pk_package_parse (package_tmp,
-						package_lines[i],
-						&error_local);
-			if (!ret) {
-				g_warning ("Failed to parse package: '%s': %s",
-					   package_lines[i], error_local->message);
-				continue;
-			}
-
-			/* not the package we care about */
-			if (!pk_engine_package_name_in_strv (package_names, package_tmp))
-				continue;
-
-			/* not a state we care about */
-			if (!pk_engine_is_package_history_interesing (package_tmp))
-				continue;
-
-			/* transactions without a timestamp are not interesting */
-			timestamp = pk_transaction_past_get_timestamp (item);
-			if (timestamp == 0)
-				continue;
-
-			/* de-duplicate the entry, in the case of multiarch */
-			key = g_strdup_printf ("%s-%" G_GINT64_FORMAT,
-					       pk_package_get_name (package_tmp),
-					       timestamp);
-			if (g_hash_table_lookup (deduplicate_hash, key) != NULL) {
-				g_free (key);
-				continue;
-			}
-			g_hash_table_insert (deduplicate_hash, key, package_lines[i]);
-
-			/* get the blob for this data item */
-			value = pk_engine_get_package_history_pkg (item, package_tmp);
-			if (value == NULL)
-				continue;
-
-			/* find the array */
-			pkgname = pk_package_get_name (package_tmp);
-			array = g_hash_table_lookup (pkgname_hash, pkgname);
-			if (array == NULL) {
-				array = g_ptr_array_new ();
-				g_hash_table_insert (pkgname_hash,
-						     g_strdup (pkgname),
-						     array);
-			}
-			g_ptr_array_add (array, value);
 		}
+		g_hash_table_insert (deduplicate_hash, key, item);
+
+		/* get the blob for this data item */
+		value = pk_engine_get_package_history_pkg (item);
+		if (value == NULL)
+			continue;
+
+		/* find the array */
+		pkgname = pk_package_get_name (item->package);
+		array = g_hash_table_lookup (pkgname_hash, pkgname);
+		if (array == NULL) {
+			array = g_ptr_array_new ();
+			g_hash_table_insert (pkgname_hash,
+					     g_strdup (pkgname),
+					     array);
+		}
+		g_ptr_array_add (array, value);
 	}
 
 	/* no history returns an empty array */
@@ -1368,10 +1355,99 @@ pk_engine_get_package_history (PkEngine *engine,
 	}
 	value = g_variant_builder_end (&builder);
 out:
-	g_list_free_full (list, (GDestroyNotify) g_object_unref);
 	return value;
 }
 
+typedef struct {
+	PkEngine		*engine;
+	GDBusMethodInvocation	*invocation;
+	gchar			**hints;
+} PkEngineCreateHelper;
+
+/**
+ * pk_engine_create_helper_new:
+ **/
+static PkEngineCreateHelper *
+pk_engine_create_helper_new (PkEngine *engine,
+			     GDBusMethodInvocation *invocation,
+			     gchar **hints)
+{
+	PkEngineCreateHelper *helper;
+	helper = g_new0 (PkEngineCreateHelper, 1);
+	helper->engine = g_object_ref (engine);
+	helper->invocation = g_object_ref (invocation);
+	helper->hints = g_strdupv (hints);
+	return helper;
+}
+
+/**
+ * pk_engine_create_helper_free:
+ **/
+static void
+pk_engine_create_helper_free (PkEngineCreateHelper *helper)
+{
+	g_object_unref (helper->engine);
+	g_object_unref (helper->invocation);
+	g_strfreev (helper->hints);
+	g_free (helper);
+}
+
+/**
+ * pk_engine_create_transaction_credentials_cb:
+ *
+ * The caller credentials are cached now, so creating the transaction
+ * does not have to wait on the bus.
+ **/
+static void
+pk_engine_create_transaction_credentials_cb (GObject *source,
+					     GAsyncResult *res,
+					     gpointer user_data)
+{
+	PkEngineCreateHelper *helper = (PkEngineCreateHelper *) user_data;
+	PkEnginePrivate *priv = helper->engine->priv;
+	PkTransaction *transaction;
+	const gchar *sender;
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *tid = NULL;
+
+	/* the transaction handles a missing uid like it always did */
+	sender = g_dbus_method_invocation_get_sender (helper->invocation);
+	if (!pk_dbus_get_credentials_finish (priv->dbus, res, &error)) {
+		g_warning ("failed to look up %s: %s", sender, error->message);
+		g_clear_error (&error);
+	}
+
+	tid = pk_transaction_db_generate_id (priv->transaction_db);
+	g_assert (tid != NULL);
+	if (!pk_scheduler_create (priv->scheduler, tid, sender, &error)) {
+		g_dbus_method_invocation_return_error (helper->invocation,
+						       PK_ENGINE_ERROR,
+						       PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
+						       "could not create transaction %s: %s",
+						       tid,
+						       error->message);
+		pk_engine_create_helper_free (helper);
+		return;
+	}
+
+	/* CreateTransactionWithHints() saves the client a SetHints() call */
+	if (helper->hints != NULL) {
+		transaction = pk_scheduler_get_transaction (priv->scheduler, tid);
+		if (!pk_transaction_apply_hints (transaction, helper->hints, &error)) {
+			pk_scheduler_remove (priv->scheduler, tid);
+			g_dbus_method_invocation_return_gerror (helper->invocation,
+								error);
+			pk_engine_create_helper_free (helper);
+			return;
+		}
+	}
+
+	g_debug ("sending object path: '%s'", tid);
+	g_dbus_method_invocation_return_value (helper->invocation,
+					       g_variant_new ("(o)", tid));
+	pk_engine_create_helper_free (helper);
+}
+
 /**
  * pk_engine_daemon_method_call:
  **/
@@ -1382,11 +1458,9 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 			      GDBusMethodInvocation *invocation, gpointer user_data)
 {
 	const gchar *tmp = NULL;
-	gboolean ret;
 	guint time_since;
 	GVariant *value = NULL;
 	GVariant *tuple = NULL;
-	PkAuthorizeEnum result_enum;
 	PkEngine *engine = PK_ENGINE (user_data);
 	PkRoleEnum role;
 	guint size;
@@ -1417,6 +1491,14 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 		return;
 	}
 
+	if (g_strcmp0 (method_name, "GetMetrics") == 0) {
+		PkMetrics *metrics = pk_scheduler_get_metrics (engine->priv->scheduler);
+		data = pk_metrics_to_string (metrics);
+		value = g_variant_new ("(s)", data);
+		g_dbus_method_invocation_return_value (invocation, value);
+		return;
+	}
+
 	if (g_strcmp0 (method_name, "GetPackageHistory") == 0) {
 		g_autofree gchar **package_names = NULL;
 
@@ -1446,23 +1528,20 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 	if (g_strcmp0 (method_name, "CreateTransaction") == 0) {
 
 		g_debug ("CreateTransaction method called");
-		data = pk_transaction_db_generate_id (engine->priv->transaction_db);
-		g_assert (data != NULL);
-		ret = pk_scheduler_create (engine->priv->scheduler,
-					   data, sender, &error);
-		if (!ret) {
-			g_dbus_method_invocation_return_error (invocation,
-							       PK_ENGINE_ERROR,
-							       PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
-							       "could not create transaction %s: %s",
-							       data,
-							       error->message);
-			return;
-		}
+		pk_dbus_get_credentials_async (engine->priv->dbus, sender, NULL,
+					       pk_engine_create_transaction_credentials_cb,
+					       pk_engine_create_helper_new (engine, invocation, NULL));
+		return;
+	}
 
-		g_debug ("sending object path: '%s'", data);
-		value = g_variant_new ("(o)", data);
-		g_dbus_method_invocation_return_value (invocation, value);
+	if (g_strcmp0 (method_name, "CreateTransactionWithHints") == 0) {
+		g_autofree gchar **hints = NULL;
+
+		g_variant_get (parameters, "(^a&s)", &hints);
+		g_debug ("CreateTransactionWithHints method called");
+		pk_dbus_get_credentials_async (engine->priv->dbus, sender, NULL,
+					       pk_engine_create_transaction_credentials_cb,
+					       pk_engine_create_helper_new (engine, invocation, hints));
 		return;
 	}
 
@@ -1566,25 +1645,17 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 	}
 
 	if (g_strcmp0 (method_name, "CanAuthorize") == 0) {
+		g_autoptr(PolkitSubject) subject = NULL;
 
+		/* no blocking on the user, but still no blocking on polkitd */
 		g_variant_get (parameters, "(&s)", &tmp);
-		result_enum = pk_engine_can_authorize_action_id (engine,
-								 tmp,
-								 sender,
-								 &error);
-		if (result_enum == PK_AUTHORIZE_ENUM_UNKNOWN) {
-			g_dbus_method_invocation_return_error (invocation,
-							       PK_ENGINE_ERROR,
-							       PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
-							       "failed to check authorisation %s: %s",
-							       tmp,
-							       error->message);
-			return;
-		}
-
-		/* all okay */
-		value = g_variant_new ("(u)", result_enum);
-		g_dbus_method_invocation_return_value (invocation, value);
+		subject = polkit_system_bus_name_new (sender);
+		pk_auth_cache_check_async (engine->priv->auth_cache, subject, tmp,
+					   NULL,
+					   POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE,
+					   NULL,
+					   pk_engine_can_authorize_cb,
+					   invocation);
 		return;
 	}
 }
@@ -1633,7 +1704,7 @@ pk_engine_offline_helper_cb (GObject *source, GAsyncResult *res, gpointer user_d
 	g_autoptr(PolkitAuthorizationResult) result = NULL;
 
 	/* finish the call */
-	result = polkit_authority_check_authorization_finish (POLKIT_AUTHORITY (source), res, &error);
+	result = pk_auth_cache_check_finish (PK_AUTH_CACHE (source), res, &error);
 	if (result == NULL) {
 		g_dbus_method_invocation_return_error (helper->invocation,
 						       PK_ENGINE_ERROR,
@@ -1729,13 +1800,13 @@ pk_engine_offline_method_call (GDBusConnection *connection_, const gchar *sender
 		helper->engine = g_object_ref (engine);
 		helper->role = PK_ENGINE_OFFLINE_ROLE_CANCEL;
 		helper->invocation = g_object_ref (invocation);
-		polkit_authority_check_authorization (engine->priv->authority, subject,
-						      "org.freedesktop.packagekit.trigger-offline-update",
-						      NULL,
-						      POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
-						      NULL,
-						      pk_engine_offline_helper_cb,
-						      helper);
+		pk_auth_cache_check_async (engine->priv->auth_cache, subject,
+					   "org.freedesktop.packagekit.trigger-offline-update",
+					   NULL,
+					   POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
+					   NULL,
+					   pk_engine_offline_helper_cb,
+					   helper);
 		return;
 	}
 	if (g_strcmp0 (method_name, "ClearResults") == 0) {
@@ -1743,13 +1814,13 @@ pk_engine_offline_method_call (GDBusConnection *connection_, const gchar *sender
 		helper->engine = g_object_ref (engine);
 		helper->role = PK_ENGINE_OFFLINE_ROLE_CLEAR_RESULTS;
 		helper->invocation = g_object_ref (invocation);
-		polkit_authority_check_authorization (engine->priv->authority, subject,
-						      "org.freedesktop.packagekit.clear-offline-update",
-						      NULL,
-						      POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
-						      NULL,
-						      pk_engine_offline_helper_cb,
-						      helper);
+		pk_auth_cache_check_async (engine->priv->auth_cache, subject,
+					   "org.freedesktop.packagekit.clear-offline-update",
+					   NULL,
+					   POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
+					   NULL,
+					   pk_engine_offline_helper_cb,
+					   helper);
 		return;
 	}
 	if (g_strcmp0 (method_name, "Trigger") == 0) {
@@ -1770,13 +1841,13 @@ pk_engine_offline_method_call (GDBusConnection *connection_, const gchar *sender
 		helper->role = PK_ENGINE_OFFLINE_ROLE_TRIGGER;
 		helper->invocation = g_object_ref (invocation);
 		helper->action = action;
-		polkit_authority_check_authorization (engine->priv->authority, subject,
-						      "org.freedesktop.packagekit.trigger-offline-update",
-						      NULL,
-						      POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
-						      NULL,
-						      pk_engine_offline_helper_cb,
-						      helper);
+		pk_auth_cache_check_async (engine->priv->auth_cache, subject,
+					   "org.freedesktop.packagekit.trigger-offline-update",
+					   NULL,
+					   POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
+					   NULL,
+					   pk_engine_offline_helper_cb,
+					   helper);
 		return;
 	}
 	if (g_strcmp0 (method_name, "TriggerUpgrade") == 0) {
@@ -1797,13 +1868,13 @@ pk_engine_offline_method_call (GDBusConnection *connection_, const gchar *sender
 		helper->role = PK_ENGINE_OFFLINE_ROLE_TRIGGER_UPGRADE;
 		helper->invocation = g_object_ref (invocation);
 		helper->action = action;
-		polkit_authority_check_authorization (engine->priv->authority, subject,
-						      "org.freedesktop.packagekit.trigger-offline-upgrade",
-						      NULL,
-						      POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
-						      NULL,
-						      pk_engine_offline_helper_cb,
-						      helper);
+		pk_auth_cache_check_async (engine->priv->auth_cache, subject,
+					   "org.freedesktop.packagekit.trigger-offline-upgrade",
+					   NULL,
+					   POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
+					   NULL,
+					   pk_engine_offline_helper_cb,
+					   helper);
 		return;
 	}
 	if (g_strcmp0 (method_name, "GetPrepared") == 0) {
@@ -1871,6 +1942,15 @@ pk_engine_on_bus_acquired_cb (GDBusConnection *connection,
 	/* save copy for emitting signals */
 	engine->priv->connection = g_object_ref (connection);
 
+	/* transactions use the same handles as the engine */
+	engine->priv->auth_cache = pk_auth_cache_new (engine->priv->authority,
+						      connection);
+	pk_scheduler_set_services (engine->priv->scheduler,
+				   connection,
+				   engine->priv->dbus,
+				   engine->priv->auth_cache,
+				   engine->priv->transaction_db);
+
 #ifdef HAVE_SYSTEMD
 	/* connect to logind */
 	g_dbus_proxy_new (connection,
@@ -2046,6 +2126,8 @@ pk_engine_finalize (GObject *object)
 	g_object_unref (engine->priv->monitor_offline_upgrade);
 	g_object_unref (engine->priv->scheduler);
 	g_object_unref (engine->priv->transaction_db);
+	if (engine->priv->auth_cache != NULL)
+		g_object_unref (engine->priv->auth_cache);
 	if (engine->priv->authority != NULL)
 		g_object_unref (engine->priv->authority);
 	g_object_unref (engine->priv->backend);
@@ -0,0 +1,276 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "pk-metrics.h"
+
+#define PK_METRICS_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_METRICS, PkMetricsPrivate))
+
+/* upper bounds, the last bucket has no bound */
+static const gdouble pk_metrics_time_bounds[] = {
+	0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 300 };
+static const gdouble pk_metrics_size_bounds[] = {
+	0, 1, 10, 100, 1000, 10000, 100000 };
+
+#define PK_METRICS_MAX_BUCKETS		16
+
+typedef struct {
+	guint64			 buckets[PK_METRICS_MAX_BUCKETS];
+	guint64			 count;
+	gdouble			 sum;
+} PkMetricsHistogram;
+
+typedef struct {
+	PkMetricsHistogram	 queue_wait;	/* s */
+	PkMetricsHistogram	 runtime;	/* s */
+	PkMetricsHistogram	 results;	/* items */
+	guint64			 signals;
+} PkMetricsRole;
+
+struct PkMetricsPrivate
+{
+	PkMetricsRole		 roles[PK_ROLE_ENUM_LAST];
+};
+
+G_DEFINE_TYPE (PkMetrics, pk_metrics, G_TYPE_OBJECT)
+
+/**
+ * pk_metrics_histogram_add:
+ **/
+static void
+pk_metrics_histogram_add (PkMetricsHistogram *hist,
+			  const gdouble *bounds,
+			  guint n_bounds,
+			  gdouble value)
+{
+	guint i;
+
+	for (i = 0; i < n_bounds; i++) {
+		if (value <= bounds[i])
+			break;
+	}
+	hist->buckets[i]++;
+	hist->count++;
+	hist->sum += value;
+}
+
+/**
+ * pk_metrics_add_transaction:
+ * @metrics: a #PkMetrics
+ * @role: the role of the finished transaction
+ * @queue_wait_ms: the time spent waiting for other transactions
+ * @runtime_ms: the time the backend was running
+ * @signal_count: the number of signals sent to the client
+ * @results_size: the number of packages, details and so on found
+ *
+ * Records one finished transaction.
+ **/
+void
+pk_metrics_add_transaction (PkMetrics *metrics,
+			    PkRoleEnum role,
+			    guint queue_wait_ms,
+			    guint runtime_ms,
+			    guint signal_count,
+			    guint results_size)
+{
+	PkMetricsRole *item;
+
+	g_return_if_fail (PK_IS_METRICS (metrics));
+	g_return_if_fail (role < PK_ROLE_ENUM_LAST);
+
+	item = &metrics->priv->roles[role];
+	pk_metrics_histogram_add (&item->queue_wait,
+				  pk_metrics_time_bounds,
+				  G_N_ELEMENTS (pk_metrics_time_bounds),
+				  queue_wait_ms / 1000.0);
+	pk_metrics_histogram_add (&item->runtime,
+				  pk_metrics_time_bounds,
+				  G_N_ELEMENTS (pk_metrics_time_bounds),
+				  runtime_ms / 1000.0);
+	pk_metrics_histogram_add (&item->results,
+				  pk_metrics_size_bounds,
+				  G_N_ELEMENTS (pk_metrics_size_bounds),
+				  results_size);
+	item->signals += signal_count;
+}
+
+/**
+ * pk_metrics_histogram_to_string:
+ *
+ * The buckets are cumulative in the text format.
+ **/
+static void
+pk_metrics_histogram_to_string (GString *str,
+				const gchar *name,
+				const gchar *role,
+				const PkMetricsHistogram *hist,
+				const gdouble *bounds,
+				guint n_bounds)
+{
+	gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+	guint64 total = 0;
+	guint i;
+
+	for (i = 0; i < n_bounds; i++) {
+		total += hist->buckets[i];
+		g_ascii_formatd (buf, sizeof (buf), "%g", bounds[i]);
+		g_string_append_printf (str, "%s_bucket{role=\"%s\",le=\"%s\"} %" G_GUINT64_FORMAT "\n",
+					name, role, buf, total);
+	}
+	g_string_append_printf (str, "%s_bucket{role=\"%s\",le=\"+Inf\"} %" G_GUINT64_FORMAT "\n",
+				name, role, hist->count);
+	g_ascii_formatd (buf, sizeof (buf), "%.3f", hist->sum);
+	g_string_append_printf (str, "%s_sum{role=\"%s\"} %s\n", name, role, buf);
+	g_string_append_printf (str, "%s_count{role=\"%s\"} %" G_GUINT64_FORMAT "\n",
+				name, role, hist->count);
+}
+
+/**
+ * pk_metrics_histograms_to_string:
+ **/
+static void
+pk_metrics_histograms_to_string (GString *str,
+				 PkMetrics *metrics,
+				 const gchar *name,
+				 const gchar *help,
+				 glong offset,
+				 const gdouble *bounds,
+				 guint n_bounds)
+{
+	PkMetricsRole *item;
+	guint i;
+
+	g_string_append_printf (str, "# HELP %s %s\n", name, help);
+	g_string_append_printf (str, "# TYPE %s histogram\n", name);
+	for (i = 0; i < PK_ROLE_ENUM_LAST; i++) {
+		item = &metrics->priv->roles[i];
+		if (item->runtime.count == 0)
+			continue;
+		pk_metrics_histogram_to_string (str, name, pk_role_enum_to_string (i),
+						G_STRUCT_MEMBER_P (item, offset),
+						bounds, n_bounds);
+	}
+}
+
+/**
+ * pk_metrics_to_string:
+ * @metrics: a #PkMetrics
+ *
+ * Return value: all the metrics, in the Prometheus text exposition format
+ **/
+gchar *
+pk_metrics_to_string (PkMetrics *metrics)
+{
+	GString *str;
+	PkMetricsRole *item;
+	guint i;
+
+	g_return_val_if_fail (PK_IS_METRICS (metrics), NULL);
+
+	str = g_string_new ("");
+	pk_metrics_histograms_to_string (str, metrics,
+					 "packagekit_queue_wait_seconds",
+					 "Time waiting for other transactions.",
+					 G_STRUCT_OFFSET (PkMetricsRole, queue_wait),
+					 pk_metrics_time_bounds,
+					 G_N_ELEMENTS (pk_metrics_time_bounds));
+	pk_metrics_histograms_to_string (str, metrics,
+					 "packagekit_backend_runtime_seconds",
+					 "Time the backend was running.",
+					 G_STRUCT_OFFSET (PkMetricsRole, runtime),
+					 pk_metrics_time_bounds,
+					 G_N_ELEMENTS (pk_metrics_time_bounds));
+	pk_metrics_histograms_to_string (str, metrics,
+					 "packagekit_results",
+					 "Packages, details, files and repos found.",
+					 G_STRUCT_OFFSET (PkMetricsRole, results),
+					 pk_metrics_size_bounds,
+					 G_N_ELEMENTS (pk_metrics_size_bounds));
+	g_string_append (str,
+			 "# HELP packagekit_signals_total Signals sent to clients.\n"
+			 "# TYPE packagekit_signals_total counter\n");
+	for (i = 0; i < PK_ROLE_ENUM_LAST; i++) {
+		item = &metrics->priv->roles[i];
+		if (item->runtime.count == 0)
+			continue;
+		g_string_append_printf (str, "packagekit_signals_total{role=\"%s\"} %" G_GUINT64_FORMAT "\n",
+					pk_role_enum_to_string (i), item->signals);
+	}
+	return g_string_free (str, FALSE);
+}
+
+/**
+ * pk_metrics_save:
+ * @metrics: a #PkMetrics
+ * @filename: the file to replace
+ * @error: a #GError, or %NULL
+ *
+ * Writes the metrics atomically, so a scraper never sees half a file.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+pk_metrics_save (PkMetrics *metrics, const gchar *filename, GError **error)
+{
+	g_autofree gchar *data = NULL;
+
+	g_return_val_if_fail (PK_IS_METRICS (metrics), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	data = pk_metrics_to_string (metrics);
+	return g_file_set_contents (filename, data, -1, error);
+}
+
+/**
+ * pk_metrics_class_init:
+ **/
+static void
+pk_metrics_class_init (PkMetricsClass *klass)
+{
+	g_type_class_add_private (klass, sizeof (PkMetricsPrivate));
+}
+
+/**
+ * pk_metrics_init:
+ **/
+static void
+pk_metrics_init (PkMetrics *metrics)
+{
+	metrics->priv = PK_METRICS_GET_PRIVATE (metrics);
+}
+
+/**
+ * pk_metrics_new:
+ *
+ * Return value: a new #PkMetrics object.
+ **/
+PkMetrics *
+pk_metrics_new (void)
+{
+	PkMetrics *metrics;
+	metrics = g_object_new (PK_TYPE_METRICS, NULL);
+	return PK_METRICS (metrics);
+}
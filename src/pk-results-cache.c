@@ -0,0 +1,175 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "pk-results-cache.h"
+
+#define PK_RESULTS_CACHE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_RESULTS_CACHE, PkResultsCachePrivate))
+
+/* forget everything rather than grow without bounds */
+#define PK_RESULTS_CACHE_MAX_ENTRIES	64
+
+struct PkResultsCachePrivate
+{
+	GHashTable		*entries;	/* key -> PkResults */
+	guint			 generation;
+};
+
+G_DEFINE_TYPE (PkResultsCache, pk_results_cache, G_TYPE_OBJECT)
+
+/**
+ * pk_results_cache_set_generation:
+ *
+ * All the entries are for one generation of the backend state, so anything
+ * stored before the state changed is dropped in one go.
+ **/
+static void
+pk_results_cache_set_generation (PkResultsCache *cache, guint generation)
+{
+	if (cache->priv->generation == generation)
+		return;
+	if (g_hash_table_size (cache->priv->entries) > 0) {
+		g_debug ("backend state changed, dropping %u cached results",
+			 g_hash_table_size (cache->priv->entries));
+		g_hash_table_remove_all (cache->priv->entries);
+	}
+	cache->priv->generation = generation;
+}
+
+/**
+ * pk_results_cache_lookup:
+ * @cache: a #PkResultsCache
+ * @key: the role, filters and arguments of the query
+ * @generation: the current backend state generation
+ *
+ * Return value: (transfer full): the results stored for @key, or %NULL
+ **/
+PkResults *
+pk_results_cache_lookup (PkResultsCache *cache,
+			 const gchar *key,
+			 guint generation)
+{
+	PkResults *results;
+
+	g_return_val_if_fail (PK_IS_RESULTS_CACHE (cache), NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	pk_results_cache_set_generation (cache, generation);
+	results = g_hash_table_lookup (cache->priv->entries, key);
+	if (results == NULL)
+		return NULL;
+	return g_object_ref (results);
+}
+
+/**
+ * pk_results_cache_add:
+ * @cache: a #PkResultsCache
+ * @key: the role, filters and arguments of the query
+ * @generation: the backend state generation when the query was started
+ * @results: the results of the query
+ **/
+void
+pk_results_cache_add (PkResultsCache *cache,
+		      const gchar *key,
+		      guint generation,
+		      PkResults *results)
+{
+	g_return_if_fail (PK_IS_RESULTS_CACHE (cache));
+	g_return_if_fail (key != NULL);
+	g_return_if_fail (PK_IS_RESULTS (results));
+
+	/* a newer query has already seen a different state */
+	if (generation < cache->priv->generation)
+		return;
+	pk_results_cache_set_generation (cache, generation);
+
+	if (g_hash_table_size (cache->priv->entries) >= PK_RESULTS_CACHE_MAX_ENTRIES)
+		g_hash_table_remove_all (cache->priv->entries);
+	g_hash_table_insert (cache->priv->entries,
+			     g_strdup (key),
+			     g_object_ref (results));
+}
+
+/**
+ * pk_results_cache_get_size:
+ **/
+guint
+pk_results_cache_get_size (PkResultsCache *cache)
+{
+	g_return_val_if_fail (PK_IS_RESULTS_CACHE (cache), 0);
+	return g_hash_table_size (cache->priv->entries);
+}
+
+/**
+ * pk_results_cache_finalize:
+ **/
+static void
+pk_results_cache_finalize (GObject *object)
+{
+	PkResultsCache *cache;
+
+	g_return_if_fail (PK_IS_RESULTS_CACHE (object));
+	cache = PK_RESULTS_CACHE (object);
+
+	g_hash_table_unref (cache->priv->entries);
+
+	G_OBJECT_CLASS (pk_results_cache_parent_class)->finalize (object);
+}
+
+/**
+ * pk_results_cache_class_init:
+ **/
+static void
+pk_results_cache_class_init (PkResultsCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_results_cache_finalize;
+	g_type_class_add_private (klass, sizeof (PkResultsCachePrivate));
+}
+
+/**
+ * pk_results_cache_init:
+ **/
+static void
+pk_results_cache_init (PkResultsCache *cache)
+{
+	cache->priv = PK_RESULTS_CACHE_GET_PRIVATE (cache);
+	cache->priv->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+						      g_free, g_object_unref);
+}
+
+/**
+ * pk_results_cache_new:
+ *
+ * Return value: a new #PkResultsCache object.
+ **/
+PkResultsCache *
+pk_results_cache_new (void)
+{
+	PkResultsCache *cache;
+	cache = g_object_new (PK_TYPE_RESULTS_CACHE, NULL);
+	return PK_RESULTS_CACHE (cache);
+}
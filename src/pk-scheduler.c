@@ -61,8 +61,13 @@
 
 #include <glib/gi18n.h>
 #include <packagekit-glib2/pk-common.h>
+#include <polkit/polkit.h>
 
+#include "pk-dbus.h"
+#include "pk-metrics.h"
+#include "pk-results-cache.h"
 #include "pk-shared.h"
+#include "pk-transaction-db.h"
 #include "pk-transaction.h"
 #include "pk-transaction-private.h"
 #include "pk-scheduler.h"
@@ -86,6 +91,9 @@ static void     pk_scheduler_finalize	(GObject	*object);
 /* maximum number of requests a given user is able to request and queue */
 #define PK_SCHEDULER_SIMULTANEOUS_TRANSACTIONS_FOR_UID	500
 
+/* how long to wait for more finished transactions before writing metrics */
+#define PK_SCHEDULER_METRICS_SAVE_DELAY			1 /* s */
+
 struct PkSchedulerPrivate
 {
 	GPtrArray		*array;
@@ -93,6 +101,14 @@ struct PkSchedulerPrivate
 	GKeyFile		*conf;
 	PkBackend		*backend;
 	GDBusNodeInfo		*introspection;
+	GDBusConnection		*connection;
+	PkDbus			*dbus;
+	PkAuthCache		*auth_cache;
+	PkTransactionDb		*transaction_db;
+	PkResultsCache		*results_cache;	/* only if enabled */
+	PkMetrics		*metrics;
+	gchar			*metrics_filename;
+	guint			 metrics_save_id;
 };
 
 typedef struct {
@@ -107,6 +123,8 @@ typedef struct {
 	gulong			 allow_cancel_changed_id;
 	guint			 uid;
 	guint			 tries;
+	gint64			 time_committed;	/* monotonic, us */
+	gint64			 queue_wait;		/* us */
 } PkSchedulerItem;
 
 enum {
@@ -322,6 +340,7 @@ pk_scheduler_run_item (PkScheduler *scheduler, PkSchedulerItem *item)
 {
 	/* we set this here so that we don't try starting more than one */
 	pk_transaction_set_state (item->transaction, PK_TRANSACTION_STATE_RUNNING);
+	item->queue_wait += g_get_monotonic_time () - item->time_committed;
 
 	/* add this idle, so that we don't have a deep out-of-order callchain */
 	item->idle_id = g_idle_add ((GSourceFunc) pk_scheduler_run_idle_cb, item);
@@ -499,6 +518,7 @@ pk_scheduler_commit (PkScheduler *scheduler, const gchar *tid)
 		g_source_remove (item->commit_id);
 		item->commit_id = 0;
 	}
+	item->time_committed = g_get_monotonic_time ();
 
 	/* we will changed what is running */
 	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
@@ -549,6 +569,64 @@ pk_scheduler_transaction_state_changed_cb (PkTransaction *transaction,
 	}
 }
 
+/**
+ * pk_scheduler_save_metrics_cb:
+ **/
+static gboolean
+pk_scheduler_save_metrics_cb (gpointer user_data)
+{
+	PkScheduler *scheduler = PK_SCHEDULER (user_data);
+	g_autoptr(GError) error = NULL;
+
+	scheduler->priv->metrics_save_id = 0;
+	if (!pk_metrics_save (scheduler->priv->metrics,
+			      scheduler->priv->metrics_filename,
+			      &error)) {
+		g_warning ("failed to save metrics: %s", error->message);
+	}
+	return FALSE;
+}
+
+/**
+ * pk_scheduler_add_metrics:
+ **/
+static void
+pk_scheduler_add_metrics (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkBackendJob *job;
+
+	job = pk_transaction_get_backend_job (item->transaction);
+	pk_metrics_add_transaction (scheduler->priv->metrics,
+				    pk_transaction_get_role (item->transaction),
+				    item->queue_wait / 1000,
+				    pk_backend_job_get_runtime (job),
+				    pk_transaction_get_signal_count (item->transaction),
+				    pk_transaction_get_results_size (item->transaction));
+
+	/* write a burst of transactions out once */
+	if (scheduler->priv->metrics_filename == NULL ||
+	    scheduler->priv->metrics_save_id != 0)
+		return;
+	scheduler->priv->metrics_save_id =
+		g_timeout_add_seconds (PK_SCHEDULER_METRICS_SAVE_DELAY,
+				       pk_scheduler_save_metrics_cb,
+				       scheduler);
+	g_source_set_name_by_id (scheduler->priv->metrics_save_id,
+				 "[PkScheduler] save metrics");
+}
+
+/**
+ * pk_scheduler_get_metrics:
+ *
+ * Return value: (transfer none): the per-role metrics
+ **/
+PkMetrics *
+pk_scheduler_get_metrics (PkScheduler *scheduler)
+{
+	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), NULL);
+	return scheduler->priv->metrics;
+}
+
 /**
  * pk_scheduler_transaction_finished_cb:
  **/
@@ -581,6 +659,9 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 		/* increase the number of tries */
 		item->tries++;
 
+		/* only the time spent waiting again counts from here */
+		item->time_committed = g_get_monotonic_time ();
+
 		g_debug ("transaction finished and requires lock now, attempt %i", item->tries);
 
 		if (item->tries > PK_SCHEDULER_MAX_LOCK_RETRIES) {
@@ -602,6 +683,7 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 			item->commit_id = 0;
 		}
 		pk_transaction_set_state (item->transaction, PK_TRANSACTION_STATE_FINISHED);
+		pk_scheduler_add_metrics (scheduler, item);
 
 		/* give the client a few seconds to still query the runner */
 		item->remove_id = g_timeout_add_seconds (PK_TRANSACTION_KEEP_FINISHED_TIMOUT,
@@ -658,6 +740,40 @@ pk_scheduler_get_number_transactions_for_uid (PkScheduler *scheduler, guint uid)
 	return count;
 }
 
+/**
+ * pk_scheduler_ensure_services:
+ *
+ * Only used when the engine did not share its own handles, e.g. in the
+ * self tests; they are then created once and shared by all transactions.
+ **/
+static void
+pk_scheduler_ensure_services (PkScheduler *scheduler)
+{
+	PkSchedulerPrivate *priv = scheduler->priv;
+	g_autoptr(GError) error = NULL;
+
+	if (priv->connection == NULL) {
+		priv->connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+		if (priv->connection == NULL)
+			g_error ("failed to get system bus: %s", error->message);
+	}
+	if (priv->dbus == NULL)
+		priv->dbus = pk_dbus_new ();
+	if (priv->auth_cache == NULL) {
+		PolkitAuthority *authority;
+		authority = polkit_authority_get_sync (NULL, &error);
+		if (authority == NULL)
+			g_error ("failed to get pokit authority: %s", error->message);
+		priv->auth_cache = pk_auth_cache_new (authority, priv->connection);
+		g_object_unref (authority);
+	}
+	if (priv->transaction_db == NULL) {
+		priv->transaction_db = pk_transaction_db_new ();
+		if (!pk_transaction_db_load (priv->transaction_db, &error))
+			g_error ("failed to load transaction db: %s", error->message);
+	}
+}
+
 /**
  * pk_scheduler_create:
  **/
@@ -688,6 +804,16 @@ pk_scheduler_create (PkScheduler *scheduler,
 	item->tid = g_strdup (tid);
 	item->transaction = pk_transaction_new (scheduler->priv->conf,
 						scheduler->priv->introspection);
+	pk_scheduler_ensure_services (scheduler);
+	pk_transaction_set_services (item->transaction,
+				     scheduler->priv->connection,
+				     scheduler->priv->dbus,
+				     scheduler->priv->auth_cache,
+				     scheduler->priv->transaction_db);
+	if (scheduler->priv->results_cache != NULL) {
+		pk_transaction_set_results_cache (item->transaction,
+						  scheduler->priv->results_cache);
+	}
 	item->finished_id =
 		g_signal_connect_after (item->transaction, "finished",
 					G_CALLBACK (pk_scheduler_transaction_finished_cb),
@@ -1079,6 +1205,29 @@ pk_scheduler_set_backend (PkScheduler *scheduler,
 	scheduler->priv->backend = g_object_ref (backend);
 }
 
+/**
+ * pk_scheduler_set_services:
+ *
+ * Shares the daemon-wide handles with every transaction the scheduler
+ * creates, rather than each transaction opening its own.
+ */
+void
+pk_scheduler_set_services (PkScheduler *scheduler,
+			   GDBusConnection *connection,
+			   PkDbus *dbus,
+			   PkAuthCache *auth_cache,
+			   PkTransactionDb *transaction_db)
+{
+	PkSchedulerPrivate *priv = scheduler->priv;
+
+	g_return_if_fail (PK_IS_SCHEDULER (scheduler));
+
+	g_set_object (&priv->connection, connection);
+	g_set_object (&priv->dbus, dbus);
+	g_set_object (&priv->auth_cache, auth_cache);
+	g_set_object (&priv->transaction_db, transaction_db);
+}
+
 /**
  * pk_scheduler_class_init:
  * @klass: The PkSchedulerClass
@@ -1108,6 +1257,7 @@ pk_scheduler_init (PkScheduler *scheduler)
 {
 	scheduler->priv = PK_SCHEDULER_GET_PRIVATE (scheduler);
 	scheduler->priv->array = g_ptr_array_new ();
+	scheduler->priv->metrics = pk_metrics_new ();
 	scheduler->priv->introspection = pk_load_introspection (PK_DBUS_INTERFACE_TRANSACTION ".xml",
 							    NULL);
 	scheduler->priv->unwedge_id = g_timeout_add_seconds (PK_TRANSACTION_WEDGE_CHECK,
@@ -1139,6 +1289,20 @@ pk_scheduler_finalize (GObject *object)
 	g_key_file_unref (scheduler->priv->conf);
 	if (scheduler->priv->backend != NULL)
 		g_object_unref (scheduler->priv->backend);
+	if (scheduler->priv->connection != NULL)
+		g_object_unref (scheduler->priv->connection);
+	if (scheduler->priv->dbus != NULL)
+		g_object_unref (scheduler->priv->dbus);
+	if (scheduler->priv->auth_cache != NULL)
+		g_object_unref (scheduler->priv->auth_cache);
+	if (scheduler->priv->transaction_db != NULL)
+		g_object_unref (scheduler->priv->transaction_db);
+	if (scheduler->priv->results_cache != NULL)
+		g_object_unref (scheduler->priv->results_cache);
+	if (scheduler->priv->metrics_save_id != 0)
+		g_source_remove (scheduler->priv->metrics_save_id);
+	g_object_unref (scheduler->priv->metrics);
+	g_free (scheduler->priv->metrics_filename);
 
 	G_OBJECT_CLASS (pk_scheduler_parent_class)->finalize (object);
 }
@@ -1153,6 +1317,17 @@ pk_scheduler_new (GKeyFile *conf)
 {
 	PkScheduler *scheduler = PK_SCHEDULER (g_object_new (PK_TYPE_SCHEDULER, NULL));
 	scheduler->priv->conf = g_key_file_ref (conf);
+
+	/* answer repeated queries without asking the backend again */
+	if (g_key_file_get_boolean (conf, "Daemon", "CacheQueryResults", NULL))
+		scheduler->priv->results_cache = pk_results_cache_new ();
+
+	/* for monitoring to scrape */
+	scheduler->priv->metrics_filename = g_key_file_get_string (conf, "Daemon",
+								   "MetricsFile", NULL);
+	if (scheduler->priv->metrics_filename != NULL &&
+	    scheduler->priv->metrics_filename[0] == '\0')
+		g_clear_pointer (&scheduler->priv->metrics_filename, g_free);
 	return scheduler;
 }
 
@@ -24,8 +24,13 @@
 
 #include <glib-object.h>
 #include <packagekit-glib2/pk-enum.h>
+#include <polkit/polkit.h>
 
+#include "pk-auth-cache.h"
+#include "pk-dbus.h"
+#include "pk-metrics.h"
 #include "pk-transaction.h"
+#include "pk-transaction-db.h"
 
 G_BEGIN_DECLS
 
@@ -79,6 +84,12 @@ void		 pk_scheduler_cancel_background	(PkScheduler	*scheduler);
 void		 pk_scheduler_cancel_queued	(PkScheduler	*scheduler);
 void		 pk_scheduler_set_backend	(PkScheduler	*scheduler,
 						 PkBackend	*backend);
+void		 pk_scheduler_set_services	(PkScheduler	*scheduler,
+						 GDBusConnection *connection,
+						 PkDbus		*dbus,
+						 PkAuthCache	*auth_cache,
+						 PkTransactionDb *transaction_db);
+PkMetrics	*pk_scheduler_get_metrics	(PkScheduler	*scheduler);
 
 G_END_DECLS
 
@@ -24,11 +24,15 @@
 #include <glib.h>
 #include <glib-object.h>
 #include <glib/gstdio.h>
+#include <sqlite3.h>
+#include <unistd.h>
 
+#include "pk-auth-cache.h"
 #include "pk-backend.h"
 #include "pk-backend-spawn.h"
 #include "pk-dbus.h"
 #include "pk-engine.h"
+#include "pk-metrics.h"
 #include "pk-spawn.h"
 #include "pk-transaction-db.h"
 #include "pk-transaction.h"
@@ -300,6 +304,83 @@ pk_test_backend_func (void)
 		         PK_EXIT_ENUM_NEED_UNTRUSTED);
 }
 
+/**
+ * pk_test_backend_synthetic_new_job:
+ **/
+static PkBackendJob *
+pk_test_backend_synthetic_new_job (GKeyFile *conf, PkBackend *backend)
+{
+	PkBackendJob *job;
+
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_backend (job, backend);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PACKAGE,
+				  (PkBackendJobVFunc) pk_test_backend_package_cb,
+				  NULL);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_FINISHED,
+				  (PkBackendJobVFunc) pk_test_backend_finished_cb,
+				  NULL);
+	pk_backend_start_job (backend, job);
+	number_packages = 0;
+	return job;
+}
+
+static void
+pk_test_backend_synthetic_func (void)
+{
+	gboolean ret;
+	GError *error = NULL;
+	gchar *names[] = { "synthetic000010", "synthetic999999", NULL };
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkBackendJob) job = NULL;
+
+	/* load the dummy backend with a generated repository */
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dummy");
+	g_key_file_set_integer (conf, "Daemon", "DummySyntheticPackages", 1000);
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* every package is listed once */
+	job = pk_test_backend_synthetic_new_job (conf, backend);
+	pk_backend_get_packages (backend, job, pk_bitfield_value (PK_FILTER_ENUM_NONE));
+	_g_test_loop_run_with_timeout (5000);
+	pk_backend_stop_job (backend, job);
+	g_assert_cmpint (number_packages, ==, 1000);
+
+	/* a quarter of them are installed */
+	g_object_unref (job);
+	job = pk_test_backend_synthetic_new_job (conf, backend);
+	pk_backend_get_packages (backend, job, pk_bitfield_value (PK_FILTER_ENUM_INSTALLED));
+	_g_test_loop_run_with_timeout (5000);
+	pk_backend_stop_job (backend, job);
+	g_assert_cmpint (number_packages, ==, 250);
+
+	/* only packages inside the repository are resolved */
+	g_object_unref (job);
+	job = pk_test_backend_synthetic_new_job (conf, backend);
+	pk_backend_resolve (backend, job, pk_bitfield_value (PK_FILTER_ENUM_NONE), names);
+	_g_test_loop_run_with_timeout (5000);
+	pk_backend_stop_job (backend, job);
+	g_assert_cmpint (number_packages, ==, 1);
+
+	/* every fifth installed package has an update */
+	g_object_unref (job);
+	job = pk_test_backend_synthetic_new_job (conf, backend);
+	pk_backend_get_updates (backend, job, pk_bitfield_value (PK_FILTER_ENUM_NONE));
+	_g_test_loop_run_with_timeout (5000);
+	pk_backend_stop_job (backend, job);
+	g_assert_cmpint (number_packages, ==, 50);
+
+	ret = pk_backend_unload (backend);
+	g_assert (ret);
+}
+
 static guint _backend_spawn_number_packages = 0;
 
 /**
@@ -331,6 +412,12 @@ pk_test_backend_spawn_func (void)
 	const gchar *text;
 	gboolean ret;
 	gchar *uri;
+	gchar *fields_none[] = { NULL };
+	gchar *fields_package[] = { "installed", "gnome-power-manager;0.0.1;i386;data",
+				    "More useless software", NULL };
+	gchar *fields_percentage[] = { "10", NULL };
+	gchar *fields_percentage_named[] = { "percentage", "20", NULL };
+	gchar *fields_unknown_named[] = { "not-a-command", "20", NULL };
 	GError *error = NULL;
 	g_autoptr(GKeyFile) conf = NULL;
 	g_autoptr(PkBackend) backend = NULL;
@@ -436,6 +523,38 @@ pk_test_backend_spawn_func (void)
 		"package\tinstalled\tgnome-power-manager;0.0.1;i386;data\tMore useless software", NULL);
 	g_assert (ret);
 
+	/* test pk_backend_spawn_inject_frame Package, opcode 1 */
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, 1, fields_package, NULL);
+	g_assert (ret);
+
+	/* test pk_backend_spawn_inject_frame Percentage, opcode 7 */
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, 7, fields_percentage, NULL);
+	g_assert (ret);
+
+	/* test pk_backend_spawn_inject_frame with the wrong number of fields */
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, 7, fields_package, NULL);
+	g_assert (!ret);
+
+	/* test pk_backend_spawn_inject_frame NoPercentageUpdates, opcode 15 */
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, 15, fields_none, NULL);
+	g_assert (ret);
+
+	/* test pk_backend_spawn_inject_frame named command */
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, 0, fields_percentage_named, NULL);
+	g_assert (ret);
+
+	/* test pk_backend_spawn_inject_frame unknown named command */
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, 0, fields_unknown_named, NULL);
+	g_assert (!ret);
+
+	/* test pk_backend_spawn_inject_frame named command with no name */
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, 0, fields_none, NULL);
+	g_assert (!ret);
+
+	/* test pk_backend_spawn_inject_frame invalid opcode */
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, 200, fields_percentage, NULL);
+	g_assert (!ret);
+
 	/* manually unlock as we have no engine */
 	ret = pk_backend_unload (backend);
 	g_assert (ret);
@@ -484,13 +603,206 @@ pk_test_backend_spawn_func (void)
 	g_object_unref (backend_spawn);
 }
 
+/**
+ * pk_test_dbus_credentials_cb:
+ **/
+static void
+pk_test_dbus_credentials_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gboolean ret;
+	guint *pending = (guint *) user_data;
+	g_autoptr(GError) error = NULL;
+
+	ret = pk_dbus_get_credentials_finish (PK_DBUS (source), res, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	if (--(*pending) == 0)
+		_g_test_loop_quit ();
+}
+
 static void
 pk_test_dbus_func (void)
 {
+	const gchar *sender;
+	guint pending;
+	guint uid;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GError) error = NULL;
 	g_autoptr(PkDbus) dbus = NULL;
+	g_autofree gchar *session = NULL;
 
 	dbus = pk_dbus_new ();
 	g_assert (dbus != NULL);
+
+	/* the fake sender of the test suite */
+	pending = 1;
+	pk_dbus_get_credentials_async (dbus, ":org.freedesktop.PackageKit", NULL,
+				       pk_test_dbus_credentials_cb, &pending);
+	_g_test_loop_run_with_timeout (500);
+	g_assert_cmpint (pk_dbus_get_uid (dbus, ":org.freedesktop.PackageKit"), ==, 500);
+	session = pk_dbus_get_session (dbus, ":org.freedesktop.PackageKit");
+	g_assert_cmpstr (session, ==, "xxx");
+
+	/* look ourselves up, twice at the same time */
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	g_assert_no_error (error);
+	sender = g_dbus_connection_get_unique_name (connection);
+	pending = 2;
+	pk_dbus_get_credentials_async (dbus, sender, NULL,
+				       pk_test_dbus_credentials_cb, &pending);
+	pk_dbus_get_credentials_async (dbus, sender, NULL,
+				       pk_test_dbus_credentials_cb, &pending);
+	_g_test_loop_run_with_timeout (2000);
+
+	/* now answered from the cache */
+	uid = pk_dbus_get_uid (dbus, sender);
+	g_assert_cmpint (uid, ==, getuid ());
+}
+
+/* an authority that counts the questions it is asked */
+typedef struct {
+	PkAuthCache		 parent;
+	guint			 calls;
+	gboolean		 is_authorized;
+} PkTestAuthCache;
+
+typedef struct {
+	PkAuthCacheClass	 parent_class;
+} PkTestAuthCacheClass;
+
+G_DEFINE_TYPE (PkTestAuthCache, pk_test_auth_cache, PK_TYPE_AUTH_CACHE)
+
+static void
+pk_test_auth_cache_check_authorization (PkAuthCache *cache,
+					PolkitSubject *subject,
+					const gchar *action_id,
+					PolkitDetails *details,
+					PolkitCheckAuthorizationFlags flags,
+					GCancellable *cancellable,
+					GAsyncReadyCallback callback,
+					gpointer user_data)
+{
+	PkTestAuthCache *mock = (PkTestAuthCache *) cache;
+	g_autoptr(GTask) task = NULL;
+
+	mock->calls++;
+	task = g_task_new (cache, cancellable, callback, user_data);
+	g_task_return_pointer (task,
+			       polkit_authorization_result_new (mock->is_authorized,
+								!mock->is_authorized,
+								NULL),
+			       g_object_unref);
+}
+
+static PolkitAuthorizationResult *
+pk_test_auth_cache_check_authorization_finish (PkAuthCache *cache,
+					       GAsyncResult *res,
+					       GError **error)
+{
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+pk_test_auth_cache_class_init (PkTestAuthCacheClass *klass)
+{
+	PkAuthCacheClass *cache_class = (PkAuthCacheClass *) klass;
+	cache_class->check_authorization = pk_test_auth_cache_check_authorization;
+	cache_class->check_authorization_finish = pk_test_auth_cache_check_authorization_finish;
+}
+
+static void
+pk_test_auth_cache_init (PkTestAuthCache *mock)
+{
+}
+
+static void
+pk_test_auth_cache_check_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	PolkitAuthorizationResult **result = (PolkitAuthorizationResult **) user_data;
+	g_autoptr(GError) error = NULL;
+
+	*result = pk_auth_cache_check_finish (PK_AUTH_CACHE (source), res, &error);
+	g_assert_no_error (error);
+}
+
+/**
+ * pk_test_auth_cache_check:
+ **/
+static gboolean
+pk_test_auth_cache_check (PkAuthCache *cache,
+			  const gchar *sender,
+			  const gchar *package_ids)
+{
+	gboolean ret;
+	PolkitAuthorizationResult *result = NULL;
+	PolkitDetails *details;
+	PolkitSubject *subject;
+
+	details = polkit_details_new ();
+	polkit_details_insert (details, "package_ids", package_ids);
+	subject = polkit_system_bus_name_new (sender);
+	pk_auth_cache_check_async (cache, subject,
+				   "org.freedesktop.packagekit.package-install",
+				   details,
+				   POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
+				   NULL,
+				   pk_test_auth_cache_check_cb,
+				   &result);
+	while (result == NULL)
+		g_main_context_iteration (NULL, TRUE);
+	ret = polkit_authorization_result_get_is_authorized (result);
+	g_object_unref (result);
+	g_object_unref (subject);
+	g_object_unref (details);
+	return ret;
+}
+
+static void
+pk_test_auth_cache_func (void)
+{
+	PkTestAuthCache *mock;
+	g_autoptr(PkAuthCache) cache = NULL;
+
+	cache = g_object_new (pk_test_auth_cache_get_type (), NULL);
+	mock = (PkTestAuthCache *) cache;
+	mock->is_authorized = TRUE;
+
+	/* nothing retained until the implicit authorization allows it */
+	g_assert (pk_test_auth_cache_check (cache, ":1.1", "powertop"));
+	g_assert (pk_test_auth_cache_check (cache, ":1.1", "powertop"));
+	g_assert_cmpint (mock->calls, ==, 2);
+	g_assert_cmpint (pk_auth_cache_get_size (cache), ==, 0);
+
+	/* asked once, then answered from the cache */
+	pk_auth_cache_set_retained (cache, "org.freedesktop.packagekit.package-install", TRUE);
+	g_assert (pk_test_auth_cache_check (cache, ":1.1", "powertop"));
+	g_assert (pk_test_auth_cache_check (cache, ":1.1", "powertop"));
+	g_assert_cmpint (mock->calls, ==, 3);
+
+	/* other details and other callers are asked again */
+	g_assert (pk_test_auth_cache_check (cache, ":1.1", "glib2"));
+	g_assert (pk_test_auth_cache_check (cache, ":1.2", "powertop"));
+	g_assert_cmpint (mock->calls, ==, 5);
+	g_assert_cmpint (pk_auth_cache_get_size (cache), ==, 3);
+
+	/* a no is never retained */
+	mock->is_authorized = FALSE;
+	g_assert (!pk_test_auth_cache_check (cache, ":1.3", "powertop"));
+	g_assert (!pk_test_auth_cache_check (cache, ":1.3", "powertop"));
+	g_assert_cmpint (mock->calls, ==, 7);
+	mock->is_authorized = TRUE;
+
+	/* the caller disconnecting */
+	pk_auth_cache_invalidate (cache, ":1.1");
+	g_assert_cmpint (pk_auth_cache_get_size (cache), ==, 1);
+	g_assert (pk_test_auth_cache_check (cache, ":1.1", "powertop"));
+	g_assert_cmpint (mock->calls, ==, 8);
+
+	/* the authority changing */
+	pk_auth_cache_invalidate (cache, NULL);
+	g_assert_cmpint (pk_auth_cache_get_size (cache), ==, 0);
+	g_assert (pk_test_auth_cache_check (cache, ":1.2", "powertop"));
+	g_assert_cmpint (mock->calls, ==, 9);
 }
 
 PkSpawnExitType mexit = PK_SPAWN_EXIT_TYPE_UNKNOWN;
@@ -730,6 +1042,115 @@ pk_test_spawn_func (void)
 	g_assert (!ret);
 }
 
+/**
+ * pk_test_spawn_frames_stdout_cb:
+ **/
+static void
+pk_test_spawn_frames_stdout_cb (PkSpawn *spawn, const gchar *line, gpointer user_data)
+{
+	if (g_strcmp0 (line, "framed") == 0)
+		pk_spawn_set_framed (spawn, TRUE);
+}
+
+/**
+ * pk_test_spawn_frames_frame_cb:
+ **/
+static void
+pk_test_spawn_frames_frame_cb (PkSpawn *spawn, guint opcode, GPtrArray *fields, gpointer user_data)
+{
+	GPtrArray *frames = (GPtrArray *) user_data;
+	g_autofree gchar *joined = NULL;
+
+	joined = g_strjoinv ("|", (gchar **) fields->pdata);
+	g_ptr_array_add (frames, g_strdup_printf ("%u/%u:%s", opcode, fields->len - 1, joined));
+}
+
+static void
+pk_test_spawn_frames_func (void)
+{
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) frames = NULL;
+	g_autoptr(PkSpawn) spawn = NULL;
+	g_auto(GStrv) argv = NULL;
+
+	frames = g_ptr_array_new_with_free_func (g_free);
+	new_spawn_object (&spawn);
+	g_signal_connect (spawn, "stdout",
+			  G_CALLBACK (pk_test_spawn_frames_stdout_cb), NULL);
+	g_signal_connect (spawn, "stdout-frame",
+			  G_CALLBACK (pk_test_spawn_frames_frame_cb), frames);
+
+	mexit = PK_SPAWN_EXIT_TYPE_UNKNOWN;
+	argv = g_strsplit (TESTDATADIR "/pk-spawn-test-frames.sh", " ", 0);
+	ret = pk_spawn_argv (spawn, argv, NULL, PK_SPAWN_ARGV_FLAGS_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_cmpint (mexit, ==, PK_SPAWN_EXIT_TYPE_SUCCESS);
+
+	/* only the switch was text, and each frame was reassembled */
+	g_assert_cmpint (stdout_count, ==, 1);
+	g_assert_cmpint (frames->len, ==, 3);
+	g_assert_cmpstr (g_ptr_array_index (frames, 0), ==, "1/2:abc|de");
+	g_assert_cmpstr (g_ptr_array_index (frames, 1), ==, "3/1:");
+	g_assert_cmpstr (g_ptr_array_index (frames, 2), ==, "15/0:");
+}
+
+/**
+ * pk_test_spawn_latency_stdout_cb:
+ **/
+static void
+pk_test_spawn_latency_stdout_cb (PkSpawn *spawn, const gchar *line, gpointer user_data)
+{
+	_g_test_loop_quit ();
+}
+
+static void
+pk_test_spawn_latency_func (void)
+{
+	gboolean ret;
+	gdouble elapsed;
+	guint i;
+	const guint round_trips = 20;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTimer) timer = NULL;
+	g_autoptr(PkSpawn) spawn = NULL;
+	g_auto(GStrv) argv = NULL;
+
+	new_spawn_object (&spawn);
+	g_signal_connect (spawn, "stdout",
+			  G_CALLBACK (pk_test_spawn_latency_stdout_cb), NULL);
+
+	/* start the echo dispatcher and wait for it to be ready */
+	argv = g_strsplit (TESTDATADIR "/pk-spawn-test-echo.sh\tping", "\t", 0);
+	ret = pk_spawn_argv (spawn, argv, NULL, PK_SPAWN_ARGV_FLAGS_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_cmpint (stdout_count, ==, 1);
+
+	/* each command is echoed back as soon as the line is read */
+	timer = g_timer_new ();
+	for (i = 0; i < round_trips; i++) {
+		ret = pk_spawn_argv (spawn, argv, NULL, PK_SPAWN_ARGV_FLAGS_NONE, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		_g_test_loop_run_with_timeout (5000);
+	}
+	elapsed = g_timer_elapsed (timer, NULL) * 1000.f;
+	g_assert_cmpint (stdout_count, ==, round_trips + 1);
+
+	/* a round trip should not wait for a polling interval, but the
+	 * timing depends on the load of the machine so is only reported */
+	g_test_message ("%u round trips took %.1fms, %.2fms each",
+			round_trips, elapsed, elapsed / round_trips);
+
+	ret = pk_spawn_exit (spawn);
+	g_assert (ret);
+	g_assert (!pk_spawn_is_running (spawn));
+}
+
 static void
 pk_test_transaction_func (void)
 {
@@ -770,7 +1191,11 @@ pk_test_transaction_db_func (void)
 	gboolean ret;
 	gdouble ms;
 	GError *error = NULL;
+	const gchar *package_names[] = { "powertop", NULL };
+	PkTransactionDbHistoryItem *item;
+	PkTransactionDbRecord *record;
 	g_autoptr(PkTransactionDb) db = NULL;
+	g_autoptr(GPtrArray) history = NULL;
 	g_autofree gchar *proxy_http = NULL;
 	g_autofree gchar *proxy_ftp = NULL;
 
@@ -782,6 +1207,8 @@ pk_test_transaction_db_func (void)
 		value = g_unlink ("./transactions.db");
 		g_assert (value == 0);
 	}
+	g_unlink ("./transactions.db-wal");
+	g_unlink ("./transactions.db-shm");
 #endif
 	/* check we created quickly */
 	g_test_timer_start ();
@@ -888,10 +1315,221 @@ pk_test_transaction_db_func (void)
 	g_assert (ret);
 	g_assert_cmpstr (proxy_http, ==, "127.0.0.1:80");
 	g_assert_cmpstr (proxy_ftp, ==, "127.0.0.1:21");
+
+	/* can we save packages for a transaction */
+	tid = pk_transaction_db_generate_id (db);
+	record = pk_transaction_db_record_new (tid);
+	record->role = PK_ROLE_ENUM_INSTALL_PACKAGES;
+	record->data = g_strdup ("installing\tpowertop;1.8-1.fc8;i386;fedora\tPower consumption monitor\n"
+				 "removing\tgnome-power-manager;2.6.19;i386;installed\tGNOME power management");
+	record->succeeded = TRUE;
+	record->duration = 1000;
+	ret = pk_transaction_db_write_record (db, record);
+	g_assert (ret);
+	pk_transaction_db_flush (db);
+	g_free (tid);
+
+	/* can we get the history for just one package */
+	history = pk_transaction_db_get_package_history (db, (gchar **) package_names, 0);
+	g_assert (history != NULL);
+	g_assert_cmpint (history->len, ==, 1);
+	item = g_ptr_array_index (history, 0);
+	g_assert_cmpstr (pk_package_get_version (item->package), ==, "1.8-1.fc8");
+	g_assert_cmpstr (pk_package_get_data (item->package), ==, "fedora");
+	g_assert_cmpint (pk_package_get_info (item->package), ==, PK_INFO_ENUM_INSTALLING);
+	g_assert_cmpint (item->timestamp, >, 0);
+}
+
+/**
+ * pk_test_transaction_db_migrate_func:
+ *
+ * A database from before the per-package history is filled in on load.
+ **/
+static void
+pk_test_transaction_db_migrate_func (void)
+{
+	gboolean ret;
+	gint rc;
+	const gchar *package_names[] = { "powertop", NULL };
+	PkTransactionDbHistoryItem *item;
+	sqlite3 *sdb = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) history = NULL;
+	g_autoptr(PkTransactionDb) tdb = NULL;
+
+#if PK_BUILD_LOCAL
+	g_unlink ("./transactions.db");
+	g_unlink ("./transactions.db-wal");
+	g_unlink ("./transactions.db-shm");
+#endif
+	rc = sqlite3_open (PK_DB_DIR "/transactions.db", &sdb);
+	g_assert_cmpint (rc, ==, SQLITE_OK);
+	rc = sqlite3_exec (sdb,
+			   "CREATE TABLE transactions (transaction_id TEXT PRIMARY KEY, "
+			   "timespec TEXT, duration INTEGER, succeeded INTEGER DEFAULT 0, "
+			   "role TEXT, data TEXT, description TEXT, uid INTEGER DEFAULT 0, "
+			   "cmdline TEXT);"
+			   "INSERT INTO transactions VALUES ('/1_old', '2015-01-01T00:00:00Z', 10, 1, "
+			   "'install-packages', 'installing\tpowertop;1.8-1.fc8;i386;fedora\tPower consumption monitor', "
+			   "NULL, 500, NULL);"
+			   "INSERT INTO transactions VALUES ('/2_new', '2016-01-01T00:00:00Z', 10, 1, "
+			   "'update-packages', 'updating\tpowertop;1.9-1.fc8;i386;fedora\tPower consumption monitor\n"
+			   "updating\tgnome-power-manager;2.6.19;i386;fedora\tGNOME power management', NULL, 500, NULL);"
+			   "INSERT INTO transactions VALUES ('/3_failed', '2017-01-01T00:00:00Z', 10, 0, "
+			   "'update-packages', 'updating\tpowertop;2.0-1.fc8;i386;fedora\tPower consumption monitor', "
+			   "NULL, 500, NULL);",
+			   NULL, NULL, NULL);
+	g_assert_cmpint (rc, ==, SQLITE_OK);
+	sqlite3_close (sdb);
+
+	tdb = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (tdb, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* only the successful transactions, newest first */
+	history = pk_transaction_db_get_package_history (tdb, (gchar **) package_names, 0);
+	g_assert (history != NULL);
+	g_assert_cmpint (history->len, ==, 2);
+	item = g_ptr_array_index (history, 0);
+	g_assert_cmpstr (pk_package_get_version (item->package), ==, "1.9-1.fc8");
+	g_assert_cmpint (pk_package_get_info (item->package), ==, PK_INFO_ENUM_UPDATING);
+	g_assert_cmpint (item->uid, ==, 500);
+	item = g_ptr_array_index (history, 1);
+	g_assert_cmpstr (pk_package_get_version (item->package), ==, "1.8-1.fc8");
+	g_assert_cmpint (pk_package_get_info (item->package), ==, PK_INFO_ENUM_INSTALLING);
+	g_assert_cmpint (((PkTransactionDbHistoryItem *) g_ptr_array_index (history, 0))->timestamp, >,
+			 item->timestamp);
+	g_ptr_array_unref (history);
+
+	/* the limit only considers the newest transactions */
+	history = pk_transaction_db_get_package_history (tdb, (gchar **) package_names, 1);
+	g_assert_cmpint (history->len, ==, 0);
+}
+
+/**
+ * pk_test_transaction_db_concurrent_func:
+ *
+ * The history can be read while the writer thread is busy, without
+ * waiting for it, and includes everything that was queued before the read.
+ **/
+static void
+pk_test_transaction_db_concurrent_func (void)
+{
+	gboolean ret;
+	guint i;
+	const guint records = 200;
+	const gchar *package_names[] = { "hal", NULL };
+	GList *l;
+	GList *list;
+	PkTransactionDbRecord *record;
+	g_autofree gchar *tid = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) history = NULL;
+	g_autoptr(PkTransactionDb) tdb = NULL;
+
+	/* start from an empty database */
+#if PK_BUILD_LOCAL
+	g_unlink ("./transactions.db");
+	g_unlink ("./transactions.db-wal");
+	g_unlink ("./transactions.db-shm");
+#endif
+	tdb = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (tdb, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* a transaction that is still running is saved as it starts */
+	tid = pk_transaction_db_generate_id (tdb);
+	record = pk_transaction_db_record_new (tid);
+	record->role = PK_ROLE_ENUM_INSTALL_PACKAGES;
+	record->uid = 500;
+	ret = pk_transaction_db_add_record (tdb, record);
+	g_assert (ret);
+	pk_transaction_db_record_free (record);
+	list = pk_transaction_db_get_list (tdb, 0);
+	g_assert_cmpint (g_list_length (list), ==, 1);
+	g_assert_cmpstr (pk_transaction_past_get_id (list->data), ==, tid);
+	g_assert (!pk_transaction_past_get_succeeded (list->data));
+	g_list_free_full (list, (GDestroyNotify) g_object_unref);
+
+	/* and then finishes while the writer thread is busy */
+	record = pk_transaction_db_record_new (tid);
+	record->role = PK_ROLE_ENUM_INSTALL_PACKAGES;
+	record->uid = 500;
+	record->succeeded = TRUE;
+	ret = pk_transaction_db_write_record (tdb, record);
+	g_assert (ret);
+
+	for (i = 0; i < records; i++) {
+		g_autofree gchar *tid_tmp = pk_transaction_db_generate_id (tdb);
+		record = pk_transaction_db_record_new (tid_tmp);
+		record->role = PK_ROLE_ENUM_UPDATE_PACKAGES;
+		record->uid = 500;
+		record->data = g_strdup_printf ("updating\thal;0.%u;i386;fedora\tHardware abstraction", i);
+		record->succeeded = TRUE;
+		ret = pk_transaction_db_write_record (tdb, record);
+		g_assert (ret);
+	}
+
+	/* the last action time does not wait for the disk */
+	g_assert_cmpint (pk_transaction_db_action_time_since (tdb, PK_ROLE_ENUM_UPDATE_PACKAGES), <=, 1);
+
+	/* a read straight after queueing sees every record, and the queued
+	 * one replaces the row saved as the transaction started */
+	list = pk_transaction_db_get_list (tdb, 0);
+	g_assert_cmpint (g_list_length (list), ==, records + 1);
+	for (l = list; l != NULL; l = l->next) {
+		if (g_strcmp0 (pk_transaction_past_get_id (l->data), tid) == 0)
+			g_assert (pk_transaction_past_get_succeeded (l->data));
+	}
+	g_list_free_full (list, (GDestroyNotify) g_object_unref);
+	list = pk_transaction_db_get_list (tdb, 10);
+	g_assert_cmpint (g_list_length (list), ==, 10);
+	g_list_free_full (list, (GDestroyNotify) g_object_unref);
+	history = pk_transaction_db_get_package_history (tdb, (gchar **) package_names, 0);
+	g_assert (history != NULL);
+	g_assert_cmpint (history->len, ==, records);
+
+	/* and the same once it is all on disk */
+	pk_transaction_db_flush (tdb);
+	list = pk_transaction_db_get_list (tdb, 0);
+	g_assert_cmpint (g_list_length (list), ==, records + 1);
+	g_list_free_full (list, (GDestroyNotify) g_object_unref);
 }
 
 static PkTransactionDb *db = NULL;
 
+typedef struct {
+	guint		 signals;
+	guint		 changes;
+	guint		 status_signals;
+} PkTestPropertiesHelper;
+
+/**
+ * pk_test_transaction_properties_changed_cb:
+ **/
+static void
+pk_test_transaction_properties_changed_cb (GDBusConnection *connection,
+					   const gchar *sender_name,
+					   const gchar *object_path,
+					   const gchar *interface_name,
+					   const gchar *signal_name,
+					   GVariant *parameters,
+					   gpointer user_data)
+{
+	PkTestPropertiesHelper *helper = (PkTestPropertiesHelper *) user_data;
+	g_autoptr(GVariant) dict = NULL;
+	g_autoptr(GVariant) status = NULL;
+
+	dict = g_variant_get_child_value (parameters, 1);
+	helper->signals++;
+	helper->changes += g_variant_n_children (dict);
+	status = g_variant_lookup_value (dict, "Status", G_VARIANT_TYPE_UINT32);
+	if (status != NULL)
+		helper->status_signals++;
+}
+
 /**
  * pk_test_scheduler_finished_cb:
  **/
@@ -901,6 +1539,92 @@ pk_test_scheduler_finished_cb (PkTransaction *transaction, const gchar *exit_tex
 	_g_test_loop_quit ();
 }
 
+/**
+ * pk_test_transaction_properties_func:
+ *
+ * The progress of a download is merged into a few PropertiesChanged
+ * signals rather than one per property per update.
+ **/
+static void
+pk_test_transaction_properties_func (void)
+{
+	gboolean ret;
+	guint subscription_id;
+	const gchar *package_ids[] = { "powertop;1.8-1.fc8;i386;fedora", NULL };
+	PkTestPropertiesHelper helper = { 0, 0, 0 };
+	PkTransaction *transaction;
+	PolkitAuthority *authority;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkAuthCache) auth_cache = NULL;
+	g_autoptr(PkDbus) dbus = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+	g_autoptr(PkTransactionDb) tdb = NULL;
+	g_autofree gchar *tid = NULL;
+
+	tdb = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (tdb, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dummy");
+	g_key_file_set_integer (conf, "Daemon", "ProgressUpdateInterval", 100);
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, NULL);
+	g_assert (ret);
+
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	g_assert_no_error (error);
+	dbus = pk_dbus_new ();
+	authority = polkit_authority_get_sync (NULL, &error);
+	g_assert_no_error (error);
+	auth_cache = pk_auth_cache_new (authority, connection);
+	tlist = pk_scheduler_new (conf);
+	pk_scheduler_set_backend (tlist, backend);
+	pk_scheduler_set_services (tlist, connection, dbus, auth_cache, tdb);
+
+	tid = pk_transaction_db_generate_id (tdb);
+	ret = pk_scheduler_create (tlist, tid, ":org.freedesktop.PackageKit", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	transaction = pk_scheduler_get_transaction (tlist, tid);
+	g_signal_connect (transaction, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+
+	/* count what a client would wake up for */
+	subscription_id =
+		g_dbus_connection_signal_subscribe (connection,
+						    NULL,
+						    "org.freedesktop.DBus.Properties",
+						    "PropertiesChanged",
+						    tid,
+						    NULL,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_test_transaction_properties_changed_cb,
+						    &helper,
+						    NULL);
+
+	/* the dummy backend sends 51 x 3 progress updates */
+	pk_transaction_download_packages (transaction,
+					  g_variant_new ("(b^as)", TRUE, package_ids),
+					  NULL);
+	_g_test_loop_run_with_timeout (5000);
+
+	/* let the last signals arrive back from the bus */
+	_g_test_loop_wait (100);
+	g_dbus_connection_signal_unsubscribe (connection, subscription_id);
+
+	g_debug ("%u property changes in %u signals", helper.changes, helper.signals);
+	g_assert_cmpint (helper.status_signals, >, 0);
+	g_assert_cmpint (helper.signals, >, 0);
+	g_assert_cmpint (helper.signals, <, 30);
+	g_assert_cmpint (helper.changes, <, 150);
+	g_object_unref (authority);
+}
+
 /**
  * pk_test_scheduler_create_transaction:
  **/
@@ -1437,6 +2161,234 @@ pk_test_scheduler_parallel_func (void)
 	g_object_unref (db);
 }
 
+/**
+ * pk_test_scheduler_burst_credentials_cb:
+ **/
+static void
+pk_test_scheduler_burst_credentials_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+
+	ret = pk_dbus_get_credentials_finish (PK_DBUS (source), res, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	_g_test_loop_quit ();
+}
+
+static void
+pk_test_scheduler_burst_func (void)
+{
+	gboolean ret;
+	guint i;
+	guint bursts = 500;
+	gdouble elapsed;
+	GError *error = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(PkDbus) dbus = NULL;
+	g_autoptr(PkAuthCache) auth_cache = NULL;
+	g_autoptr(GHashTable) tids = NULL;
+	PolkitAuthority *authority;
+
+	db = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dummy");
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, NULL);
+	g_assert (ret);
+
+	/* share the handles like the engine does */
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	g_assert_no_error (error);
+	dbus = pk_dbus_new ();
+	authority = polkit_authority_get_sync (NULL, &error);
+	g_assert_no_error (error);
+	auth_cache = pk_auth_cache_new (authority, connection);
+	tlist = pk_scheduler_new (conf);
+	pk_scheduler_set_backend (tlist, backend);
+	pk_scheduler_set_services (tlist, connection, dbus, auth_cache, db);
+
+	/* a client burst of CreateTransaction calls, with the credentials
+	 * looked up first just like the engine does */
+	tids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_test_timer_start ();
+	for (i = 0; i < bursts; i++) {
+		pk_dbus_get_credentials_async (dbus, ":org.freedesktop.PackageKit", NULL,
+					       pk_test_scheduler_burst_credentials_cb, NULL);
+		_g_test_loop_run_with_timeout (500);
+		g_hash_table_add (tids, pk_test_scheduler_create_transaction (tlist));
+	}
+	elapsed = g_test_timer_elapsed ();
+
+	/* only reported, the time depends too much on the machine */
+	g_test_message ("%u transactions created in %.1fms, %.0f per second",
+			bursts, elapsed * 1000, bursts / MAX (elapsed, 0.000001));
+	g_test_minimized_result (elapsed * 1000 / bursts,
+				 "%.3fms per transaction", elapsed * 1000 / bursts);
+
+	/* every call was queued as a transaction of its own */
+	g_assert_cmpint (g_hash_table_size (tids), ==, bursts);
+	g_assert_cmpint (pk_scheduler_get_size (tlist), ==, bursts);
+
+	/* and all of them share the handles rather than creating their own */
+	g_assert_cmpint (G_OBJECT (dbus)->ref_count, ==, 2 + bursts);
+	g_assert_cmpint (G_OBJECT (auth_cache)->ref_count, ==, 2 + bursts);
+	g_assert_cmpint (G_OBJECT (db)->ref_count, ==, 2 + bursts);
+
+	g_object_unref (authority);
+	g_object_unref (db);
+}
+
+/**
+ * pk_test_results_cache_resolve:
+ *
+ * Return value: %TRUE if the backend was not asked
+ **/
+static gboolean
+pk_test_results_cache_resolve (PkScheduler *tlist)
+{
+	PkTransaction *transaction;
+	g_autofree gchar *tid = NULL;
+	g_auto(GStrv) packages = NULL;
+
+	tid = pk_test_scheduler_create_transaction (tlist);
+	transaction = pk_scheduler_get_transaction (tlist, tid);
+	g_signal_connect (transaction, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	packages = g_strsplit ("glib2", " ", -1);
+	pk_transaction_resolve (transaction,
+				g_variant_new ("(t^as)",
+					       pk_bitfield_value (PK_FILTER_ENUM_NONE),
+					       packages),
+				NULL);
+	_g_test_loop_run_with_timeout (5000);
+	return pk_transaction_is_replayed (transaction);
+}
+
+static void
+pk_test_results_cache_func (void)
+{
+	gboolean ret;
+	guint generation;
+	PkTransaction *transaction;
+	GError *error = NULL;
+	g_autofree gchar *tid_install = NULL;
+	g_autofree gchar *tid_refresh = NULL;
+	g_auto(GStrv) package_ids = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+
+	db = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dummy");
+	g_key_file_set_boolean (conf, "Daemon", "CacheQueryResults", TRUE);
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, NULL);
+	g_assert (ret);
+	tlist = pk_scheduler_new (conf);
+	pk_scheduler_set_backend (tlist, backend);
+
+	/* only the first of two identical queries gets to the backend */
+	g_assert (!pk_test_results_cache_resolve (tlist));
+	g_assert (pk_test_results_cache_resolve (tlist));
+
+	/* installing a package makes the answer stale */
+	generation = pk_backend_get_state_generation (backend);
+	tid_install = pk_test_scheduler_create_transaction (tlist);
+	transaction = pk_scheduler_get_transaction (tlist, tid_install);
+	g_signal_connect (transaction, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	pk_transaction_skip_auth_checks (transaction, TRUE);
+	package_ids = g_strsplit ("libawesome;42;i386;debian", " ", -1);
+	pk_transaction_install_packages (transaction,
+					 g_variant_new ("(t^as)",
+							pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_NONE),
+							package_ids),
+					 NULL);
+	_g_test_loop_run_with_timeout (15000);
+	g_assert_cmpint (pk_backend_get_state_generation (backend), >, generation);
+
+	/* let the delayed ::updates-changed go first */
+	_g_test_loop_wait (500);
+	g_assert (!pk_test_results_cache_resolve (tlist));
+	g_assert (pk_test_results_cache_resolve (tlist));
+
+	/* so does refreshing the metadata */
+	generation = pk_backend_get_state_generation (backend);
+	tid_refresh = pk_test_scheduler_create_transaction (tlist);
+	transaction = pk_scheduler_get_transaction (tlist, tid_refresh);
+	g_signal_connect (transaction, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	pk_transaction_skip_auth_checks (transaction, TRUE);
+	pk_transaction_refresh_cache (transaction,
+				      g_variant_new ("(b)", FALSE),
+				      NULL);
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpint (pk_backend_get_state_generation (backend), >, generation);
+	_g_test_loop_wait (500);
+	g_assert (!pk_test_results_cache_resolve (tlist));
+	g_assert (pk_test_results_cache_resolve (tlist));
+
+	/* and a change made outside of PackageKit */
+	pk_backend_installed_db_changed (backend);
+	g_assert (!pk_test_results_cache_resolve (tlist));
+
+	g_object_unref (db);
+}
+
+static void
+pk_test_metrics_func (void)
+{
+	gboolean ret;
+	GError *error = NULL;
+	const gchar *filename = "/tmp/pk-self-test-metrics.prom";
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *str = NULL;
+	g_autoptr(PkMetrics) metrics = NULL;
+
+	metrics = pk_metrics_new ();
+	g_assert (metrics != NULL);
+
+	/* nothing run yet */
+	str = pk_metrics_to_string (metrics);
+	g_assert (g_strstr_len (str, -1, "role=") == NULL);
+	g_free (str);
+
+	/* add two resolves */
+	pk_metrics_add_transaction (metrics, PK_ROLE_ENUM_RESOLVE, 2, 150, 5, 3);
+	pk_metrics_add_transaction (metrics, PK_ROLE_ENUM_RESOLVE, 0, 20, 2, 0);
+	str = pk_metrics_to_string (metrics);
+	g_assert (g_strstr_len (str, -1, "packagekit_queue_wait_seconds_bucket{role=\"resolve\",le=\"0.005\"} 2\n") != NULL);
+	g_assert (g_strstr_len (str, -1, "packagekit_backend_runtime_seconds_bucket{role=\"resolve\",le=\"0.1\"} 1\n") != NULL);
+	g_assert (g_strstr_len (str, -1, "packagekit_backend_runtime_seconds_sum{role=\"resolve\"} 0.170\n") != NULL);
+	g_assert (g_strstr_len (str, -1, "packagekit_results_bucket{role=\"resolve\",le=\"0\"} 1\n") != NULL);
+	g_assert (g_strstr_len (str, -1, "packagekit_results_count{role=\"resolve\"} 2\n") != NULL);
+	g_assert (g_strstr_len (str, -1, "packagekit_signals_total{role=\"resolve\"} 7\n") != NULL);
+	g_assert (g_strstr_len (str, -1, "role=\"install-packages\"") == NULL);
+
+	/* the file has the same contents */
+	ret = pk_metrics_save (metrics, filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = g_file_get_contents (filename, &data, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpstr (data, ==, str);
+	g_unlink (filename);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -1454,13 +2406,23 @@ main (int argc, char **argv)
 	/* components */
 	g_test_add_func ("/packagekit/transaction", pk_test_transaction_func);
 	g_test_add_func ("/packagekit/dbus", pk_test_dbus_func);
+	g_test_add_func ("/packagekit/auth-cache", pk_test_auth_cache_func);
 	g_test_add_func ("/packagekit/spawn", pk_test_spawn_func);
+	g_test_add_func ("/packagekit/spawn-latency", pk_test_spawn_latency_func);
+	g_test_add_func ("/packagekit/spawn-frames", pk_test_spawn_frames_func);
 	g_test_add_func ("/packagekit/scheduler", pk_test_scheduler_func);
 	g_test_add_func ("/packagekit/scheduler-parallel", pk_test_scheduler_parallel_func);
+	g_test_add_func ("/packagekit/scheduler-burst", pk_test_scheduler_burst_func);
+	g_test_add_func ("/packagekit/results-cache", pk_test_results_cache_func);
+	g_test_add_func ("/packagekit/metrics", pk_test_metrics_func);
+	g_test_add_func ("/packagekit/transaction-properties", pk_test_transaction_properties_func);
 	g_test_add_func ("/packagekit/transaction-db", pk_test_transaction_db_func);
+	g_test_add_func ("/packagekit/transaction-db-migrate", pk_test_transaction_db_migrate_func);
+	g_test_add_func ("/packagekit/transaction-db-concurrent", pk_test_transaction_db_concurrent_func);
 
 	/* backend stuff */
 	g_test_add_func ("/packagekit/backend", pk_test_backend_func);
+	g_test_add_func ("/packagekit/backend-synthetic", pk_test_backend_synthetic_func);
 	g_test_add_func ("/packagekit/backend_spawn", pk_test_backend_spawn_func);
 
 	return g_test_run ();
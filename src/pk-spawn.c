@@ -39,6 +39,7 @@
 #include <fcntl.h>
 
 #include <glib/gi18n.h>
+#include <glib-unix.h>
 
 #include "pk-spawn.h"
 #include "pk-shared.h"
@@ -46,8 +47,8 @@
 static void     pk_spawn_finalize	(GObject       *object);
 
 #define PK_SPAWN_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_SPAWN, PkSpawnPrivate))
-#define PK_SPAWN_POLL_DELAY	50 /* ms */
 #define PK_SPAWN_SIGKILL_DELAY	2500 /* ms */
+#define PK_SPAWN_FRAME_FIELD_MAX	(16 * 1024 * 1024) /* bytes */
 
 struct PkSpawnPrivate
 {
@@ -55,15 +56,19 @@ struct PkSpawnPrivate
 	gint			 stdin_fd;
 	gint			 stdout_fd;
 	gint			 stderr_fd;
-	guint			 poll_id;
+	guint			 stdout_id;
+	guint			 stderr_id;
+	guint			 child_id;
 	guint			 kill_id;
 	gboolean		 finished;
 	gboolean		 background;
 	gboolean		 is_sending_exit;
 	gboolean		 is_changing_dispatcher;
 	gboolean		 allow_sigkill;
+	gboolean		 framed;
 	PkSpawnExitType		 exit;
 	GString			*stdout_buf;
+	gsize			 stdout_scanned;
 	GString			*stderr_buf;
 	gchar			*last_argv0;
 	gchar			**last_envp;
@@ -73,6 +78,7 @@ struct PkSpawnPrivate
 enum {
 	SIGNAL_EXIT,
 	SIGNAL_STDOUT,
+	SIGNAL_STDOUT_FRAME,
 	SIGNAL_STDERR,
 	SIGNAL_LAST
 };
@@ -90,56 +96,214 @@ G_DEFINE_TYPE (PkSpawn, pk_spawn, G_TYPE_OBJECT)
 
 /**
  * pk_spawn_read_fd_into_buffer:
+ *
+ * Returns: %FALSE if the other end of the pipe has been closed
  **/
 static gboolean
 pk_spawn_read_fd_into_buffer (gint fd, GString *string)
 {
-	gint bytes_read;
+	gssize bytes_read;
 	gchar buffer[BUFSIZ];
 
-	/* ITS4: ignore, we manually NULL terminate and GString cannot overflow */
-	while ((bytes_read = read (fd, buffer, BUFSIZ-1)) > 0) {
-		buffer[bytes_read] = '\0';
-		g_string_append (string, buffer);
-	}
-
-	return TRUE;
+	while ((bytes_read = read (fd, buffer, BUFSIZ)) > 0)
+		g_string_append_len (string, buffer, bytes_read);
+	if (bytes_read == 0)
+		return FALSE;
+	if (errno == EAGAIN || errno == EINTR)
+		return TRUE;
+	return FALSE;
 }
 
 /**
  * pk_spawn_emit_whole_lines:
+ *
+ * Emits each complete line in the buffer, only scanning the bytes that
+ * have been appended since the last call.
+ *
+ * Each line is removed from the buffer before it is emitted, as a handler
+ * may call pk_spawn_exit() or pk_spawn_argv() which empty the buffer.
  **/
 static gboolean
 pk_spawn_emit_whole_lines (PkSpawn *spawn, GString *string)
 {
-	guint i;
-	guint size;
-	guint bytes_processed;
-	g_auto(GStrv) lines = NULL;
+	gboolean emitted = FALSE;
+	gchar *eol;
+	gsize len;
+
+	/* the last line may be incomplete */
+	while (spawn->priv->stdout_scanned < string->len &&
+	       (eol = memchr (string->str + spawn->priv->stdout_scanned, '\n',
+			      string->len - spawn->priv->stdout_scanned)) != NULL) {
+		g_autofree gchar *line = NULL;
+
+		len = (gsize) (eol - string->str);
+		line = g_strndup (string->str, len);
+		g_string_erase (string, 0, len + 1);
+		spawn->priv->stdout_scanned = 0;
+		g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, line);
+		emitted = TRUE;
+
+		/* the rest of the output is not line based */
+		if (spawn->priv->framed)
+			break;
+	}
+	spawn->priv->stdout_scanned = string->len;
+	return emitted;
+}
 
-	/* if nothing then don't emit */
-	if (pk_strzero (string->str))
-		return FALSE;
+/**
+ * pk_spawn_emit_frames:
+ *
+ * Each frame is a one byte opcode, a one byte field count, and then each
+ * field as a big endian 32 bit length followed by that many bytes.
+ *
+ * As with lines, each frame is removed from the buffer before it is emitted.
+ **/
+static void
+pk_spawn_emit_frames (PkSpawn *spawn, GString *string)
+{
+	while (string->len >= 2) {
+		const guint8 *data = (const guint8 *) string->str;
+		gsize pos = 2;
+		guint8 opcode = data[0];
+		guint8 n_fields = data[1];
+		guint32 len;
+		guint i;
+		g_autoptr(GPtrArray) fields = NULL;
+
+		/* check we have the whole frame before copying anything */
+		for (i = 0; i < n_fields; i++) {
+			if (string->len - pos < 4)
+				break;
+			memcpy (&len, data + pos, 4);
+			len = GUINT32_FROM_BE (len);
+			if (len > PK_SPAWN_FRAME_FIELD_MAX) {
+				g_warning ("frame field of %u bytes too large, dropping output", len);
+				g_string_set_size (string, 0);
+				return;
+			}
+			if (string->len - pos - 4 < len)
+				break;
+			pos += 4 + len;
+		}
+		if (i != n_fields)
+			break;
+
+		/* split out the fields, NULL terminated so they can be used as a GStrv */
+		fields = g_ptr_array_new_full (n_fields + 1, g_free);
+		pos = 2;
+		for (i = 0; i < n_fields; i++) {
+			memcpy (&len, data + pos, 4);
+			len = GUINT32_FROM_BE (len);
+			g_ptr_array_add (fields, g_strndup (string->str + pos + 4, len));
+			pos += 4 + len;
+		}
+		g_ptr_array_add (fields, NULL);
+		g_string_erase (string, 0, pos);
+		g_signal_emit (spawn, signals [SIGNAL_STDOUT_FRAME], 0, (guint) opcode, fields);
 
-	/* split into lines - the last line may be incomplete */
-	lines = g_strsplit (string->str, "\n", 0);
-	if (lines == NULL)
-		return FALSE;
+		/* the handler may have switched back to lines */
+		if (!spawn->priv->framed)
+			break;
+	}
+}
 
-	/* find size */
-	size = g_strv_length (lines);
+/**
+ * pk_spawn_emit_stdout:
+ **/
+static void
+pk_spawn_emit_stdout (PkSpawn *spawn)
+{
+	if (!spawn->priv->framed)
+		pk_spawn_emit_whole_lines (spawn, spawn->priv->stdout_buf);
+
+	/* the text protocol may have been switched off by the last line */
+	if (spawn->priv->framed)
+		pk_spawn_emit_frames (spawn, spawn->priv->stdout_buf);
+}
+
+/**
+ * pk_spawn_set_framed:
+ *
+ * Switches the standard output from newline separated text to binary frames,
+ * which can be done from a ::stdout handler to take effect on the next byte.
+ **/
+void
+pk_spawn_set_framed (PkSpawn *spawn, gboolean framed)
+{
+	g_return_if_fail (PK_IS_SPAWN (spawn));
+	spawn->priv->framed = framed;
+}
 
-	bytes_processed = 0;
-	/* we only emit n-1 strings */
-	for (i = 0; i < (size-1); i++) {
-		g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, lines[i]);
-		/* ITS4: ignore, g_strsplit always NULL terminates */
-		bytes_processed += strlen (lines[i]) + 1;
+/**
+ * pk_spawn_emit_stderr:
+ **/
+static void
+pk_spawn_emit_stderr (PkSpawn *spawn)
+{
+	/* emit all lines on standard out in one callback, as it's all probably
+	* related to the error that just happened */
+	if (spawn->priv->stderr_buf->len != 0) {
+		g_signal_emit (spawn, signals [SIGNAL_STDERR], 0, spawn->priv->stderr_buf->str);
+		g_string_set_size (spawn->priv->stderr_buf, 0);
 	}
+}
 
-	/* remove the text we've processed */
-	g_string_erase (string, 0, bytes_processed);
-	return TRUE;
+/**
+ * pk_spawn_stdout_cb:
+ **/
+static gboolean
+pk_spawn_stdout_cb (gint fd, GIOCondition condition, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+	gboolean ret;
+
+	/* all usual output goes on standard out, only bad libraries bitch to stderr */
+	ret = pk_spawn_read_fd_into_buffer (fd, spawn->priv->stdout_buf);
+	pk_spawn_emit_stdout (spawn);
+	if (!ret || (condition & (G_IO_HUP | G_IO_ERR)) > 0) {
+		spawn->priv->stdout_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+/**
+ * pk_spawn_stderr_cb:
+ **/
+static gboolean
+pk_spawn_stderr_cb (gint fd, GIOCondition condition, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+	gboolean ret;
+
+	ret = pk_spawn_read_fd_into_buffer (fd, spawn->priv->stderr_buf);
+	pk_spawn_emit_stderr (spawn);
+	if (!ret || (condition & (G_IO_HUP | G_IO_ERR)) > 0) {
+		spawn->priv->stderr_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+/**
+ * pk_spawn_remove_sources:
+ **/
+static void
+pk_spawn_remove_sources (PkSpawn *spawn)
+{
+	if (spawn->priv->stdout_id != 0) {
+		g_source_remove (spawn->priv->stdout_id);
+		spawn->priv->stdout_id = 0;
+	}
+	if (spawn->priv->stderr_id != 0) {
+		g_source_remove (spawn->priv->stderr_id);
+		spawn->priv->stderr_id = 0;
+	}
+	if (spawn->priv->child_id != 0) {
+		g_source_remove (spawn->priv->child_id);
+		spawn->priv->child_id = 0;
+	}
 }
 
 /**
@@ -164,61 +328,29 @@ pk_spawn_exit_type_enum_to_string (PkSpawnExitType type)
 }
 
 /**
- * pk_spawn_check_child:
+ * pk_spawn_child_exited:
+ *
+ * Drains any remaining output, closes the pipes and emits ::exit.
  **/
-static gboolean
-pk_spawn_check_child (PkSpawn *spawn)
+static void
+pk_spawn_child_exited (PkSpawn *spawn, gint status)
 {
-	pid_t pid;
-	int status;
 	gint retval;
-	static guint limit_printing = 0;
 
 	/* this shouldn't happen */
 	if (spawn->priv->finished) {
 		g_warning ("finished twice!");
-		spawn->priv->poll_id = 0;
-		return FALSE;
+		return;
 	}
 
+	/* the child may have written something just before exiting */
 	pk_spawn_read_fd_into_buffer (spawn->priv->stdout_fd, spawn->priv->stdout_buf);
 	pk_spawn_read_fd_into_buffer (spawn->priv->stderr_fd, spawn->priv->stderr_buf);
+	pk_spawn_emit_stderr (spawn);
+	pk_spawn_emit_stdout (spawn);
 
-	/* emit all lines on standard out in one callback, as it's all probably
-	* related to the error that just happened */
-	if (spawn->priv->stderr_buf->len != 0) {
-		g_signal_emit (spawn, signals [SIGNAL_STDERR], 0, spawn->priv->stderr_buf->str);
-		g_string_set_size (spawn->priv->stderr_buf, 0);
-	}
-
-	/* all usual output goes on standard out, only bad libraries bitch to stderr */
-	pk_spawn_emit_whole_lines (spawn, spawn->priv->stdout_buf);
-
-	/* Only print one in twenty times to avoid filling the screen */
-	if (limit_printing++ % 20 == 0)
-		g_debug ("polling child_pid=%ld (1/20)", (long)spawn->priv->child_pid);
-
-	/* check if the child exited */
-	pid = waitpid (spawn->priv->child_pid, &status, WNOHANG);
-	if (pid == -1) {
-		g_warning ("failed to get the child PID data for %ld", (long)spawn->priv->child_pid);
-		return TRUE;
-	}
-	if (pid == 0) {
-		/* process still exist, but has not changed state */
-		return TRUE;
-	}
-	if (pid != spawn->priv->child_pid) {
-		g_warning ("some other process id was returned: got %ld and wanted %ld",
-			     (long)pid, (long)spawn->priv->child_pid);
-		return TRUE;
-	}
-
-	/* disconnect the poll as there will be no more updates */
-	if (spawn->priv->poll_id > 0) {
-		g_source_remove (spawn->priv->poll_id);
-		spawn->priv->poll_id = 0;
-	}
+	/* disconnect the watches as there will be no more updates */
+	pk_spawn_remove_sources (spawn);
 
 	/* child exited, close resources */
 	close (spawn->priv->stdin_fd);
@@ -228,6 +360,9 @@ pk_spawn_check_child (PkSpawn *spawn)
 	spawn->priv->stdout_fd = -1;
 	spawn->priv->stderr_fd = -1;
 	spawn->priv->child_pid = -1;
+	g_string_set_size (spawn->priv->stdout_buf, 0);
+	spawn->priv->stdout_scanned = 0;
+	spawn->priv->framed = FALSE;
 
 	/* use this to detect SIGKILL and SIGQUIT */
 	if (WIFSIGNALED (status)) {
@@ -242,13 +377,7 @@ pk_spawn_check_child (PkSpawn *spawn)
 			g_warning ("the child process was terminated by signal %i", WTERMSIG (status));
 			spawn->priv->exit = PK_SPAWN_EXIT_TYPE_SIGKILL;
 		}
-	} else {
-		/* check we are dead and buried */
-		if (!WIFEXITED (status)) {
-			g_warning ("the process did not exit, but waitpid() returned!");
-			return TRUE;
-		}
-
+	} else if (WIFEXITED (status)) {
 		/* get the exit code */
 		retval = WEXITSTATUS (status);
 		if (retval == 0) {
@@ -263,6 +392,10 @@ pk_spawn_check_child (PkSpawn *spawn)
 			if (spawn->priv->exit == PK_SPAWN_EXIT_TYPE_UNKNOWN)
 				spawn->priv->exit = PK_SPAWN_EXIT_TYPE_FAILED;
 		}
+	} else {
+		g_warning ("the process did not exit, but was reaped");
+		if (spawn->priv->exit == PK_SPAWN_EXIT_TYPE_UNKNOWN)
+			spawn->priv->exit = PK_SPAWN_EXIT_TYPE_FAILED;
 	}
 
 	/* officially done, although no signal yet */
@@ -283,8 +416,97 @@ pk_spawn_check_child (PkSpawn *spawn)
 	/* don't emit if we just closed an invalid dispatcher */
 	g_debug ("emitting exit %s", pk_spawn_exit_type_enum_to_string (spawn->priv->exit));
 	g_signal_emit (spawn, signals [SIGNAL_EXIT], 0, spawn->priv->exit);
+}
+
+/**
+ * pk_spawn_child_watch_cb:
+ **/
+static void
+pk_spawn_child_watch_cb (GPid pid, gint status, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+
+	/* the source is destroyed after this returns */
+	spawn->priv->child_id = 0;
+	g_spawn_close_pid (pid);
+	pk_spawn_child_exited (spawn, status);
+}
+
+/**
+ * pk_spawn_add_child_watch:
+ **/
+static void
+pk_spawn_add_child_watch (PkSpawn *spawn)
+{
+	/* sanity check */
+	if (spawn->priv->child_id != 0) {
+		g_warning ("trying to add child watch when already set");
+		g_source_remove (spawn->priv->child_id);
+	}
+	spawn->priv->child_id = g_child_watch_add (spawn->priv->child_pid,
+						   pk_spawn_child_watch_cb,
+						   spawn);
+	g_source_set_name_by_id (spawn->priv->child_id, "[PkSpawn] child watch");
+}
+
+/**
+ * pk_spawn_check_child:
+ *
+ * Synchronously checks if the child has exited, which is only used when we
+ * have to block and cannot use the child watch.
+ *
+ * Returns: %TRUE if the child is still running
+ **/
+static gboolean
+pk_spawn_check_child (PkSpawn *spawn)
+{
+	pid_t pid;
+	int status = 0;
+
+	/* this shouldn't happen */
+	if (spawn->priv->finished) {
+		g_warning ("finished twice!");
+		return FALSE;
+	}
+
+	/* keep the output flowing while we wait */
+	pk_spawn_read_fd_into_buffer (spawn->priv->stdout_fd, spawn->priv->stdout_buf);
+	pk_spawn_read_fd_into_buffer (spawn->priv->stderr_fd, spawn->priv->stderr_buf);
+	pk_spawn_emit_stderr (spawn);
+	pk_spawn_emit_stdout (spawn);
+
+	/* check if the child exited */
+	pid = waitpid (spawn->priv->child_pid, &status, WNOHANG);
+	if (pid == -1 && errno == ECHILD) {
+		/* the child watch reaped it before it was removed, and
+		 * the exit status went with it */
+		g_warning ("child_pid=%ld already reaped, exit status unknown",
+			   (long)spawn->priv->child_pid);
+		if (spawn->priv->exit == PK_SPAWN_EXIT_TYPE_UNKNOWN)
+			spawn->priv->exit = PK_SPAWN_EXIT_TYPE_FAILED;
+		pk_spawn_child_exited (spawn, 0);
+		return FALSE;
+	}
+	if (pid == -1) {
+		g_warning ("failed to get the child PID data for %ld", (long)spawn->priv->child_pid);
+		return TRUE;
+	}
+	if (pid == 0) {
+		/* process still exist, but has not changed state */
+		return TRUE;
+	}
+	if (pid != spawn->priv->child_pid) {
+		g_warning ("some other process id was returned: got %ld and wanted %ld",
+			     (long)pid, (long)spawn->priv->child_pid);
+		return TRUE;
+	}
 
-	spawn->priv->poll_id = 0;
+	/* check we are dead and buried */
+	if (!WIFEXITED (status) && !WIFSIGNALED (status)) {
+		g_warning ("the process did not exit, but waitpid() returned!");
+		return TRUE;
+	}
+	pk_spawn_child_exited (spawn, status);
 	return FALSE;
 }
 
@@ -453,6 +675,12 @@ pk_spawn_exit (PkSpawn *spawn)
 		goto out;
 	}
 
+	/* we have to reap the child ourselves as we cannot run the loop */
+	if (spawn->priv->child_id != 0) {
+		g_source_remove (spawn->priv->child_id);
+		spawn->priv->child_id = 0;
+	}
+
 	/* block until the previous script exited */
 	do {
 		g_debug ("waiting for exit");
@@ -465,10 +693,13 @@ pk_spawn_exit (PkSpawn *spawn)
 	} while (ret && count++ < 500);
 
 	/* the script exited okay */
-	if (count < 500)
+	if (count < 500) {
 		ret = TRUE;
-	else
+	} else {
 		g_warning ("failed to exit script");
+		ret = FALSE;
+		pk_spawn_add_child_watch (spawn);
+	}
 out:
 	spawn->priv->is_sending_exit = FALSE;
 	return ret;
@@ -575,17 +806,18 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 		ret = pk_spawn_exit (spawn);
 		if (!ret) {
 			g_warning ("failed to exit previous instance");
-			/* remove poll, as we can't reply on pk_spawn_check_child() */
-			if (spawn->priv->poll_id != 0) {
-				g_source_remove (spawn->priv->poll_id);
-				spawn->priv->poll_id = 0;
-			}
+			/* remove watches, as we're about to replace the fds */
+			pk_spawn_remove_sources (spawn);
 		}
 		spawn->priv->is_changing_dispatcher = FALSE;
 	}
 
 	/* create spawned object for tracking */
 	spawn->priv->finished = FALSE;
+	g_string_set_size (spawn->priv->stdout_buf, 0);
+	g_string_set_size (spawn->priv->stderr_buf, 0);
+	spawn->priv->stdout_scanned = 0;
+	spawn->priv->framed = FALSE;
 	g_debug ("creating new instance of %s", argv[0]);
 	ret = g_spawn_async_with_pipes (NULL, argv, envp,
 				 G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH,
@@ -626,7 +858,7 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 	g_strfreev (spawn->priv->last_envp);
 	spawn->priv->last_envp = g_strdupv (envp);
 
-	/* install an idle handler to check if the child returnd successfully. */
+	/* the fd watches read until the pipe would block */
 	rc = fcntl (spawn->priv->stdout_fd, F_SETFL, O_NONBLOCK);
 	if (rc < 0) {
 		ret = FALSE;
@@ -641,14 +873,21 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 	}
 
 	/* sanity check */
-	if (spawn->priv->poll_id != 0) {
-		g_warning ("trying to set timeout when already set");
-		g_source_remove (spawn->priv->poll_id);
+	if (spawn->priv->stdout_id != 0 || spawn->priv->stderr_id != 0) {
+		g_warning ("trying to add fd watches when already set");
+		pk_spawn_remove_sources (spawn);
 	}
 
-	/* poll quickly */
-	spawn->priv->poll_id = g_timeout_add (PK_SPAWN_POLL_DELAY, (GSourceFunc) pk_spawn_check_child, spawn);
-	g_source_set_name_by_id (spawn->priv->poll_id, "[PkSpawn] main poll");
+	/* process output as soon as it arrives, and the exit when it happens */
+	spawn->priv->stdout_id = g_unix_fd_add (spawn->priv->stdout_fd,
+						G_IO_IN | G_IO_HUP | G_IO_ERR,
+						pk_spawn_stdout_cb, spawn);
+	g_source_set_name_by_id (spawn->priv->stdout_id, "[PkSpawn] stdout");
+	spawn->priv->stderr_id = g_unix_fd_add (spawn->priv->stderr_fd,
+						G_IO_IN | G_IO_HUP | G_IO_ERR,
+						pk_spawn_stderr_cb, spawn);
+	g_source_set_name_by_id (spawn->priv->stderr_id, "[PkSpawn] stderr");
+	pk_spawn_add_child_watch (spawn);
 out:
 	return ret;
 }
@@ -740,6 +979,11 @@ pk_spawn_class_init (PkSpawnClass *klass)
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__STRING,
 			      G_TYPE_NONE, 1, G_TYPE_STRING);
+	signals [SIGNAL_STDOUT_FRAME] =
+		g_signal_new ("stdout-frame",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_generic,
+			      G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_POINTER);
 	signals [SIGNAL_STDERR] =
 		g_signal_new ("stderr",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
@@ -762,7 +1006,9 @@ pk_spawn_init (PkSpawn *spawn)
 	spawn->priv->stdout_fd = -1;
 	spawn->priv->stderr_fd = -1;
 	spawn->priv->stdin_fd = -1;
-	spawn->priv->poll_id = 0;
+	spawn->priv->stdout_id = 0;
+	spawn->priv->stderr_id = 0;
+	spawn->priv->child_id = 0;
 	spawn->priv->kill_id = 0;
 	spawn->priv->finished = FALSE;
 	spawn->priv->is_sending_exit = FALSE;
@@ -793,11 +1039,8 @@ pk_spawn_finalize (GObject *object)
 
 	g_return_if_fail (spawn->priv != NULL);
 
-	/* disconnect the poll in case we were cancelled before completion */
-	if (spawn->priv->poll_id != 0) {
-		g_source_remove (spawn->priv->poll_id);
-		spawn->priv->poll_id = 0;
-	}
+	/* disconnect the watches in case we were cancelled before completion */
+	pk_spawn_remove_sources (spawn);
 
 	/* disconnect the SIGKILL check */
 	if (spawn->priv->kill_id != 0) {
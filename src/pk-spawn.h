@@ -85,6 +85,8 @@ gboolean	 pk_spawn_argv				(PkSpawn	*spawn,
 gboolean	 pk_spawn_is_running			(PkSpawn	*spawn);
 gboolean	 pk_spawn_kill				(PkSpawn	*spawn);
 gboolean	 pk_spawn_exit				(PkSpawn	*spawn);
+void		 pk_spawn_set_framed			(PkSpawn	*spawn,
+							 gboolean	 framed);
 
 G_END_DECLS
 
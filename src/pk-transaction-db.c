@@ -48,12 +48,27 @@ static void     pk_transaction_db_finalize	(GObject        *object);
 
 #define PK_TRANSACTION_DB_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_TRANSACTION_DB, PkTransactionDbPrivate))
 
+/* how long a connection waits for the other one to finish writing */
+#define PK_TRANSACTION_DB_BUSY_TIMEOUT		5000 /* ms */
+
 struct PkTransactionDbPrivate
 {
 	gboolean		 loaded;
 	sqlite3			*db;
 	guint			 job_count;
 	guint			 database_save_id;
+	GHashTable		*last_action;	/* role -> timespec, ahead of the writer */
+	GThreadPool		*writer;
+	GMutex			 writer_mutex;
+	GCond			 writer_cond;
+	guint			 writer_pending;
+	GPtrArray		*pending;	/* queued records, oldest first */
+	/* only used from the writer thread */
+	sqlite3			*writer_db;
+	sqlite3_stmt		*stmt_transaction;
+	sqlite3_stmt		*stmt_packages_delete;
+	sqlite3_stmt		*stmt_packages_insert;
+	sqlite3_stmt		*stmt_last_action;
 };
 
 G_DEFINE_TYPE (PkTransactionDb, pk_transaction_db, G_TYPE_OBJECT)
@@ -68,6 +83,15 @@ typedef struct {
 	gboolean	set;
 } PkTransactionDbProxyItem;
 
+typedef struct {
+	PkTransactionDbRecord	*record;
+	gchar			*last_action;
+	gchar			*timespec;
+} PkTransactionDbJob;
+
+static void pk_transaction_db_push_job (PkTransactionDb *tdb, PkTransactionDbJob *job);
+static PkTransactionDbRecord *pk_transaction_db_record_copy (PkTransactionDbRecord *record);
+
 /**
  * pk_transaction_sqlite_transaction_cb:
  **/
@@ -212,6 +236,7 @@ pk_transaction_db_action_time_since (PkTransactionDb *tdb, PkRoleEnum role)
 	gchar *error_msg = NULL;
 	gint rc;
 	const gchar *role_text;
+	const gchar *tmp;
 	g_autofree gchar *statement = NULL;
 	g_autofree gchar *timespec = NULL;
 
@@ -220,6 +245,11 @@ pk_transaction_db_action_time_since (PkTransactionDb *tdb, PkRoleEnum role)
 
 	role_text = pk_role_enum_to_string (role);
 
+	/* reset since we started, and maybe not written yet */
+	tmp = g_hash_table_lookup (tdb->priv->last_action, role_text);
+	if (tmp != NULL)
+		return pk_transaction_db_iso8601_difference (tmp);
+
 	statement = g_strdup_printf ("SELECT timespec FROM last_action WHERE role = '%s'", role_text);
 	rc = sqlite3_exec (tdb->priv->db, statement,
 			   pk_time_action_sqlite_callback, &timespec, &error_msg);
@@ -237,174 +267,761 @@ pk_transaction_db_action_time_since (PkTransactionDb *tdb, PkRoleEnum role)
 
 /**
  * pk_transaction_db_action_time_reset:
+ *
+ * Resets the last action time of the role. The new time is visible to
+ * pk_transaction_db_action_time_since() at once and written to disk by the
+ * writer thread.
  **/
 gboolean
 pk_transaction_db_action_time_reset (PkTransactionDb *tdb, PkRoleEnum role)
 {
-	gchar *error_msg = NULL;
-	gint rc;
-	const gchar *role_text;
-	guint since;
-	g_autofree gchar *statement = NULL;
-	g_autofree gchar *timespec = NULL;
+	PkTransactionDbJob *job;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
 
-	timespec = pk_iso8601_present ();
-	role_text = pk_role_enum_to_string (role);
+	job = g_new0 (PkTransactionDbJob, 1);
+	job->last_action = g_strdup (pk_role_enum_to_string (role));
+	job->timespec = pk_iso8601_present ();
+	g_hash_table_insert (tdb->priv->last_action,
+			     g_strdup (job->last_action),
+			     g_strdup (job->timespec));
+	pk_transaction_db_push_job (tdb, job);
+	return TRUE;
+}
 
-	/* get the previous entry */
-	since = pk_transaction_db_action_time_since (tdb, role);
-	if (since == G_MAXUINT) {
-		statement = g_strdup_printf ("INSERT INTO last_action (role, timespec) VALUES ('%s', '%s')", role_text, timespec);
-	} else {
-		statement = g_strdup_printf ("UPDATE last_action SET timespec = '%s' WHERE role = '%s'", timespec, role_text);
-	}
+/**
+ * pk_transaction_db_add_transaction_stmt:
+ *
+ * Steps a prepared SELECT and hands each row to the sqlite3_exec() style
+ * callback, so both code paths build the #PkTransactionPast the same way.
+ **/
+static gboolean
+pk_transaction_db_add_transaction_stmt (PkTransactionDb *tdb,
+					sqlite3_stmt *statement,
+					GList **list)
+{
+	gint i;
+	gint n_columns;
+	gint rc;
 
-	/* update or insert the entry */
-	rc = sqlite3_exec (tdb->priv->db, statement, NULL, NULL, &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
+	n_columns = sqlite3_column_count (statement);
+	while ((rc = sqlite3_step (statement)) == SQLITE_ROW) {
+		g_autofree gchar **argv = g_new0 (gchar *, n_columns);
+		g_autofree gchar **col_name = g_new0 (gchar *, n_columns);
+		for (i = 0; i < n_columns; i++) {
+			argv[i] = (gchar *) sqlite3_column_text (statement, i);
+			col_name[i] = (gchar *) sqlite3_column_name (statement, i);
+		}
+		pk_transaction_db_add_transaction_cb (list, n_columns, argv, col_name);
+	}
+	if (rc != SQLITE_DONE) {
+		g_warning ("failed to execute statement: %s", sqlite3_errmsg (tdb->priv->db));
 		return FALSE;
 	}
 	return TRUE;
 }
 
+/**
+ * pk_transaction_db_add_transaction_record:
+ *
+ * Builds the #PkTransactionPast of a record that is still queued for the
+ * writer thread, the same way as for a row read back from the database.
+ **/
+static void
+pk_transaction_db_add_transaction_record (PkTransactionDbRecord *record, GList **list)
+{
+	gchar *argv[8];
+	gchar *col_name[] = { (gchar *) "transaction_id", (gchar *) "timespec",
+			      (gchar *) "succeeded", (gchar *) "duration",
+			      (gchar *) "role", (gchar *) "data",
+			      (gchar *) "uid", (gchar *) "cmdline" };
+	g_autofree gchar *duration = g_strdup_printf ("%u", record->duration);
+	g_autofree gchar *uid = g_strdup_printf ("%u", record->uid);
+
+	argv[0] = record->tid;
+	argv[1] = record->timespec;
+	argv[2] = (gchar *) (record->succeeded ? "1" : "0");
+	argv[3] = duration;
+	argv[4] = (gchar *) pk_role_enum_to_string (record->role);
+	argv[5] = record->data;
+	argv[6] = uid;
+	argv[7] = record->cmdline;
+	pk_transaction_db_add_transaction_cb (list, 8, argv, col_name);
+}
+
+/**
+ * pk_transaction_db_get_pending:
+ *
+ * Gets the newest queued record of each transaction that the writer
+ * thread has not written yet. A record is only dropped from the queue
+ * once it is committed, so anything missing here is in the database.
+ *
+ * Return value: (transfer container): a hash of tid to #PkTransactionDbRecord
+ **/
+static GHashTable *
+pk_transaction_db_get_pending (PkTransactionDb *tdb)
+{
+	PkTransactionDbPrivate *priv = tdb->priv;
+	GHashTable *pending;
+	guint i;
+
+	pending = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+					 (GDestroyNotify) pk_transaction_db_record_free);
+	g_mutex_lock (&priv->writer_mutex);
+	for (i = 0; i < priv->pending->len; i++) {
+		PkTransactionDbRecord *record = g_ptr_array_index (priv->pending, i);
+		record = pk_transaction_db_record_copy (record);
+		g_hash_table_replace (pending, record->tid, record);
+	}
+	g_mutex_unlock (&priv->writer_mutex);
+	return pending;
+}
+
+/**
+ * pk_transaction_db_past_sort_cb:
+ **/
+static gint
+pk_transaction_db_past_sort_cb (gconstpointer a, gconstpointer b)
+{
+	return g_strcmp0 (pk_transaction_past_get_timespec ((PkTransactionPast *) a),
+			  pk_transaction_past_get_timespec ((PkTransactionPast *) b));
+}
+
 /**
  * pk_transaction_db_get_list:
+ *
+ * Gets the newest @limit transactions, oldest first. Transactions that are
+ * still queued for the writer thread are included without waiting for it.
  **/
 GList *
 pk_transaction_db_get_list (PkTransactionDb *tdb, guint limit)
 {
-	gchar *error_msg = NULL;
 	gint rc;
+	GHashTableIter iter;
+	GList *l;
 	GList *list = NULL;
-	g_autofree gchar *statement = NULL;
+	gpointer value;
+	guint length;
+	sqlite3_stmt *statement = NULL;
+	g_autoptr(GHashTable) pending = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), NULL);
 
-	if (limit == 0) {
-		statement = g_strdup ("SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
-				      "FROM transactions ORDER BY timespec DESC");
-	} else {
-		statement = g_strdup_printf ("SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
-					     "FROM transactions ORDER BY timespec DESC LIMIT %i", limit);
-	}
-	rc = sqlite3_exec (tdb->priv->db,
-			   statement,
-			   pk_transaction_db_add_transaction_cb,
-			   &list,
-			   &error_msg);
+	/* include transactions that have just finished */
+	pending = pk_transaction_db_get_pending (tdb);
+
+	/* uses the transactions_timespec index, so a small limit does not
+	 * have to sort the entire history */
+	rc = sqlite3_prepare_v2 (tdb->priv->db,
+				 "SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
+				 "FROM transactions ORDER BY timespec DESC LIMIT ?",
+				 -1, &statement, NULL);
 	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
-		goto out;
+		g_warning ("failed to prepare statement: %s", sqlite3_errmsg (tdb->priv->db));
+		return NULL;
+	}
+
+	/* a negative limit means no limit */
+	sqlite3_bind_int64 (statement, 1, limit == 0 ? -1 : (sqlite3_int64) limit);
+	pk_transaction_db_add_transaction_stmt (tdb, statement, &list);
+	sqlite3_finalize (statement);
+
+	/* the queued records are newer than what is on disk */
+	l = list;
+	while (l != NULL) {
+		GList *next = l->next;
+		if (g_hash_table_contains (pending, pk_transaction_past_get_id (l->data))) {
+			g_object_unref (l->data);
+			list = g_list_delete_link (list, l);
+		}
+		l = next;
+	}
+	g_hash_table_iter_init (&iter, pending);
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+		pk_transaction_db_add_transaction_record (value, &list);
+	list = g_list_sort (list, pk_transaction_db_past_sort_cb);
+
+	/* drop the oldest ones again */
+	length = g_list_length (list);
+	while (limit > 0 && length-- > limit) {
+		g_object_unref (list->data);
+		list = g_list_delete_link (list, list);
 	}
-out:
 	return list;
 }
 
 /**
- * pk_transaction_db_add:
+ * pk_transaction_db_history_item_free:
  **/
-gboolean
-pk_transaction_db_add (PkTransactionDb *tdb, const gchar *tid)
+void
+pk_transaction_db_history_item_free (PkTransactionDbHistoryItem *item)
 {
-	g_autofree gchar *timespec = NULL;
-	g_autofree gchar *statement = NULL;
+	if (item->package != NULL)
+		g_object_unref (item->package);
+	g_free (item);
+}
 
-	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+/**
+ * pk_transaction_db_history_sort_cb:
+ **/
+static gint
+pk_transaction_db_history_sort_cb (gconstpointer a, gconstpointer b)
+{
+	PkTransactionDbHistoryItem *item1 = *((PkTransactionDbHistoryItem **) a);
+	PkTransactionDbHistoryItem *item2 = *((PkTransactionDbHistoryItem **) b);
+
+	/* newest first */
+	if (item1->timestamp > item2->timestamp)
+		return -1;
+	if (item1->timestamp < item2->timestamp)
+		return 1;
+	return 0;
+}
 
-	timespec = pk_iso8601_present ();
-	statement = g_strdup_printf ("INSERT INTO transactions (transaction_id, timespec) VALUES ('%s', '%s')", tid, timespec);
-	pk_transaction_db_sql_statement (tdb, statement);
-	return TRUE;
+/**
+ * pk_transaction_db_add_history_record:
+ *
+ * Adds the packages of a queued record that match @package_names, the
+ * same way as the rows of the transaction_packages table.
+ **/
+static void
+pk_transaction_db_add_history_record (GPtrArray *array,
+				      PkTransactionDbRecord *record,
+				      gchar **package_names)
+{
+	guint i;
+	gint64 timestamp = 0;
+	g_auto(GStrv) package_lines = NULL;
+	g_autoptr(GDateTime) datetime = NULL;
+
+	if (!record->succeeded || record->data == NULL)
+		return;
+
+	datetime = pk_iso8601_to_datetime (record->timespec);
+	if (datetime != NULL)
+		timestamp = g_date_time_to_unix (datetime);
+
+	package_lines = g_strsplit (record->data, "\n", -1);
+	for (i = 0; package_lines[i] != NULL; i++) {
+		PkTransactionDbHistoryItem *item;
+		g_autoptr(GError) error_local = NULL;
+		g_autoptr(PkPackage) package = pk_package_new ();
+
+		if (!pk_package_parse (package, package_lines[i], &error_local)) {
+			g_warning ("Failed to parse package: '%s': %s",
+				   package_lines[i], error_local->message);
+			continue;
+		}
+		if (!g_strv_contains ((const gchar * const *) package_names,
+				      pk_package_get_name (package)))
+			continue;
+		item = g_new0 (PkTransactionDbHistoryItem, 1);
+		item->package = g_object_ref (package);
+		item->timestamp = timestamp;
+		item->uid = record->uid;
+		g_ptr_array_add (array, item);
+	}
 }
 
 /**
- * pk_transaction_db_set_role:
+ * pk_transaction_db_get_package_history:
+ * @tdb: the #PkTransactionDb instance
+ * @package_names: package names to look up
+ * @limit: only consider the newest @limit transactions, or 0 for all
+ *
+ * Gets the packages with a matching name from all the transactions that
+ * succeeded, newest first. This only touches the transaction_packages
+ * rows for the requested names rather than parsing the whole history.
+ * Transactions that are still queued for the writer thread are included
+ * without waiting for it.
+ *
+ * Return value: (transfer container): an array of #PkTransactionDbHistoryItem
  **/
-gboolean
-pk_transaction_db_set_role (PkTransactionDb *tdb, const gchar *tid, PkRoleEnum role)
+GPtrArray *
+pk_transaction_db_get_package_history (PkTransactionDb *tdb,
+				       gchar **package_names,
+				       guint limit)
 {
-	const gchar *role_text;
-	g_autofree gchar *statement = NULL;
+	gint rc;
+	guint i;
+	GHashTableIter iter;
+	GPtrArray *array;
+	gpointer value;
+	sqlite3_stmt *statement = NULL;
+	g_autoptr(GHashTable) pending = NULL;
 
-	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), NULL);
+	g_return_val_if_fail (package_names != NULL, NULL);
 
-	role_text = pk_role_enum_to_string (role);
-	statement = g_strdup_printf ("UPDATE transactions SET role = '%s' WHERE transaction_id = '%s'", role_text, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
+	/* include transactions that have just finished */
+	pending = pk_transaction_db_get_pending (tdb);
+
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_transaction_db_history_item_free);
+	rc = sqlite3_prepare_v2 (tdb->priv->db,
+				 "SELECT p.name, p.version, p.arch, p.data, p.info, t.timespec, t.uid, "
+				 "t.transaction_id "
+				 "FROM transaction_packages p "
+				 "JOIN transactions t ON t.transaction_id = p.transaction_id "
+				 "WHERE p.name = ?1 AND t.succeeded = 1 AND "
+				 "(?2 < 0 OR t.transaction_id IN "
+				 "(SELECT transaction_id FROM transactions ORDER BY timespec DESC LIMIT ?2)) "
+				 "ORDER BY t.timespec DESC",
+				 -1, &statement, NULL);
+	if (rc != SQLITE_OK) {
+		g_warning ("failed to prepare statement: %s", sqlite3_errmsg (tdb->priv->db));
+		return array;
+	}
+	sqlite3_bind_int64 (statement, 2, limit == 0 ? -1 : (sqlite3_int64) limit);
+
+	for (i = 0; package_names[i] != NULL; i++) {
+		sqlite3_bind_text (statement, 1, package_names[i], -1, SQLITE_STATIC);
+		while ((rc = sqlite3_step (statement)) == SQLITE_ROW) {
+			PkTransactionDbHistoryItem *item;
+			g_autoptr(GDateTime) datetime = NULL;
+			g_autoptr(GError) error_local = NULL;
+			g_autofree gchar *package_id = NULL;
+
+			/* the queued record replaces this row */
+			if (g_hash_table_contains (pending, sqlite3_column_text (statement, 7)))
+				continue;
+
+			package_id = pk_package_id_build ((const gchar *) sqlite3_column_text (statement, 0),
+							  (const gchar *) sqlite3_column_text (statement, 1),
+							  (const gchar *) sqlite3_column_text (statement, 2),
+							  (const gchar *) sqlite3_column_text (statement, 3));
+			item = g_new0 (PkTransactionDbHistoryItem, 1);
+			item->package = pk_package_new ();
+			if (!pk_package_set_id (item->package, package_id, &error_local)) {
+				g_warning ("failed to parse package: '%s': %s",
+					   package_id, error_local->message);
+				pk_transaction_db_history_item_free (item);
+				continue;
+			}
+			pk_package_set_info (item->package, sqlite3_column_int (statement, 4));
+
+			/* same conversion as pk_transaction_past_get_timestamp() */
+			datetime = pk_iso8601_to_datetime ((const gchar *) sqlite3_column_text (statement, 5));
+			if (datetime != NULL)
+				item->timestamp = g_date_time_to_unix (datetime);
+			item->uid = sqlite3_column_int (statement, 6);
+			g_ptr_array_add (array, item);
+		}
+		if (rc != SQLITE_DONE)
+			g_warning ("failed to execute statement: %s", sqlite3_errmsg (tdb->priv->db));
+		sqlite3_reset (statement);
+	}
+	sqlite3_finalize (statement);
+
+	g_hash_table_iter_init (&iter, pending);
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+		pk_transaction_db_add_history_record (array, value, package_names);
+	g_ptr_array_sort (array, pk_transaction_db_history_sort_cb);
+	return array;
+}
+
+/**
+ * pk_transaction_db_record_new:
+ * @tid: the transaction ID
+ *
+ * Creates the history record of a transaction, which is filled in while
+ * it runs and written in one go with pk_transaction_db_write_record().
+ *
+ * Return value: a new #PkTransactionDbRecord, timestamped now
+ **/
+PkTransactionDbRecord *
+pk_transaction_db_record_new (const gchar *tid)
+{
+	PkTransactionDbRecord *record;
+	record = g_new0 (PkTransactionDbRecord, 1);
+	record->tid = g_strdup (tid);
+	record->timespec = pk_iso8601_present ();
+	record->role = PK_ROLE_ENUM_UNKNOWN;
+	return record;
+}
+
+/**
+ * pk_transaction_db_record_copy:
+ **/
+static PkTransactionDbRecord *
+pk_transaction_db_record_copy (PkTransactionDbRecord *record)
+{
+	PkTransactionDbRecord *copy;
+	copy = g_new0 (PkTransactionDbRecord, 1);
+	copy->tid = g_strdup (record->tid);
+	copy->timespec = g_strdup (record->timespec);
+	copy->role = record->role;
+	copy->uid = record->uid;
+	copy->cmdline = g_strdup (record->cmdline);
+	copy->data = g_strdup (record->data);
+	copy->succeeded = record->succeeded;
+	copy->duration = record->duration;
+	return copy;
+}
+
+/**
+ * pk_transaction_db_record_free:
+ **/
+void
+pk_transaction_db_record_free (PkTransactionDbRecord *record)
+{
+	g_free (record->tid);
+	g_free (record->timespec);
+	g_free (record->cmdline);
+	g_free (record->data);
+	g_free (record);
+}
+
+/**
+ * pk_transaction_db_step:
+ *
+ * Runs a prepared statement that returns no rows and readies it for the
+ * next use.
+ **/
+static gboolean
+pk_transaction_db_step (sqlite3 *db, sqlite3_stmt *statement)
+{
+	gint rc;
+	rc = sqlite3_step (statement);
+	sqlite3_reset (statement);
+	sqlite3_clear_bindings (statement);
+	if (rc != SQLITE_DONE) {
+		g_warning ("failed to execute statement: %s", sqlite3_errmsg (db));
+		return FALSE;
+	}
 	return TRUE;
 }
 
 /**
- * pk_transaction_db_set_uid:
+ * pk_transaction_db_add_packages:
+ *
+ * Splits the newline-joined "info\tpackage_id\tsummary" data of a
+ * transaction into rows of the indexed transaction_packages table, using
+ * a prepared INSERT of the six columns.
  **/
-gboolean
-pk_transaction_db_set_uid (PkTransactionDb *tdb, const gchar *tid, guint uid)
+static gboolean
+pk_transaction_db_add_packages (sqlite3 *db,
+				sqlite3_stmt *statement,
+				const gchar *tid,
+				const gchar *data)
 {
-	g_autofree gchar *statement = NULL;
+	guint i;
+	g_auto(GStrv) package_lines = NULL;
+	g_autoptr(PkPackage) package = NULL;
+
+	package = pk_package_new ();
+	package_lines = g_strsplit (data, "\n", -1);
+	for (i = 0; package_lines[i] != NULL; i++) {
+		g_autoptr(GError) error_local = NULL;
+		if (!pk_package_parse (package, package_lines[i], &error_local)) {
+			g_warning ("Failed to parse package: '%s': %s",
+				   package_lines[i], error_local->message);
+			continue;
+		}
+		sqlite3_bind_text (statement, 1, tid, -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 2, pk_package_get_name (package), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text (statement, 3, pk_package_get_version (package), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text (statement, 4, pk_package_get_arch (package), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text (statement, 5, pk_package_get_data (package), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int (statement, 6, pk_package_get_info (package));
+		if (!pk_transaction_db_step (db, statement))
+			return FALSE;
+	}
+	return TRUE;
+}
 
-	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+/**
+ * pk_transaction_db_writer_prepare:
+ **/
+static gboolean
+pk_transaction_db_writer_prepare (PkTransactionDb *tdb,
+				  const gchar *sql,
+				  sqlite3_stmt **statement)
+{
+	gint rc;
+	rc = sqlite3_prepare_v2 (tdb->priv->writer_db, sql, -1, statement, NULL);
+	if (rc != SQLITE_OK) {
+		g_warning ("failed to prepare statement: %s",
+			   sqlite3_errmsg (tdb->priv->writer_db));
+		return FALSE;
+	}
+	return TRUE;
+}
 
-	statement = g_strdup_printf ("UPDATE transactions SET uid = '%i' WHERE transaction_id = '%s'", uid, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
+/**
+ * pk_transaction_db_writer_close:
+ **/
+static void
+pk_transaction_db_writer_close (PkTransactionDb *tdb)
+{
+	PkTransactionDbPrivate *priv = tdb->priv;
+
+	g_clear_pointer (&priv->stmt_transaction, sqlite3_finalize);
+	g_clear_pointer (&priv->stmt_packages_delete, sqlite3_finalize);
+	g_clear_pointer (&priv->stmt_packages_insert, sqlite3_finalize);
+	g_clear_pointer (&priv->stmt_last_action, sqlite3_finalize);
+	g_clear_pointer (&priv->writer_db, sqlite3_close);
+}
+
+/**
+ * pk_transaction_db_writer_ensure:
+ *
+ * Opens the second connection the writer thread uses, and prepares the
+ * statements it needs once. With WAL journaling the main loop can keep
+ * reading through its own connection while this one writes.
+ **/
+static gboolean
+pk_transaction_db_writer_ensure (PkTransactionDb *tdb)
+{
+	PkTransactionDbPrivate *priv = tdb->priv;
+	gint rc;
+
+	if (priv->writer_db != NULL)
+		return TRUE;
+
+	rc = sqlite3_open (PK_DB_DIR "/transactions.db", &priv->writer_db);
+	if (rc != SQLITE_OK) {
+		g_warning ("Can't open transaction database: %s",
+			   sqlite3_errmsg (priv->writer_db));
+		sqlite3_close (priv->writer_db);
+		priv->writer_db = NULL;
+		return FALSE;
+	}
+	sqlite3_busy_timeout (priv->writer_db, PK_TRANSACTION_DB_BUSY_TIMEOUT);
+	sqlite3_exec (priv->writer_db, "PRAGMA synchronous=OFF", NULL, NULL, NULL);
+
+	if (!pk_transaction_db_writer_prepare (tdb,
+					       "INSERT OR REPLACE INTO transactions "
+					       "(transaction_id, timespec, succeeded, duration, role, data, uid, cmdline) "
+					       "VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+					       &priv->stmt_transaction))
+		goto fail;
+	if (!pk_transaction_db_writer_prepare (tdb,
+					       "DELETE FROM transaction_packages WHERE transaction_id = ?",
+					       &priv->stmt_packages_delete))
+		goto fail;
+	if (!pk_transaction_db_writer_prepare (tdb,
+					       "INSERT INTO transaction_packages "
+					       "(transaction_id, name, version, arch, data, info) "
+					       "VALUES (?, ?, ?, ?, ?, ?)",
+					       &priv->stmt_packages_insert))
+		goto fail;
+	if (!pk_transaction_db_writer_prepare (tdb,
+					       "INSERT OR REPLACE INTO last_action (role, timespec) "
+					       "VALUES (?, ?)",
+					       &priv->stmt_last_action))
+		goto fail;
 	return TRUE;
+fail:
+	/* try again from scratch for the next job */
+	pk_transaction_db_writer_close (tdb);
+	return FALSE;
 }
 
 /**
- * pk_transaction_db_set_cmdline:
+ * pk_transaction_db_write_job:
  **/
-gboolean
-pk_transaction_db_set_cmdline (PkTransactionDb *tdb, const gchar *tid, const gchar *cmdline)
+static gboolean
+pk_transaction_db_write_job (PkTransactionDb *tdb, PkTransactionDbJob *job)
 {
-	g_autofree gchar *statement = NULL;
+	PkTransactionDbPrivate *priv = tdb->priv;
+	PkTransactionDbRecord *record = job->record;
+	sqlite3_stmt *statement;
+
+	if (record != NULL) {
+		statement = priv->stmt_transaction;
+		sqlite3_bind_text (statement, 1, record->tid, -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 2, record->timespec, -1, SQLITE_STATIC);
+		sqlite3_bind_int (statement, 3, record->succeeded);
+		sqlite3_bind_int (statement, 4, record->duration);
+		sqlite3_bind_text (statement, 5, pk_role_enum_to_string (record->role), -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 6, record->data, -1, SQLITE_STATIC);
+		sqlite3_bind_int64 (statement, 7, record->uid);
+		sqlite3_bind_text (statement, 8, record->cmdline, -1, SQLITE_STATIC);
+		if (!pk_transaction_db_step (priv->writer_db, statement))
+			return FALSE;
 
-	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+		/* replace any packages previously recorded for this transaction */
+		statement = priv->stmt_packages_delete;
+		sqlite3_bind_text (statement, 1, record->tid, -1, SQLITE_STATIC);
+		if (!pk_transaction_db_step (priv->writer_db, statement))
+			return FALSE;
+		if (record->data != NULL &&
+		    !pk_transaction_db_add_packages (priv->writer_db,
+						     priv->stmt_packages_insert,
+						     record->tid,
+						     record->data))
+			return FALSE;
+	}
 
-	statement = g_strdup_printf ("UPDATE transactions SET cmdline = '%s' WHERE transaction_id = '%s'", cmdline, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
+	if (job->last_action != NULL) {
+		statement = priv->stmt_last_action;
+		sqlite3_bind_text (statement, 1, job->last_action, -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 2, job->timespec, -1, SQLITE_STATIC);
+		if (!pk_transaction_db_step (priv->writer_db, statement))
+			return FALSE;
+	}
 	return TRUE;
 }
 
 /**
- * pk_transaction_db_set_data:
+ * pk_transaction_db_writer_func:
+ *
+ * Runs in the writer thread, one job at a time and in the order they were
+ * queued, each inside a single SQLite transaction.
+ **/
+static void
+pk_transaction_db_writer_func (gpointer data, gpointer user_data)
+{
+	PkTransactionDb *tdb = PK_TRANSACTION_DB (user_data);
+	PkTransactionDbPrivate *priv = tdb->priv;
+	PkTransactionDbJob *job = (PkTransactionDbJob *) data;
+	gboolean ret;
+
+	if (!pk_transaction_db_writer_ensure (tdb))
+		goto out;
+	if (sqlite3_exec (priv->writer_db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+		g_warning ("failed to start writing history: %s",
+			   sqlite3_errmsg (priv->writer_db));
+		goto out;
+	}
+	ret = pk_transaction_db_write_job (tdb, job);
+	sqlite3_exec (priv->writer_db, ret ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL);
+out:
+	g_mutex_lock (&priv->writer_mutex);
+	/* the jobs are taken in order, so this is the oldest one */
+	if (job->record != NULL)
+		g_ptr_array_remove_index (priv->pending, 0);
+	if (--priv->writer_pending == 0)
+		g_cond_broadcast (&priv->writer_cond);
+	g_mutex_unlock (&priv->writer_mutex);
+
+	if (job->record != NULL)
+		pk_transaction_db_record_free (job->record);
+	g_free (job->last_action);
+	g_free (job->timespec);
+	g_free (job);
+}
+
+/**
+ * pk_transaction_db_push_job:
+ **/
+static void
+pk_transaction_db_push_job (PkTransactionDb *tdb, PkTransactionDbJob *job)
+{
+	PkTransactionDbPrivate *priv = tdb->priv;
+	g_mutex_lock (&priv->writer_mutex);
+	priv->writer_pending++;
+	if (job->record != NULL)
+		g_ptr_array_add (priv->pending, pk_transaction_db_record_copy (job->record));
+	g_mutex_unlock (&priv->writer_mutex);
+	g_thread_pool_push (priv->writer, job, NULL);
+}
+
+/**
+ * pk_transaction_db_add_record:
+ * @tdb: the #PkTransactionDb instance
+ * @record: the transaction that is about to run
+ *
+ * Saves the row of a transaction as it starts, so there is a record of it
+ * even if the daemon goes away before pk_transaction_db_write_record()
+ * fills in the rest. This is written synchronously on the main connection.
+ *
+ * Return value: %TRUE if the row was saved
  **/
 gboolean
-pk_transaction_db_set_data (PkTransactionDb *tdb, const gchar *tid, const gchar *data)
+pk_transaction_db_add_record (PkTransactionDb *tdb, PkTransactionDbRecord *record)
 {
-	g_autofree gchar *statement = NULL;
+	gint rc;
+	sqlite3_stmt *statement = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (record != NULL, FALSE);
+	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
 
-	/* TODO: we have to be careful of SQL injection attacks */
-	statement = g_strdup_printf ("UPDATE transactions SET data = \"%s\" WHERE transaction_id = '%s'",
-				     data, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
+	rc = sqlite3_prepare_v2 (tdb->priv->db,
+				 "INSERT OR REPLACE INTO transactions "
+				 "(transaction_id, timespec, role, uid, cmdline) "
+				 "VALUES (?, ?, ?, ?, ?)",
+				 -1, &statement, NULL);
+	if (rc != SQLITE_OK) {
+		g_warning ("failed to prepare statement: %s", sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
+	sqlite3_bind_text (statement, 1, record->tid, -1, SQLITE_STATIC);
+	sqlite3_bind_text (statement, 2, record->timespec, -1, SQLITE_STATIC);
+	sqlite3_bind_text (statement, 3, pk_role_enum_to_string (record->role), -1, SQLITE_STATIC);
+	sqlite3_bind_int64 (statement, 4, record->uid);
+	sqlite3_bind_text (statement, 5, record->cmdline, -1, SQLITE_STATIC);
+	rc = sqlite3_step (statement);
+	sqlite3_finalize (statement);
+	if (rc != SQLITE_DONE) {
+		g_warning ("failed to execute statement: %s", sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
 	return TRUE;
 }
 
 /**
- * pk_transaction_db_set_finished:
- * @runtime: time in ms
+ * pk_transaction_db_write_record:
+ * @tdb: the #PkTransactionDb instance
+ * @record: (transfer full): the finished transaction
  *
+ * Queues the history of a finished transaction to be written by the
+ * writer thread, so that the main loop never waits on the disk. If the
+ * transaction succeeded the last action time of its role is reset in the
+ * same SQLite transaction.
+ *
+ * Return value: %TRUE if the record was queued
  **/
 gboolean
-pk_transaction_db_set_finished (PkTransactionDb *tdb, const gchar *tid, gboolean success, guint runtime)
+pk_transaction_db_write_record (PkTransactionDb *tdb, PkTransactionDbRecord *record)
 {
-	g_autofree gchar *statement = NULL;
+	PkTransactionDbJob *job;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (record != NULL, FALSE);
 
-	statement = g_strdup_printf ("UPDATE transactions SET succeeded = %i, duration = %i WHERE transaction_id = '%s'",
-				     success, runtime, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
+	if (tdb->priv->db == NULL) {
+		g_warning ("PkTransactionDb not loaded");
+		pk_transaction_db_record_free (record);
+		return FALSE;
+	}
+
+	job = g_new0 (PkTransactionDbJob, 1);
+	if (record->succeeded) {
+		job->last_action = g_strdup (pk_role_enum_to_string (record->role));
+		job->timespec = pk_iso8601_present ();
+		g_hash_table_insert (tdb->priv->last_action,
+				     g_strdup (job->last_action),
+				     g_strdup (job->timespec));
+	}
+	job->record = record;
+	pk_transaction_db_push_job (tdb, job);
 	return TRUE;
 }
 
+/**
+ * pk_transaction_db_flush:
+ * @tdb: the #PkTransactionDb instance
+ *
+ * Waits until everything queued for the writer thread is on disk. The
+ * readers do not need this as they include the queued records, so this is
+ * only for when the database file itself is used.
+ **/
+void
+pk_transaction_db_flush (PkTransactionDb *tdb)
+{
+	PkTransactionDbPrivate *priv = tdb->priv;
+
+	g_return_if_fail (PK_IS_TRANSACTION_DB (tdb));
+
+	g_mutex_lock (&priv->writer_mutex);
+	while (priv->writer_pending > 0)
+		g_cond_wait (&priv->writer_cond, &priv->writer_mutex);
+	g_mutex_unlock (&priv->writer_mutex);
+}
+
 /**
  * pk_transaction_db_print:
  **/
@@ -434,6 +1051,8 @@ pk_transaction_db_empty (PkTransactionDb *tdb)
 
 	statement = "TRUNCATE TABLE transactions;";
 	sqlite3_exec (tdb->priv->db, statement, NULL, NULL, NULL);
+	statement = "DELETE FROM transaction_packages;";
+	sqlite3_exec (tdb->priv->db, statement, NULL, NULL, NULL);
 	return TRUE;
 }
 
@@ -865,6 +1484,72 @@ pk_transaction_db_execute (PkTransactionDb *tdb,
 	return ret;
 }
 
+/**
+ * pk_transaction_db_migrate_packages:
+ *
+ * Fills the transaction_packages table from the data column of all the
+ * transactions that were saved before it existed.
+ **/
+static gboolean
+pk_transaction_db_migrate_packages (PkTransactionDb *tdb, GError **error)
+{
+	gboolean ret = FALSE;
+	gint rc;
+	guint cnt = 0;
+	sqlite3_stmt *statement = NULL;
+	sqlite3_stmt *statement_insert = NULL;
+
+	rc = sqlite3_prepare_v2 (tdb->priv->db,
+				 "SELECT transaction_id, data FROM transactions "
+				 "WHERE data IS NOT NULL",
+				 -1, &statement, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0,
+			     "failed to prepare statement: %s",
+			     sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
+	rc = sqlite3_prepare_v2 (tdb->priv->db,
+				 "INSERT INTO transaction_packages "
+				 "(transaction_id, name, version, arch, data, info) "
+				 "VALUES (?, ?, ?, ?, ?, ?)",
+				 -1, &statement_insert, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0,
+			     "failed to prepare statement: %s",
+			     sqlite3_errmsg (tdb->priv->db));
+		goto out;
+	}
+	if (!pk_transaction_db_execute (tdb, "BEGIN TRANSACTION", error))
+		goto out;
+	while ((rc = sqlite3_step (statement)) == SQLITE_ROW) {
+		const gchar *tid = (const gchar *) sqlite3_column_text (statement, 0);
+		const gchar *data = (const gchar *) sqlite3_column_text (statement, 1);
+		if (!pk_transaction_db_add_packages (tdb->priv->db, statement_insert, tid, data)) {
+			g_set_error (error, 1, 0,
+				     "failed to add packages for %s", tid);
+			pk_transaction_db_execute (tdb, "ROLLBACK", NULL);
+			goto out;
+		}
+		cnt++;
+	}
+	if (rc != SQLITE_DONE) {
+		g_set_error (error, 1, 0,
+			     "failed to read transactions: %s",
+			     sqlite3_errmsg (tdb->priv->db));
+		pk_transaction_db_execute (tdb, "ROLLBACK", NULL);
+		goto out;
+	}
+	if (!pk_transaction_db_execute (tdb, "COMMIT", error))
+		goto out;
+	g_debug ("migrated packages of %u transactions", cnt);
+	ret = TRUE;
+out:
+	sqlite3_finalize (statement);
+	sqlite3_finalize (statement_insert);
+	return ret;
+}
+
 /**
  * pk_transaction_db_load:
  **/
@@ -900,6 +1585,11 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 	if (!pk_transaction_db_execute (tdb, "PRAGMA synchronous=OFF", error))
 		return FALSE;
 
+	/* let the writer thread commit while we read */
+	if (!pk_transaction_db_execute (tdb, "PRAGMA journal_mode=WAL", error))
+		return FALSE;
+	sqlite3_busy_timeout (tdb->priv->db, PK_TRANSACTION_DB_BUSY_TIMEOUT);
+
 	/* check transactions */
 	if (!pk_transaction_db_execute (tdb, "SELECT * FROM transactions LIMIT 1", &error_local)) {
 		g_debug ("creating table to repair: %s", error_local->message);
@@ -963,6 +1653,37 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 			return FALSE;
 	}
 
+	/* per-package history (since 1.1.11) */
+	if (!pk_transaction_db_execute (tdb, "SELECT * FROM transaction_packages LIMIT 1", &error_local)) {
+		g_debug ("adding table transaction_packages: %s", error_local->message);
+		g_clear_error (&error_local);
+		statement = "CREATE TABLE transaction_packages ("
+			    "transaction_id TEXT,"
+			    "name TEXT,"
+			    "version TEXT,"
+			    "arch TEXT,"
+			    "data TEXT,"
+			    "info INTEGER);";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+		statement = "CREATE INDEX transaction_packages_name "
+			    "ON transaction_packages (name);";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+		statement = "CREATE INDEX transaction_packages_transaction_id "
+			    "ON transaction_packages (transaction_id);";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+		if (!pk_transaction_db_migrate_packages (tdb, error))
+			return FALSE;
+	}
+
+	/* GetOldTransactions and the history limit sort by time */
+	statement = "CREATE INDEX IF NOT EXISTS transactions_timespec "
+		    "ON transactions (timespec);";
+	if (!pk_transaction_db_execute (tdb, statement, error))
+		return FALSE;
+
 	/* try to set correct permissions */
 	g_chmod (PK_DB_DIR "/transactions.db", 0644);
 
@@ -978,6 +1699,15 @@ static void
 pk_transaction_db_init (PkTransactionDb *tdb)
 {
 	tdb->priv = PK_TRANSACTION_DB_GET_PRIVATE (tdb);
+	tdb->priv->last_action = g_hash_table_new_full (g_str_hash, g_str_equal,
+							g_free, g_free);
+	g_mutex_init (&tdb->priv->writer_mutex);
+	g_cond_init (&tdb->priv->writer_cond);
+	tdb->priv->pending = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_transaction_db_record_free);
+
+	/* one thread, so the jobs are written in order */
+	tdb->priv->writer = g_thread_pool_new (pk_transaction_db_writer_func,
+					       tdb, 1, FALSE, NULL);
 }
 
 /**
@@ -998,6 +1728,14 @@ pk_transaction_db_finalize (GObject *object)
 		g_source_remove (tdb->priv->database_save_id);
 	}
 
+	/* write everything that is still queued */
+	g_thread_pool_free (tdb->priv->writer, FALSE, TRUE);
+	pk_transaction_db_writer_close (tdb);
+	g_mutex_clear (&tdb->priv->writer_mutex);
+	g_cond_clear (&tdb->priv->writer_cond);
+	g_ptr_array_unref (tdb->priv->pending);
+	g_hash_table_unref (tdb->priv->last_action);
+
 	/* close the database */
 	sqlite3_close (tdb->priv->db);
 
@@ -24,6 +24,7 @@
 
 #include <glib-object.h>
 #include <packagekit-glib2/pk-enum.h>
+#include <packagekit-glib2/pk-package.h>
 
 G_BEGIN_DECLS
 
@@ -47,6 +48,25 @@ typedef struct
 	GObjectClass	parent_class;
 } PkTransactionDbClass;
 
+typedef struct
+{
+	PkPackage	*package;
+	gint64		 timestamp;
+	guint		 uid;
+} PkTransactionDbHistoryItem;
+
+typedef struct
+{
+	gchar		*tid;
+	gchar		*timespec;
+	PkRoleEnum	 role;
+	guint		 uid;
+	gchar		*cmdline;
+	gchar		*data;
+	gboolean	 succeeded;
+	guint		 duration;
+} PkTransactionDbRecord;
+
 #ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkTransactionDb, g_object_unref)
 #endif
@@ -56,27 +76,20 @@ PkTransactionDb	*pk_transaction_db_new			(void);
 gboolean	 pk_transaction_db_load			(PkTransactionDb	*tdb,
 							 GError			**error);
 gboolean	 pk_transaction_db_empty		(PkTransactionDb	*tdb);
-gboolean	 pk_transaction_db_add			(PkTransactionDb	*tdb,
-							 const gchar		*tid);
 gboolean	 pk_transaction_db_print		(PkTransactionDb	*tdb);
-gboolean	 pk_transaction_db_set_role		(PkTransactionDb	*tdb,
-							 const gchar		*tid,
-							 PkRoleEnum		 role);
-gboolean	 pk_transaction_db_set_uid		(PkTransactionDb	*tdb,
-							 const gchar		*tid,
-							 guint			 uid);
-gboolean	 pk_transaction_db_set_cmdline		(PkTransactionDb	*tdb,
-							 const gchar		*tid,
-							 const gchar		*cmdline);
-gboolean	 pk_transaction_db_set_finished		(PkTransactionDb	*tdb,
-							 const gchar		*tid,
-							 gboolean		 success,
-							 guint			 runtime);
-gboolean	 pk_transaction_db_set_data		(PkTransactionDb	*tdb,
-							 const gchar		*tid,
-							 const gchar		*data);
+PkTransactionDbRecord *pk_transaction_db_record_new	(const gchar		*tid);
+void		 pk_transaction_db_record_free		(PkTransactionDbRecord	*record);
+gboolean	 pk_transaction_db_add_record		(PkTransactionDb	*tdb,
+							 PkTransactionDbRecord	*record);
+gboolean	 pk_transaction_db_write_record		(PkTransactionDb	*tdb,
+							 PkTransactionDbRecord	*record);
+void		 pk_transaction_db_flush		(PkTransactionDb	*tdb);
 GList		*pk_transaction_db_get_list		(PkTransactionDb	*tdb,
 							 guint			 limit);
+GPtrArray	*pk_transaction_db_get_package_history	(PkTransactionDb	*tdb,
+							 gchar			**package_names,
+							 guint			 limit);
+void		 pk_transaction_db_history_item_free	(PkTransactionDbHistoryItem *item);
 gboolean	 pk_transaction_db_action_time_reset	(PkTransactionDb	*tdb,
 							 PkRoleEnum		 role);
 guint		 pk_transaction_db_action_time_since	(PkTransactionDb	*tdb,
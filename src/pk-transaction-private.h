@@ -24,6 +24,12 @@
 
 #include <glib-object.h>
 #include <gio/gio.h>
+#include <polkit/polkit.h>
+
+#include "pk-auth-cache.h"
+#include "pk-dbus.h"
+#include "pk-results-cache.h"
+#include "pk-transaction-db.h"
 
 G_BEGIN_DECLS
 
@@ -40,6 +46,16 @@ void	pk_transaction_search_names	(PkTransaction	*transaction,
 void	pk_transaction_install_packages (PkTransaction *transaction,
 					 GVariant *params,
 					 GDBusMethodInvocation *context);
+void	pk_transaction_download_packages (PkTransaction *transaction,
+					 GVariant *params,
+					 GDBusMethodInvocation *context);
+void	pk_transaction_resolve		(PkTransaction	*transaction,
+					 GVariant	*params,
+					 GDBusMethodInvocation *context);
+void	pk_transaction_refresh_cache	(PkTransaction	*transaction,
+					 GVariant	*params,
+					 GDBusMethodInvocation *context);
+gboolean	 pk_transaction_is_replayed			(PkTransaction	*transaction);
 gboolean	 pk_transaction_set_sender			(PkTransaction	*transaction,
 								 const gchar	*sender);
 gboolean	 pk_transaction_filter_check			(const gchar	*filter,
@@ -48,6 +64,13 @@ gboolean	 pk_transaction_strvalidate			(const gchar	*textr,
 								 GError		**error);
 gboolean	 pk_transaction_set_tid				(PkTransaction	*transaction,
 								 const gchar	*tid);
+void		 pk_transaction_set_services			(PkTransaction	*transaction,
+								 GDBusConnection *connection,
+								 PkDbus		*dbus,
+								 PkAuthCache	*auth_cache,
+								 PkTransactionDb *transaction_db);
+void		 pk_transaction_set_results_cache		(PkTransaction	*transaction,
+								 PkResultsCache	*results_cache);
 
 
 G_END_DECLS
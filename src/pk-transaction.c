@@ -41,6 +41,7 @@
 #include <glib/gi18n.h>
 #include <gio/gio.h>
 #include <packagekit-glib2/pk-common.h>
+#include <packagekit-glib2/pk-command-index-private.h>
 #include <packagekit-glib2/pk-common-private.h>
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-offline-private.h>
@@ -79,6 +80,9 @@ static gboolean pk_transaction_is_supported_content_type (PkTransaction *transac
 /* maximum number of packages that can be processed in one go */
 #define PK_TRANSACTION_MAX_PACKAGES_TO_PROCESS	5200
 
+/* default for how often progress properties are sent to clients */
+#define PK_TRANSACTION_PROGRESS_UPDATE_INTERVAL	100 /* ms */
+
 struct PkTransactionPrivate
 {
 	PkRoleEnum		 role;
@@ -102,7 +106,7 @@ struct PkTransactionPrivate
 	PkBackendJob		*job;
 	GKeyFile		*conf;
 	PkDbus			*dbus;
-	PolkitAuthority		*authority;
+	PkAuthCache		*auth_cache;
 	PolkitSubject		*subject;
 	GCancellable		*cancellable;
 	gboolean		 skip_auth_check;
@@ -114,6 +118,22 @@ struct PkTransactionPrivate
 	gchar			*cmdline;
 	PkResults		*results;
 	PkTransactionDb		*transaction_db;
+	PkTransactionDbRecord	*record;	/* written once finished */
+
+	/* answers to earlier queries, if enabled */
+	PkResultsCache		*results_cache;
+	gchar			*results_cache_key;
+	guint			 results_cache_generation;
+	gboolean		 replayed;
+
+	/* for the metrics */
+	guint			 signal_count;
+
+	/* property changes not sent yet */
+	GHashTable		*properties_pending;	/* name -> GVariant */
+	guint			 properties_id;
+	gint64			 properties_last;	/* monotonic, us */
+	guint			 properties_interval;	/* ms */
 
 	/* cached */
 	gboolean		 cached_force;
@@ -315,26 +335,94 @@ out:
 }
 
 /**
- * pk_transaction_emit_property_changed:
+ * pk_transaction_emit_signal:
  **/
 static void
-pk_transaction_emit_property_changed (PkTransaction *transaction,
-				      const gchar *property_name,
-				      GVariant *property_value)
+pk_transaction_emit_signal (PkTransaction *transaction,
+			    const gchar *signal_name,
+			    GVariant *parameters)
+{
+	transaction->priv->signal_count++;
+	g_dbus_connection_emit_signal (transaction->priv->connection,
+				       NULL,
+				       transaction->priv->tid,
+				       PK_DBUS_INTERFACE_TRANSACTION,
+				       signal_name,
+				       parameters,
+				       NULL);
+}
+
+/**
+ * pk_transaction_get_signal_count:
+ *
+ * Return value: the number of signals sent to the client so far
+ **/
+guint
+pk_transaction_get_signal_count (PkTransaction *transaction)
 {
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), 0);
+	return transaction->priv->signal_count;
+}
+
+/**
+ * pk_transaction_get_results_size:
+ *
+ * Return value: the number of packages, details, files and repos found
+ **/
+guint
+pk_transaction_get_results_size (PkTransaction *transaction)
+{
+	PkResults *results = transaction->priv->results;
+	g_autoptr(GPtrArray) details = NULL;
+	g_autoptr(GPtrArray) files = NULL;
+	g_autoptr(GPtrArray) repo_details = NULL;
+	g_autoptr(GPtrArray) update_details = NULL;
+	g_autoptr(PkPackageSack) sack = NULL;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), 0);
+
+	/* all of these are just references */
+	sack = pk_results_get_package_sack (results);
+	details = pk_results_get_details_array (results);
+	files = pk_results_get_files_array (results);
+	repo_details = pk_results_get_repo_detail_array (results);
+	update_details = pk_results_get_update_detail_array (results);
+	return pk_package_sack_get_size (sack) +
+	       details->len + files->len + repo_details->len + update_details->len;
+}
+
+/**
+ * pk_transaction_flush_properties:
+ *
+ * Sends every pending property change in one PropertiesChanged signal.
+ **/
+static void
+pk_transaction_flush_properties (PkTransaction *transaction)
+{
+	GHashTableIter iter;
 	GVariantBuilder builder;
 	GVariantBuilder invalidated_builder;
+	GVariant *value;
+	const gchar *name;
+	PkTransactionPrivate *priv = transaction->priv;
+
+	if (priv->properties_id != 0) {
+		g_source_remove (priv->properties_id);
+		priv->properties_id = 0;
+	}
+	if (g_hash_table_size (priv->properties_pending) == 0)
+		return;
 
 	/* build the dict */
 	g_variant_builder_init (&invalidated_builder, G_VARIANT_TYPE ("as"));
 	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-	g_variant_builder_add (&builder,
-			       "{sv}",
-			       property_name,
-			       property_value);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
+	g_hash_table_iter_init (&iter, priv->properties_pending);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &name, (gpointer *) &value))
+		g_variant_builder_add (&builder, "{sv}", name, value);
+	priv->signal_count++;
+	g_dbus_connection_emit_signal (priv->connection,
 				       NULL,
-				       transaction->priv->tid,
+				       priv->tid,
 				       "org.freedesktop.DBus.Properties",
 				       "PropertiesChanged",
 				       g_variant_new ("(sa{sv}as)",
@@ -342,6 +430,75 @@ pk_transaction_emit_property_changed (PkTransaction *transaction,
 						      &builder,
 						      &invalidated_builder),
 				       NULL);
+	g_hash_table_remove_all (priv->properties_pending);
+	priv->properties_last = g_get_monotonic_time ();
+}
+
+/**
+ * pk_transaction_flush_properties_cb:
+ **/
+static gboolean
+pk_transaction_flush_properties_cb (gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+	transaction->priv->properties_id = 0;
+	pk_transaction_flush_properties (transaction);
+	return FALSE;
+}
+
+/**
+ * pk_transaction_is_progress_property:
+ **/
+static gboolean
+pk_transaction_is_progress_property (const gchar *property_name)
+{
+	const gchar *progress[] = { "Percentage",
+				    "ElapsedTime",
+				    "RemainingTime",
+				    "Speed",
+				    "DownloadSizeRemaining",
+				    NULL };
+	return g_strv_contains (progress, property_name);
+}
+
+/**
+ * pk_transaction_emit_property_changed:
+ *
+ * Progress properties are merged and sent at most once per
+ * ProgressUpdateInterval, and never more than once per main loop
+ * dispatch. Any other change is sent at once, together with the
+ * progress that is still pending, so clients see state transitions
+ * without delay and in order.
+ **/
+static void
+pk_transaction_emit_property_changed (PkTransaction *transaction,
+				      const gchar *property_name,
+				      GVariant *property_value)
+{
+	gint64 elapsed;
+	PkTransactionPrivate *priv = transaction->priv;
+
+	/* a newer value replaces the pending one */
+	g_hash_table_insert (priv->properties_pending,
+			     g_strdup (property_name),
+			     g_variant_ref_sink (property_value));
+	if (!pk_transaction_is_progress_property (property_name)) {
+		pk_transaction_flush_properties (transaction);
+		return;
+	}
+
+	/* already scheduled */
+	if (priv->properties_id != 0)
+		return;
+	elapsed = (g_get_monotonic_time () - priv->properties_last) / 1000;
+	if (elapsed >= priv->properties_interval) {
+		priv->properties_id = g_idle_add (pk_transaction_flush_properties_cb,
+						  transaction);
+	} else {
+		priv->properties_id = g_timeout_add (priv->properties_interval - elapsed,
+						     pk_transaction_flush_properties_cb,
+						     transaction);
+	}
 }
 
 /**
@@ -426,15 +583,14 @@ pk_transaction_finished_emit (PkTransaction *transaction,
 	g_debug ("emitting finished '%s', %i",
 		 pk_exit_enum_to_string (exit_enum),
 		 time_ms);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "Finished",
-				       g_variant_new ("(uu)",
-						      exit_enum,
-						      time_ms),
-				       NULL);
+
+	/* clients expect the final progress before ::Finished() */
+	pk_transaction_flush_properties (transaction);
+	pk_transaction_emit_signal (transaction,
+				    "Finished",
+				    g_variant_new ("(uu)",
+						   exit_enum,
+						   time_ms));
 
 	/* For the transaction list */
 	g_signal_emit (transaction, signals[SIGNAL_FINISHED], 0);
@@ -451,15 +607,11 @@ pk_transaction_error_code_emit (PkTransaction *transaction,
 	g_debug ("emitting error-code %s, '%s'",
 		 pk_error_enum_to_string (error_enum),
 		 details);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "ErrorCode",
-				       g_variant_new ("(us)",
-						      error_enum,
-						      details),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "ErrorCode",
+				    g_variant_new ("(us)",
+						   error_enum,
+						   details));
 }
 
 /**
@@ -544,13 +696,9 @@ pk_transaction_details_cb (PkBackendJob *job,
 		g_variant_builder_add (&builder, "{sv}", "size",
 				       g_variant_new_uint64 (size));
 
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "Details",
-				       g_variant_new ("(a{sv})", &builder),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "Details",
+				    g_variant_new ("(a{sv})", &builder));
 }
 
 /**
@@ -629,15 +777,11 @@ pk_transaction_files_cb (PkBackendJob *job,
 
 	/* emit */
 	g_debug ("emitting files %s", package_id);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "Files",
-				       g_variant_new ("(s^as)",
-						      package_id != NULL ? package_id : "",
-						      files),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "Files",
+				    g_variant_new ("(s^as)",
+						   package_id != NULL ? package_id : "",
+						   files));
 }
 
 /**
@@ -671,18 +815,14 @@ pk_transaction_category_cb (PkBackendJob *job,
 
 	/* emit */
 	g_debug ("emitting category %s, %s, %s, %s, %s ", parent_id, cat_id, name, summary, icon);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "Category",
-				       g_variant_new ("(sssss)",
-						      parent_id != NULL ? parent_id : "",
-						      cat_id,
-						      name,
-						      summary,
-						      icon != NULL ? icon : ""),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "Category",
+				    g_variant_new ("(sssss)",
+						   parent_id != NULL ? parent_id : "",
+						   cat_id,
+						   name,
+						   summary,
+						   icon != NULL ? icon : ""));
 }
 
 /**
@@ -701,16 +841,12 @@ pk_transaction_item_progress_cb (PkBackendJob *job,
 		 pk_item_progress_get_package_id (item_progress),
 		 pk_status_enum_to_string (pk_item_progress_get_status (item_progress)),
 		 pk_item_progress_get_percentage (item_progress));
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "ItemProgress",
-				       g_variant_new ("(suu)",
-						      pk_item_progress_get_package_id (item_progress),
-						      pk_item_progress_get_status (item_progress),
-						      pk_item_progress_get_percentage (item_progress)),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "ItemProgress",
+				    g_variant_new ("(suu)",
+						   pk_item_progress_get_package_id (item_progress),
+						   pk_item_progress_get_status (item_progress),
+						   pk_item_progress_get_percentage (item_progress)));
 }
 
 /**
@@ -742,16 +878,12 @@ pk_transaction_distro_upgrade_cb (PkBackendJob *job,
 	g_debug ("emitting distro-upgrade %s, %s, %s",
 		 pk_distro_upgrade_enum_to_string (state),
 		 name, summary);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "DistroUpgrade",
-				       g_variant_new ("(uss)",
-						      state,
-						      name,
-						      summary != NULL ? summary : ""),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "DistroUpgrade",
+				    g_variant_new ("(uss)",
+						   state,
+						   name,
+						   summary != NULL ? summary : ""));
 }
 
 /**
@@ -836,18 +968,12 @@ pk_transaction_set_state (PkTransaction *transaction, PkTransactionState state)
 	     priv->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
 	     priv->role == PK_ROLE_ENUM_UPDATE_PACKAGES)) {
 
-		/* add to database */
-		pk_transaction_db_add (priv->transaction_db, priv->tid);
-
-		/* save role in the database */
-		pk_transaction_db_set_role (priv->transaction_db, priv->tid, priv->role);
-
-		/* save uid */
-		pk_transaction_db_set_uid (priv->transaction_db, priv->tid, priv->uid);
-
-		/* save cmdline in db */
-		if (priv->cmdline != NULL)
-			pk_transaction_db_set_cmdline (priv->transaction_db, priv->tid, priv->cmdline);
+		/* save the history row now, and the rest when we finish */
+		priv->record = pk_transaction_db_record_new (priv->tid);
+		priv->record->role = priv->role;
+		priv->record->uid = priv->uid;
+		priv->record->cmdline = g_strdup (priv->cmdline);
+		pk_transaction_db_add_record (priv->transaction_db, priv->record);
 
 		/* report to syslog */
 		syslog (LOG_DAEMON | LOG_DEBUG,
@@ -1021,13 +1147,20 @@ pk_transaction_offline_finished (PkTransaction *transaction)
 	g_autoptr(GPtrArray) array = NULL;
 
 	/* if we're doing UpdatePackages[only-download] then update the
-	 * prepared-updates file */
+	 * prepared-updates file, remembering the solved transaction and the
+	 * package database state it was solved against */
 	transaction_flags = transaction->priv->cached_transaction_flags;
 	if (transaction->priv->role == PK_ROLE_ENUM_UPDATE_PACKAGES &&
 	    pk_bitfield_contain (transaction_flags,
 				 PK_TRANSACTION_FLAG_ENUM_ONLY_DOWNLOAD)) {
+		g_autofree gchar *fingerprint = NULL;
+		g_autoptr(GPtrArray) files = NULL;
 		package_ids = transaction->priv->cached_package_ids;
-		if (!pk_offline_auth_set_prepared_ids (package_ids, &error)) {
+		array = pk_results_get_package_array (transaction->priv->results);
+		files = pk_results_get_files_array (transaction->priv->results);
+		fingerprint = pk_offline_get_package_db_fingerprint ();
+		if (!pk_offline_auth_set_prepared_plan (package_ids, array, files,
+							fingerprint, &error)) {
 			g_warning ("failed to write offline update: %s",
 				   error->message);
 		}
@@ -1088,6 +1221,77 @@ pk_transaction_offline_finished (PkTransaction *transaction)
 	}
 }
 
+/**
+ * pk_transaction_save_command_index:
+ *
+ * Saves the executables the backend found while refreshing the metadata,
+ * so command-not-found does not have to start a transaction for a typo.
+ **/
+static void
+pk_transaction_save_command_index (PkTransaction *transaction)
+{
+	GHashTable *index;
+	g_autoptr(GError) error = NULL;
+
+	index = pk_backend_job_get_command_index (transaction->priv->job);
+	if (index == NULL)
+		return;
+	if (!pk_command_index_save (PK_COMMAND_INDEX_FILENAME, index, &error)) {
+		g_warning ("failed to save command index: %s", error->message);
+		return;
+	}
+	g_debug ("saved %u commands to %s",
+		 g_hash_table_size (index), PK_COMMAND_INDEX_FILENAME);
+}
+
+/**
+ * pk_transaction_role_changes_state:
+ **/
+static gboolean
+pk_transaction_role_changes_state (PkRoleEnum role)
+{
+	return role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
+	       role == PK_ROLE_ENUM_INSTALL_FILES ||
+	       role == PK_ROLE_ENUM_INSTALL_SIGNATURE ||
+	       role == PK_ROLE_ENUM_REMOVE_PACKAGES ||
+	       role == PK_ROLE_ENUM_UPDATE_PACKAGES ||
+	       role == PK_ROLE_ENUM_UPGRADE_SYSTEM ||
+	       role == PK_ROLE_ENUM_REPAIR_SYSTEM ||
+	       role == PK_ROLE_ENUM_REFRESH_CACHE ||
+	       role == PK_ROLE_ENUM_REPO_ENABLE ||
+	       role == PK_ROLE_ENUM_REPO_SET_DATA ||
+	       role == PK_ROLE_ENUM_REPO_REMOVE ||
+	       role == PK_ROLE_ENUM_ACCEPT_EULA;
+}
+
+/**
+ * pk_transaction_results_cache_add:
+ **/
+static void
+pk_transaction_results_cache_add (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	g_autoptr(PkError) error_code = NULL;
+
+	/* a partial answer is no answer */
+	error_code = pk_results_get_error_code (priv->results);
+	if (error_code != NULL)
+		return;
+	if (priv->emit_eula_required ||
+	    priv->emit_signature_required ||
+	    priv->emit_media_change_required)
+		return;
+
+	/* the state changed while the backend was running */
+	if (pk_backend_get_state_generation (priv->backend) != priv->results_cache_generation)
+		return;
+
+	pk_results_cache_add (priv->results_cache,
+			      priv->results_cache_key,
+			      priv->results_cache_generation,
+			      priv->results);
+}
+
 /**
  * pk_transaction_finished_cb:
  **/
@@ -1141,6 +1345,23 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 	if (exit_enum == PK_EXIT_ENUM_SUCCESS)
 		pk_transaction_finish_invalidate_caches (transaction);
 
+	/* anything remembered about the old state is now out of date */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
+	    !pk_bitfield_contain (transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE) &&
+	    pk_transaction_role_changes_state (transaction->priv->role))
+		pk_backend_state_changed (transaction->priv->backend);
+
+	/* remember the answer for the next caller asking the same */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
+	    !transaction->priv->replayed &&
+	    transaction->priv->results_cache_key != NULL)
+		pk_transaction_results_cache_add (transaction);
+
+	/* the backend may have indexed the executables it found */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
+	    transaction->priv->role == PK_ROLE_ENUM_REFRESH_CACHE)
+		pk_transaction_save_command_index (transaction);
+
 	/* find the length of time we have been running */
 	time_ms = pk_transaction_get_runtime (transaction);
 	g_debug ("backend was running for %i ms", time_ms);
@@ -1156,8 +1377,8 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 
 		/* save to database */
 		packages = pk_transaction_package_list_to_string (array);
-		if (!pk_strzero (packages))
-			pk_transaction_db_set_data (transaction->priv->transaction_db, transaction->priv->tid, packages);
+		if (transaction->priv->record != NULL && !pk_strzero (packages))
+			transaction->priv->record->data = g_steal_pointer (&packages);
 
 		/* report to syslog */
 		for (i = 0; i < array->len; i++) {
@@ -1184,15 +1405,16 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 		pk_backend_repo_list_changed (transaction->priv->backend);
 	}
 
-	/* only reset the time if we succeeded */
-	if (exit_enum == PK_EXIT_ENUM_SUCCESS)
+	/* write the history in one go, which also resets the time if we
+	 * succeeded; otherwise only reset the time if we succeeded */
+	if (transaction->priv->record != NULL) {
+		transaction->priv->record->succeeded = (exit_enum == PK_EXIT_ENUM_SUCCESS);
+		transaction->priv->record->duration = time_ms;
+		pk_transaction_db_write_record (transaction->priv->transaction_db,
+						g_steal_pointer (&transaction->priv->record));
+	} else if (exit_enum == PK_EXIT_ENUM_SUCCESS) {
 		pk_transaction_db_action_time_reset (transaction->priv->transaction_db, transaction->priv->role);
-
-	/* did we finish okay? */
-	if (exit_enum == PK_EXIT_ENUM_SUCCESS)
-		pk_transaction_db_set_finished (transaction->priv->transaction_db, transaction->priv->tid, TRUE, time_ms);
-	else
-		pk_transaction_db_set_finished (transaction->priv->transaction_db, transaction->priv->tid, FALSE, time_ms);
+	}
 
 	/* remove any inhibit */
 	//TODO: on main interface
@@ -1215,11 +1437,14 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 			time_ms);
 	}
 
-	/* this disconnects any pending signals */
-	pk_backend_job_disconnect_vfuncs (transaction->priv->job);
+	/* the backend never saw a replayed transaction */
+	if (!transaction->priv->replayed) {
+		/* this disconnects any pending signals */
+		pk_backend_job_disconnect_vfuncs (transaction->priv->job);
 
-	/* destroy the job */
-	pk_backend_stop_job (transaction->priv->backend, transaction->priv->job);
+		/* destroy the job */
+		pk_backend_stop_job (transaction->priv->backend, transaction->priv->job);
+	}
 
 	/* we emit last, as other backends will be running very soon after us, and we don't want to be notified */
 	pk_transaction_finished_emit (transaction, exit_enum, time_ms);
@@ -1296,16 +1521,12 @@ pk_transaction_package_cb (PkBackend *backend,
 			 package_id,
 			 summary);
 	}
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "Package",
-				       g_variant_new ("(uss)",
-						      info,
-						      package_id,
-						      summary ? summary : ""),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "Package",
+				    g_variant_new ("(uss)",
+						   info,
+						   package_id,
+						   summary ? summary : ""));
 }
 
 /**
@@ -1331,16 +1552,12 @@ pk_transaction_repo_detail_cb (PkBackend *backend,
 	description = pk_repo_detail_get_description (item);
 	enabled = pk_repo_detail_get_enabled (item);
 	g_debug ("emitting repo-detail %s, %s, %i", repo_id, description, enabled);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "RepoDetail",
-				       g_variant_new ("(ssb)",
-						      repo_id,
-						      description != NULL ? description : "",
-						      enabled),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "RepoDetail",
+				    g_variant_new ("(ssb)",
+						   repo_id,
+						   description != NULL ? description : "",
+						   enabled));
 }
 
 /**
@@ -1383,21 +1600,17 @@ pk_transaction_repo_signature_required_cb (PkBackend *backend,
 		 package_id, repository_name, key_url, key_userid, key_id,
 		 key_fingerprint, key_timestamp,
 		 pk_sig_type_enum_to_string (type));
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "RepoSignatureRequired",
-				       g_variant_new ("(sssssssu)",
-						      package_id,
-						      repository_name,
-						      key_url != NULL ? key_url : "",
-						      key_userid != NULL ? key_userid : "",
-						      key_id != NULL ? key_id : "",
-						      key_fingerprint != NULL ? key_fingerprint : "",
-						      key_timestamp != NULL ? key_timestamp : "",
-						      type),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "RepoSignatureRequired",
+				    g_variant_new ("(sssssssu)",
+						   package_id,
+						   repository_name,
+						   key_url != NULL ? key_url : "",
+						   key_userid != NULL ? key_userid : "",
+						   key_id != NULL ? key_id : "",
+						   key_fingerprint != NULL ? key_fingerprint : "",
+						   key_timestamp != NULL ? key_timestamp : "",
+						   type));
 
 	/* we should mark this transaction so that we finish with a special code */
 	transaction->priv->emit_signature_required = TRUE;
@@ -1431,17 +1644,13 @@ pk_transaction_eula_required_cb (PkBackend *backend,
 	/* emit */
 	g_debug ("emitting eula-required %s, %s, %s, %s",
 		   eula_id, package_id, vendor_name, license_agreement);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "EulaRequired",
-				       g_variant_new ("(ssss)",
-						      eula_id,
-						      package_id,
-						      vendor_name != NULL ? vendor_name : "",
-						      license_agreement != NULL ? license_agreement : ""),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "EulaRequired",
+				    g_variant_new ("(ssss)",
+						   eula_id,
+						   package_id,
+						   vendor_name != NULL ? vendor_name : "",
+						   license_agreement != NULL ? license_agreement : ""));
 
 	/* we should mark this transaction so that we finish with a special code */
 	transaction->priv->emit_eula_required = TRUE;
@@ -1477,16 +1686,12 @@ pk_transaction_media_change_required_cb (PkBackend *backend,
 		 pk_media_type_enum_to_string (media_type),
 		 media_id,
 		 media_text);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "MediaChangeRequired",
-				       g_variant_new ("(uss)",
-						      media_type,
-						      media_id,
-						      media_text != NULL ? media_text : ""),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "MediaChangeRequired",
+				    g_variant_new ("(uss)",
+						   media_type,
+						   media_id,
+						   media_text != NULL ? media_text : ""));
 
 	/* we should mark this transaction so that we finish with a special code */
 	transaction->priv->emit_media_change_required = TRUE;
@@ -1545,15 +1750,11 @@ pk_transaction_require_restart_cb (PkBackend *backend,
 	g_debug ("emitting require-restart %s, '%s'",
 		 pk_restart_enum_to_string (restart),
 		 package_id);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "RequireRestart",
-				       g_variant_new ("(us)",
-						      restart,
-						      package_id),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "RequireRestart",
+				    g_variant_new ("(us)",
+						   restart,
+						   package_id));
 }
 
 /**
@@ -1619,25 +1820,21 @@ pk_transaction_update_detail_cb (PkBackend *backend,
 	issued = pk_update_detail_get_issued (item);
 	updated = pk_update_detail_get_updated (item);
 	g_debug ("emitting update-detail for %s", package_id);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "UpdateDetail",
-				       g_variant_new ("(s^as^as^as^as^asussuss)",
-						      package_id,
-						      updates != NULL ? updates : empty,
-						      obsoletes != NULL ? obsoletes : empty,
-						      vendor_urls != NULL ? vendor_urls : empty,
-						      bugzilla_urls != NULL ? bugzilla_urls : empty,
-						      cve_urls != NULL ? cve_urls : empty,
-						      pk_update_detail_get_restart (item),
-						      update_text != NULL ? update_text : "",
-						      changelog != NULL ? changelog : "",
-						      pk_update_detail_get_state (item),
-						      issued != NULL ? issued : "",
-						      updated != NULL ? updated : ""),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    "UpdateDetail",
+				    g_variant_new ("(s^as^as^as^as^asussuss)",
+						   package_id,
+						   updates != NULL ? updates : empty,
+						   obsoletes != NULL ? obsoletes : empty,
+						   vendor_urls != NULL ? vendor_urls : empty,
+						   bugzilla_urls != NULL ? bugzilla_urls : empty,
+						   cve_urls != NULL ? cve_urls : empty,
+						   pk_update_detail_get_restart (item),
+						   update_text != NULL ? update_text : "",
+						   changelog != NULL ? changelog : "",
+						   pk_update_detail_get_state (item),
+						   issued != NULL ? issued : "",
+						   updated != NULL ? updated : ""));
 }
 
 /**
@@ -1743,6 +1940,100 @@ pk_transaction_percentage_cb (PkBackendJob *job,
 					      g_variant_new_uint32 (percentage));
 }
 
+/**
+ * pk_transaction_get_results_cache_key:
+ *
+ * Only read-only queries that depend on nothing but their arguments and the
+ * state of the package database are cached.
+ **/
+static gchar *
+pk_transaction_get_results_cache_key (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	GString *key;
+	const gchar *locale;
+	guint i;
+
+	if (priv->role != PK_ROLE_ENUM_RESOLVE &&
+	    priv->role != PK_ROLE_ENUM_GET_DETAILS &&
+	    priv->role != PK_ROLE_ENUM_GET_UPDATES)
+		return NULL;
+
+	/* the summaries and descriptions are translated */
+	locale = pk_backend_job_get_locale (priv->job);
+	key = g_string_new (pk_role_enum_to_string (priv->role));
+	g_string_append_printf (key, "\n%" G_GUINT64_FORMAT "\n%s",
+				priv->cached_filters,
+				locale != NULL ? locale : "");
+	if (priv->cached_package_ids != NULL) {
+		for (i = 0; priv->cached_package_ids[i] != NULL; i++)
+			g_string_append_printf (key, "\n%s", priv->cached_package_ids[i]);
+	}
+	return g_string_free (key, FALSE);
+}
+
+/**
+ * pk_transaction_replay_cached_results:
+ *
+ * Sends the results of an earlier identical query, if the backend state has
+ * not changed since, without starting the backend at all.
+ *
+ * Return value: %TRUE if the transaction has finished
+ **/
+static gboolean
+pk_transaction_replay_cached_results (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	guint i;
+	g_autoptr(GPtrArray) details = NULL;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	if (priv->results_cache == NULL)
+		return FALSE;
+	g_free (priv->results_cache_key);
+	priv->results_cache_key = pk_transaction_get_results_cache_key (transaction);
+	if (priv->results_cache_key == NULL)
+		return FALSE;
+	priv->results_cache_generation = pk_backend_get_state_generation (priv->backend);
+	results = pk_results_cache_lookup (priv->results_cache,
+					   priv->results_cache_key,
+					   priv->results_cache_generation);
+	if (results == NULL)
+		return FALSE;
+
+	g_debug ("replaying cached %s results for %s",
+		 pk_role_enum_to_string (priv->role), priv->tid);
+	priv->replayed = TRUE;
+	pk_backend_job_set_role (priv->job, priv->role);
+	packages = pk_results_get_package_array (results);
+	for (i = 0; i < packages->len; i++) {
+		pk_transaction_package_cb (priv->backend,
+					   g_ptr_array_index (packages, i),
+					   transaction);
+	}
+	details = pk_results_get_details_array (results);
+	for (i = 0; i < details->len; i++) {
+		pk_transaction_details_cb (priv->job,
+					   g_ptr_array_index (details, i),
+					   transaction);
+	}
+	pk_transaction_finished_cb (priv->job, PK_EXIT_ENUM_SUCCESS, transaction);
+	return TRUE;
+}
+
+/**
+ * pk_transaction_is_replayed:
+ *
+ * Return value: %TRUE if the results were replayed from the cache
+ **/
+gboolean
+pk_transaction_is_replayed (PkTransaction *transaction)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
+	return transaction->priv->replayed;
+}
+
 /**
  * pk_transaction_run:
  */
@@ -1774,6 +2065,10 @@ pk_transaction_run (PkTransaction *transaction)
 		return TRUE;
 	}
 
+	/* answered before? */
+	if (pk_transaction_replay_cached_results (transaction))
+		return TRUE;
+
 	/* run the job */
 	pk_backend_start_job (priv->backend, priv->job);
 
@@ -2320,7 +2615,7 @@ pk_transaction_authorize_actions_finished_cb (GObject *source_object,
 	action_id = g_ptr_array_index (data->actions, 0);
 
 	/* finish the call */
-	result = polkit_authority_check_authorization_finish (priv->authority, res, &error);
+	result = pk_auth_cache_check_finish (priv->auth_cache, res, &error);
 
 	/* failed because the request was cancelled */
 	if (g_cancellable_is_cancelled (priv->cancellable)) {
@@ -2490,15 +2785,15 @@ pk_transaction_authorize_actions (PkTransaction *transaction,
 	data->actions = g_ptr_array_ref (actions);
 
 	g_debug ("authorizing action %s", action_id);
-	/* do authorization async */
-	polkit_authority_check_authorization (priv->authority,
-					      priv->subject,
-					      action_id,
-					      details,
-					      POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
-					      priv->cancellable,
-					      (GAsyncReadyCallback) pk_transaction_authorize_actions_finished_cb,
-					      data);
+	/* do authorization async, unless polkitd said yes recently */
+	pk_auth_cache_check_async (priv->auth_cache,
+				   priv->subject,
+				   action_id,
+				   details,
+				   POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
+				   priv->cancellable,
+				   (GAsyncReadyCallback) pk_transaction_authorize_actions_finished_cb,
+				   data);
 	return TRUE;
 }
 
@@ -2911,7 +3206,7 @@ out:
 /**
  * pk_transaction_download_packages:
  **/
-static void
+void
 pk_transaction_download_packages (PkTransaction *transaction,
 				  GVariant *params,
 				  GDBusMethodInvocation *context)
@@ -3558,21 +3853,17 @@ pk_transaction_get_old_transactions (PkTransaction *transaction,
 			 tid, modified, succeeded,
 			 pk_role_enum_to_string (role),
 			 duration, data, uid, cmdline);
-		g_dbus_connection_emit_signal (transaction->priv->connection,
-					       NULL,
-					       transaction->priv->tid,
-					       PK_DBUS_INTERFACE_TRANSACTION,
-					       "Transaction",
-					       g_variant_new ("(osbuusus)",
-							      tid,
-							      modified,
-							      succeeded,
-							      role,
-							      duration,
-							      data != NULL ? data : "",
-							      uid,
-							      cmdline != NULL ? cmdline : ""),
-					       NULL);
+		pk_transaction_emit_signal (transaction,
+					    "Transaction",
+					    g_variant_new ("(osbuusus)",
+							   tid,
+							   modified,
+							   succeeded,
+							   role,
+							   duration,
+							   data != NULL ? data : "",
+							   uid,
+							   cmdline != NULL ? cmdline : ""));
 	}
 	g_list_free_full (transactions, (GDestroyNotify) g_object_unref);
 
@@ -4111,7 +4402,7 @@ out:
 /**
  * pk_transaction_refresh_cache:
  **/
-static void
+void
 pk_transaction_refresh_cache (PkTransaction *transaction,
 			      GVariant *params,
 			      GDBusMethodInvocation *context)
@@ -4429,7 +4720,7 @@ out:
 /**
  * pk_transaction_resolve:
  **/
-static void
+void
 pk_transaction_resolve (PkTransaction *transaction,
 			GVariant *params,
 			GDBusMethodInvocation *context)
@@ -4835,12 +5126,72 @@ pk_transaction_set_hint (PkTransaction *transaction,
 		return TRUE;
 	}
 
+	/* prepared-plan=updating:hal;0.1.2;i386;fedora,... */
+	if (g_strcmp0 (key, "prepared-plan") == 0) {
+		g_autoptr(GError) error_local = NULL;
+		g_autoptr(GPtrArray) plan = NULL;
+
+		/* the plan can remove packages, so only trust the
+		 * offline update, which runs as root */
+		if (priv->uid != 0) {
+			g_set_error_literal (error,
+					     PK_TRANSACTION_ERROR,
+					     PK_TRANSACTION_ERROR_REFUSED_BY_POLICY,
+					     "only root can set a prepared plan");
+			return FALSE;
+		}
+		plan = pk_offline_plan_from_string (value, &error_local);
+		if (plan == NULL) {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				     "cannot parse prepared plan: %s",
+				     error_local->message);
+			return FALSE;
+		}
+		pk_backend_job_set_prepared_plan (priv->job, plan);
+		return TRUE;
+	}
+
 	/* to preserve forwards and backwards compatibility, we ignore
 	 * extra options here */
 	g_warning ("unknown option: %s with value %s", key, value);
 	return TRUE;
 }
 
+/**
+ * pk_transaction_apply_hints:
+ *
+ * Parses "key=value" hints, as sent by SetHints() or by
+ * CreateTransactionWithHints() on the daemon interface.
+ **/
+gboolean
+pk_transaction_apply_hints (PkTransaction *transaction,
+			    gchar **hints,
+			    GError **error)
+{
+	guint i;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
+
+	for (i = 0; hints[i] != NULL; i++) {
+		g_auto(GStrv) sections = NULL;
+		sections = g_strsplit (hints[i], "=", 2);
+		if (g_strv_length (sections) != 2) {
+			g_set_error (error, PK_TRANSACTION_ERROR,
+					    PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+					    "Could not parse hint '%s'", hints[i]);
+			return FALSE;
+		}
+		if (!pk_transaction_set_hint (transaction,
+					      sections[0],
+					      sections[1],
+					      error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
 /**
  * pk_transaction_set_hints:
  */
@@ -4849,8 +5200,6 @@ pk_transaction_set_hints (PkTransaction *transaction,
 			  GVariant *params,
 			  GDBusMethodInvocation *context)
 {
-	gboolean ret;
-	guint i;
 	g_autofree gchar **hints = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *dbg = NULL;
@@ -4862,25 +5211,7 @@ pk_transaction_set_hints (PkTransaction *transaction,
 	dbg = g_strjoinv (", ", (gchar**) hints);
 	g_debug ("SetHints method called: %s", dbg);
 
-	/* parse */
-	for (i = 0; hints[i] != NULL; i++) {
-		g_auto(GStrv) sections = NULL;
-		sections = g_strsplit (hints[i], "=", 2);
-		if (g_strv_length (sections) == 2) {
-			ret = pk_transaction_set_hint (transaction,
-						       sections[0],
-						       sections[1],
-						       &error);
-			if (!ret)
-				goto out;
-		} else {
-			g_set_error (&error, PK_TRANSACTION_ERROR,
-					     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
-					     "Could not parse hint '%s'", hints[i]);
-			goto out;
-		}
-	}
-out:
+	pk_transaction_apply_hints (transaction, hints, &error);
 	pk_transaction_dbus_return (context, error);
 }
 
@@ -5371,7 +5702,6 @@ pk_transaction_set_tid (PkTransaction *transaction, const gchar *tid)
 	transaction->priv->tid = g_strdup (tid);
 
 	/* register org.freedesktop.PackageKit.Transaction */
-	transaction->priv->connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL);
 	g_assert (transaction->priv->connection != NULL);
 	transaction->priv->registration_id =
 		g_dbus_connection_register_object (transaction->priv->connection,
@@ -5385,6 +5715,47 @@ pk_transaction_set_tid (PkTransaction *transaction, const gchar *tid)
 	return TRUE;
 }
 
+/**
+ * pk_transaction_set_services:
+ *
+ * Gives the transaction the daemon-wide handles, so that creating a
+ * transaction does not need any blocking calls.
+ **/
+void
+pk_transaction_set_services (PkTransaction *transaction,
+			     GDBusConnection *connection,
+			     PkDbus *dbus,
+			     PkAuthCache *auth_cache,
+			     PkTransactionDb *transaction_db)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (G_IS_DBUS_CONNECTION (connection));
+	g_return_if_fail (PK_IS_DBUS (dbus));
+	g_return_if_fail (PK_IS_AUTH_CACHE (auth_cache));
+	g_return_if_fail (PK_IS_TRANSACTION_DB (transaction_db));
+	g_return_if_fail (priv->connection == NULL);
+
+	priv->connection = g_object_ref (connection);
+	priv->dbus = g_object_ref (dbus);
+	priv->auth_cache = g_object_ref (auth_cache);
+	priv->transaction_db = g_object_ref (transaction_db);
+}
+
+/**
+ * pk_transaction_set_results_cache:
+ **/
+void
+pk_transaction_set_results_cache (PkTransaction *transaction,
+				  PkResultsCache *results_cache)
+{
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (PK_IS_RESULTS_CACHE (results_cache));
+
+	g_set_object (&transaction->priv->results_cache, results_cache);
+}
+
 /**
  * pk_transaction_reset_after_lock_error:
  **/
@@ -5443,8 +5814,6 @@ pk_transaction_class_init (PkTransactionClass *klass)
 static void
 pk_transaction_init (PkTransaction *transaction)
 {
-	gboolean ret;
-	g_autoptr(GError) error = NULL;
 	transaction->priv = PK_TRANSACTION_GET_PRIVATE (transaction);
 	transaction->priv->allow_cancel = TRUE;
 	transaction->priv->caller_active = TRUE;
@@ -5455,18 +5824,11 @@ pk_transaction_init (PkTransaction *transaction)
 	transaction->priv->status = PK_STATUS_ENUM_WAIT;
 	transaction->priv->percentage = PK_BACKEND_PERCENTAGE_INVALID;
 	transaction->priv->state = PK_TRANSACTION_STATE_UNKNOWN;
-	transaction->priv->dbus = pk_dbus_new ();
 	transaction->priv->results = pk_results_new ();
 	transaction->priv->supported_content_types = g_ptr_array_new_with_free_func (g_free);
-	transaction->priv->authority = polkit_authority_get_sync (NULL, &error);
-	if (transaction->priv->authority == NULL)
-		g_error ("failed to get pokit authority: %s", error->message);
 	transaction->priv->cancellable = g_cancellable_new ();
-
-	transaction->priv->transaction_db = pk_transaction_db_new ();
-	ret = pk_transaction_db_load (transaction->priv->transaction_db, &error);
-	if (!ret)
-		g_error ("PkEngine: failed to load transaction db: %s", error->message);
+	transaction->priv->properties_pending = g_hash_table_new_full (g_str_hash, g_str_equal,
+								       g_free, (GDestroyNotify) g_variant_unref);
 }
 
 /**
@@ -5497,14 +5859,9 @@ pk_transaction_dispose (GObject *object)
 
 	/* send signal to clients that we are about to be destroyed */
 	if (transaction->priv->connection != NULL) {
+		pk_transaction_flush_properties (transaction);
 		g_debug ("emitting destroy %s", transaction->priv->tid);
-		g_dbus_connection_emit_signal (transaction->priv->connection,
-					       NULL,
-					       transaction->priv->tid,
-					       PK_DBUS_INTERFACE_TRANSACTION,
-					       "Destroy",
-					       NULL,
-					       NULL);
+		pk_transaction_emit_signal (transaction, "Destroy", NULL);
 	}
 
 	G_OBJECT_CLASS (pk_transaction_parent_class)->dispose (object);
@@ -5539,6 +5896,11 @@ pk_transaction_finalize (GObject *object)
 	g_free (transaction->priv->tid);
 	g_free (transaction->priv->sender);
 	g_free (transaction->priv->cmdline);
+	if (transaction->priv->properties_id != 0)
+		g_source_remove (transaction->priv->properties_id);
+	g_hash_table_unref (transaction->priv->properties_pending);
+	if (transaction->priv->record != NULL)
+		pk_transaction_db_record_free (transaction->priv->record);
 	g_ptr_array_unref (transaction->priv->supported_content_types);
 
 	if (transaction->priv->connection != NULL)
@@ -5547,13 +5909,19 @@ pk_transaction_finalize (GObject *object)
 		g_dbus_node_info_unref (transaction->priv->introspection);
 
 	g_key_file_unref (transaction->priv->conf);
-	g_object_unref (transaction->priv->dbus);
+	if (transaction->priv->dbus != NULL)
+		g_object_unref (transaction->priv->dbus);
 	if (transaction->priv->backend != NULL)
 		g_object_unref (transaction->priv->backend);
 	g_object_unref (transaction->priv->job);
-	g_object_unref (transaction->priv->transaction_db);
+	if (transaction->priv->transaction_db != NULL)
+		g_object_unref (transaction->priv->transaction_db);
 	g_object_unref (transaction->priv->results);
-	g_object_unref (transaction->priv->authority);
+	if (transaction->priv->auth_cache != NULL)
+		g_object_unref (transaction->priv->auth_cache);
+	if (transaction->priv->results_cache != NULL)
+		g_object_unref (transaction->priv->results_cache);
+	g_free (transaction->priv->results_cache_key);
 	g_object_unref (transaction->priv->cancellable);
 
 	G_OBJECT_CLASS (pk_transaction_parent_class)->finalize (object);
@@ -5568,9 +5936,23 @@ PkTransaction *
 pk_transaction_new (GKeyFile *conf, GDBusNodeInfo *introspection)
 {
 	PkTransaction *transaction;
+	gint interval;
+	g_autoptr(GError) error = NULL;
+
 	transaction = g_object_new (PK_TYPE_TRANSACTION, NULL);
 	transaction->priv->conf = g_key_file_ref (conf);
 	transaction->priv->job = pk_backend_job_new (conf);
+	transaction->priv->properties_interval = PK_TRANSACTION_PROGRESS_UPDATE_INTERVAL;
+	if (g_key_file_has_key (conf, "Daemon", "ProgressUpdateInterval", NULL)) {
+		interval = g_key_file_get_integer (conf, "Daemon", "ProgressUpdateInterval", &error);
+		if (error != NULL) {
+			g_warning ("invalid ProgressUpdateInterval: %s", error->message);
+		} else if (interval < 0) {
+			g_warning ("ignoring negative ProgressUpdateInterval %i", interval);
+		} else {
+			transaction->priv->properties_interval = interval;
+		}
+	}
 	transaction->priv->introspection = g_dbus_node_info_ref (introspection);
 	return PK_TRANSACTION (transaction);
 }
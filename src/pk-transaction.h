@@ -90,6 +90,11 @@ void		 pk_transaction_reset_after_lock_error		(PkTransaction *transaction);
 void		 pk_transaction_make_exclusive			(PkTransaction *transaction);
 void		 pk_transaction_skip_auth_checks		(PkTransaction *transaction,
 								 gboolean skip_checks);
+gboolean	 pk_transaction_apply_hints			(PkTransaction	*transaction,
+								 gchar		**hints,
+								 GError		**error);
+guint		 pk_transaction_get_signal_count		(PkTransaction	*transaction);
+guint		 pk_transaction_get_results_size		(PkTransaction	*transaction);
 
 G_END_DECLS
 